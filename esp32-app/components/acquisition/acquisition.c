@@ -0,0 +1,142 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+#include "acquisition.h"
+
+/* Data ready is polled with a period of 1/50 of the measurement interval, within these bounds */
+#define ACQUISITION_POLL_DIVIDER 50
+#define ACQUISITION_MIN_POLL_MS 10
+#define ACQUISITION_MAX_POLL_MS 100
+
+static void acquisition_sleep_until(int64_t wake_us)
+{
+    int64_t now_us = esp_timer_get_time();
+    if (wake_us > now_us)
+    {
+        vTaskDelay(pdMS_TO_TICKS((wake_us - now_us + 999) / 1000));
+    }
+}
+
+/* Account a sample that became ready at ready_us and schedule the next one */
+static void acquisition_sample_ready(acquisition_t *acquisition, int64_t ready_us)
+{
+    int64_t period_us = (int64_t)acquisition->period_ms * 1000;
+
+    if (acquisition->last_ready_us != 0)
+    {
+        /* Every sample is overwritten by the next one, a gap of n periods means n - 1 were lost */
+        int64_t periods = (ready_us - acquisition->last_ready_us + period_us / 2) / period_us;
+        if (periods > 1)
+        {
+            acquisition->stats.missed += periods - 1;
+        }
+    }
+    acquisition->last_ready_us = ready_us;
+    acquisition->next_due_us = ready_us + period_us;
+    acquisition->stats.samples++;
+}
+
+void acquisition_init(acquisition_t *acquisition, const char *name, uint32_t period_ms,
+                      acquisition_data_ready_t data_ready)
+{
+    uint32_t poll_ms = period_ms / ACQUISITION_POLL_DIVIDER;
+    if (poll_ms < ACQUISITION_MIN_POLL_MS)
+    {
+        poll_ms = ACQUISITION_MIN_POLL_MS;
+    }
+    else if (poll_ms > ACQUISITION_MAX_POLL_MS)
+    {
+        poll_ms = ACQUISITION_MAX_POLL_MS;
+    }
+
+    *acquisition = (acquisition_t){
+        .name = name,
+        .period_ms = period_ms,
+        .poll_ms = poll_ms,
+        .data_ready = data_ready,
+        /* The measurement was just started, nothing can be ready before one period */
+        .next_due_us = esp_timer_get_time() + (int64_t)period_ms * 1000,
+    };
+}
+
+int16_t acquisition_wait(acquisition_t *acquisition)
+{
+    int64_t poll_us = (int64_t)acquisition->poll_ms * 1000;
+
+    if (acquisition->data_ready == NULL)
+    {
+        /* Nothing to lock to, keep the cadence of the sensor */
+        acquisition_sleep_until(acquisition->next_due_us);
+        int64_t now_us = esp_timer_get_time();
+        int64_t ready_us = acquisition->next_due_us;
+        while (ready_us + (int64_t)acquisition->period_ms * 1000 <= now_us)
+        {
+            ready_us += (int64_t)acquisition->period_ms * 1000;
+        }
+        acquisition_sample_ready(acquisition, ready_us);
+        return 0;
+    }
+
+    /* Wake up a bit before the sample is due. While unlocked, start polling right away. */
+    if (acquisition->locked)
+    {
+        acquisition_sleep_until(acquisition->next_due_us - 2 * poll_us);
+    }
+    else
+    {
+        acquisition_sleep_until(acquisition->next_due_us - (int64_t)acquisition->period_ms * 1000);
+    }
+
+    while (1)
+    {
+        bool ready = false;
+        int16_t error = acquisition->data_ready(&ready);
+        acquisition->stats.polls++;
+        if (error)
+        {
+            return error;
+        }
+
+        int64_t now_us = esp_timer_get_time();
+        if (ready)
+        {
+            /* When the first poll already succeeds the sample was ready earlier, the next wake up
+            then moves earlier until the sensor is caught not ready once */
+            acquisition_sample_ready(acquisition, now_us);
+            acquisition->locked = true;
+            return 0;
+        }
+
+        if (acquisition->locked && now_us > acquisition->next_due_us + (int64_t)acquisition->period_ms * 1000)
+        {
+            /* More than a period late, the sensor restarted or lost a measurement */
+            acquisition->locked = false;
+        }
+        acquisition_sleep_until(now_us + poll_us);
+    }
+}
+
+bool acquisition_sample_read(acquisition_t *acquisition, const void *data, size_t size)
+{
+    /* FNV-1a */
+    const uint8_t *bytes = data;
+    uint32_t digest = 2166136261u;
+    for (size_t i = 0; i < size; i++)
+    {
+        digest = (digest ^ bytes[i]) * 16777619u;
+    }
+
+    bool duplicate = acquisition->stats.samples > 1 && digest == acquisition->last_digest;
+    if (duplicate)
+    {
+        acquisition->stats.duplicates++;
+    }
+    acquisition->last_digest = digest;
+    return duplicate;
+}
+
+void acquisition_get_stats(const acquisition_t *acquisition, acquisition_stats_t *stats)
+{
+    *stats = acquisition->stats;
+}
@@ -0,0 +1,86 @@
+#ifndef COMPONENTS_ACQUISITION_H
+#define COMPONENTS_ACQUISITION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Ask the sensor whether a new sample is ready.
+ *
+ * @param[out] ready true if a sample is ready to be read.
+ *
+ * @return 0 on success, the driver error otherwise.
+ */
+typedef int16_t (*acquisition_data_ready_t)(bool *ready);
+
+typedef struct
+{
+    uint32_t samples;    // Samples read.
+    uint32_t missed;     // Samples the sensor produced but were overwritten before being read.
+    uint32_t duplicates; // Reads that returned the same data as the previous read.
+    uint32_t polls;      // Data ready requests sent to the sensor.
+} acquisition_stats_t;
+
+/**
+ * Schedules the reads of a sensor that produces a sample every period_ms. A sensor task calls
+ * acquisition_wait() and then reads the sample exactly once.
+ *
+ * With a data ready function, the first sample is found by polling. After that the scheduler is
+ * locked to the sensor's phase: it sleeps until shortly before the next sample is due and only
+ * polls the last few milliseconds. Without a data ready function it simply keeps a fixed cadence.
+ */
+typedef struct
+{
+    const char *name;
+    uint32_t period_ms;
+    uint32_t poll_ms;
+    acquisition_data_ready_t data_ready;
+
+    bool locked;
+    int64_t last_ready_us; // When the last sample was seen ready.
+    int64_t next_due_us;   // When the next sample is expected.
+    uint32_t last_digest;  // Digest of the last sample, to detect duplicates.
+    acquisition_stats_t stats;
+} acquisition_t;
+
+/**
+ * @brief Initialize the scheduler of a sensor.
+ *
+ * @param[out] acquisition the scheduler.
+ * @param[in] name name of the sensor, used in logs.
+ * @param[in] period_ms measurement interval of the sensor.
+ * @param[in] data_ready data ready function of the sensor, NULL if it has none.
+ */
+void acquisition_init(acquisition_t *acquisition, const char *name, uint32_t period_ms,
+                      acquisition_data_ready_t data_ready);
+
+/**
+ * @brief Block until the sensor has a new sample.
+ *
+ * @param[in,out] acquisition the scheduler.
+ *
+ * @return 0 when a sample is ready, the error of the data ready function otherwise.
+ */
+int16_t acquisition_wait(acquisition_t *acquisition);
+
+/**
+ * @brief Report the sample that was read after acquisition_wait(), to count duplicates.
+ *
+ * @param[in,out] acquisition the scheduler.
+ * @param[in] data the sample as read from the sensor.
+ * @param[in] size size of data.
+ *
+ * @return true if the sample is identical to the previous one.
+ */
+bool acquisition_sample_read(acquisition_t *acquisition, const void *data, size_t size);
+
+/**
+ * @brief Get the counters of a sensor.
+ *
+ * @param[in] acquisition the scheduler.
+ * @param[out] stats copy of the counters.
+ */
+void acquisition_get_stats(const acquisition_t *acquisition, acquisition_stats_t *stats);
+
+#endif
@@ -0,0 +1,395 @@
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+
+#include "sample_bus.h"
+#include "aqi.h"
+
+#define TAG "aqi.c"
+
+/* Hourly averages kept, the European index takes the mean of a day and the NowCast the last 12
+hours */
+#define AQI_HOURS 24
+#define AQI_NOWCAST_HOURS 12
+
+/* Lowest NowCast weight factor for PM, a lower one would let the current hour alone decide */
+#define AQI_NOWCAST_MIN_WEIGHT 0.5f
+
+typedef enum
+{
+    AQI_POLLUTANT_PM2P5 = 0,
+    AQI_POLLUTANT_PM10P0,
+    AQI_POLLUTANT_MAX
+} aqi_pollutant_t;
+
+/* Samples of one hour since boot */
+typedef struct
+{
+    uint32_t hour; // Unit in hours since boot.
+    uint32_t count;
+    uint32_t sum[AQI_POLLUTANT_MAX];
+} aqi_hour_t;
+
+/* US EPA breakpoint, concentrations in tenths of ug/m3 like the samples */
+typedef struct
+{
+    uint16_t concentration_low;
+    uint16_t concentration_high;
+    uint16_t index_low;
+    uint16_t index_high;
+} aqi_breakpoint_t;
+
+/* Highest value of a level, values above the last but one entry fall into the last one */
+typedef struct
+{
+    uint16_t max;
+    aqi_level_t level;
+} aqi_threshold_t;
+
+#ifdef CONFIG_AQI_STANDARD_EU
+/* Bands of the European index, in tenths of ug/m3 */
+static const aqi_threshold_t s_eu_thresholds[AQI_POLLUTANT_MAX][AQI_LEVEL_MAX] = {
+    [AQI_POLLUTANT_PM2P5] = {
+        {50, AQI_LEVEL_GOOD},
+        {150, AQI_LEVEL_MODERATE},
+        {500, AQI_LEVEL_UNHEALTHY_FOR_SENSITIVE_GROUPS},
+        {900, AQI_LEVEL_UNHEALTHY},
+        {1400, AQI_LEVEL_VERY_UNHEALTHY},
+        {UINT16_MAX, AQI_LEVEL_HAZARDOUS},
+    },
+    [AQI_POLLUTANT_PM10P0] = {
+        {150, AQI_LEVEL_GOOD},
+        {450, AQI_LEVEL_MODERATE},
+        {1200, AQI_LEVEL_UNHEALTHY_FOR_SENSITIVE_GROUPS},
+        {1950, AQI_LEVEL_UNHEALTHY},
+        {2700, AQI_LEVEL_VERY_UNHEALTHY},
+        {UINT16_MAX, AQI_LEVEL_HAZARDOUS},
+    },
+};
+#else
+/* Breakpoints of the six categories, the category is the aqi_level_t of the same position */
+static const aqi_breakpoint_t s_us_epa_breakpoints[AQI_POLLUTANT_MAX][AQI_LEVEL_MAX] = {
+    [AQI_POLLUTANT_PM2P5] = {
+        {0, 90, 0, 50},
+        {91, 354, 51, 100},
+        {355, 554, 101, 150},
+        {555, 1254, 151, 200},
+        {1255, 2254, 201, 300},
+        {2255, 3254, 301, 500},
+    },
+    [AQI_POLLUTANT_PM10P0] = {
+        {0, 540, 0, 50},
+        {550, 1540, 51, 100},
+        {1550, 2540, 101, 150},
+        {2550, 3540, 151, 200},
+        {3550, 4240, 201, 300},
+        {4250, 6040, 301, 500},
+    },
+};
+#endif
+
+// https://greenecon.net/3-metrics-to-guide-air-quality-health-safety/carbon-footprint.html
+// Unit in ppm.
+static const aqi_threshold_t s_co2_thresholds[] = {
+    {700, AQI_LEVEL_GOOD},
+    {1000, AQI_LEVEL_MODERATE},
+    {1500, AQI_LEVEL_UNHEALTHY_FOR_SENSITIVE_GROUPS},
+    {2500, AQI_LEVEL_UNHEALTHY},
+    {5000, AQI_LEVEL_VERY_UNHEALTHY},
+    {UINT16_MAX, AQI_LEVEL_HAZARDOUS},
+};
+
+// https://www.airthings.com/en/what-is-humidity
+// Hundredths of %, like the samples.
+static const aqi_threshold_t s_rhumidity_thresholds[] = {
+    {2499, AQI_LEVEL_HAZARDOUS},
+    {2999, AQI_LEVEL_UNHEALTHY},
+    {5999, AQI_LEVEL_GOOD},
+    {6999, AQI_LEVEL_UNHEALTHY},
+    {UINT16_MAX, AQI_LEVEL_HAZARDOUS},
+};
+
+/* Only accessed by the aqi task */
+static aqi_hour_t s_hours[AQI_HOURS];
+static spmc_ring_reader_t s_pm_reader;
+static aqi_t s_working;
+
+/* Latest index, read by other tasks */
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static aqi_t s_aqi;
+
+static aqi_level_t aqi_threshold_level(const aqi_threshold_t *thresholds, uint16_t value)
+{
+    for (; value > thresholds->max; thresholds++)
+    {
+    }
+    return thresholds->level;
+}
+
+static void aqi_add_pm(const sample_bus_sample_t *sample)
+{
+    uint32_t hour = (uint32_t)(sample->timestamp_us / (3600LL * 1000000));
+    aqi_hour_t *bucket = &s_hours[hour % AQI_HOURS];
+
+    if (bucket->hour != hour)
+    {
+        /* The bucket still holds an hour of the day before */
+        memset(bucket, 0, sizeof(*bucket));
+        bucket->hour = hour;
+    }
+    bucket->sum[AQI_POLLUTANT_PM2P5] += sample->pm.mc_2p5;
+    bucket->sum[AQI_POLLUTANT_PM10P0] += sample->pm.mc_10p0;
+    bucket->count++;
+}
+
+#ifdef CONFIG_AQI_STANDARD_EU
+/* Mean of every sample of the last 24 hours */
+static bool aqi_average(uint32_t current_hour, aqi_pollutant_t pollutant, uint16_t *average)
+{
+    uint32_t sum = 0;
+    uint32_t count = 0;
+
+    for (uint32_t hours_ago = 0; hours_ago < AQI_HOURS && hours_ago <= current_hour; hours_ago++)
+    {
+        const aqi_hour_t *bucket = &s_hours[(current_hour - hours_ago) % AQI_HOURS];
+        if (bucket->count != 0 && bucket->hour == current_hour - hours_ago)
+        {
+            sum += bucket->sum[pollutant];
+            count += bucket->count;
+        }
+    }
+    if (count == 0)
+    {
+        return false;
+    }
+    *average = sum / count;
+    return true;
+}
+
+static uint16_t aqi_index(aqi_pollutant_t pollutant, uint16_t concentration, aqi_level_t *level)
+{
+    *level = aqi_threshold_level(s_eu_thresholds[pollutant], concentration);
+    return *level + 1;
+}
+#else
+/* Hourly average of hours_ago hours before current_hour. Returns false if there were no samples in
+that hour. */
+static bool aqi_hour_average(uint32_t current_hour, uint32_t hours_ago, aqi_pollutant_t pollutant, uint32_t *average)
+{
+    if (hours_ago > current_hour)
+    {
+        return false;
+    }
+    const aqi_hour_t *bucket = &s_hours[(current_hour - hours_ago) % AQI_HOURS];
+    if (bucket->count == 0 || bucket->hour != current_hour - hours_ago)
+    {
+        return false;
+    }
+    *average = bucket->sum[pollutant] / bucket->count;
+    return true;
+}
+
+/* NowCast of the EPA: the hourly averages of the last 12 hours weighted by w^hours_ago, with w the
+ratio of the lowest to the highest of them. The current hour counts with the samples it has so far.
+The EPA asks for two of the last three hours, this uses whatever hours exist so that the index is
+available right after boot. */
+static bool aqi_average(uint32_t current_hour, aqi_pollutant_t pollutant, uint16_t *average)
+{
+    uint32_t hourly[AQI_NOWCAST_HOURS];
+    bool valid[AQI_NOWCAST_HOURS];
+    uint32_t min = UINT32_MAX;
+    uint32_t max = 0;
+
+    for (uint32_t hours_ago = 0; hours_ago < AQI_NOWCAST_HOURS; hours_ago++)
+    {
+        valid[hours_ago] = aqi_hour_average(current_hour, hours_ago, pollutant, &hourly[hours_ago]);
+        if (valid[hours_ago])
+        {
+            min = hourly[hours_ago] < min ? hourly[hours_ago] : min;
+            max = hourly[hours_ago] > max ? hourly[hours_ago] : max;
+        }
+    }
+    if (min > max)
+    {
+        return false;
+    }
+
+    float weight = max > 0 ? (float)min / max : 1;
+    if (weight < AQI_NOWCAST_MIN_WEIGHT)
+    {
+        weight = AQI_NOWCAST_MIN_WEIGHT;
+    }
+
+    float weighted_sum = 0;
+    float weights = 0;
+    float factor = 1;
+    for (uint32_t hours_ago = 0; hours_ago < AQI_NOWCAST_HOURS; hours_ago++)
+    {
+        if (valid[hours_ago])
+        {
+            weighted_sum += factor * hourly[hours_ago];
+            weights += factor;
+        }
+        factor *= weight;
+    }
+    /* Truncated like the EPA does, to 0.1 ug/m3 for PM2.5 and 1 ug/m3 for PM10 */
+    *average = (uint16_t)(weighted_sum / weights);
+    if (pollutant == AQI_POLLUTANT_PM10P0)
+    {
+        *average -= *average % 10;
+    }
+    return true;
+}
+
+static uint16_t aqi_index(aqi_pollutant_t pollutant, uint16_t concentration, aqi_level_t *level)
+{
+    const aqi_breakpoint_t *breakpoints = s_us_epa_breakpoints[pollutant];
+
+    for (uint8_t i = 0; i < AQI_LEVEL_MAX; i++)
+    {
+        const aqi_breakpoint_t *breakpoint = &breakpoints[i];
+        if (concentration > breakpoint->concentration_high)
+        {
+            continue;
+        }
+
+        /* Linear between the breakpoints, rounded to the nearest integer */
+        uint32_t range = breakpoint->concentration_high - breakpoint->concentration_low;
+        uint32_t offset = concentration > breakpoint->concentration_low ? concentration - breakpoint->concentration_low : 0;
+        *level = (aqi_level_t)i;
+        return breakpoint->index_low +
+               (2 * (uint32_t)(breakpoint->index_high - breakpoint->index_low) * offset + range) / (2 * range);
+    }
+
+    /* Beyond the index */
+    *level = AQI_LEVEL_HAZARDOUS;
+    return breakpoints[AQI_LEVEL_MAX - 1].index_high;
+}
+#endif
+
+static void aqi_update_pm(uint32_t current_hour)
+{
+    uint16_t average[AQI_POLLUTANT_MAX];
+    aqi_level_t level[AQI_POLLUTANT_MAX];
+    uint16_t index[AQI_POLLUTANT_MAX];
+
+    for (uint8_t pollutant = 0; pollutant < AQI_POLLUTANT_MAX; pollutant++)
+    {
+        if (!aqi_average(current_hour, pollutant, &average[pollutant]))
+        {
+            return;
+        }
+        index[pollutant] = aqi_index(pollutant, average[pollutant], &level[pollutant]);
+    }
+
+    s_working.valid = true;
+    s_working.pm2p5_average = average[AQI_POLLUTANT_PM2P5];
+    s_working.pm10p0_average = average[AQI_POLLUTANT_PM10P0];
+    s_working.levels[AQI_INDICATOR_PM2P5] = level[AQI_POLLUTANT_PM2P5];
+    s_working.levels[AQI_INDICATOR_PM10P0] = level[AQI_POLLUTANT_PM10P0];
+    if (index[AQI_POLLUTANT_PM2P5] >= index[AQI_POLLUTANT_PM10P0])
+    {
+        s_working.index = index[AQI_POLLUTANT_PM2P5];
+        s_working.level = level[AQI_POLLUTANT_PM2P5];
+    }
+    else
+    {
+        s_working.index = index[AQI_POLLUTANT_PM10P0];
+        s_working.level = level[AQI_POLLUTANT_PM10P0];
+    }
+}
+
+static void aqi_task(void *pvParameters)
+{
+    sample_bus_subscriber_t subscriber = pvParameters;
+    uint32_t co2_sequence = 0;
+    uint32_t voc_sequence = 0;
+    sample_bus_sample_t sample;
+
+    while (1)
+    {
+        uint32_t updated = sample_bus_wait(subscriber, portMAX_DELAY);
+        bool changed = false;
+
+        if (updated & SAMPLE_BUS_SOURCE_BIT(SAMPLE_BUS_SOURCE_PM))
+        {
+            /* Every sample goes into the hourly averages, not only the latest one */
+            const spmc_ring_t *history = sample_bus_history(SAMPLE_BUS_SOURCE_PM);
+            int64_t latest_us = -1;
+            spmc_ring_status_t status;
+            while ((status = spmc_ring_pop(history, &s_pm_reader, &sample)) != SPMC_RING_EMPTY)
+            {
+                if (status == SPMC_RING_OK)
+                {
+                    aqi_add_pm(&sample);
+                    latest_us = sample.timestamp_us;
+                }
+            }
+            if (latest_us >= 0)
+            {
+                aqi_update_pm((uint32_t)(latest_us / (3600LL * 1000000)));
+                changed = true;
+            }
+        }
+
+        if (sample_bus_get_if_newer(SAMPLE_BUS_SOURCE_CO2, &co2_sequence, &sample))
+        {
+            s_working.levels[AQI_INDICATOR_CO2] = aqi_threshold_level(s_co2_thresholds, sample.co2.co2);
+            changed = true;
+        }
+
+        if (sample_bus_get_if_newer(SAMPLE_BUS_SOURCE_VOC, &voc_sequence, &sample))
+        {
+            uint16_t rhumidity = sample.voc.rhumidity > 0 ? sample.voc.rhumidity : 0;
+            s_working.levels[AQI_INDICATOR_RHUMIDITY] = aqi_threshold_level(s_rhumidity_thresholds, rhumidity);
+            changed = true;
+        }
+
+        if (changed)
+        {
+            portENTER_CRITICAL(&s_lock);
+            s_working.sequence = s_aqi.sequence + 1;
+            s_aqi = s_working;
+            portEXIT_CRITICAL(&s_lock);
+        }
+    }
+}
+
+void aqi_init()
+{
+    sample_bus_subscriber_t subscriber = sample_bus_subscribe(SAMPLE_BUS_ALL_SOURCES);
+    if (subscriber == NULL)
+    {
+        ESP_LOGE(TAG, "Error subscribing to the sample bus");
+        return;
+    }
+
+    spmc_ring_reader_init(sample_bus_history(SAMPLE_BUS_SOURCE_PM), &s_pm_reader, 0);
+
+    xTaskCreate(aqi_task, "aqi task", 1024 * 2, subscriber, 4, NULL);
+}
+
+void aqi_get(aqi_t *aqi)
+{
+    portENTER_CRITICAL(&s_lock);
+    *aqi = s_aqi;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+bool aqi_get_if_newer(uint32_t *last_sequence, aqi_t *aqi)
+{
+    bool newer = false;
+
+    portENTER_CRITICAL(&s_lock);
+    if (s_aqi.sequence != *last_sequence)
+    {
+        *aqi = s_aqi;
+        *last_sequence = aqi->sequence;
+        newer = true;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    return newer;
+}
@@ -0,0 +1,64 @@
+#ifndef COMPONENTS_AQI_H
+#define COMPONENTS_AQI_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Severity levels, from the US EPA categories. The six European index levels map to them in order:
+good, fair, moderate, poor, very poor and extremely poor. */
+typedef enum
+{
+    AQI_LEVEL_GOOD = 0,
+    AQI_LEVEL_MODERATE,
+    AQI_LEVEL_UNHEALTHY_FOR_SENSITIVE_GROUPS,
+    AQI_LEVEL_UNHEALTHY,
+    AQI_LEVEL_VERY_UNHEALTHY,
+    AQI_LEVEL_HAZARDOUS,
+    AQI_LEVEL_MAX
+} aqi_level_t;
+
+typedef enum
+{
+    AQI_INDICATOR_PM2P5 = 0,
+    AQI_INDICATOR_PM10P0,
+    AQI_INDICATOR_CO2,       // No official index, levels from common ventilation guidelines.
+    AQI_INDICATOR_RHUMIDITY, // No official index, too dry and too humid are both bad.
+    AQI_INDICATOR_MAX
+} aqi_indicator_t;
+
+typedef struct
+{
+    uint32_t sequence;       // Incremented on every update. 0 means nothing was computed yet.
+    bool valid;              // false until the first PM sample, index and the PM fields are 0 until then.
+    uint16_t index;          // Highest index of PM2.5 and PM10. 0 - 500 for the US EPA AQI, 1 - 6 for the European AQI.
+    aqi_level_t level;       // Level of index.
+    uint16_t pm2p5_average;  // Averaged concentration index is computed from. Divide by 10 to get real value. Unit in ug/m3.
+    uint16_t pm10p0_average; // Averaged concentration index is computed from. Divide by 10 to get real value. Unit in ug/m3.
+    aqi_level_t levels[AQI_INDICATOR_MAX]; // Level of every indicator, PM from the averages and the others from the latest sample.
+} aqi_t;
+
+/**
+ * @brief Start the task that computes the index whenever a sensor publishes a new sample. Call
+ * before the sensors are started so that no sample is missed.
+ */
+void aqi_init();
+
+/**
+ * @brief Get the latest index.
+ *
+ * @param[out] aqi copy of the index. aqi->sequence is 0 if nothing was computed yet.
+ */
+void aqi_get(aqi_t *aqi);
+
+/**
+ * @brief Get the latest index only if it is newer than the one the caller has seen.
+ *
+ * @param[in,out] last_sequence sequence number of the last index seen by the caller. Updated when
+ * a newer index is returned.
+ * @param[out] aqi copy of the index, only written when true is returned.
+ *
+ * @return true if a new index was copied, false otherwise.
+ */
+bool aqi_get_if_newer(uint32_t *last_sequence, aqi_t *aqi);
+
+#endif
@@ -0,0 +1,321 @@
+/* Tests of the air quality index on Linux, built once per index standard. The test includes aqi.c
+ * to feed its hourly averages directly, without the aqi task.
+ *
+ *   aqi_us_epa_test breakpoints | average | hours
+ *   aqi_eu_test breakpoints | average | hours
+ *
+ * breakpoints checks every breakpoint edge of PM2.5 and PM10 and that the index never decreases
+ * with the concentration. average checks worked examples of the NowCast, or of the 24 hour mean
+ * for the European index, with and without missing hours. hours checks that the 24 hourly slots
+ * are reused after a day, that stale slots are ignored after a gap and the index aqi_update_pm()
+ * publishes. */
+
+#include <string.h>
+
+#include "host_test.h"
+
+/* The source itself, to test its static averages and index directly */
+#include "aqi.c"
+
+#define TEST_HOUR_US (3600LL * 1000000)
+
+/* Concentrations are in tenths of ug/m3 like the samples */
+static void test_add_pm(uint32_t hour, uint32_t second, uint16_t pm2p5, uint16_t pm10p0)
+{
+    sample_bus_sample_t sample = {
+        .timestamp_us = hour * TEST_HOUR_US + second * 1000000LL,
+        .pm = {.mc_2p5 = pm2p5, .mc_10p0 = pm10p0}};
+    aqi_add_pm(&sample);
+}
+
+static void test_reset(void)
+{
+    memset(s_hours, 0, sizeof(s_hours));
+    memset(&s_working, 0, sizeof(s_working));
+}
+
+static uint16_t test_average(uint32_t current_hour, aqi_pollutant_t pollutant)
+{
+    uint16_t average;
+    HOST_CHECK(aqi_average(current_hour, pollutant, &average));
+    return average;
+}
+
+static void test_check_index(aqi_pollutant_t pollutant, uint16_t concentration, uint16_t index, aqi_level_t level)
+{
+    aqi_level_t actual_level;
+
+    HOST_CHECK_EQUAL(aqi_index(pollutant, concentration, &actual_level), index);
+    HOST_CHECK_EQUAL(actual_level, level);
+}
+
+/* The index never decreases with the concentration, nor does the level */
+static void test_monotonic(aqi_pollutant_t pollutant)
+{
+    aqi_level_t previous_level = AQI_LEVEL_GOOD;
+    uint16_t previous = 0;
+
+    for (uint32_t concentration = 0; concentration <= UINT16_MAX; concentration++)
+    {
+        aqi_level_t level;
+        uint16_t index = aqi_index(pollutant, concentration, &level);
+        HOST_CHECK(index >= previous && level >= previous_level);
+        previous = index;
+        previous_level = level;
+    }
+    HOST_CHECK_EQUAL(previous_level, AQI_LEVEL_HAZARDOUS);
+}
+
+#ifdef CONFIG_AQI_STANDARD_EU
+static void test_breakpoints(void)
+{
+    for (aqi_pollutant_t pollutant = 0; pollutant < AQI_POLLUTANT_MAX; pollutant++)
+    {
+        test_check_index(pollutant, 0, 1, AQI_LEVEL_GOOD);
+        /* Each band includes its upper bound */
+        for (uint8_t level = 0; level < AQI_LEVEL_MAX - 1; level++)
+        {
+            uint16_t max = s_eu_thresholds[pollutant][level].max;
+            test_check_index(pollutant, max, level + 1, level);
+            test_check_index(pollutant, max + 1, level + 2, level + 1);
+        }
+        test_check_index(pollutant, UINT16_MAX, 6, AQI_LEVEL_HAZARDOUS);
+        test_monotonic(pollutant);
+    }
+
+    /* The bands of the 2023 revision */
+    test_check_index(AQI_POLLUTANT_PM2P5, 50, 1, AQI_LEVEL_GOOD);
+    test_check_index(AQI_POLLUTANT_PM2P5, 150, 2, AQI_LEVEL_MODERATE);
+    test_check_index(AQI_POLLUTANT_PM2P5, 500, 3, AQI_LEVEL_UNHEALTHY_FOR_SENSITIVE_GROUPS);
+    test_check_index(AQI_POLLUTANT_PM2P5, 900, 4, AQI_LEVEL_UNHEALTHY);
+    test_check_index(AQI_POLLUTANT_PM2P5, 1400, 5, AQI_LEVEL_VERY_UNHEALTHY);
+    test_check_index(AQI_POLLUTANT_PM2P5, 1401, 6, AQI_LEVEL_HAZARDOUS);
+    test_check_index(AQI_POLLUTANT_PM10P0, 150, 1, AQI_LEVEL_GOOD);
+    test_check_index(AQI_POLLUTANT_PM10P0, 450, 2, AQI_LEVEL_MODERATE);
+    test_check_index(AQI_POLLUTANT_PM10P0, 1200, 3, AQI_LEVEL_UNHEALTHY_FOR_SENSITIVE_GROUPS);
+    test_check_index(AQI_POLLUTANT_PM10P0, 1950, 4, AQI_LEVEL_UNHEALTHY);
+    test_check_index(AQI_POLLUTANT_PM10P0, 2700, 5, AQI_LEVEL_VERY_UNHEALTHY);
+    test_check_index(AQI_POLLUTANT_PM10P0, 2701, 6, AQI_LEVEL_HAZARDOUS);
+}
+
+static void test_averages(void)
+{
+    /* The mean of the samples, not of the hourly means: 3 samples of 10 ug/m3 and one of 20 */
+    test_reset();
+    test_add_pm(5, 0, 100, 300);
+    test_add_pm(5, 1200, 100, 300);
+    test_add_pm(5, 2400, 100, 300);
+    test_add_pm(6, 0, 200, 700);
+    HOST_CHECK_EQUAL(test_average(6, AQI_POLLUTANT_PM2P5), 125);
+    HOST_CHECK_EQUAL(test_average(6, AQI_POLLUTANT_PM10P0), 400);
+
+    /* Hours without samples do not count, 23 hours later the first hour is still in */
+    HOST_CHECK_EQUAL(test_average(28, AQI_POLLUTANT_PM2P5), 125);
+    HOST_CHECK_EQUAL(test_average(29, AQI_POLLUTANT_PM2P5), 200);
+
+    /* A day without samples */
+    uint16_t average;
+    HOST_CHECK(!aqi_average(30, AQI_POLLUTANT_PM2P5, &average));
+}
+#else
+static void test_breakpoints(void)
+{
+    for (aqi_pollutant_t pollutant = 0; pollutant < AQI_POLLUTANT_MAX; pollutant++)
+    {
+        /* Both ends of every category give its index bounds */
+        for (uint8_t level = 0; level < AQI_LEVEL_MAX; level++)
+        {
+            const aqi_breakpoint_t *breakpoint = &s_us_epa_breakpoints[pollutant][level];
+            test_check_index(pollutant, breakpoint->concentration_low, breakpoint->index_low, level);
+            test_check_index(pollutant, breakpoint->concentration_high, breakpoint->index_high, level);
+            if (level > 0)
+            {
+                /* Right above the category before is the bottom of this one, also in the gaps of
+                PM10 left by its whole ug/m3 */
+                test_check_index(pollutant, s_us_epa_breakpoints[pollutant][level - 1].concentration_high + 1,
+                                 breakpoint->index_low, level);
+            }
+        }
+        /* Beyond the index */
+        uint16_t top = s_us_epa_breakpoints[pollutant][AQI_LEVEL_MAX - 1].concentration_high;
+        test_check_index(pollutant, top + 1, 500, AQI_LEVEL_HAZARDOUS);
+        test_check_index(pollutant, UINT16_MAX, 500, AQI_LEVEL_HAZARDOUS);
+        test_monotonic(pollutant);
+    }
+
+    /* The PM2.5 breakpoints of the 2024 revision, 9.0 ug/m3 is the top of good */
+    test_check_index(AQI_POLLUTANT_PM2P5, 90, 50, AQI_LEVEL_GOOD);
+    test_check_index(AQI_POLLUTANT_PM2P5, 91, 51, AQI_LEVEL_MODERATE);
+    test_check_index(AQI_POLLUTANT_PM2P5, 354, 100, AQI_LEVEL_MODERATE);
+    test_check_index(AQI_POLLUTANT_PM2P5, 355, 101, AQI_LEVEL_UNHEALTHY_FOR_SENSITIVE_GROUPS);
+    test_check_index(AQI_POLLUTANT_PM2P5, 1254, 200, AQI_LEVEL_UNHEALTHY);
+    test_check_index(AQI_POLLUTANT_PM2P5, 2255, 301, AQI_LEVEL_HAZARDOUS);
+    test_check_index(AQI_POLLUTANT_PM2P5, 3254, 500, AQI_LEVEL_HAZARDOUS);
+    /* I = (Ihi - Ilo) / (Chi - Clo) * (C - Clo) + Ilo rounded: 49 / 19.9 * (35.9 - 35.5) + 101 = 101.98 */
+    test_check_index(AQI_POLLUTANT_PM2P5, 359, 102, AQI_LEVEL_UNHEALTHY_FOR_SENSITIVE_GROUPS);
+    test_check_index(AQI_POLLUTANT_PM10P0, 540, 50, AQI_LEVEL_GOOD);
+    test_check_index(AQI_POLLUTANT_PM10P0, 550, 51, AQI_LEVEL_MODERATE);
+    test_check_index(AQI_POLLUTANT_PM10P0, 6040, 500, AQI_LEVEL_HAZARDOUS);
+}
+
+static void test_averages(void)
+{
+    /* Worked example, hourly PM2.5 means from the current hour back in ug/m3: 35.0 42.0 50.0 55.0
+    48.0 40.0 30.0 28.0 30.0 33.0 36.0 40.0. w = 28 / 55 = 0.509, the NowCast is
+    sum(w^i * c_i) / sum(w^i) = 40.38, truncated to 40.3 ug/m3. AQI: 49 / 19.9 * (40.3 - 35.5) + 101
+    = 112.8, 113. */
+    static const uint16_t hourly[AQI_NOWCAST_HOURS] = {350, 420, 500, 550, 480, 400, 300, 280, 300, 330, 360, 400};
+    test_reset();
+    for (uint32_t hours_ago = 0; hours_ago < AQI_NOWCAST_HOURS; hours_ago++)
+    {
+        /* Two samples an hour, their mean is the hourly value */
+        test_add_pm(100 - hours_ago, 0, hourly[hours_ago] - 10, 0);
+        test_add_pm(100 - hours_ago, 1800, hourly[hours_ago] + 10, 0);
+    }
+    /* Older than 12 hours, not part of the NowCast */
+    test_add_pm(100 - AQI_NOWCAST_HOURS, 0, 3000, 0);
+    HOST_CHECK_EQUAL(test_average(100, AQI_POLLUTANT_PM2P5), 403);
+    test_check_index(AQI_POLLUTANT_PM2P5, 403, 113, AQI_LEVEL_UNHEALTHY_FOR_SENSITIVE_GROUPS);
+
+    /* A missing hour keeps its weight factor: 20.0 now and 10.0 two hours ago, w = 0.5,
+    (20 + 0.25 * 10) / (1 + 0.25) = 18.0 */
+    test_reset();
+    test_add_pm(50, 0, 200, 0);
+    test_add_pm(48, 0, 100, 0);
+    HOST_CHECK_EQUAL(test_average(50, AQI_POLLUTANT_PM2P5), 180);
+
+    /* A weight factor below 0.5 is raised to it: 100.0 now and 20.0 an hour ago, w = 0.2 raised
+    to 0.5, (100 + 0.5 * 20) / 1.5 = 73.33, AQI 49 / 69.9 * (73.3 - 55.5) + 151 = 163.5, 163 */
+    test_reset();
+    test_add_pm(50, 0, 1000, 0);
+    test_add_pm(49, 0, 200, 0);
+    HOST_CHECK_EQUAL(test_average(50, AQI_POLLUTANT_PM2P5), 733);
+    test_check_index(AQI_POLLUTANT_PM2P5, 733, 163, AQI_LEVEL_UNHEALTHY);
+
+    /* PM10 is truncated to whole ug/m3: 155 120 90 80, w = 80 / 155, NowCast 131.2 down to 131.
+    AQI 49 / 99 * (131 - 55) + 51 = 88.6, 89 */
+    static const uint16_t pm10[] = {1550, 1200, 900, 800};
+    test_reset();
+    for (uint32_t hours_ago = 0; hours_ago < sizeof(pm10) / sizeof(pm10[0]); hours_ago++)
+    {
+        test_add_pm(20 - hours_ago, 0, 0, pm10[hours_ago]);
+    }
+    HOST_CHECK_EQUAL(test_average(20, AQI_POLLUTANT_PM10P0), 1310);
+    test_check_index(AQI_POLLUTANT_PM10P0, 1310, 89, AQI_LEVEL_MODERATE);
+
+    /* Only the current hour, and a constant concentration, give the concentration itself */
+    test_reset();
+    test_add_pm(0, 10, 123, 450);
+    HOST_CHECK_EQUAL(test_average(0, AQI_POLLUTANT_PM2P5), 123);
+    HOST_CHECK_EQUAL(test_average(0, AQI_POLLUTANT_PM10P0), 450);
+    for (uint32_t hour = 1; hour < 30; hour++)
+    {
+        test_add_pm(hour, 0, 123, 450);
+        HOST_CHECK_EQUAL(test_average(hour, AQI_POLLUTANT_PM2P5), 123);
+    }
+
+    /* No sample in the last 12 hours */
+    uint16_t average;
+    HOST_CHECK(!aqi_average(29 + AQI_NOWCAST_HOURS, AQI_POLLUTANT_PM2P5, &average));
+}
+#endif
+
+static void test_hours(void)
+{
+    /* A sample every hour for 30 hours, the slots of the first 6 hours hold hours 24 to 29 */
+    test_reset();
+    for (uint32_t hour = 0; hour < 30; hour++)
+    {
+        test_add_pm(hour, 0, 10 * hour, 0);
+    }
+    for (uint32_t hour = 0; hour < 30; hour++)
+    {
+        const aqi_hour_t *bucket = &s_hours[hour % AQI_HOURS];
+        HOST_CHECK_EQUAL(bucket->hour == hour, hour >= 30 - AQI_HOURS);
+    }
+#ifdef CONFIG_AQI_STANDARD_EU
+    /* Mean of hours 6 to 29 */
+    HOST_CHECK_EQUAL(test_average(29, AQI_POLLUTANT_PM2P5), 10 * (6 + 29) / 2);
+#else
+    uint32_t average;
+    for (uint32_t hours_ago = 0; hours_ago < AQI_HOURS; hours_ago++)
+    {
+        HOST_CHECK(aqi_hour_average(29, hours_ago, AQI_POLLUTANT_PM2P5, &average));
+        HOST_CHECK_EQUAL(average, 10 * (29 - hours_ago));
+    }
+    /* 24 hours ago shares the slot of the current hour */
+    HOST_CHECK(!aqi_hour_average(29, AQI_HOURS, AQI_POLLUTANT_PM2P5, &average));
+    /* Before boot */
+    HOST_CHECK(!aqi_hour_average(5, 6, AQI_POLLUTANT_PM2P5, &average));
+#endif
+
+    /* After a gap of a day and a half, the slots only hold stale hours */
+    test_add_pm(65, 0, 777, 0);
+    HOST_CHECK_EQUAL(test_average(65, AQI_POLLUTANT_PM2P5), 777);
+    uint16_t unused;
+    HOST_CHECK(!aqi_average(65 + AQI_HOURS, AQI_POLLUTANT_PM2P5, &unused));
+
+    /* A slot reused by the same hour of the next day starts over */
+    test_reset();
+    test_add_pm(3, 0, 1000, 0);
+    test_add_pm(3, 1, 1000, 0);
+    test_add_pm(3 + AQI_HOURS, 0, 100, 0);
+    HOST_CHECK_EQUAL(s_hours[3].hour, 3 + AQI_HOURS);
+    HOST_CHECK_EQUAL(s_hours[3].count, 1);
+    HOST_CHECK_EQUAL(test_average(3 + AQI_HOURS, AQI_POLLUTANT_PM2P5), 100);
+
+    /* The published index: nothing before the first sample, then the worse of PM2.5 and PM10 */
+    test_reset();
+    aqi_update_pm(0);
+    HOST_CHECK(!s_working.valid);
+    test_add_pm(0, 0, 100, 300);
+    aqi_update_pm(0);
+    HOST_CHECK(s_working.valid);
+    HOST_CHECK_EQUAL(s_working.pm2p5_average, 100);
+    HOST_CHECK_EQUAL(s_working.pm10p0_average, 300);
+#ifdef CONFIG_AQI_STANDARD_EU
+    HOST_CHECK_EQUAL(s_working.levels[AQI_INDICATOR_PM2P5], AQI_LEVEL_MODERATE);
+    HOST_CHECK_EQUAL(s_working.levels[AQI_INDICATOR_PM10P0], AQI_LEVEL_MODERATE);
+    HOST_CHECK_EQUAL(s_working.index, 2);
+    test_add_pm(0, 1, 100, 2900);
+    aqi_update_pm(0);
+    /* PM10 of 160 ug/m3 on average */
+    HOST_CHECK_EQUAL(s_working.index, 4);
+    HOST_CHECK_EQUAL(s_working.level, AQI_LEVEL_UNHEALTHY);
+#else
+    /* PM2.5 51 + 49 * 0.9 / 26.3 = 52.7, PM10 50 / 54 * 30 = 27.8 */
+    HOST_CHECK_EQUAL(s_working.levels[AQI_INDICATOR_PM2P5], AQI_LEVEL_MODERATE);
+    HOST_CHECK_EQUAL(s_working.levels[AQI_INDICATOR_PM10P0], AQI_LEVEL_GOOD);
+    HOST_CHECK_EQUAL(s_working.index, 53);
+    HOST_CHECK_EQUAL(s_working.level, AQI_LEVEL_MODERATE);
+    test_add_pm(0, 1, 100, 3700);
+    aqi_update_pm(0);
+    /* PM10 of 200 ug/m3 on average: 49 / 99 * (200 - 155) + 101 = 123.3 */
+    HOST_CHECK_EQUAL(s_working.index, 123);
+    HOST_CHECK_EQUAL(s_working.level, AQI_LEVEL_UNHEALTHY_FOR_SENSITIVE_GROUPS);
+#endif
+}
+
+int main(int argc, char **argv)
+{
+    if (argc >= 2 && strcmp(argv[1], "breakpoints") == 0)
+    {
+        test_breakpoints();
+        printf("aqi breakpoint tests passed\n");
+        return EXIT_SUCCESS;
+    }
+    if (argc >= 2 && strcmp(argv[1], "average") == 0)
+    {
+        test_averages();
+        printf("aqi average tests passed\n");
+        return EXIT_SUCCESS;
+    }
+    if (argc >= 2 && strcmp(argv[1], "hours") == 0)
+    {
+        test_hours();
+        printf("aqi hour tests passed\n");
+        return EXIT_SUCCESS;
+    }
+    fprintf(stderr, "usage: %s breakpoints | average | hours\n", argv[0]);
+    return EXIT_FAILURE;
+}
@@ -1,9 +1,14 @@
 #include <stdint.h>
+#include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 
 #include "co2.h"
+#include "sample_bus.h"
+#include "acquisition.h"
+#include "energy.h"
 
 #include "scd4x_i2c.h"
 #include "sensirion_common.h"
@@ -11,69 +16,238 @@
 
 #define TAG "co2.c"
 
-static void co2_task(void *pvParameters);
+#ifdef CONFIG_ACQUISITION_MODE_LOW_POWER
+/* SCD41 low power periodic measurement interval */
+#define CO2_MEASUREMENT_PERIOD_MS 30000
+#define CO2_MEASURING_STATE ENERGY_STATE_LOW_POWER
+#else
+/* SCD41 periodic measurement interval */
+#define CO2_MEASUREMENT_PERIOD_MS 5000
+#define CO2_MEASURING_STATE ENERGY_STATE_MEASURING
+#endif
 
-static uint16_t s_co2;
+/* Time until a single shot measurement is ready */
+#define CO2_SINGLE_SHOT_DURATION_MS 5000
 
-static void co2_task(void *pvParameters)
-{
-    /* NOTE: it is assumed that the I2C bus that is connected to is initialized
-    in 'main.c' */
+/* Powering down saves the 0.2 mA idle current, but the first sample after waking up has to be
+discarded which costs another 5 s single shot at 15 mA. That only pays off from 375 s on. */
+#define CO2_POWER_DOWN_MIN_INTERVAL_S 375
 
-    int16_t error = 0;
+static acquisition_t s_acquisition;
 
-    // Clean up potential SCD40 states
-    scd4x_wake_up();
-    scd4x_stop_periodic_measurement();
-    scd4x_reinit();
+static void co2_task(void *pvParameters);
 
-    uint16_t serial_0;
-    uint16_t serial_1;
-    uint16_t serial_2;
-    error = scd4x_get_serial_number(&serial_0, &serial_1, &serial_2);
+static int16_t co2_data_ready(bool *ready)
+{
+    uint16_t status;
+    int16_t error = scd4x_get_data_ready_status(&status);
+
+    if (error != NO_ERROR)
+    {
+        *ready = false;
+        return error;
+    }
+    /* Data is ready when any of the lower 11 bits is set */
+    *ready = (status & 0x07FF) != 0;
+    return error;
+}
+
+static void co2_read_and_publish(void)
+{
+    sample_bus_co2_t measurement;
+    memset(&measurement, 0, sizeof(measurement)); // Padding is part of the duplicate check
+    int16_t error = scd4x_read_measurement(&measurement.co2, &measurement.temperature, &measurement.humidity);
     if (error)
     {
-        ESP_LOGE(TAG, "Error executing scd4x_get_serial_number(): %i\n", error);
+        ESP_LOGE(TAG, "Error executing scd4x_read_measurement(): %i\n", error);
+    }
+    else if (measurement.co2 == 0)
+    {
+        ESP_LOGE(TAG, "Invalid sample detected, skipping.\n");
     }
     else
     {
-        ESP_LOGI(TAG, "serial: 0x%04x%04x%04x\n", serial_0, serial_1, serial_2);
+        if (acquisition_sample_read(&s_acquisition, &measurement, sizeof(measurement)))
+        {
+            ESP_LOGW(TAG, "Duplicate sample\n");
+        }
+        sample_bus_sample_t sample = {.co2 = measurement};
+        sample_bus_publish(SAMPLE_BUS_SOURCE_CO2, &sample);
     }
+}
 
-    // Start Measurement
+#ifdef CONFIG_ACQUISITION_MODE_SINGLE_SHOT
+/* The first reading after waking up is not valid, measure once and throw it away. Called with the
+MCU marked busy. */
+static void co2_discard_single_shot(void)
+{
+    uint16_t co2;
+    int32_t temperature;
+    int32_t humidity;
+    bool ready = false;
 
-    error = scd4x_start_periodic_measurement();
-    if (error)
+    if (scd4x_measure_single_shot() != 0)
     {
-        ESP_LOGE(TAG, "Error executing scd4x_start_periodic_measurement(): %i\n",
-                 error);
+        return;
     }
+    energy_set_state(ENERGY_CONSUMER_SCD41, ENERGY_STATE_MEASURING);
+
+    energy_mcu_release();
+    vTaskDelay(pdMS_TO_TICKS(CO2_SINGLE_SHOT_DURATION_MS));
+    while (co2_data_ready(&ready) == 0 && !ready)
+    {
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+    energy_mcu_acquire();
+
+    scd4x_read_measurement(&co2, &temperature, &humidity);
+    energy_set_state(ENERGY_CONSUMER_SCD41, ENERGY_STATE_IDLE);
+}
+
+static void co2_single_shot_loop(void)
+{
+    const bool power_down = CONFIG_ACQUISITION_INTERVAL_S >= CO2_POWER_DOWN_MIN_INTERVAL_S;
+    int64_t next_shot_us = esp_timer_get_time();
 
-    ESP_LOGI(TAG, "Waiting for first measurement... (5 sec)\n");
+    ESP_LOGI(TAG, "Single shot every %u sec, %s in between\n", CONFIG_ACQUISITION_INTERVAL_S,
+             power_down ? "powered down" : "idle");
+
+    acquisition_init(&s_acquisition, "SCD41", CONFIG_ACQUISITION_INTERVAL_S * 1000, co2_data_ready);
 
     for (;;)
     {
-        // Read Measurement
-        sensirion_i2c_hal_sleep_usec(5000000);
+        energy_mcu_acquire();
+        if (power_down)
+        {
+            scd4x_wake_up();
+            energy_set_state(ENERGY_CONSUMER_SCD41, ENERGY_STATE_IDLE);
+            co2_discard_single_shot();
+        }
 
-        uint16_t co2;
-        int32_t temperature;
-        int32_t humidity;
-        error = scd4x_read_measurement(&co2, &temperature, &humidity);
+        int16_t error = scd4x_measure_single_shot();
         if (error)
         {
-            ESP_LOGE(TAG, "Error executing scd4x_read_measurement(): %i\n", error);
+            ESP_LOGE(TAG, "Error executing scd4x_measure_single_shot(): %i\n", error);
         }
-        else if (co2 == 0)
+        else
         {
-            ESP_LOGE(TAG, "Invalid sample detected, skipping.\n");
+            energy_set_state(ENERGY_CONSUMER_SCD41, ENERGY_STATE_MEASURING);
+            energy_mcu_release();
+            error = acquisition_wait(&s_acquisition);
+            energy_mcu_acquire();
+            energy_set_state(ENERGY_CONSUMER_SCD41, ENERGY_STATE_IDLE);
+            if (error)
+            {
+                ESP_LOGE(TAG, "Error executing scd4x_get_data_ready_status(): %i\n", error);
+            }
+            else
+            {
+                co2_read_and_publish();
+            }
+        }
+
+        if (power_down)
+        {
+            scd4x_power_down();
+            energy_set_state(ENERGY_CONSUMER_SCD41, ENERGY_STATE_OFF);
+        }
+        energy_mcu_release();
+
+        next_shot_us += (int64_t)CONFIG_ACQUISITION_INTERVAL_S * 1000000;
+        int64_t now_us = esp_timer_get_time();
+        if (next_shot_us > now_us)
+        {
+            vTaskDelay(pdMS_TO_TICKS((next_shot_us - now_us) / 1000));
         }
         else
         {
-            s_co2 = co2;
+            next_shot_us = now_us;
+        }
+    }
+}
+#else
+static void co2_periodic_loop(void)
+{
+    int16_t error = 0;
+
+    // Start Measurement
+#ifdef CONFIG_ACQUISITION_MODE_LOW_POWER
+    error = scd4x_start_low_power_periodic_measurement();
+    if (error)
+    {
+        ESP_LOGE(TAG, "Error executing scd4x_start_low_power_periodic_measurement(): %i\n",
+                 error);
+    }
+#else
+    error = scd4x_start_periodic_measurement();
+    if (error)
+    {
+        ESP_LOGE(TAG, "Error executing scd4x_start_periodic_measurement(): %i\n",
+                 error);
+    }
+#endif
+    energy_set_state(ENERGY_CONSUMER_SCD41, CO2_MEASURING_STATE);
+
+    ESP_LOGI(TAG, "Waiting for first measurement... (%u sec)\n", CO2_MEASUREMENT_PERIOD_MS / 1000);
+
+    acquisition_init(&s_acquisition, "SCD41", CO2_MEASUREMENT_PERIOD_MS, co2_data_ready);
+    uint32_t missed = 0;
+
+    for (;;)
+    {
+        error = acquisition_wait(&s_acquisition);
+        if (error)
+        {
+            ESP_LOGE(TAG, "Error executing scd4x_get_data_ready_status(): %i\n", error);
+            sensirion_i2c_hal_sleep_usec(1000000);
+            continue;
+        }
+        if (s_acquisition.stats.missed != missed)
+        {
+            ESP_LOGW(TAG, "%u sample(s) missed\n", s_acquisition.stats.missed - missed);
+            missed = s_acquisition.stats.missed;
         }
+
+        // Read Measurement
+        energy_mcu_acquire();
+        co2_read_and_publish();
+        energy_mcu_release();
     }
 }
+#endif
+
+static void co2_task(void *pvParameters)
+{
+    (void)pvParameters;
+    int16_t error = 0;
+
+    sensirion_i2c_hal_init();
+
+    // Clean up potential SCD40 states
+    scd4x_wake_up();
+    scd4x_stop_periodic_measurement();
+    scd4x_reinit();
+    energy_set_state(ENERGY_CONSUMER_SCD41, ENERGY_STATE_IDLE);
+
+    uint16_t serial_0;
+    uint16_t serial_1;
+    uint16_t serial_2;
+    error = scd4x_get_serial_number(&serial_0, &serial_1, &serial_2);
+    if (error)
+    {
+        ESP_LOGE(TAG, "Error executing scd4x_get_serial_number(): %i\n", error);
+    }
+    else
+    {
+        ESP_LOGI(TAG, "serial: 0x%04x%04x%04x\n", serial_0, serial_1, serial_2);
+    }
+
+#ifdef CONFIG_ACQUISITION_MODE_SINGLE_SHOT
+    co2_single_shot_loop();
+#else
+    co2_periodic_loop();
+#endif
+}
 
 void co2_init()
 {
@@ -82,5 +256,11 @@ void co2_init()
 
 void co2_get_co2(uint16_t *co2)
 {
-    *co2 = s_co2;
+    sample_bus_sample_t sample;
+    sample_bus_get(SAMPLE_BUS_SOURCE_CO2, &sample);
+    *co2 = sample.co2.co2;
+}
+void co2_get_acquisition_stats(acquisition_stats_t *stats)
+{
+    acquisition_get_stats(&s_acquisition, stats);
 }
\ No newline at end of file
@@ -1,6 +1,8 @@
 #ifndef COMPONENTS_CO2_H
 #define COMPONENTS_CO2_H
 
+#include "acquisition.h"
+
 void co2_init();
 
 /**
@@ -10,4 +12,11 @@ void co2_init();
  */ 
 void co2_get_co2(uint16_t *co2);
 
+/**
+ * @brief get the sample counters of the CO2 sensor.
+ *
+ * @param[out] stats samples read, missed and duplicated and data ready polls.
+ */
+void co2_get_acquisition_stats(acquisition_stats_t *stats);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,148 @@
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#include "energy.h"
+
+#define TAG "energy.c"
+
+#define ENERGY_REPORT_PERIOD_US (10 * 60 * 1000000LL)
+
+/* Typical supply current in microampere at 3.3 V of every consumer in every state, from the
+datasheets unless noted otherwise. States a consumer does not have use its idle current. */
+static const uint32_t s_current_ua[ENERGY_CONSUMER_MAX][ENERGY_STATE_MAX] = {
+    /* ESP32 at 80 MHz with the radio off, light sleep with RTC and internal memory retained */
+    [ENERGY_CONSUMER_MCU] = {[ENERGY_STATE_OFF] = 0, [ENERGY_STATE_SLEEP] = 800, [ENERGY_STATE_IDLE] = 30000, [ENERGY_STATE_MEASURING] = 30000, [ENERGY_STATE_LOW_POWER] = 30000},
+    /* Measuring is the average over a periodic or single shot measurement */
+    [ENERGY_CONSUMER_SCD41] = {[ENERGY_STATE_OFF] = 0, [ENERGY_STATE_SLEEP] = 0, [ENERGY_STATE_IDLE] = 200, [ENERGY_STATE_MEASURING] = 15000, [ENERGY_STATE_LOW_POWER] = 3200},
+    [ENERGY_CONSUMER_SPS30] = {[ENERGY_STATE_OFF] = 0, [ENERGY_STATE_SLEEP] = 38, [ENERGY_STATE_IDLE] = 330, [ENERGY_STATE_MEASURING] = 60000, [ENERGY_STATE_LOW_POWER] = 60000},
+    /* Not specified in the datasheet, rough estimate of the module including its microcontroller */
+    [ENERGY_CONSUMER_SVM40] = {[ENERGY_STATE_OFF] = 0, [ENERGY_STATE_SLEEP] = 0, [ENERGY_STATE_IDLE] = 3000, [ENERGY_STATE_MEASURING] = 7000, [ENERGY_STATE_LOW_POWER] = 7000},
+};
+
+static const char *s_consumer_names[ENERGY_CONSUMER_MAX] = {"MCU", "SCD41", "SPS30", "SVM40"};
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static const char *s_mode_name;
+static int64_t s_start_us;
+static energy_state_t s_states[ENERGY_CONSUMER_MAX];
+static int64_t s_since_us[ENERGY_CONSUMER_MAX];
+static uint64_t s_charge_ua_us[ENERGY_CONSUMER_MAX];
+
+/* The MCU sleeps whenever power management allows it and no task marked it busy. Other tasks such
+as the GUI also wake it up, so this is a lower bound. */
+static bool s_light_sleep_allowed;
+static uint32_t s_mcu_busy;
+
+/* Must be called with s_lock held */
+static void energy_change_state(energy_consumer_t consumer, energy_state_t state, int64_t now_us)
+{
+    s_charge_ua_us[consumer] += (uint64_t)s_current_ua[consumer][s_states[consumer]] * (uint64_t)(now_us - s_since_us[consumer]);
+    s_states[consumer] = state;
+    s_since_us[consumer] = now_us;
+}
+
+/* Must be called with s_lock held */
+static void energy_update_mcu(int64_t now_us)
+{
+    energy_state_t state = s_light_sleep_allowed && s_mcu_busy == 0 ? ENERGY_STATE_SLEEP : ENERGY_STATE_IDLE;
+    energy_change_state(ENERGY_CONSUMER_MCU, state, now_us);
+}
+
+static void energy_log_report(void *arg)
+{
+    (void)arg;
+    energy_report_t report;
+    energy_get_report(&report);
+
+    ESP_LOGI(TAG, "%s mode, %u min: %.3f mAh per hour", s_mode_name, (unsigned)(report.elapsed_us / 60000000), report.total_average_ua / 1000.0);
+    for (int i = 0; i < ENERGY_CONSUMER_MAX; i++)
+    {
+        ESP_LOGI(TAG, "  %s: %.3f mAh per hour, %.3f mAh total", s_consumer_names[i], report.average_ua[i] / 1000.0, report.charge_uah[i] / 1000.0);
+    }
+}
+
+void energy_init(const char *mode_name)
+{
+    int64_t now_us = esp_timer_get_time();
+
+    portENTER_CRITICAL(&s_lock);
+    s_mode_name = mode_name;
+    s_start_us = now_us;
+    for (int i = 0; i < ENERGY_CONSUMER_MAX; i++)
+    {
+        s_states[i] = ENERGY_STATE_OFF;
+        s_since_us[i] = now_us;
+        s_charge_ua_us[i] = 0;
+    }
+    energy_update_mcu(now_us);
+    portEXIT_CRITICAL(&s_lock);
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = energy_log_report,
+        .name = "energy report"};
+    esp_timer_handle_t timer;
+    if (esp_timer_create(&timer_args, &timer) == ESP_OK)
+    {
+        esp_timer_start_periodic(timer, ENERGY_REPORT_PERIOD_US);
+    }
+}
+
+void energy_set_state(energy_consumer_t consumer, energy_state_t state)
+{
+    int64_t now_us = esp_timer_get_time();
+
+    portENTER_CRITICAL(&s_lock);
+    energy_change_state(consumer, state, now_us);
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void energy_set_light_sleep_allowed(bool allowed)
+{
+    int64_t now_us = esp_timer_get_time();
+
+    portENTER_CRITICAL(&s_lock);
+    s_light_sleep_allowed = allowed;
+    energy_update_mcu(now_us);
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void energy_mcu_acquire(void)
+{
+    int64_t now_us = esp_timer_get_time();
+
+    portENTER_CRITICAL(&s_lock);
+    s_mcu_busy++;
+    energy_update_mcu(now_us);
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void energy_mcu_release(void)
+{
+    int64_t now_us = esp_timer_get_time();
+
+    portENTER_CRITICAL(&s_lock);
+    s_mcu_busy--;
+    energy_update_mcu(now_us);
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void energy_get_report(energy_report_t *report)
+{
+    int64_t now_us = esp_timer_get_time();
+    uint64_t total_ua_us = 0;
+
+    portENTER_CRITICAL(&s_lock);
+    report->elapsed_us = now_us - s_start_us;
+    for (int i = 0; i < ENERGY_CONSUMER_MAX; i++)
+    {
+        /* Close the current state so that it is included */
+        energy_change_state(i, s_states[i], now_us);
+        report->charge_uah[i] = s_charge_ua_us[i] / (3600ULL * 1000000);
+        report->average_ua[i] = report->elapsed_us > 0 ? s_charge_ua_us[i] / report->elapsed_us : 0;
+        total_ua_us += s_charge_ua_us[i];
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    report->total_average_ua = report->elapsed_us > 0 ? total_ua_us / report->elapsed_us : 0;
+}
@@ -0,0 +1,77 @@
+#ifndef COMPONENTS_ENERGY_H
+#define COMPONENTS_ENERGY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum
+{
+    ENERGY_CONSUMER_MCU = 0, // ESP32 without radio
+    ENERGY_CONSUMER_SCD41,
+    ENERGY_CONSUMER_SPS30,
+    ENERGY_CONSUMER_SVM40,
+    ENERGY_CONSUMER_MAX
+} energy_consumer_t;
+
+typedef enum
+{
+    ENERGY_STATE_OFF = 0,      // Powered down, SCD41 power down.
+    ENERGY_STATE_SLEEP,        // SPS30 sleep, ESP32 light sleep.
+    ENERGY_STATE_IDLE,         // Powered but not measuring, ESP32 running.
+    ENERGY_STATE_MEASURING,    // Continuous or single shot measurement.
+    ENERGY_STATE_LOW_POWER,    // SCD41 low power periodic measurement.
+    ENERGY_STATE_MAX
+} energy_state_t;
+
+typedef struct
+{
+    int64_t elapsed_us;                         // Time since energy_init().
+    uint32_t charge_uah[ENERGY_CONSUMER_MAX];   // Charge drawn by each consumer since energy_init(). Unit in microampere hour.
+    uint32_t average_ua[ENERGY_CONSUMER_MAX];   // Average current of each consumer. Unit in microampere, equal to uAh per hour.
+    uint32_t total_average_ua;                  // Average current of the whole device. Unit in microampere.
+} energy_report_t;
+
+/**
+ * @brief Start accounting. Every consumer starts in ENERGY_STATE_OFF, except the MCU which starts
+ * running. A report is logged every 10 minutes.
+ *
+ * @param[in] mode_name name of the acquisition mode, used in the logged report.
+ */
+void energy_init(const char *mode_name);
+
+/**
+ * @brief Record that a consumer changed state. The charge of the previous state is accounted from
+ * its typical current.
+ *
+ * @param[in] consumer the device that changed state.
+ * @param[in] state the new state.
+ */
+void energy_set_state(energy_consumer_t consumer, energy_state_t state);
+
+/**
+ * @brief Tell whether the ESP32 may light sleep when it is idle, as configured by power
+ * management. The MCU is accounted as sleeping while this is allowed and nobody holds it awake.
+ *
+ * @param[in] allowed true if light sleep is enabled.
+ */
+void energy_set_light_sleep_allowed(bool allowed);
+
+/**
+ * @brief Mark the MCU busy, e.g. while a sensor task talks to its sensor. Calls nest, every call
+ * must be matched by energy_mcu_release().
+ */
+void energy_mcu_acquire(void);
+
+/**
+ * @brief Release a busy mark taken with energy_mcu_acquire().
+ */
+void energy_mcu_release(void);
+
+/**
+ * @brief Get the charge drawn so far.
+ *
+ * @param[out] report charge and average current per consumer.
+ */
+void energy_get_report(energy_report_t *report);
+
+#endif
@@ -0,0 +1,95 @@
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+
+#include "gui_binding.h"
+
+/* Written by the GUI task, read by other tasks */
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static gui_binding_stats_t s_stats;
+
+/* Only accessed by the GUI task */
+static lv_style_t s_severity_styles[AQI_LEVEL_MAX];
+
+/* Every change invalidates the area of the object, which LVGL renders again and sends to the
+display in RGB565. A suppressed change saves these bytes. */
+static void gui_binding_count(lv_obj_t *obj, bool applied, uint8_t areas)
+{
+    uint32_t bytes = (uint32_t)lv_obj_get_width(obj) * lv_obj_get_height(obj) * sizeof(lv_color_t) * areas;
+
+    portENTER_CRITICAL(&s_lock);
+    if (applied)
+    {
+        s_stats.applied++;
+    }
+    else
+    {
+        s_stats.suppressed++;
+        s_stats.bytes_saved += bytes;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+bool gui_binding_update(const gui_binding_t *binding, const sample_bus_sample_t *sample)
+{
+    char text[GUI_BINDING_TEXT_SIZE];
+
+    binding->format(sample, text, sizeof(text));
+    return gui_binding_set_text(binding->label, text);
+}
+
+bool gui_binding_set_text(lv_obj_t *label, const char *text)
+{
+    /* lv_label_set_text() reallocates and invalidates even for the same text */
+    bool changed = strcmp(lv_label_get_text(label), text) != 0;
+    if (changed)
+    {
+        lv_label_set_text(label, text);
+    }
+    gui_binding_count(label, changed, 1);
+    return changed;
+}
+
+bool gui_binding_set_pos(lv_obj_t *obj, lv_coord_t x, lv_coord_t y)
+{
+    bool changed = lv_obj_get_x(obj) != x || lv_obj_get_y(obj) != y;
+    if (changed)
+    {
+        lv_obj_set_pos(obj, x, y);
+    }
+    /* A move invalidates the old and the new area */
+    gui_binding_count(obj, changed, 2);
+    return changed;
+}
+
+void gui_binding_severity_init(const lv_color_t colors[AQI_LEVEL_MAX])
+{
+    for (uint8_t level = 0; level < AQI_LEVEL_MAX; level++)
+    {
+        lv_style_init(&s_severity_styles[level]);
+        lv_style_set_bg_color(&s_severity_styles[level], LV_STATE_DEFAULT, colors[level]);
+    }
+}
+
+bool gui_binding_set_severity(gui_binding_severity_t *severity, aqi_level_t level)
+{
+    bool changed = severity->level != (int8_t)level;
+    if (changed)
+    {
+        if (severity->level >= 0)
+        {
+            lv_obj_remove_style(severity->obj, severity->part, &s_severity_styles[severity->level]);
+        }
+        lv_obj_add_style(severity->obj, severity->part, &s_severity_styles[level]);
+        severity->level = level;
+    }
+    gui_binding_count(severity->obj, changed, 1);
+    return changed;
+}
+
+void gui_binding_get_stats(gui_binding_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,110 @@
+#ifndef COMPONENTS_GUI_BINDING_H
+#define COMPONENTS_GUI_BINDING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lvgl.h"
+
+#include "sample_bus.h"
+#include "aqi.h"
+
+/* Longest text a bound label shows, including the terminating zero */
+#define GUI_BINDING_TEXT_SIZE 16
+
+/**
+ * @brief Format the value a label shows from a sample. The text is what is compared against the
+ * rendered one, so it must only change when the shown value does.
+ *
+ * @param[in] sample latest sample of the source of the binding.
+ * @param[out] text the text to show.
+ * @param[in] size size of text in bytes.
+ */
+typedef void (*gui_binding_format_t)(const sample_bus_sample_t *sample, char *text, size_t size);
+
+/* Maps a value of a sample to the label that shows it */
+typedef struct
+{
+    gui_binding_format_t format;
+    lv_obj_t *label;
+} gui_binding_t;
+
+/* A part of a widget that shows a severity level with one of the shared styles, see
+gui_binding_severity_init() */
+typedef struct
+{
+    lv_obj_t *obj;
+    uint8_t part;  // e.g. LV_BAR_PART_INDIC.
+    int8_t level;  // aqi_level_t of the style the part has, -1 before the first level is shown.
+} gui_binding_severity_t;
+
+/* Counts every update of a bound widget since boot */
+typedef struct
+{
+    uint32_t applied;     // Updates that changed the widget and invalidated its area.
+    uint32_t suppressed;  // Updates dropped because the widget already showed the value.
+    uint64_t bytes_saved; // Pixel bytes the suppressed updates would have rendered and sent over SPI.
+} gui_binding_stats_t;
+
+/**
+ * @brief Update the label of a binding if the formatted value differs from the shown one. Call
+ * with the GUI semaphore held.
+ *
+ * @param[in] binding the binding.
+ * @param[in] sample new sample of the source of the binding.
+ *
+ * @return true if the label was changed.
+ */
+bool gui_binding_update(const gui_binding_t *binding, const sample_bus_sample_t *sample);
+
+/**
+ * @brief Set the text of a label unless it already shows it. Call with the GUI semaphore held.
+ *
+ * @param[in] label the label.
+ * @param[in] text the text.
+ *
+ * @return true if the label was changed.
+ */
+bool gui_binding_set_text(lv_obj_t *label, const char *text);
+
+/**
+ * @brief Move an object unless it already is at the position. Call with the GUI semaphore held.
+ *
+ * @param[in] obj the object.
+ * @param[in] x the x coordinate, relative to the parent.
+ * @param[in] y the y coordinate, relative to the parent.
+ *
+ * @return true if the object was moved.
+ */
+bool gui_binding_set_pos(lv_obj_t *obj, lv_coord_t x, lv_coord_t y);
+
+/**
+ * @brief Create the six severity styles shared by every gui_binding_severity_t. The styles only
+ * set the background color and are never changed afterwards. Call once before the first
+ * gui_binding_set_severity().
+ *
+ * @param[in] colors background color of each level.
+ */
+void gui_binding_severity_init(const lv_color_t colors[AQI_LEVEL_MAX]);
+
+/**
+ * @brief Show a severity level. The style of the old level is swapped for the one of the new level
+ * only if they differ, adding a style refreshes and redraws the whole object even when it is
+ * already in its style list. Call with the GUI semaphore held.
+ *
+ * @param[in,out] severity the widget part.
+ * @param[in] level the level to show.
+ *
+ * @return true if the style was swapped.
+ */
+bool gui_binding_set_severity(gui_binding_severity_t *severity, aqi_level_t level);
+
+/**
+ * @brief Get the update counters of all bound widgets. Safe to call from any task.
+ *
+ * @param[out] stats copy of the counters.
+ */
+void gui_binding_get_stats(gui_binding_stats_t *stats);
+
+#endif
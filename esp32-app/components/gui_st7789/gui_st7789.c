@@ -12,22 +12,17 @@
 #include "freertos/semphr.h"
 #include "esp_system.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "driver/gpio.h"
 
 #include "lvgl.h"
 #include "lvgl_helpers.h"
+#include "disp_spi.h"
 
-#ifdef CONFIG_VOC_INSTALLED
-#include "voc_index.h"
-#endif
-
-#ifdef CONFIG_PM_INSTALLED
-#include "particulate_matter.h"
-#endif
-
-#ifdef CONFIG_CO2_INSTALLED
-#include "co2.h"
-#endif
+#include "sample_bus.h"
+#include "spmc_ring.h"
+#include "aqi.h"
+#include "gui_binding.h"
 
 #define LV_TICK_PERIOD_MS 1
 
@@ -43,8 +38,16 @@
 
 /* Static function prototypes for LVGL main functions */
 static void lv_tick_task(void *arg);
+static void gui_monitor_cb(lv_disp_drv_t *disp_drv, uint32_t time, uint32_t px);
 static void guiTask(void *pvParameter);
 static void create_graphics_application(void);
+#ifdef CONFIG_GUI_FLUSH_TASK
+static void gui_flush_cb(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_map);
+static void flushTask(void *pvParameter);
+#endif
+#ifdef CONFIG_GUI_BENCHMARK
+static void gui_benchmark(void);
+#endif
 
 /* static variables for GUI components to modify it such as its styles and positioning */
 static lv_style_t screen_style;
@@ -76,24 +79,61 @@ static lv_style_t pm10_box_style;
 static lv_style_t pm10_value_style;
 static lv_style_t pm10_bar_style;
 
-/* function prototypes for callbacks to update GUI components */
-static void voc_indicator_pointer_refresher_task(lv_task_t *task_info);
-static void temp_label_value_refresher_task(lv_task_t *task_info);
-static void hum_label_value_refresher_task(lv_task_t *task_info);
-static void hum_bar_value_refresher_task(lv_task_t *task_info);
-#ifdef CONFIG_HCHO_INSTALLED
-static void formaldehyde_label_value_refresher_task(lv_task_t *task_info);
-static void formaldehyde_bar_value_refresher_task(lv_task_t *task_info);
+/* function prototypes to update GUI components */
+static void gui_model_update(uint32_t updated);
+#ifdef CONFIG_VOC_INSTALLED
+static void voc_indicator_pointer_update(lv_obj_t *pointer, int16_t voc_index);
+#endif
+
+/* Sources that published since the last model update, see gui_model_update() */
+static sample_bus_subscriber_t gui_subscriber;
+#ifdef CONFIG_VOC_INSTALLED
+static lv_obj_t *voc_pointer;
+#endif
+
+/* Severity of the bars, shown with the shared styles of gui_binding.h */
+#ifdef CONFIG_VOC_INSTALLED
+static gui_binding_severity_t hum_severity = {.part = LV_BAR_PART_INDIC, .level = -1};
+#endif
+#ifdef CONFIG_CO2_INSTALLED
+static gui_binding_severity_t co2_severity = {.part = LV_BAR_PART_INDIC, .level = -1};
+#endif
+#ifdef CONFIG_PM_INSTALLED
+static gui_binding_severity_t pm2_5_severity = {.part = LV_BAR_PART_INDIC, .level = -1};
+static gui_binding_severity_t pm10_severity = {.part = LV_BAR_PART_INDIC, .level = -1};
+#endif
+
+/* Formatting of the labels bound to the sample bus, see gui_binding.h */
+#ifdef CONFIG_VOC_INSTALLED
+static void temp_label_format(const sample_bus_sample_t *sample, char *text, size_t size)
+{
+    snprintf(text, size, "%.01fC", sample->voc.temperature / 200.0);
+}
+static void hum_label_format(const sample_bus_sample_t *sample, char *text, size_t size)
+{
+    snprintf(text, size, "%0.1f%%", sample->voc.rhumidity / 100.0);
+}
+static gui_binding_t temp_binding = {.format = temp_label_format};
+static gui_binding_t hum_binding = {.format = hum_label_format};
 #endif
 #ifdef CONFIG_CO2_INSTALLED
-static void co2_label_value_refresher_task(lv_task_t *task_info);
-static void co2_bar_value_refresher_task(lv_task_t *task_info);
+static void co2_label_format(const sample_bus_sample_t *sample, char *text, size_t size)
+{
+    snprintf(text, size, "%i", sample->co2.co2);
+}
+static gui_binding_t co2_binding = {.format = co2_label_format};
 #endif
 #ifdef CONFIG_PM_INSTALLED
-static void pm2_5_label_value_refresher_task(lv_task_t *task_info);
-static void pm2_5_bar_value_refresher_task(lv_task_t *task_info);
-static void pm10_label_value_refresher_task(lv_task_t *task_info);
-static void pm10_bar_value_refresher_task(lv_task_t *task_info);
+static void pm2_5_label_format(const sample_bus_sample_t *sample, char *text, size_t size)
+{
+    snprintf(text, size, "%u.%u", sample->pm.mc_2p5 / 10, sample->pm.mc_2p5 % 10);
+}
+static void pm10_label_format(const sample_bus_sample_t *sample, char *text, size_t size)
+{
+    snprintf(text, size, "%u.%u", sample->pm.mc_10p0 / 10, sample->pm.mc_10p0 % 10);
+}
+static gui_binding_t pm2_5_binding = {.format = pm2_5_label_format};
+static gui_binding_t pm10_binding = {.format = pm10_label_format};
 #endif
 
 /**
@@ -103,6 +143,30 @@ static void pm10_bar_value_refresher_task(lv_task_t *task_info);
  */
 SemaphoreHandle_t xGuiSemaphore;
 
+/* Written by the GUI task, read by other tasks */
+static portMUX_TYPE render_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static gui_st7789_render_stats_t render_stats;
+
+#ifdef CONFIG_GUI_FLUSH_TASK
+/* A rendered buffer handed from the GUI task to the flush task */
+typedef struct
+{
+    lv_disp_drv_t *drv;
+    lv_area_t area;
+    lv_color_t *color_map;
+} gui_flush_request_t;
+
+/* LVGL waits for lv_disp_flush_ready() of one buffer before it flushes the other one, so at most
+one request is pending and the ring never overwrites an unread request. The GUI task is the single
+producer, the flush task the only reader. */
+#define FLUSH_RING_LENGTH 2
+static uint8_t flush_ring_storage[SPMC_RING_STORAGE_SIZE(sizeof(gui_flush_request_t), FLUSH_RING_LENGTH)]
+    __attribute__((aligned(SPMC_RING_CACHE_LINE_SIZE)));
+static spmc_ring_t flush_ring = SPMC_RING_INITIALIZER(flush_ring_storage, sizeof(gui_flush_request_t), FLUSH_RING_LENGTH);
+static spmc_ring_reader_t flush_reader;
+static TaskHandle_t flush_task;
+#endif
+
 static void guiTask(void *pvParameter)
 {
     (void)pvParameter;
@@ -141,7 +205,15 @@ static void guiTask(void *pvParameter)
 
     lv_disp_drv_t disp_drv;
     lv_disp_drv_init(&disp_drv);
+#ifdef CONFIG_GUI_FLUSH_TASK
+    /* The reader is initialized before the first request can be pushed */
+    spmc_ring_reader_init(&flush_ring, &flush_reader, 0);
+    xTaskCreatePinnedToCore(flushTask, "st7789 flush", 1024 * 2, NULL, 6, &flush_task, 0);
+    disp_drv.flush_cb = gui_flush_cb;
+#else
     disp_drv.flush_cb = disp_driver_flush;
+#endif
+    disp_drv.monitor_cb = gui_monitor_cb;
 
     /**
      * When using a monochrome display we need to register the callbacks:
@@ -173,17 +245,30 @@ static void guiTask(void *pvParameter)
     ESP_ERROR_CHECK(esp_timer_create(&periodic_timer_args, &periodic_timer));
     ESP_ERROR_CHECK(esp_timer_start_periodic(periodic_timer, LV_TICK_PERIOD_MS * 1000));
 
+    /* New samples wake up the loop, the display is updated right away instead of on the next
+    poll of the widgets */
+    gui_subscriber = sample_bus_subscribe(SAMPLE_BUS_ALL_SOURCES);
+    assert(gui_subscriber != NULL);
+
     /* Create the demo application */
     create_graphics_application();
 
+#ifdef CONFIG_GUI_BENCHMARK
+    gui_benchmark();
+#endif
+
+    /* Samples published before the subscription */
+    gui_model_update(SAMPLE_BUS_ALL_SOURCES);
+
     while (1)
     {
-        /* Delay 1 tick (assumes FreeRTOS tick is 10ms) */
-        vTaskDelay(pdMS_TO_TICKS(10));
+        /* Wait 1 tick (assumes FreeRTOS tick is 10ms) or until a sensor published */
+        uint32_t updated = sample_bus_wait(gui_subscriber, pdMS_TO_TICKS(10));
 
         /* Try to take the semaphore, call lvgl related functions on success */
         if (pdTRUE == xSemaphoreTake(xGuiSemaphore, portMAX_DELAY))
         {
+            gui_model_update(updated);
             lv_task_handler();
             xSemaphoreGive(xGuiSemaphore);
         }
@@ -202,6 +287,16 @@ static void create_graphics_application(void)
     lv_style_set_bg_color(&screen_style, LV_STATE_DEFAULT, LV_COLOR_BLACK);
     lv_obj_add_style(screen, LV_OBJ_PART_MAIN, &screen_style);
 
+    /* Severity styles shared by the bars, never changed after this */
+    const lv_color_t severity_colors[AQI_LEVEL_MAX] = {
+        [AQI_LEVEL_GOOD] = LV_COLOR_GOOD,
+        [AQI_LEVEL_MODERATE] = LV_COLOR_MODERATE,
+        [AQI_LEVEL_UNHEALTHY_FOR_SENSITIVE_GROUPS] = LV_COLOR_UNHEALTHY_FOR_SENSITIVE_GROUPS,
+        [AQI_LEVEL_UNHEALTHY] = LV_COLOR_UNHEALTHY,
+        [AQI_LEVEL_VERY_UNHEALTHY] = LV_COLOR_VERY_UNHEALTHY,
+        [AQI_LEVEL_HAZARDOUS] = LV_COLOR_HAZARDOUS};
+    gui_binding_severity_init(severity_colors);
+
     hum_border_color = LV_COLOR_BLACK;
     temp_border_color = LV_COLOR_BLACK;
     formaldehyde_border_color = LV_COLOR_BLACK;
@@ -244,7 +339,6 @@ static void create_graphics_application(void)
     lv_obj_add_style(voc_indicator_pointer, LV_OBJ_PART_MAIN, &voc_indicator_pointer_style);
 
     int8_t voc_indicator_color_box_y_offset = 5;
-    int8_t voc_indicator_color_box_x_offset = 5;
 
     lv_obj_t *voc_indicator_green_box = lv_obj_create(voc_indicator_box, NULL);
     lv_obj_set_size(voc_indicator_green_box, 230 / 8, (230 / 12) - 2);
@@ -646,51 +740,81 @@ static void create_graphics_application(void)
 #endif
 
     /**
-     * lv tasks creation for dynamic value handling
+     * Widgets updated by gui_model_update() when a new sample or index is available
      */
-    /* VOC related */
 #ifdef CONFIG_VOC_INSTALLED
-    lv_task_create(voc_indicator_pointer_refresher_task, 250, LV_TASK_PRIO_MID, (void *)voc_indicator_pointer);
-    /* Temperature related */
-    lv_task_create(temp_label_value_refresher_task, 250, LV_TASK_PRIO_MID, (void *)temp_value);
-    /* Humidity related */
-    lv_task_create(hum_label_value_refresher_task, 250, LV_TASK_PRIO_MID, (void *)hum_value);
-    lv_task_create(hum_bar_value_refresher_task, 250, LV_TASK_PRIO_MID, (void *)hum_bar);
+    voc_pointer = voc_indicator_pointer;
+    temp_binding.label = temp_value;
+    hum_binding.label = hum_value;
+    hum_severity.obj = hum_bar;
 #endif
-    /* Formaldehyde related */
-#ifdef CONFIG_HCHO_INSTALLED
-    lv_task_create(formaldehyde_label_value_refresher_task, 250, LV_TASK_PRIO_MID, (void *)formaldehyde_value);
-    lv_task_create(formaldehyde_bar_value_refresher_task, 250, LV_TASK_PRIO_MID, (void *)formaldehyde_bar);
-#endif
-    /* CO2 related */
+    /* Formaldehyde has no sensor yet, its widgets keep their initial value */
 #ifdef CONFIG_CO2_INSTALLED
-    lv_task_create(co2_label_value_refresher_task, 250, LV_TASK_PRIO_MID, (void *)co2_value);
-    lv_task_create(co2_bar_value_refresher_task, 250, LV_TASK_PRIO_MID, (void *)co2_bar);
+    co2_binding.label = co2_value;
+    co2_severity.obj = co2_bar;
 #endif
-    /* Particulate matter related*/
 #ifdef CONFIG_PM_INSTALLED
-    lv_task_create(pm2_5_label_value_refresher_task, 250, LV_TASK_PRIO_MID, (void *)pm2_5_value);
-    lv_task_create(pm2_5_bar_value_refresher_task, 250, LV_TASK_PRIO_MID, (void *)pm2_5_bar);
-    lv_task_create(pm10_label_value_refresher_task, 250, LV_TASK_PRIO_MID, (void *)pm10_value);
-    lv_task_create(pm10_bar_value_refresher_task, 250, LV_TASK_PRIO_MID, (void *)pm10_bar);
+    pm2_5_binding.label = pm2_5_value;
+    pm2_5_severity.obj = pm2_5_bar;
+    pm10_binding.label = pm10_value;
+    pm10_severity.obj = pm10_bar;
 #endif
 }
 
-#ifdef CONFIG_HCHO_INSTALLED
-static void formaldehyde_label_value_refresher_task(lv_task_t *task_info)
+/* Updates every widget whose source changed in one pass, so that LVGL merges their invalidated
+areas into a single refresh instead of one per widget. updated is the mask returned by
+sample_bus_wait(), sources without any sample yet are skipped. */
+static void gui_model_update(uint32_t updated)
 {
-}
+    static uint32_t aqi_sequence;
+    sample_bus_sample_t sample;
+    aqi_t aqi;
 
-static void formaldehyde_bar_value_refresher_task(lv_task_t *task_info)
-{
-}
+#ifdef CONFIG_VOC_INSTALLED
+    if ((updated & SAMPLE_BUS_SOURCE_BIT(SAMPLE_BUS_SOURCE_VOC)) && sample_bus_get(SAMPLE_BUS_SOURCE_VOC, &sample) != 0)
+    {
+        voc_indicator_pointer_update(voc_pointer, sample.voc.voc_index);
+        gui_binding_update(&temp_binding, &sample);
+        gui_binding_update(&hum_binding, &sample);
+    }
+#endif
+#ifdef CONFIG_CO2_INSTALLED
+    if ((updated & SAMPLE_BUS_SOURCE_BIT(SAMPLE_BUS_SOURCE_CO2)) && sample_bus_get(SAMPLE_BUS_SOURCE_CO2, &sample) != 0)
+    {
+        gui_binding_update(&co2_binding, &sample);
+    }
+#endif
+#ifdef CONFIG_PM_INSTALLED
+    if ((updated & SAMPLE_BUS_SOURCE_BIT(SAMPLE_BUS_SOURCE_PM)) && sample_bus_get(SAMPLE_BUS_SOURCE_PM, &sample) != 0)
+    {
+        gui_binding_update(&pm2_5_binding, &sample);
+        gui_binding_update(&pm10_binding, &sample);
+    }
+#endif
+
+    /* The index is computed by another task shortly after the sample, it is checked on every pass */
+    if (!aqi_get_if_newer(&aqi_sequence, &aqi))
+    {
+        return;
+    }
+#ifdef CONFIG_VOC_INSTALLED
+    gui_binding_set_severity(&hum_severity, aqi.levels[AQI_INDICATOR_RHUMIDITY]);
+#endif
+#ifdef CONFIG_CO2_INSTALLED
+    gui_binding_set_severity(&co2_severity, aqi.levels[AQI_INDICATOR_CO2]);
+#endif
+#ifdef CONFIG_PM_INSTALLED
+    if (aqi.valid)
+    {
+        gui_binding_set_severity(&pm2_5_severity, aqi.levels[AQI_INDICATOR_PM2P5]);
+        gui_binding_set_severity(&pm10_severity, aqi.levels[AQI_INDICATOR_PM10P0]);
+    }
 #endif
+}
 
 #ifdef CONFIG_VOC_INSTALLED
-static void voc_indicator_pointer_refresher_task(lv_task_t *task_info)
+static void voc_indicator_pointer_update(lv_obj_t *pointer, int16_t voc_index)
 {
-    int16_t voc_index;
-    voc_index_get_voc(&voc_index);
     float real_voc = voc_index / 10.0;
 
     /* This conditional statements is for adjusting the position of the pointer depending on the VOC value.
@@ -698,236 +822,118 @@ static void voc_indicator_pointer_refresher_task(lv_task_t *task_info)
     if (real_voc >= 0 && real_voc <= 50)
     {
         uint8_t offset = real_voc / (51 / 25);
-        lv_obj_set_pos((lv_obj_t *)(task_info->user_data), 54 + offset, 20);
+        gui_binding_set_pos(pointer, 54 + offset, 20);
     }
     else if (real_voc >= 51 && real_voc <= 100)
     {
         uint8_t offset = (real_voc - 50) / (50 / 25);
-        lv_obj_set_pos((lv_obj_t *)(task_info->user_data), 83 + offset, 20); /* Start position of MODERATE */
+        gui_binding_set_pos(pointer, 83 + offset, 20); /* Start position of MODERATE */
     }
     else if (real_voc >= 101 && real_voc <= 150)
     {
         uint8_t offset = (real_voc - 100) / (50 / 25);
-        lv_obj_set_pos((lv_obj_t *)(task_info->user_data), 112 + offset, 20); /* Start position of UNHEALTHY FOR SENSITIVE GROUPS */
+        gui_binding_set_pos(pointer, 112 + offset, 20); /* Start position of UNHEALTHY FOR SENSITIVE GROUPS */
     }
     else if (real_voc >= 151 && real_voc <= 200)
     {
         uint8_t offset = (real_voc - 150) / (50 / 25);
-        lv_obj_set_pos((lv_obj_t *)(task_info->user_data), 141 + offset, 20); /* Start position of UNHEALTHY */
+        gui_binding_set_pos(pointer, 141 + offset, 20); /* Start position of UNHEALTHY */
     }
     else if (real_voc >= 201 && real_voc <= 300)
     {
         uint8_t offset = (real_voc - 200) / (100 / 25);
-        lv_obj_set_pos((lv_obj_t *)(task_info->user_data), 170 + offset, 20); /* Start position of VERY UNHEALTHY */
+        gui_binding_set_pos(pointer, 170 + offset, 20); /* Start position of VERY UNHEALTHY */
     }
     else if (real_voc >= 301 && real_voc <= 500)
     {
         uint8_t offset = (real_voc - 300) / (200 / 25);
-        lv_obj_set_pos((lv_obj_t *)(task_info->user_data), 199 + offset, 20); /* Start position of HAZARDOUS */
+        gui_binding_set_pos(pointer, 199 + offset, 20); /* Start position of HAZARDOUS */
     }
 }
 #endif
 
-#ifdef CONFIG_VOC_INSTALLED
-static void temp_label_value_refresher_task(lv_task_t *task_info)
+#ifdef CONFIG_GUI_FLUSH_TASK
+/* Called by LVGL on the GUI task core, only hands the buffer over */
+static void gui_flush_cb(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_map)
 {
-    int16_t temperature;
-    voc_index_get_temperature(&temperature);
-    float real_temperature = temperature / 200.0;
-    lv_label_set_text_fmt((lv_obj_t *)(task_info->user_data), "%.01fC", real_temperature);
+    gui_flush_request_t request = {
+        .drv = drv,
+        .area = *area,
+        .color_map = color_map,
+    };
+
+    spmc_ring_push(&flush_ring, &request);
+    xTaskNotifyGive(flush_task);
 }
-#endif
 
-#ifdef CONFIG_VOC_INSTALLED
-static void hum_label_value_refresher_task(lv_task_t *task_info)
+/* Sends the buffers on the other core. The SPI ISR calls lv_disp_flush_ready() when the pixels are
+on the wire, the transactions are then recycled here instead of on the GUI task. */
+static void flushTask(void *pvParameter)
 {
-    int16_t humidity;
-    voc_index_get_rhumidity(&humidity);
-    float real_humidity = humidity / 100.0;
-    lv_label_set_text_fmt((lv_obj_t *)(task_info->user_data), "%0.1f%%", real_humidity);
-}
-#endif
+    (void)pvParameter;
+    gui_flush_request_t request;
 
-#ifdef CONFIG_VOC_INSTALLED
-static void hum_bar_value_refresher_task(lv_task_t *task_info)
-{
-    int16_t humidity;
-    voc_index_get_rhumidity(&humidity);
-    float real_humidity = humidity / 100.0;
-    lv_bar_set_value((lv_obj_t *)(task_info->user_data), 100, LV_ANIM_OFF); // set it at 100 just to fill in the bar's color.
-    // Source for color assignment: https://www.airthings.com/en/what-is-humidity
-    if (real_humidity < 25)
-    {
-        lv_style_set_bg_color(&hum_bar_style, LV_STATE_DEFAULT, LV_COLOR_HAZARDOUS);
-        lv_obj_add_style((lv_obj_t *)(task_info->user_data), LV_BAR_PART_INDIC, &hum_bar_style);
-    }
-    else if (real_humidity >= 25 && real_humidity < 30)
-    {
-        lv_style_set_bg_color(&hum_bar_style, LV_STATE_DEFAULT, LV_COLOR_UNHEALTHY);
-        lv_obj_add_style((lv_obj_t *)(task_info->user_data), LV_BAR_PART_INDIC, &hum_bar_style);
-    }
-    else if (real_humidity >= 30 && real_humidity < 60)
-    {
-        lv_style_set_bg_color(&hum_bar_style, LV_STATE_DEFAULT, LV_COLOR_GOOD);
-        lv_obj_add_style((lv_obj_t *)(task_info->user_data), LV_BAR_PART_INDIC, &hum_bar_style);
-    }
-    else if (real_humidity >= 60 && real_humidity < 70)
-    {
-        lv_style_set_bg_color(&hum_bar_style, LV_STATE_DEFAULT, LV_COLOR_UNHEALTHY);
-        lv_obj_add_style((lv_obj_t *)(task_info->user_data), LV_BAR_PART_INDIC, &hum_bar_style);
-    }
-    else if (real_humidity >= 70)
+    while (1)
     {
-        lv_style_set_bg_color(&hum_bar_style, LV_STATE_DEFAULT, LV_COLOR_HAZARDOUS);
-        lv_obj_add_style((lv_obj_t *)(task_info->user_data), LV_BAR_PART_INDIC, &hum_bar_style);
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        while (spmc_ring_pop(&flush_ring, &flush_reader, &request) == SPMC_RING_OK)
+        {
+            disp_driver_flush(request.drv, &request.area, request.color_map);
+            disp_wait_for_pending_transactions();
+        }
     }
 }
 #endif
 
-#ifdef CONFIG_CO2_INSTALLED
-static void co2_label_value_refresher_task(lv_task_t *task_info)
+#ifdef CONFIG_GUI_BENCHMARK
+/* Time full screen redraws, from the invalidation until the last buffer is on the wire. Call with
+the GUI semaphore held or before the loop of the GUI task. */
+static void gui_benchmark(void)
 {
-    uint16_t co2;
-    co2_get_co2(&co2);
-    lv_label_set_text_fmt((lv_obj_t *)(task_info->user_data), "%i", co2);
-}
-static void co2_bar_value_refresher_task(lv_task_t *task_info)
-{
-    uint16_t co2;
-    co2_get_co2(&co2);
-
-    lv_bar_set_value((lv_obj_t *)(task_info->user_data), 100, LV_ANIM_OFF); // set it at 100 just to fill in the bar's color.
+    lv_disp_t *disp = lv_disp_get_default();
+    lv_disp_buf_t *disp_buf = lv_disp_get_buf(disp);
+    int64_t total_us = 0;
 
-    // https://greenecon.net/3-metrics-to-guide-air-quality-health-safety/carbon-footprint.html
-    if (co2 <= 700)
-    {
-        lv_style_set_bg_color(&co2_bar_style, LV_STATE_DEFAULT, LV_COLOR_GOOD);
-        lv_obj_add_style((lv_obj_t *)(task_info->user_data), LV_BAR_PART_INDIC, &co2_bar_style);
-    }
-    else if (co2 > 700 && co2 <= 1000)
+    for (int frame = 0; frame < CONFIG_GUI_BENCHMARK_FRAMES; frame++)
     {
-        lv_style_set_bg_color(&co2_bar_style, LV_STATE_DEFAULT, LV_COLOR_MODERATE);
-        lv_obj_add_style((lv_obj_t *)(task_info->user_data), LV_BAR_PART_INDIC, &co2_bar_style);
-    }
-    else if (co2 > 1000 && co2 <= 1500)
-    {
-        lv_style_set_bg_color(&co2_bar_style, LV_STATE_DEFAULT, LV_COLOR_UNHEALTHY_FOR_SENSITIVE_GROUPS);
-        lv_obj_add_style((lv_obj_t *)(task_info->user_data), LV_BAR_PART_INDIC, &co2_bar_style);
-    }
-    else if (co2 > 1500 && co2 <= 2500)
-    {
-        lv_style_set_bg_color(&co2_bar_style, LV_STATE_DEFAULT, LV_COLOR_UNHEALTHY);
-        lv_obj_add_style((lv_obj_t *)(task_info->user_data), LV_BAR_PART_INDIC, &co2_bar_style);
-    }
-    else if (co2 > 2500 && co2 <= 5000)
-    {
-        lv_style_set_bg_color(&co2_bar_style, LV_STATE_DEFAULT, LV_COLOR_VERY_UNHEALTHY);
-        lv_obj_add_style((lv_obj_t *)(task_info->user_data), LV_BAR_PART_INDIC, &co2_bar_style);
-    }
-    else if (co2 > 5000)
-    {
-        lv_style_set_bg_color(&co2_bar_style, LV_STATE_DEFAULT, LV_COLOR_HAZARDOUS);
-        lv_obj_add_style((lv_obj_t *)(task_info->user_data), LV_BAR_PART_INDIC, &co2_bar_style);
+        int64_t start_us = esp_timer_get_time();
+        lv_obj_invalidate(lv_scr_act());
+        lv_refr_now(disp);
+        /* The last buffer is still being sent when lv_refr_now() returns */
+        while (disp_buf->flushing)
+        {
+        }
+        total_us += esp_timer_get_time() - start_us;
     }
+
+#ifdef CONFIG_GUI_FLUSH_TASK
+    const char *mode = "flush task on core 0";
+#else
+    const char *mode = "flush in the GUI task";
+#endif
+    ESP_LOGI(TAG, "Full screen redraw: %lld us on average over %d frames, %s",
+             (long long)(total_us / CONFIG_GUI_BENCHMARK_FRAMES), CONFIG_GUI_BENCHMARK_FRAMES, mode);
 }
 #endif
 
-#ifdef CONFIG_PM_INSTALLED
-static void pm2_5_label_value_refresher_task(lv_task_t *task_info)
+/* Called by LVGL after every refresh with the time it took to render and flush it */
+static void gui_monitor_cb(lv_disp_drv_t *disp_drv, uint32_t time, uint32_t px)
 {
-    uint16_t pm2p5;
-    particulate_matter_get_pm2p5(&pm2p5);
-    float real_pm2p5 = pm2p5 / 1000.0;
-    lv_label_set_text_fmt((lv_obj_t *)(task_info->user_data), "%.01f", real_pm2p5);
+    (void)disp_drv;
+    portENTER_CRITICAL(&render_stats_lock);
+    render_stats.refreshes++;
+    render_stats.pixels += px;
+    render_stats.time_ms += time;
+    portEXIT_CRITICAL(&render_stats_lock);
 }
-static void pm2_5_bar_value_refresher_task(lv_task_t *task_info)
-{
-    uint16_t pm2p5;
-    particulate_matter_get_pm2p5(&pm2p5);
-    float real_pm2p5 = pm2p5 / 1000.0;
-
-    lv_bar_set_value((lv_obj_t *)(task_info->user_data), 100, LV_ANIM_OFF); // set it at 100 just to fill in the bar's color.
 
-    // https://www.airveda.com/blog/Understanding-Particulate-Matter-and-Its-Associated-Health-Impact
-    if (real_pm2p5 <= 30)
-    {
-        lv_style_set_bg_color(&pm2_5_bar_style, LV_STATE_DEFAULT, LV_COLOR_GOOD);
-        lv_obj_add_style((lv_obj_t *)(task_info->user_data), LV_BAR_PART_INDIC, &pm2_5_bar_style);
-    }
-    else if (real_pm2p5 > 30 && real_pm2p5 <= 60)
-    {
-        lv_style_set_bg_color(&pm2_5_bar_style, LV_STATE_DEFAULT, LV_COLOR_MODERATE);
-        lv_obj_add_style((lv_obj_t *)(task_info->user_data), LV_BAR_PART_INDIC, &pm2_5_bar_style);
-    }
-    else if (real_pm2p5 > 60 && real_pm2p5 <= 90)
-    {
-        lv_style_set_bg_color(&pm2_5_bar_style, LV_STATE_DEFAULT, LV_COLOR_UNHEALTHY_FOR_SENSITIVE_GROUPS);
-        lv_obj_add_style((lv_obj_t *)(task_info->user_data), LV_BAR_PART_INDIC, &pm2_5_bar_style);
-    }
-    else if (real_pm2p5 > 90 && real_pm2p5 <= 120)
-    {
-        lv_style_set_bg_color(&pm2_5_bar_style, LV_STATE_DEFAULT, LV_COLOR_UNHEALTHY);
-        lv_obj_add_style((lv_obj_t *)(task_info->user_data), LV_BAR_PART_INDIC, &pm2_5_bar_style);   
-    }
-    else if (real_pm2p5 > 120 && real_pm2p5 <= 250)
-    {
-        lv_style_set_bg_color(&pm2_5_bar_style, LV_STATE_DEFAULT, LV_COLOR_VERY_UNHEALTHY);
-        lv_obj_add_style((lv_obj_t *)(task_info->user_data), LV_BAR_PART_INDIC, &pm2_5_bar_style);
-    }
-    else if (real_pm2p5 > 250)
-    {
-        lv_style_set_bg_color(&pm2_5_bar_style, LV_STATE_DEFAULT, LV_COLOR_HAZARDOUS);
-        lv_obj_add_style((lv_obj_t *)(task_info->user_data), LV_BAR_PART_INDIC, &pm2_5_bar_style);
-    }
-}
-static void pm10_label_value_refresher_task(lv_task_t *task_info)
-{
-    uint16_t pm10p0;
-    particulate_matter_get_pm10p0(&pm10p0);
-    float real_pm10p0 = pm10p0 / 1000.0;
-    lv_label_set_text_fmt((lv_obj_t *)(task_info->user_data), "%.01f", real_pm10p0);
-}
-static void pm10_bar_value_refresher_task(lv_task_t *task_info)
+void gui_st7789_get_render_stats(gui_st7789_render_stats_t *stats)
 {
-    uint16_t pm10p0;
-    particulate_matter_get_pm10p0(&pm10p0);
-    float real_pm10p0 = pm10p0 / 1000.0;
-
-    lv_bar_set_value((lv_obj_t *)(task_info->user_data), 100, LV_ANIM_OFF); // set it at 100 just to fill in the bar's color.
-
-    // https://www.airveda.com/blog/Understanding-Particulate-Matter-and-Its-Associated-Health-Impact
-    if (real_pm10p0 <= 50)
-    {
-        lv_style_set_bg_color(&pm10_bar_style, LV_STATE_DEFAULT, LV_COLOR_GOOD);
-        lv_obj_add_style((lv_obj_t *)(task_info->user_data), LV_BAR_PART_INDIC, &pm10_bar_style);
-    }
-    else if (real_pm10p0 > 50 && real_pm10p0 <= 100)
-    {
-        lv_style_set_bg_color(&pm10_bar_style, LV_STATE_DEFAULT, LV_COLOR_MODERATE);
-        lv_obj_add_style((lv_obj_t *)(task_info->user_data), LV_BAR_PART_INDIC, &pm10_bar_style);
-    }
-    else if (real_pm10p0 > 100 && real_pm10p0 <= 250)
-    {
-        lv_style_set_bg_color(&pm10_bar_style, LV_STATE_DEFAULT, LV_COLOR_UNHEALTHY_FOR_SENSITIVE_GROUPS);
-        lv_obj_add_style((lv_obj_t *)(task_info->user_data), LV_BAR_PART_INDIC, &pm10_bar_style);
-    }
-    else if (real_pm10p0 > 250 && real_pm10p0 <= 350)
-    {
-        lv_style_set_bg_color(&pm10_bar_style, LV_STATE_DEFAULT, LV_COLOR_UNHEALTHY);
-        lv_obj_add_style((lv_obj_t *)(task_info->user_data), LV_BAR_PART_INDIC, &pm10_bar_style);   
-    }
-    else if (real_pm10p0 > 350 && real_pm10p0 <= 430)
-    {
-        lv_style_set_bg_color(&pm10_bar_style, LV_STATE_DEFAULT, LV_COLOR_VERY_UNHEALTHY);
-        lv_obj_add_style((lv_obj_t *)(task_info->user_data), LV_BAR_PART_INDIC, &pm10_bar_style);
-    }
-    else if (real_pm10p0 > 430)
-    {
-        lv_style_set_bg_color(&pm10_bar_style, LV_STATE_DEFAULT, LV_COLOR_HAZARDOUS);
-        lv_obj_add_style((lv_obj_t *)(task_info->user_data), LV_BAR_PART_INDIC, &pm10_bar_style);
-    }
+    portENTER_CRITICAL(&render_stats_lock);
+    *stats = render_stats;
+    portEXIT_CRITICAL(&render_stats_lock);
+    stats->spi_busy_us = disp_spi_get_busy_time_us();
 }
-#endif
 
 static void lv_tick_task(void *arg)
 {
@@ -1,10 +1,28 @@
 #ifndef COMPONENTS_GUI_ST7789_H
 #define COMPONENTS_GUI_ST7789_H
 
+#include <stdint.h>
+
+/* Screen refreshes since boot, the cost of every update of the widgets */
+typedef struct
+{
+    uint32_t refreshes; // Refreshes that rendered at least one invalidated area.
+    uint64_t pixels;    // Pixels rendered and sent to the display.
+    uint32_t time_ms;   // Time spent rendering and flushing. Unit in milliseconds.
+    uint64_t spi_busy_us; // Time the display SPI bus spent transferring. Unit in microseconds.
+} gui_st7789_render_stats_t;
+
 /**
  * @brief Initialize the GUI with the ST7789 TFT display and run the task that is responsible
  * for updating the display.
  */ 
 void gui_st7789_init();
 
+/**
+ * @brief Get the refresh counters of the display. Safe to call from any task.
+ *
+ * @param[out] stats copy of the counters.
+ */
+void gui_st7789_get_render_stats(gui_st7789_render_stats_t *stats);
+
 #endif
\ No newline at end of file
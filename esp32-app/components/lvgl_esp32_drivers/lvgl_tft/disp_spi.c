@@ -10,6 +10,7 @@
 #include "driver/gpio.h"
 #include "driver/spi_master.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 
 #define TAG "disp_spi"
 
@@ -85,6 +86,7 @@
 /**********************
  *  STATIC PROTOTYPES
  **********************/
+static void IRAM_ATTR spi_pre (spi_transaction_t *trans);
 static void IRAM_ATTR spi_ready (spi_transaction_t *trans);
 
 /**********************
@@ -93,7 +95,14 @@ static void IRAM_ATTR spi_ready (spi_transaction_t *trans);
 static spi_host_device_t spi_host;
 static spi_device_handle_t spi;
 static QueueHandle_t TransactionPool = NULL;
+static transaction_cb_t chained_pre_cb;
 static transaction_cb_t chained_post_cb;
+static int dc_gpio = -1;
+
+/* Bus time accounting, updated from the SPI callbacks */
+static portMUX_TYPE busy_lock = portMUX_INITIALIZER_UNLOCKED;
+static int64_t busy_start_us;
+static uint64_t busy_us;
 
 /**********************
  *      MACROS
@@ -105,6 +114,8 @@ static transaction_cb_t chained_post_cb;
 void disp_spi_add_device_config(spi_host_device_t host, spi_device_interface_config_t *devcfg)
 {
     spi_host=host;
+    chained_pre_cb=devcfg->pre_cb;
+    devcfg->pre_cb=spi_pre;
     chained_post_cb=devcfg->post_cb;
     devcfg->post_cb=spi_ready;
     esp_err_t ret=spi_bus_add_device(host, devcfg, &spi);
@@ -157,6 +168,22 @@ void disp_spi_add_device_with_speed(spi_host_device_t host, int clock_speed_hz)
 	}
 }
 
+void disp_spi_set_dc_gpio(int gpio)
+{
+    dc_gpio = gpio;
+}
+
+uint64_t disp_spi_get_busy_time_us(void)
+{
+    uint64_t us;
+
+    portENTER_CRITICAL(&busy_lock);
+    us = busy_us;
+    portEXIT_CRITICAL(&busy_lock);
+
+    return us;
+}
+
 void disp_spi_change_device_speed(int clock_speed_hz)
 {
     if (clock_speed_hz <= 0) {
@@ -297,10 +324,32 @@ void disp_spi_release(void)
  *   STATIC FUNCTIONS
  **********************/
 
+static void IRAM_ATTR spi_pre(spi_transaction_t *trans)
+{
+    disp_spi_send_flag_t flags = (disp_spi_send_flag_t) trans->user;
+
+    /* Called right before the transaction goes on the wire, after the previous one completed */
+    if ((dc_gpio >= 0) && (flags & (DISP_SPI_DC_COMMAND | DISP_SPI_DC_DATA))) {
+        gpio_set_level(dc_gpio, (flags & DISP_SPI_DC_DATA) ? 1 : 0);
+    }
+
+    portENTER_CRITICAL_SAFE(&busy_lock);
+    busy_start_us = esp_timer_get_time();
+    portEXIT_CRITICAL_SAFE(&busy_lock);
+
+    if (chained_pre_cb) {
+        chained_pre_cb(trans);
+    }
+}
+
 static void IRAM_ATTR spi_ready(spi_transaction_t *trans)
 {
     disp_spi_send_flag_t flags = (disp_spi_send_flag_t) trans->user;
 
+    portENTER_CRITICAL_SAFE(&busy_lock);
+    busy_us += esp_timer_get_time() - busy_start_us;
+    portEXIT_CRITICAL_SAFE(&busy_lock);
+
     if (flags & DISP_SPI_SIGNAL_FLUSH) {
         lv_disp_t * disp = NULL;
 
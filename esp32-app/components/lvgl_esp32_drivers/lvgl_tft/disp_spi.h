@@ -40,6 +40,8 @@ typedef enum _disp_spi_send_flag_t {
     DISP_SPI_MODE_QIO           = 0x00000800, 
     DISP_SPI_MODE_DIOQIO_ADDR   = 0x00001000, 
 	DISP_SPI_VARIABLE_DUMMY		= 0x00002000,
+    DISP_SPI_DC_COMMAND         = 0x00004000, /* D/C low, see disp_spi_set_dc_gpio() */
+    DISP_SPI_DC_DATA            = 0x00008000, /* D/C high, see disp_spi_set_dc_gpio() */
 } disp_spi_send_flag_t;
 
 
@@ -52,6 +54,14 @@ void disp_spi_add_device_with_speed(spi_host_device_t host, int clock_speed_hz);
 void disp_spi_change_device_speed(int clock_speed_hz);
 void disp_spi_remove_device();
 
+/* Let the pre-transaction callback drive the D/C line of transactions sent with
+   DISP_SPI_DC_COMMAND or DISP_SPI_DC_DATA. Commands and data can then be queued
+   back to back instead of waiting for the bus to drain before toggling D/C. */
+void disp_spi_set_dc_gpio(int dc_gpio);
+
+/* Time the bus spent transferring since boot, in microseconds */
+uint64_t disp_spi_get_busy_time_us(void);
+
 /*	Important! 
 	All buffers should also be 32-bit aligned and DMA capable to prevent extra allocations and copying.
 	When DMA reading (even in polling mode) the ESP32 always read in 4-byte chunks even if less is requested.
@@ -37,7 +37,10 @@ static void st7789_set_orientation(uint8_t orientation);
 
 static void st7789_send_cmd(uint8_t cmd);
 static void st7789_send_data(void *data, uint16_t length);
-static void st7789_send_color(void *data, uint16_t length);
+
+static void st7789_queue_cmd(uint8_t cmd);
+static void st7789_queue_data(void *data, uint16_t length);
+static void st7789_queue_color(void *data, size_t length);
 
 /**********************
  *  STATIC VARIABLES
@@ -90,6 +93,7 @@ void st7789_init(void)
     //Initialize non-SPI GPIOs
     gpio_pad_select_gpio(ST7789_DC);
     gpio_set_direction(ST7789_DC, GPIO_MODE_OUTPUT);
+    disp_spi_set_dc_gpio(ST7789_DC);
 
 #if !defined(CONFIG_LV_DISP_ST7789_SOFT_RESET)
     gpio_pad_select_gpio(ST7789_RST);
@@ -173,28 +177,33 @@ void st7789_flush(lv_disp_drv_t * drv, const lv_area_t * area, lv_color_t * colo
 #endif
 #endif
 
+    /* The whole flush is queued without waiting in between: the address window is set
+     * while the previous stripe may still be on the wire, and the D/C line is driven
+     * per transaction by disp_spi. The ISR of the color transaction calls
+     * lv_disp_flush_ready(), so LVGL renders into the other buffer meanwhile. */
+
     /*Column addresses*/
-    st7789_send_cmd(ST7789_CASET);
+    st7789_queue_cmd(ST7789_CASET);
     data[0] = (offsetx1 >> 8) & 0xFF;
     data[1] = offsetx1 & 0xFF;
     data[2] = (offsetx2 >> 8) & 0xFF;
     data[3] = offsetx2 & 0xFF;
-    st7789_send_data(data, 4);
+    st7789_queue_data(data, 4);
 
     /*Page addresses*/
-    st7789_send_cmd(ST7789_RASET);
+    st7789_queue_cmd(ST7789_RASET);
     data[0] = (offsety1 >> 8) & 0xFF;
     data[1] = offsety1 & 0xFF;
     data[2] = (offsety2 >> 8) & 0xFF;
     data[3] = offsety2 & 0xFF;
-    st7789_send_data(data, 4);
+    st7789_queue_data(data, 4);
 
     /*Memory write*/
-    st7789_send_cmd(ST7789_RAMWR);
+    st7789_queue_cmd(ST7789_RAMWR);
 
     uint32_t size = lv_area_get_width(area) * lv_area_get_height(area);
 
-    st7789_send_color((void*)color_map, size * 2);
+    st7789_queue_color((void*)color_map, size * 2);
 
 }
 
@@ -215,11 +224,23 @@ static void st7789_send_data(void * data, uint16_t length)
     disp_spi_send_data(data, length);
 }
 
-static void st7789_send_color(void * data, uint16_t length)
+/* Commands and data of up to 4 bytes are copied into the transaction, the caller's
+ * buffer can be reused as soon as these return. */
+static void st7789_queue_cmd(uint8_t cmd)
 {
-    disp_wait_for_pending_transactions();
-    gpio_set_level(ST7789_DC, 1);
-    disp_spi_send_colors(data, length);
+    disp_spi_transaction(&cmd, 1, DISP_SPI_SEND_QUEUED | DISP_SPI_DC_COMMAND, NULL, 0, 0);
+}
+
+static void st7789_queue_data(void * data, uint16_t length)
+{
+    disp_spi_transaction(data, length, DISP_SPI_SEND_QUEUED | DISP_SPI_DC_DATA, NULL, 0, 0);
+}
+
+static void st7789_queue_color(void * data, size_t length)
+{
+    disp_spi_transaction(data, length,
+        DISP_SPI_SEND_QUEUED | DISP_SPI_SIGNAL_FLUSH | DISP_SPI_DC_DATA,
+        NULL, 0, 0);
 }
 
 static void st7789_set_orientation(uint8_t orientation)
@@ -0,0 +1,381 @@
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_http_server.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "metrics.h"
+#include "sample_bus.h"
+#include "aqi.h"
+#include "acquisition.h"
+#include "energy.h"
+#include "telemetry.h"
+#include "wifi.h"
+#include "sensirion_i2c_arbiter.h"
+#include "gui_binding.h"
+#include "gui_st7789.h"
+
+#ifdef CONFIG_VOC_INSTALLED
+#include "voc_index.h"
+#endif
+#ifdef CONFIG_PM_INSTALLED
+#include "particulate_matter.h"
+#endif
+#ifdef CONFIG_CO2_INSTALLED
+#include "co2.h"
+#endif
+
+#define TAG "metrics.c"
+
+/* Counters also change without a new sample, refresh at least this often */
+#define METRICS_REFRESH_PERIOD_MS 10000
+
+#define METRICS_PROMETHEUS_SIZE 7168
+#define METRICS_JSON_SIZE 256
+
+typedef struct
+{
+    char prometheus[METRICS_PROMETHEUS_SIZE];
+    size_t prometheus_length;
+    char json[METRICS_JSON_SIZE];
+    size_t json_length;
+    uint8_t readers; // Requests currently sending this page.
+} metrics_page_t;
+
+/* One page is served while the other one is formatted. A page that is still being sent is not
+overwritten, the update is skipped instead. */
+static metrics_page_t s_pages[2];
+static uint8_t s_current;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static const struct
+{
+    uint8_t address;
+    const char *name;
+} s_i2c_devices[] = {{0x62, "SCD41"}, {0x6A, "SVM40"}, {0x69, "SPS30"}};
+
+/* Sensors with acquisition statistics */
+#define METRICS_MAX_SENSORS 3
+
+#define METRICS_I2C_DEVICE_COUNT (sizeof(s_i2c_devices) / sizeof(s_i2c_devices[0]))
+
+static const char *s_energy_consumers[ENERGY_CONSUMER_MAX] = {"MCU", "SCD41", "SPS30", "SVM40"};
+
+static void metrics_printf(char *buffer, size_t size, size_t *length, const char *format, ...)
+{
+    va_list args;
+
+    if (*length >= size)
+    {
+        return;
+    }
+    va_start(args, format);
+    int written = vsnprintf(&buffer[*length], size - *length, format, args);
+    va_end(args);
+    if (written > 0)
+    {
+        *length += written;
+    }
+}
+
+#define METRICS_PROMETHEUS(page, ...) metrics_printf((page)->prometheus, METRICS_PROMETHEUS_SIZE, &(page)->prometheus_length, __VA_ARGS__)
+#define METRICS_JSON(page, ...) metrics_printf((page)->json, METRICS_JSON_SIZE, &(page)->json_length, __VA_ARGS__)
+
+static void metrics_format_gauge(metrics_page_t *page, const char *name, const char *help, double value)
+{
+    METRICS_PROMETHEUS(page, "# HELP %s %s\n# TYPE %s gauge\n%s %.3f\n", name, help, name, name, value);
+}
+
+/* One family with a sample per label value. Prometheus wants all samples of a family together. */
+static void metrics_format_family(metrics_page_t *page, const char *name, const char *type, const char *label,
+                                  const char *const *label_values, const double *values, size_t count, int decimals)
+{
+    METRICS_PROMETHEUS(page, "# TYPE %s %s\n", name, type);
+    for (size_t i = 0; i < count; i++)
+    {
+        METRICS_PROMETHEUS(page, "%s{%s=\"%s\"} %.*f\n", name, label, label_values[i], decimals, values[i]);
+    }
+}
+
+static void metrics_format_acquisition(metrics_page_t *page)
+{
+    const char *sensors[METRICS_MAX_SENSORS];
+    acquisition_stats_t stats[METRICS_MAX_SENSORS];
+    double values[4][METRICS_MAX_SENSORS];
+    size_t count = 0;
+
+#ifdef CONFIG_VOC_INSTALLED
+    voc_index_get_acquisition_stats(&stats[count]);
+    sensors[count++] = "SVM40";
+#endif
+#ifdef CONFIG_CO2_INSTALLED
+    co2_get_acquisition_stats(&stats[count]);
+    sensors[count++] = "SCD41";
+#endif
+#ifdef CONFIG_PM_INSTALLED
+    particulate_matter_get_acquisition_stats(&stats[count]);
+    sensors[count++] = "SPS30";
+#endif
+    for (size_t i = 0; i < count; i++)
+    {
+        values[0][i] = stats[i].samples;
+        values[1][i] = stats[i].missed;
+        values[2][i] = stats[i].duplicates;
+        values[3][i] = stats[i].polls;
+    }
+    metrics_format_family(page, "airquality_acquisition_samples_total", "counter", "sensor", sensors, values[0], count, 0);
+    metrics_format_family(page, "airquality_acquisition_missed_total", "counter", "sensor", sensors, values[1], count, 0);
+    metrics_format_family(page, "airquality_acquisition_duplicates_total", "counter", "sensor", sensors, values[2], count, 0);
+    metrics_format_family(page, "airquality_acquisition_polls_total", "counter", "sensor", sensors, values[3], count, 0);
+}
+
+static void metrics_format_i2c(metrics_page_t *page)
+{
+    const char *devices[METRICS_I2C_DEVICE_COUNT];
+    sensirion_i2c_device_stats_t stats;
+    double values[4][METRICS_I2C_DEVICE_COUNT];
+    size_t count = 0;
+
+    for (size_t i = 0; i < METRICS_I2C_DEVICE_COUNT; i++)
+    {
+        if (!sensirion_i2c_arbiter_get_stats(s_i2c_devices[i].address, &stats))
+        {
+            continue;
+        }
+        devices[count] = s_i2c_devices[i].name;
+        values[0][count] = stats.transactions;
+        values[1][count] = stats.errors;
+        values[2][count] = stats.busy_us / 1e6;
+        values[3][count] = stats.max_latency_us / 1e6;
+        count++;
+    }
+    metrics_format_family(page, "airquality_i2c_transactions_total", "counter", "device", devices, values[0], count, 0);
+    metrics_format_family(page, "airquality_i2c_errors_total", "counter", "device", devices, values[1], count, 0);
+    metrics_format_family(page, "airquality_i2c_busy_seconds_total", "counter", "device", devices, values[2], count, 6);
+    metrics_format_family(page, "airquality_i2c_max_latency_seconds", "gauge", "device", devices, values[3], count, 6);
+}
+
+static void metrics_format_counters(metrics_page_t *page)
+{
+    energy_report_t energy;
+    telemetry_store_backlog_t backlog;
+    telemetry_uplink_stats_t uplink;
+    wifi_stats_t wifi;
+    gui_binding_stats_t gui;
+    gui_st7789_render_stats_t render;
+
+    metrics_format_acquisition(page);
+    metrics_format_i2c(page);
+
+    energy_get_report(&energy);
+    METRICS_PROMETHEUS(page, "# HELP airquality_energy_average_microamperes Average current since boot, estimated from typical currents.\n"
+                             "# TYPE airquality_energy_average_microamperes gauge\n");
+    for (int i = 0; i < ENERGY_CONSUMER_MAX; i++)
+    {
+        METRICS_PROMETHEUS(page, "airquality_energy_average_microamperes{consumer=\"%s\"} %u\n", s_energy_consumers[i], energy.average_ua[i]);
+    }
+
+    if (telemetry_get_backlog(&backlog))
+    {
+        METRICS_PROMETHEUS(page, "# TYPE airquality_telemetry_backlog_records gauge\nairquality_telemetry_backlog_records %u\n", backlog.pending_records);
+        METRICS_PROMETHEUS(page, "# TYPE airquality_telemetry_backlog_bytes gauge\nairquality_telemetry_backlog_bytes %u\n", backlog.pending_bytes);
+        METRICS_PROMETHEUS(page, "# TYPE airquality_telemetry_capacity_bytes gauge\nairquality_telemetry_capacity_bytes %u\n", backlog.capacity_bytes);
+        METRICS_PROMETHEUS(page, "# TYPE airquality_telemetry_dropped_total counter\nairquality_telemetry_dropped_total %u\n", backlog.dropped_records);
+    }
+    telemetry_get_uplink_stats(&uplink);
+    METRICS_PROMETHEUS(page, "# TYPE airquality_telemetry_published_total counter\nairquality_telemetry_published_total %u\n", uplink.published);
+    METRICS_PROMETHEUS(page, "# TYPE airquality_telemetry_acked_total counter\nairquality_telemetry_acked_total %u\n", uplink.acked);
+    METRICS_PROMETHEUS(page, "# TYPE airquality_telemetry_expired_total counter\nairquality_telemetry_expired_total %u\n", uplink.expired);
+    METRICS_PROMETHEUS(page, "# TYPE airquality_telemetry_in_flight gauge\nairquality_telemetry_in_flight %u\n", uplink.in_flight);
+
+    wifi_get_stats(&wifi);
+    METRICS_PROMETHEUS(page, "# TYPE airquality_wifi_connects_total counter\nairquality_wifi_connects_total %u\n", wifi.connects);
+    METRICS_PROMETHEUS(page, "# TYPE airquality_wifi_disconnects_total counter\nairquality_wifi_disconnects_total %u\n", wifi.disconnects);
+    METRICS_PROMETHEUS(page, "# TYPE airquality_wifi_last_connect_seconds gauge\nairquality_wifi_last_connect_seconds %.3f\n", wifi.last_connect_ms / 1000.0);
+
+    gui_binding_get_stats(&gui);
+    METRICS_PROMETHEUS(page, "# TYPE airquality_gui_updates_applied_total counter\nairquality_gui_updates_applied_total %u\n", gui.applied);
+    METRICS_PROMETHEUS(page, "# TYPE airquality_gui_updates_suppressed_total counter\nairquality_gui_updates_suppressed_total %u\n", gui.suppressed);
+    METRICS_PROMETHEUS(page, "# HELP airquality_gui_saved_bytes_total Pixel bytes not rendered and sent to the display because the value did not change.\n"
+                             "# TYPE airquality_gui_saved_bytes_total counter\nairquality_gui_saved_bytes_total %llu\n", gui.bytes_saved);
+
+    gui_st7789_get_render_stats(&render);
+    METRICS_PROMETHEUS(page, "# HELP airquality_gui_refreshes_total Screen refreshes, its rate is the achieved frame rate.\n"
+                             "# TYPE airquality_gui_refreshes_total counter\nairquality_gui_refreshes_total %u\n", render.refreshes);
+    METRICS_PROMETHEUS(page, "# TYPE airquality_gui_rendered_pixels_total counter\nairquality_gui_rendered_pixels_total %llu\n", render.pixels);
+    METRICS_PROMETHEUS(page, "# TYPE airquality_gui_render_seconds_total counter\nairquality_gui_render_seconds_total %.3f\n", render.time_ms / 1000.0);
+    METRICS_PROMETHEUS(page, "# HELP airquality_gui_spi_busy_seconds_total Time the display SPI bus spent transferring, its rate is the bus utilisation.\n"
+                             "# TYPE airquality_gui_spi_busy_seconds_total counter\nairquality_gui_spi_busy_seconds_total %.6f\n", render.spi_busy_us / 1e6);
+}
+
+static void metrics_format(metrics_page_t *page)
+{
+    double uptime = esp_timer_get_time() / 1e6;
+
+    page->prometheus_length = 0;
+    page->json_length = 0;
+
+    metrics_format_gauge(page, "airquality_uptime_seconds", "Time since boot.", uptime);
+    METRICS_JSON(page, "{\"uptime\":%.0f", uptime);
+
+#ifdef CONFIG_VOC_INSTALLED
+    int16_t voc_index;
+    int16_t rhumidity;
+    int16_t temperature;
+    voc_index_get_voc(&voc_index);
+    voc_index_get_rhumidity(&rhumidity);
+    voc_index_get_temperature(&temperature);
+    metrics_format_gauge(page, "airquality_voc_index", "VOC index measured by the SVM40.", voc_index / 10.0f);
+    metrics_format_gauge(page, "airquality_temperature_celsius", "Temperature measured by the SVM40.", temperature / 200.0f);
+    metrics_format_gauge(page, "airquality_relative_humidity_percent", "Relative humidity measured by the SVM40.", rhumidity / 100.0f);
+    METRICS_JSON(page, ",\"voc\":%.1f,\"temperature\":%.2f,\"rhumidity\":%.2f", voc_index / 10.0f, temperature / 200.0f, rhumidity / 100.0f);
+#endif
+
+#ifdef CONFIG_CO2_INSTALLED
+    uint16_t co2;
+    co2_get_co2(&co2);
+    metrics_format_gauge(page, "airquality_co2_ppm", "CO2 concentration measured by the SCD41.", co2);
+    METRICS_JSON(page, ",\"co2\":%u", co2);
+#endif
+
+#ifdef CONFIG_PM_INSTALLED
+    static const char *sizes[] = {"0.5", "1.0", "2.5", "4.0", "10.0"};
+    sample_bus_pm_t pm;
+    particulate_matter_get_measurement(&pm);
+    const uint16_t counts[] = {pm.nc_0p5, pm.nc_1p0, pm.nc_2p5, pm.nc_4p0, pm.nc_10p0};
+    metrics_format_gauge(page, "airquality_pm1_micrograms_per_cubic_meter", "PM1.0 mass concentration measured by the SPS30.", pm.mc_1p0 / 10.0f);
+    metrics_format_gauge(page, "airquality_pm2p5_micrograms_per_cubic_meter", "PM2.5 mass concentration measured by the SPS30.", pm.mc_2p5 / 10.0f);
+    metrics_format_gauge(page, "airquality_pm4_micrograms_per_cubic_meter", "PM4.0 mass concentration measured by the SPS30.", pm.mc_4p0 / 10.0f);
+    metrics_format_gauge(page, "airquality_pm10_micrograms_per_cubic_meter", "PM10 mass concentration measured by the SPS30.", pm.mc_10p0 / 10.0f);
+    METRICS_PROMETHEUS(page, "# HELP airquality_particles_per_cubic_centimeter Number concentration of particles up to the given size measured by the SPS30.\n"
+                             "# TYPE airquality_particles_per_cubic_centimeter gauge\n");
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        METRICS_PROMETHEUS(page, "airquality_particles_per_cubic_centimeter{size_um=\"%s\"} %.1f\n", sizes[i], counts[i] / 10.0f);
+    }
+    metrics_format_gauge(page, "airquality_typical_particle_size_micrometers", "Typical particle size measured by the SPS30.", pm.typical_particle_size / 1000.0);
+    METRICS_JSON(page, ",\"pm2p5\":%.1f,\"pm10p0\":%.1f", pm.mc_2p5 / 10.0f, pm.mc_10p0 / 10.0f);
+
+    aqi_t aqi;
+    aqi_get(&aqi);
+    if (aqi.valid)
+    {
+        metrics_format_gauge(page, "airquality_index", "Air quality index from the averaged PM2.5 and PM10 concentrations.", aqi.index);
+        METRICS_JSON(page, ",\"aqi\":%u", aqi.index);
+    }
+#endif
+
+    METRICS_JSON(page, "}\n");
+    metrics_format_counters(page);
+
+    if (page->prometheus_length >= METRICS_PROMETHEUS_SIZE || page->json_length >= METRICS_JSON_SIZE)
+    {
+        ESP_LOGW(TAG, "Metrics truncated");
+        page->prometheus_length = page->prometheus_length < METRICS_PROMETHEUS_SIZE ? page->prometheus_length : METRICS_PROMETHEUS_SIZE - 1;
+        page->json_length = page->json_length < METRICS_JSON_SIZE ? page->json_length : METRICS_JSON_SIZE - 1;
+    }
+}
+
+static void metrics_update(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    metrics_page_t *page = &s_pages[!s_current];
+    bool busy = page->readers > 0;
+    portEXIT_CRITICAL(&s_lock);
+
+    /* Readers only take the current page, so nobody starts reading this one while it is formatted */
+    if (busy)
+    {
+        return;
+    }
+    metrics_format(page);
+
+    portENTER_CRITICAL(&s_lock);
+    s_current = !s_current;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static metrics_page_t *metrics_acquire_page(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    metrics_page_t *page = &s_pages[s_current];
+    page->readers++;
+    portEXIT_CRITICAL(&s_lock);
+    return page;
+}
+
+static void metrics_release_page(metrics_page_t *page)
+{
+    portENTER_CRITICAL(&s_lock);
+    page->readers--;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static esp_err_t metrics_prometheus_handler(httpd_req_t *req)
+{
+    metrics_page_t *page = metrics_acquire_page();
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+    esp_err_t err = httpd_resp_send(req, page->prometheus, page->prometheus_length);
+    metrics_release_page(page);
+    return err;
+}
+
+static esp_err_t metrics_json_handler(httpd_req_t *req)
+{
+    metrics_page_t *page = metrics_acquire_page();
+    httpd_resp_set_type(req, "application/json");
+    esp_err_t err = httpd_resp_send(req, page->json, page->json_length);
+    metrics_release_page(page);
+    return err;
+}
+
+static void metrics_task(void *pvParameters)
+{
+    sample_bus_subscriber_t subscriber = pvParameters;
+
+    while (1)
+    {
+        sample_bus_wait(subscriber, pdMS_TO_TICKS(METRICS_REFRESH_PERIOD_MS));
+        metrics_update();
+    }
+}
+
+void metrics_init(void)
+{
+    httpd_handle_t server = NULL;
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+
+    sample_bus_subscriber_t subscriber = sample_bus_subscribe(SAMPLE_BUS_ALL_SOURCES);
+    if (subscriber == NULL)
+    {
+        ESP_LOGE(TAG, "Error subscribing to the sample bus");
+        return;
+    }
+
+    /* Both pages are valid before the first request */
+    metrics_format(&s_pages[0]);
+    s_pages[1] = s_pages[0];
+
+    esp_err_t err = httpd_start(&server, &config);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Error starting the HTTP server: %s", esp_err_to_name(err));
+        return;
+    }
+
+    const httpd_uri_t prometheus_uri = {
+        .uri = "/metrics",
+        .method = HTTP_GET,
+        .handler = metrics_prometheus_handler};
+    const httpd_uri_t json_uri = {
+        .uri = "/json",
+        .method = HTTP_GET,
+        .handler = metrics_json_handler};
+    httpd_register_uri_handler(server, &prometheus_uri);
+    httpd_register_uri_handler(server, &json_uri);
+
+    xTaskCreate(metrics_task, "metrics task", 1024 * 3, subscriber, 3, NULL);
+}
@@ -0,0 +1,13 @@
+#ifndef COMPONENTS_METRICS_H
+#define COMPONENTS_METRICS_H
+
+/**
+ * @brief Start the HTTP server exposing the latest sensor values and the internal counters.
+ *
+ * GET /metrics returns the Prometheus text format, GET /json the sensor values as JSON. Both
+ * responses are formatted by a background task whenever a sensor publishes a sample, a scrape
+ * only sends the prepared buffer.
+ */
+void metrics_init(void);
+
+#endif
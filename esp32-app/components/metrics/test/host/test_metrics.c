@@ -0,0 +1,246 @@
+/* Load test of the metrics server on Linux, over the loopback server of the esp_http_server shim.
+ *
+ *   metrics_test load [clients] [requests]
+ *
+ * Every client thread scrapes /metrics and /json in turn while another thread publishes samples
+ * as fast as the bus takes them, so the pages are formatted and swapped during the scrapes. Each
+ * response must be complete and well formed: every Prometheus sample follows the # TYPE of its
+ * family, each family appears once, and a client never sees the uptime go back. Prints the
+ * requests per second and the latency percentiles. */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "host_shim.h"
+#include "host_test.h"
+#include "metrics.h"
+#include "sample_bus.h"
+
+#define TEST_MAX_CLIENTS 64
+#define TEST_MAX_RESPONSE (16 * 1024)
+#define TEST_MAX_FAMILIES 128
+#define TEST_MAX_NAME 96
+
+typedef struct
+{
+    pthread_t thread;
+    uint32_t requests;
+    uint64_t *latencies_ns;
+} test_client_t;
+
+static uint16_t s_port;
+static volatile bool s_publishing = true;
+
+/* Sends one GET and reads the response up to the close of the connection. Returns the body length,
+the body is at *body. */
+static size_t test_get(const char *uri, char *response, size_t size, const char **body)
+{
+    struct sockaddr_in address = {.sin_family = AF_INET, .sin_port = htons(s_port), .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    char request[128];
+    size_t length = 0;
+    ssize_t received;
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    HOST_CHECK(fd >= 0);
+    HOST_CHECK(connect(fd, (struct sockaddr *)&address, sizeof(address)) == 0);
+    int request_length = snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\nHost: localhost\r\n\r\n", uri);
+    HOST_CHECK(send(fd, request, request_length, MSG_NOSIGNAL) == request_length);
+    while ((received = recv(fd, response + length, size - 1 - length, 0)) > 0)
+    {
+        length += received;
+        HOST_CHECK(length < size - 1);
+    }
+    HOST_CHECK(received == 0);
+    close(fd);
+    response[length] = '\0';
+
+    HOST_CHECK(strncmp(response, "HTTP/1.1 200 OK\r\n", 17) == 0);
+    char *end_of_header = strstr(response, "\r\n\r\n");
+    HOST_CHECK(end_of_header != NULL);
+    *body = end_of_header + 4;
+    const char *content_length = strstr(response, "Content-Length: ");
+    HOST_CHECK(content_length != NULL && content_length < end_of_header);
+    size_t body_length = length - (*body - response);
+    HOST_CHECK_EQUAL(strtoul(content_length + 16, NULL, 10), body_length);
+    return body_length;
+}
+
+static void test_copy_name(char *name, const char *start, size_t length)
+{
+    HOST_CHECK(length > 0 && length < TEST_MAX_NAME);
+    memcpy(name, start, length);
+    name[length] = '\0';
+}
+
+/* Checks the text format and returns the uptime */
+static double test_check_prometheus(const char *body, size_t length)
+{
+    static __thread char s_families[TEST_MAX_FAMILIES][TEST_MAX_NAME];
+    char current[TEST_MAX_NAME] = "";
+    size_t family_count = 0;
+    double uptime = -1;
+
+    HOST_CHECK(length > 0 && body[length - 1] == '\n');
+    HOST_CHECK_EQUAL(strlen(body), length);
+    for (const char *line = body; line < body + length; line = strchr(line, '\n') + 1)
+    {
+        size_t line_length = strchr(line, '\n') - line;
+        char name[TEST_MAX_NAME];
+
+        if (strncmp(line, "# HELP ", 7) == 0 || strncmp(line, "# TYPE ", 7) == 0)
+        {
+            const char *start = line + 7;
+            test_copy_name(name, start, strcspn(start, " \n"));
+            if (strcmp(name, current) == 0)
+            {
+                continue;
+            }
+            /* A new family, it must not have appeared before */
+            for (size_t i = 0; i < family_count; i++)
+            {
+                HOST_CHECK(strcmp(s_families[i], name) != 0);
+            }
+            HOST_CHECK(family_count < TEST_MAX_FAMILIES);
+            strcpy(s_families[family_count++], name);
+            strcpy(current, name);
+            continue;
+        }
+
+        /* A sample of the current family: name, optional labels, value */
+        size_t name_length = strcspn(line, "{ \n");
+        test_copy_name(name, line, name_length);
+        HOST_CHECK(strcmp(name, current) == 0);
+        const char *value = line + name_length;
+        if (*value == '{')
+        {
+            value = strchr(value, '}');
+            HOST_CHECK(value != NULL && value < line + line_length);
+            value++;
+        }
+        HOST_CHECK(*value == ' ');
+        char *value_end;
+        double parsed = strtod(value + 1, &value_end);
+        HOST_CHECK(value_end == line + line_length);
+        if (strcmp(name, "airquality_uptime_seconds") == 0)
+        {
+            uptime = parsed;
+        }
+    }
+    HOST_CHECK(uptime >= 0);
+    return uptime;
+}
+
+static void test_check_json(const char *body, size_t length)
+{
+    HOST_CHECK(length > 3 && strncmp(body, "{\"uptime\":", 10) == 0);
+    HOST_CHECK(strcmp(body + length - 2, "}\n") == 0);
+    HOST_CHECK_EQUAL(strlen(body), length);
+}
+
+static void *test_client_thread(void *arg)
+{
+    test_client_t *client = arg;
+    char *response = malloc(TEST_MAX_RESPONSE);
+    double last_uptime = 0;
+    const char *body;
+
+    HOST_CHECK(response != NULL);
+    for (uint32_t i = 0; i < client->requests; i++)
+    {
+        uint64_t start_ns = host_test_now_ns();
+        if (i % 2 == 0)
+        {
+            size_t length = test_get("/metrics", response, TEST_MAX_RESPONSE, &body);
+            client->latencies_ns[i] = host_test_now_ns() - start_ns;
+            /* An older page is never served after a newer one */
+            double uptime = test_check_prometheus(body, length);
+            HOST_CHECK(uptime >= last_uptime);
+            last_uptime = uptime;
+        }
+        else
+        {
+            size_t length = test_get("/json", response, TEST_MAX_RESPONSE, &body);
+            client->latencies_ns[i] = host_test_now_ns() - start_ns;
+            test_check_json(body, length);
+        }
+    }
+    free(response);
+    return NULL;
+}
+
+static void *test_publisher_thread(void *arg)
+{
+    (void)arg;
+    sample_bus_sample_t sample = {0};
+    uint32_t count = 0;
+
+    while (s_publishing)
+    {
+        sample.co2.co2 = 400 + count % 1000;
+        sample_bus_publish(SAMPLE_BUS_SOURCE_CO2, &sample);
+        count++;
+        usleep(100);
+    }
+    return NULL;
+}
+
+static int test_compare(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void test_load(unsigned long clients, unsigned long requests)
+{
+    static test_client_t s_clients[TEST_MAX_CLIENTS];
+    pthread_t publisher;
+
+    HOST_CHECK(clients > 0 && clients <= TEST_MAX_CLIENTS && requests > 0);
+    host_httpd_set_port(0);
+    metrics_init();
+    s_port = host_httpd_get_port();
+    HOST_CHECK(s_port != 0);
+
+    uint64_t *latencies_ns = calloc(clients * requests, sizeof(uint64_t));
+    HOST_CHECK(latencies_ns != NULL);
+    HOST_CHECK(pthread_create(&publisher, NULL, test_publisher_thread, NULL) == 0);
+
+    uint64_t start_ns = host_test_now_ns();
+    for (unsigned long i = 0; i < clients; i++)
+    {
+        s_clients[i] = (test_client_t){.requests = requests, .latencies_ns = &latencies_ns[i * requests]};
+        HOST_CHECK(pthread_create(&s_clients[i].thread, NULL, test_client_thread, &s_clients[i]) == 0);
+    }
+    for (unsigned long i = 0; i < clients; i++)
+    {
+        pthread_join(s_clients[i].thread, NULL);
+    }
+    uint64_t elapsed_ns = host_test_now_ns() - start_ns;
+    s_publishing = false;
+    pthread_join(publisher, NULL);
+
+    size_t total = clients * requests;
+    qsort(latencies_ns, total, sizeof(uint64_t), test_compare);
+    printf("%lu clients, %zu requests in %.2f s: %.0f requests/s, latency p50 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+           clients, total, elapsed_ns / 1e9, total / (elapsed_ns / 1e9), latencies_ns[total / 2] / 1e6,
+           latencies_ns[total * 99 / 100] / 1e6, latencies_ns[total - 1] / 1e6);
+    free(latencies_ns);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc >= 2 && strcmp(argv[1], "load") == 0)
+    {
+        test_load(host_test_arg(argc, argv, 2, 8), host_test_arg(argc, argv, 3, 500));
+        printf("metrics load test passed\n");
+        return EXIT_SUCCESS;
+    }
+    fprintf(stderr, "usage: %s load [clients] [requests]\n", argv[0]);
+    return EXIT_FAILURE;
+}
@@ -1,25 +1,190 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 
 #include "particulate_matter.h"
+#include "sample_bus.h"
+#include "acquisition.h"
+#include "energy.h"
 
 #include "sps30.h"
 #include "sensirion_i2c_hal.h"
 
 #define TAG "particulate_matter.c"
 
+static acquisition_t s_acquisition;
+
 static void particulate_matter_task(void *pvParameters);
 
-static float s_pm10p0, s_pm2p5;
+static int16_t particulate_matter_data_ready(bool *ready)
+{
+    uint16_t data_ready;
+    int16_t error = sps30_read_data_ready(&data_ready);
 
-static void particulate_matter_task(void *pvParameters)
+    if (error != NO_ERROR)
+    {
+        *ready = false;
+        return error;
+    }
+    *ready = data_ready != 0;
+    return error;
+}
+
+/* Rounded to the nearest step, the sensor range stays far below the limit so clamping only guards
+against garbage */
+static uint16_t particulate_matter_to_fixed(float value, float scale)
+{
+    float scaled = value * scale + 0.5f;
+
+    if (!(scaled > 0.0f))
+    {
+        return 0;
+    }
+    if (scaled >= 65535.0f)
+    {
+        return UINT16_MAX;
+    }
+    return (uint16_t)scaled;
+}
+
+static void particulate_matter_read_and_publish(void)
 {
     struct sps30_measurement m;
+
+    int16_t ret = sps30_read_measurement(&m);
+    if (ret != NO_ERROR)
+    {
+        ESP_LOGE(TAG, "error reading measurement.");
+    }
+    else
+    {
+        if (acquisition_sample_read(&s_acquisition, &m, sizeof(m)))
+        {
+            ESP_LOGW(TAG, "duplicate sample.");
+        }
+        sample_bus_sample_t sample = {
+            .pm = {
+                .mc_1p0 = particulate_matter_to_fixed(m.mc_1p0, 10.0f),
+                .mc_2p5 = particulate_matter_to_fixed(m.mc_2p5, 10.0f),
+                .mc_4p0 = particulate_matter_to_fixed(m.mc_4p0, 10.0f),
+                .mc_10p0 = particulate_matter_to_fixed(m.mc_10p0, 10.0f),
+                .nc_0p5 = particulate_matter_to_fixed(m.nc_0p5, 10.0f),
+                .nc_1p0 = particulate_matter_to_fixed(m.nc_1p0, 10.0f),
+                .nc_2p5 = particulate_matter_to_fixed(m.nc_2p5, 10.0f),
+                .nc_4p0 = particulate_matter_to_fixed(m.nc_4p0, 10.0f),
+                .nc_10p0 = particulate_matter_to_fixed(m.nc_10p0, 10.0f),
+                .typical_particle_size = particulate_matter_to_fixed(m.typical_particle_size, 1000.0f)}};
+        sample_bus_publish(SAMPLE_BUS_SOURCE_PM, &sample);
+    }
+}
+
+#ifdef CONFIG_ACQUISITION_MODE_CONTINUOUS
+static void particulate_matter_continuous_loop(void)
+{
+    int16_t ret = sps30_start_measurement();
+    if (ret != NO_ERROR)
+        ESP_LOGE(TAG, "error starting measurement\n");
+    ESP_LOGI(TAG, "measurements started\n");
+    energy_set_state(ENERGY_CONSUMER_SPS30, ENERGY_STATE_MEASURING);
+
+    acquisition_init(&s_acquisition, "SPS30", SPS30_MEASUREMENT_DURATION_USEC / 1000, particulate_matter_data_ready);
+    uint32_t missed = 0;
+
+    while (1)
+    {
+        ret = acquisition_wait(&s_acquisition);
+        if (ret)
+        {
+            ESP_LOGE(TAG, "error reading data ready flag.");
+            sensirion_i2c_hal_sleep_usec(SPS30_MEASUREMENT_DURATION_USEC); /* wait 1s */
+            continue;
+        }
+        if (s_acquisition.stats.missed != missed)
+        {
+            ESP_LOGW(TAG, "%u sample(s) missed", s_acquisition.stats.missed - missed);
+            missed = s_acquisition.stats.missed;
+        }
+
+        energy_mcu_acquire();
+        particulate_matter_read_and_publish();
+        energy_mcu_release();
+    }
+}
+#else
+/* The fan and laser draw most of the current, so the sensor only measures for the warm up time
+and one sample per acquisition interval. Sleep needs firmware 2.0, older sensors stay idle. */
+static void particulate_matter_duty_cycle_loop(bool can_sleep)
+{
+    int64_t next_start_us = esp_timer_get_time();
+
+    ESP_LOGI(TAG, "measuring %us every %us\n", CONFIG_ACQUISITION_SPS30_WARMUP_S, CONFIG_ACQUISITION_INTERVAL_S);
+
+    /* One sample per interval, ready right after the warm up */
+    acquisition_init(&s_acquisition, "SPS30", CONFIG_ACQUISITION_INTERVAL_S * 1000, particulate_matter_data_ready);
+
+    while (1)
+    {
+        energy_mcu_acquire();
+        if (can_sleep)
+        {
+            sps30_wake_up();
+            energy_set_state(ENERGY_CONSUMER_SPS30, ENERGY_STATE_IDLE);
+        }
+        int16_t ret = sps30_start_measurement();
+        if (ret != NO_ERROR)
+        {
+            ESP_LOGE(TAG, "error starting measurement\n");
+        }
+        else
+        {
+            energy_set_state(ENERGY_CONSUMER_SPS30, ENERGY_STATE_MEASURING);
+            energy_mcu_release();
+            vTaskDelay(pdMS_TO_TICKS(CONFIG_ACQUISITION_SPS30_WARMUP_S * 1000));
+            ret = acquisition_wait(&s_acquisition);
+            energy_mcu_acquire();
+            if (ret)
+            {
+                ESP_LOGE(TAG, "error reading data ready flag.");
+            }
+            else
+            {
+                particulate_matter_read_and_publish();
+            }
+
+            sps30_stop_measurement();
+            energy_set_state(ENERGY_CONSUMER_SPS30, ENERGY_STATE_IDLE);
+        }
+        if (can_sleep)
+        {
+            sps30_sleep();
+            energy_set_state(ENERGY_CONSUMER_SPS30, ENERGY_STATE_SLEEP);
+        }
+        energy_mcu_release();
+
+        next_start_us += (int64_t)CONFIG_ACQUISITION_INTERVAL_S * 1000000;
+        int64_t now_us = esp_timer_get_time();
+        if (next_start_us > now_us)
+        {
+            vTaskDelay(pdMS_TO_TICKS((next_start_us - now_us) / 1000));
+        }
+        else
+        {
+            next_start_us = now_us;
+        }
+    }
+}
+#endif
+
+static void particulate_matter_task(void *pvParameters)
+{
+    (void)pvParameters;
     int16_t ret;
 
-    /* NOTE: it is assumed that the I2C bus that this sensor is connected to is
-    initialized in 'main.c' */
+    /* The UART is set up by sps30_probe() */
+#ifndef CONFIG_SENSIRION_SPS30_INTERFACE_UART
+    sensirion_i2c_hal_init();
+#endif
 
     while (sps30_probe() != 0)
     {
@@ -27,8 +192,9 @@ static void particulate_matter_task(void *pvParameters)
         sensirion_i2c_hal_sleep_usec(1000000); /* wait 1s */
     }
     ESP_LOGI(TAG, "SPS sensor probing successful\n");
+    energy_set_state(ENERGY_CONSUMER_SPS30, ENERGY_STATE_IDLE);
 
-    uint8_t fw_major;
+    uint8_t fw_major = 0;
     uint8_t fw_minor;
     ret = sps30_read_firmware_version(&fw_major, &fw_minor);
     if (ret)
@@ -51,25 +217,11 @@ static void particulate_matter_task(void *pvParameters)
         ESP_LOGI(TAG, "Serial Number: %s\n", serial_number);
     }
 
-    ret = sps30_start_measurement();
-    if (ret < 0)
-        ESP_LOGE(TAG, "error starting measurement\n");
-    ESP_LOGI(TAG, "measurements started\n");
-
-    while (1)
-    {
-        sensirion_i2c_hal_sleep_usec(SPS30_MEASUREMENT_DURATION_USEC); /* wait 1s */
-        ret = sps30_read_measurement(&m);
-        if (ret < 0)
-        {
-            ESP_LOGE(TAG, "error reading measurement.");
-        }
-        else
-        {
-            s_pm2p5 = m.mc_2p5;
-            s_pm10p0 = m.mc_10p0;
-        }
-    }
+#ifdef CONFIG_ACQUISITION_MODE_CONTINUOUS
+    particulate_matter_continuous_loop();
+#else
+    particulate_matter_duty_cycle_loop(fw_major >= 2);
+#endif
 }
 
 void particulate_matter_init()
@@ -79,10 +231,26 @@ void particulate_matter_init()
 
 void particulate_matter_get_pm10p0(uint16_t *pm10p0)
 {
-    *pm10p0 = (uint16_t)(s_pm10p0 * 1000); // Multiplying by 1000 for scaling purposes since this will be saved in an uint16_t variable.
+    sample_bus_sample_t sample;
+    sample_bus_get(SAMPLE_BUS_SOURCE_PM, &sample);
+    *pm10p0 = sample.pm.mc_10p0;
 }
 
 void particulate_matter_get_pm2p5(uint16_t *pm2p5)
 {
-    *pm2p5 = (uint16_t)(s_pm2p5 * 1000); // Multiplying by 1000 for scaling purposes since this will be saved in an uint16_t variable.
+    sample_bus_sample_t sample;
+    sample_bus_get(SAMPLE_BUS_SOURCE_PM, &sample);
+    *pm2p5 = sample.pm.mc_2p5;
+}
+
+void particulate_matter_get_measurement(sample_bus_pm_t *measurement)
+{
+    sample_bus_sample_t sample;
+    sample_bus_get(SAMPLE_BUS_SOURCE_PM, &sample);
+    *measurement = sample.pm;
+}
+
+void particulate_matter_get_acquisition_stats(acquisition_stats_t *stats)
+{
+    acquisition_get_stats(&s_acquisition, stats);
 }
\ No newline at end of file
@@ -1,6 +1,9 @@
 #ifndef COMPONENTS_PARTICULATE_MATTER_H
 #define COMPONENTS_PARTICULATE_MATTER_H
 
+#include "acquisition.h"
+#include "sample_bus.h"
+
 /**
  * @brief Start the task for reading values from particulate matter sensor and update 
  * values on particulate matter.
@@ -10,15 +13,29 @@ void particulate_matter_init();
 /**
  * @brief Get pm10.
  * 
- * @param[out] pm10p0 returns pm10. Must divide by 1000 to get real value. Converted unit in microgram/meter cube. 
+ * @param[out] pm10p0 returns pm10. Must divide by 10 to get real value. Converted unit in microgram/meter cube. 
  */ 
 void particulate_matter_get_pm10p0(uint16_t *pm10p0);
 
 /**
  * @brief Get pm2.5.
  * 
- * @param[out] pm2p5 returns pm2.5. Must divide by 1000 to get real value. Converted unit in microgram/meter cube. 
+ * @param[out] pm2p5 returns pm2.5. Must divide by 10 to get real value. Converted unit in microgram/meter cube. 
  */ 
 void particulate_matter_get_pm2p5(uint16_t *pm2p5);
 
+/**
+ * @brief Get the last complete measurement: mass and number concentrations and typical particle size.
+ * 
+ * @param[out] measurement returns the measurement. See sample_bus_pm_t for the scaling of each field.
+ */ 
+void particulate_matter_get_measurement(sample_bus_pm_t *measurement);
+
+/**
+ * @brief Get the sample counters of the particulate matter sensor.
+ *
+ * @param[out] stats samples read, missed and duplicated and data ready polls.
+ */
+void particulate_matter_get_acquisition_stats(acquisition_stats_t *stats);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,120 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "esp_timer.h"
+
+#include "sample_bus.h"
+
+struct sample_bus_subscriber
+{
+    EventGroupHandle_t events;
+    uint32_t source_mask;
+};
+
+/* Latest sample of each source. Only accessed while holding s_lock so that readers never see a
+half written sample. */
+static sample_bus_sample_t s_samples[SAMPLE_BUS_SOURCE_MAX];
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* History of each source. Every source has a single sensor task publishing it, which makes that
+task the single producer of its ring. */
+static uint8_t s_history_storage[SAMPLE_BUS_SOURCE_MAX][SPMC_RING_STORAGE_SIZE(sizeof(sample_bus_sample_t), SAMPLE_BUS_HISTORY_LENGTH)]
+    __attribute__((aligned(SPMC_RING_CACHE_LINE_SIZE)));
+static spmc_ring_t s_history[SAMPLE_BUS_SOURCE_MAX] = {
+    [SAMPLE_BUS_SOURCE_VOC] = SPMC_RING_INITIALIZER(s_history_storage[SAMPLE_BUS_SOURCE_VOC], sizeof(sample_bus_sample_t), SAMPLE_BUS_HISTORY_LENGTH),
+    [SAMPLE_BUS_SOURCE_CO2] = SPMC_RING_INITIALIZER(s_history_storage[SAMPLE_BUS_SOURCE_CO2], sizeof(sample_bus_sample_t), SAMPLE_BUS_HISTORY_LENGTH),
+    [SAMPLE_BUS_SOURCE_PM] = SPMC_RING_INITIALIZER(s_history_storage[SAMPLE_BUS_SOURCE_PM], sizeof(sample_bus_sample_t), SAMPLE_BUS_HISTORY_LENGTH),
+};
+
+/* Subscriber slots are only ever added, a slot is filled in before s_subscriber_count is incremented */
+static struct sample_bus_subscriber s_subscribers[SAMPLE_BUS_MAX_SUBSCRIBERS];
+static uint8_t s_subscriber_count;
+
+void sample_bus_publish(sample_bus_source_t source, const sample_bus_sample_t *sample)
+{
+    uint8_t subscriber_count;
+    sample_bus_sample_t stamped = *sample;
+    stamped.timestamp_us = esp_timer_get_time();
+
+    portENTER_CRITICAL(&s_lock);
+    stamped.sequence = s_samples[source].sequence + 1;
+    s_samples[source] = stamped;
+    subscriber_count = s_subscriber_count;
+    portEXIT_CRITICAL(&s_lock);
+
+    spmc_ring_push(&s_history[source], &stamped);
+
+    for (uint8_t i = 0; i < subscriber_count; i++)
+    {
+        if (s_subscribers[i].source_mask & SAMPLE_BUS_SOURCE_BIT(source))
+        {
+            xEventGroupSetBits(s_subscribers[i].events, SAMPLE_BUS_SOURCE_BIT(source));
+        }
+    }
+}
+
+uint32_t sample_bus_get(sample_bus_source_t source, sample_bus_sample_t *sample)
+{
+    portENTER_CRITICAL(&s_lock);
+    *sample = s_samples[source];
+    portEXIT_CRITICAL(&s_lock);
+
+    return sample->sequence;
+}
+
+bool sample_bus_get_if_newer(sample_bus_source_t source, uint32_t *last_sequence, sample_bus_sample_t *sample)
+{
+    bool newer = false;
+
+    portENTER_CRITICAL(&s_lock);
+    if (s_samples[source].sequence != *last_sequence)
+    {
+        *sample = s_samples[source];
+        newer = true;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (newer)
+    {
+        *last_sequence = sample->sequence;
+    }
+    return newer;
+}
+
+const spmc_ring_t *sample_bus_history(sample_bus_source_t source)
+{
+    return &s_history[source];
+}
+
+sample_bus_subscriber_t sample_bus_subscribe(uint32_t source_mask)
+{
+    sample_bus_subscriber_t subscriber = NULL;
+
+    /* Created outside of the critical section since it allocates memory */
+    EventGroupHandle_t events = xEventGroupCreate();
+    if (events == NULL)
+    {
+        return NULL;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    if (s_subscriber_count < SAMPLE_BUS_MAX_SUBSCRIBERS)
+    {
+        subscriber = &s_subscribers[s_subscriber_count];
+        subscriber->events = events;
+        subscriber->source_mask = source_mask & SAMPLE_BUS_ALL_SOURCES;
+        s_subscriber_count++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (subscriber == NULL)
+    {
+        vEventGroupDelete(events);
+    }
+    return subscriber;
+}
+
+uint32_t sample_bus_wait(sample_bus_subscriber_t subscriber, TickType_t ticks_to_wait)
+{
+    EventBits_t bits = xEventGroupWaitBits(subscriber->events, subscriber->source_mask, pdTRUE, pdFALSE, ticks_to_wait);
+    return bits & subscriber->source_mask;
+}
@@ -0,0 +1,133 @@
+#ifndef COMPONENTS_SAMPLE_BUS_H
+#define COMPONENTS_SAMPLE_BUS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+
+#include "spmc_ring.h"
+
+/* Maximum number of consumers that can subscribe to the sample bus at the same time */
+#define SAMPLE_BUS_MAX_SUBSCRIBERS 8
+
+/* Number of past samples kept per source. Must be a power of two. */
+#define SAMPLE_BUS_HISTORY_LENGTH 64
+
+/* Event bit of a source, used for the subscription mask and the return value of sample_bus_wait() */
+#define SAMPLE_BUS_SOURCE_BIT(source) (1UL << (source))
+#define SAMPLE_BUS_ALL_SOURCES (SAMPLE_BUS_SOURCE_BIT(SAMPLE_BUS_SOURCE_MAX) - 1)
+
+typedef enum
+{
+    SAMPLE_BUS_SOURCE_VOC = 0, // SVM40, VOC index with temperature and relative humidity
+    SAMPLE_BUS_SOURCE_CO2,     // SCD41
+    SAMPLE_BUS_SOURCE_PM,      // SPS30
+    SAMPLE_BUS_SOURCE_MAX
+} sample_bus_source_t;
+
+typedef struct
+{
+    int16_t voc_index;   // Divide by 10 to get real value.
+    int16_t rhumidity;   // Divide by 100 to get real value. Unit in %.
+    int16_t temperature; // Divide by 200 to get real value. Unit in C.
+} sample_bus_voc_t;
+
+typedef struct
+{
+    uint16_t co2;        // Unit in ppm.
+    int32_t temperature; // Unit in milli degree C.
+    int32_t humidity;    // Unit in milli %.
+} sample_bus_co2_t;
+
+/* Fixed point so that the whole 0 - 1000 ug/m3 range of the sensor fits in 16 bits */
+typedef struct
+{
+    uint16_t mc_1p0;                // Divide by 10 to get real value. Unit in microgram/meter cube.
+    uint16_t mc_2p5;                // Divide by 10 to get real value. Unit in microgram/meter cube.
+    uint16_t mc_4p0;                // Divide by 10 to get real value. Unit in microgram/meter cube.
+    uint16_t mc_10p0;               // Divide by 10 to get real value. Unit in microgram/meter cube.
+    uint16_t nc_0p5;                // Divide by 10 to get real value. Unit in particles/centimeter cube.
+    uint16_t nc_1p0;                // Divide by 10 to get real value. Unit in particles/centimeter cube.
+    uint16_t nc_2p5;                // Divide by 10 to get real value. Unit in particles/centimeter cube.
+    uint16_t nc_4p0;                // Divide by 10 to get real value. Unit in particles/centimeter cube.
+    uint16_t nc_10p0;               // Divide by 10 to get real value. Unit in particles/centimeter cube.
+    uint16_t typical_particle_size; // Unit in nanometer.
+} sample_bus_pm_t;
+
+typedef struct
+{
+    uint32_t sequence;    // Incremented on every publish of the source. 0 means no sample yet.
+    int64_t timestamp_us; // Time since boot when the sample was published.
+    union
+    {
+        sample_bus_voc_t voc;
+        sample_bus_co2_t co2;
+        sample_bus_pm_t pm;
+    };
+} sample_bus_sample_t;
+
+typedef struct sample_bus_subscriber *sample_bus_subscriber_t;
+
+/**
+ * @brief Publish a new sample of a source. The sequence number and timestamp are assigned by the
+ * bus and every subscriber of the source is woken up.
+ *
+ * @param[in] source the sensor that produced the sample.
+ * @param[in] sample the sample data. Only the member of the union that belongs to the source is used.
+ */
+void sample_bus_publish(sample_bus_source_t source, const sample_bus_sample_t *sample);
+
+/**
+ * @brief Get a consistent snapshot of the latest sample of a source.
+ *
+ * @param[in] source the sensor to read.
+ * @param[out] sample copy of the latest sample. sample->sequence is 0 if nothing was published yet.
+ *
+ * @return the sequence number of the returned sample.
+ */
+uint32_t sample_bus_get(sample_bus_source_t source, sample_bus_sample_t *sample);
+
+/**
+ * @brief Get the latest sample of a source only if it is newer than the one the caller has seen.
+ *
+ * @param[in] source the sensor to read.
+ * @param[in,out] last_sequence sequence number of the last sample seen by the caller. Updated when
+ * a newer sample is returned.
+ * @param[out] sample copy of the latest sample, only written when true is returned.
+ *
+ * @return true if a new sample was copied, false otherwise.
+ */
+bool sample_bus_get_if_newer(sample_bus_source_t source, uint32_t *last_sequence, sample_bus_sample_t *sample);
+
+/**
+ * @brief Get the history of a source. Every published sample is pushed into it by the publishing
+ * sensor task. Use spmc_ring_reader_init() and spmc_ring_pop() to read sample_bus_sample_t items,
+ * readers never block the sensor task.
+ *
+ * @param[in] source the sensor of interest.
+ *
+ * @return the ring holding the last SAMPLE_BUS_HISTORY_LENGTH samples of the source.
+ */
+const spmc_ring_t *sample_bus_history(sample_bus_source_t source);
+
+/**
+ * @brief Subscribe to new samples of one or more sources.
+ *
+ * @param[in] source_mask SAMPLE_BUS_SOURCE_BIT() of every source of interest.
+ *
+ * @return the subscriber handle or NULL if there are no free subscriber slots.
+ */
+sample_bus_subscriber_t sample_bus_subscribe(uint32_t source_mask);
+
+/**
+ * @brief Block until at least one of the subscribed sources published a new sample.
+ *
+ * @param[in] subscriber handle returned by sample_bus_subscribe().
+ * @param[in] ticks_to_wait maximum time to wait. Use 0 to poll without blocking.
+ *
+ * @return SAMPLE_BUS_SOURCE_BIT() of every source that published since the last call, 0 on timeout.
+ */
+uint32_t sample_bus_wait(sample_bus_subscriber_t subscriber, TickType_t ticks_to_wait);
+
+#endif
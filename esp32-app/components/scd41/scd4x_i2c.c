@@ -64,14 +64,8 @@ int16_t scd4x_read_measurement_ticks(uint16_t* co2, uint16_t* temperature,
     uint16_t offset = 0;
     offset = sensirion_i2c_add_command_to_buffer(&buffer[0], offset, 0xEC05);
 
-    error = sensirion_i2c_write_data(SCD4X_I2C_ADDRESS, &buffer[0], offset);
-    if (error) {
-        return error;
-    }
-
-    sensirion_i2c_hal_sleep_usec(1000);
-
-    error = sensirion_i2c_read_data_inplace(SCD4X_I2C_ADDRESS, &buffer[0], 6);
+    error = sensirion_i2c_write_read_data_inplace(
+        SCD4X_I2C_ADDRESS, &buffer[0], offset, 1000, 6);
     if (error) {
         return error;
     }
@@ -116,14 +110,8 @@ int16_t scd4x_get_temperature_offset_ticks(uint16_t* t_offset) {
     uint16_t offset = 0;
     offset = sensirion_i2c_add_command_to_buffer(&buffer[0], offset, 0x2318);
 
-    error = sensirion_i2c_write_data(SCD4X_I2C_ADDRESS, &buffer[0], offset);
-    if (error) {
-        return error;
-    }
-
-    sensirion_i2c_hal_sleep_usec(1000);
-
-    error = sensirion_i2c_read_data_inplace(SCD4X_I2C_ADDRESS, &buffer[0], 2);
+    error = sensirion_i2c_write_read_data_inplace(
+        SCD4X_I2C_ADDRESS, &buffer[0], offset, 1000, 2);
     if (error) {
         return error;
     }
@@ -170,14 +158,8 @@ int16_t scd4x_get_sensor_altitude(uint16_t* sensor_altitude) {
     uint16_t offset = 0;
     offset = sensirion_i2c_add_command_to_buffer(&buffer[0], offset, 0x2322);
 
-    error = sensirion_i2c_write_data(SCD4X_I2C_ADDRESS, &buffer[0], offset);
-    if (error) {
-        return error;
-    }
-
-    sensirion_i2c_hal_sleep_usec(1000);
-
-    error = sensirion_i2c_read_data_inplace(SCD4X_I2C_ADDRESS, &buffer[0], 2);
+    error = sensirion_i2c_write_read_data_inplace(
+        SCD4X_I2C_ADDRESS, &buffer[0], offset, 1000, 2);
     if (error) {
         return error;
     }
@@ -229,14 +211,8 @@ int16_t scd4x_perform_forced_recalibration(uint16_t target_co2_concentration,
     offset = sensirion_i2c_add_uint16_t_to_buffer(&buffer[0], offset,
                                                   target_co2_concentration);
 
-    error = sensirion_i2c_write_data(SCD4X_I2C_ADDRESS, &buffer[0], offset);
-    if (error) {
-        return error;
-    }
-
-    sensirion_i2c_hal_sleep_usec(400000);
-
-    error = sensirion_i2c_read_data_inplace(SCD4X_I2C_ADDRESS, &buffer[0], 2);
+    error = sensirion_i2c_write_read_data_inplace(
+        SCD4X_I2C_ADDRESS, &buffer[0], offset, 400000, 2);
     if (error) {
         return error;
     }
@@ -250,14 +226,8 @@ int16_t scd4x_get_automatic_self_calibration(uint16_t* asc_enabled) {
     uint16_t offset = 0;
     offset = sensirion_i2c_add_command_to_buffer(&buffer[0], offset, 0x2313);
 
-    error = sensirion_i2c_write_data(SCD4X_I2C_ADDRESS, &buffer[0], offset);
-    if (error) {
-        return error;
-    }
-
-    sensirion_i2c_hal_sleep_usec(1000);
-
-    error = sensirion_i2c_read_data_inplace(SCD4X_I2C_ADDRESS, &buffer[0], 2);
+    error = sensirion_i2c_write_read_data_inplace(
+        SCD4X_I2C_ADDRESS, &buffer[0], offset, 1000, 2);
     if (error) {
         return error;
     }
@@ -296,14 +266,8 @@ int16_t scd4x_get_data_ready_status(uint16_t* data_ready) {
     uint16_t offset = 0;
     offset = sensirion_i2c_add_command_to_buffer(&buffer[0], offset, 0xE4B8);
 
-    error = sensirion_i2c_write_data(SCD4X_I2C_ADDRESS, &buffer[0], offset);
-    if (error) {
-        return error;
-    }
-
-    sensirion_i2c_hal_sleep_usec(1000);
-
-    error = sensirion_i2c_read_data_inplace(SCD4X_I2C_ADDRESS, &buffer[0], 2);
+    error = sensirion_i2c_write_read_data_inplace(
+        SCD4X_I2C_ADDRESS, &buffer[0], offset, 1000, 2);
     if (error) {
         return error;
     }
@@ -332,14 +296,8 @@ int16_t scd4x_get_serial_number(uint16_t* serial_0, uint16_t* serial_1,
     uint16_t offset = 0;
     offset = sensirion_i2c_add_command_to_buffer(&buffer[0], offset, 0x3682);
 
-    error = sensirion_i2c_write_data(SCD4X_I2C_ADDRESS, &buffer[0], offset);
-    if (error) {
-        return error;
-    }
-
-    sensirion_i2c_hal_sleep_usec(1000);
-
-    error = sensirion_i2c_read_data_inplace(SCD4X_I2C_ADDRESS, &buffer[0], 6);
+    error = sensirion_i2c_write_read_data_inplace(
+        SCD4X_I2C_ADDRESS, &buffer[0], offset, 1000, 6);
     if (error) {
         return error;
     }
@@ -355,14 +313,8 @@ int16_t scd4x_perform_self_test(uint16_t* sensor_status) {
     uint16_t offset = 0;
     offset = sensirion_i2c_add_command_to_buffer(&buffer[0], offset, 0x3639);
 
-    error = sensirion_i2c_write_data(SCD4X_I2C_ADDRESS, &buffer[0], offset);
-    if (error) {
-        return error;
-    }
-
-    sensirion_i2c_hal_sleep_usec(10000000);
-
-    error = sensirion_i2c_read_data_inplace(SCD4X_I2C_ADDRESS, &buffer[0], 2);
+    error = sensirion_i2c_write_read_data_inplace(
+        SCD4X_I2C_ADDRESS, &buffer[0], offset, 10000000, 2);
     if (error) {
         return error;
     }
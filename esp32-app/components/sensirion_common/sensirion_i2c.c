@@ -29,10 +29,65 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <string.h>
+
 #include "sensirion_i2c.h"
 #include "sensirion_common.h"
 #include "sensirion_config.h"
 #include "sensirion_i2c_hal.h"
+#include "sdkconfig.h"
+
+#if defined(CONFIG_SENSIRION_CRC8_TABLE_FLASH) || \
+    defined(CONFIG_SENSIRION_CRC8_TABLE_RAM)
+
+/* One step of the bitwise algorithm, and eight steps for a whole byte. The
+ * table below is generated by the compiler from these, so it cannot get out of
+ * sync with CRC8_POLYNOMIAL. */
+#define CRC8_SHIFT(c) \
+    ((uint8_t)(((c) << 1) ^ (((c)&0x80) ? CRC8_POLYNOMIAL : 0)))
+#define CRC8_BYTE(c)                                                       \
+    CRC8_SHIFT(CRC8_SHIFT(                                                 \
+        CRC8_SHIFT(CRC8_SHIFT(CRC8_SHIFT(CRC8_SHIFT(CRC8_SHIFT(CRC8_SHIFT( \
+            (uint8_t)(c)))))))))
+#define CRC8_ROW(i)                                                    \
+    CRC8_BYTE((i) + 0), CRC8_BYTE((i) + 1), CRC8_BYTE((i) + 2),        \
+        CRC8_BYTE((i) + 3), CRC8_BYTE((i) + 4), CRC8_BYTE((i) + 5),    \
+        CRC8_BYTE((i) + 6), CRC8_BYTE((i) + 7), CRC8_BYTE((i) + 8),    \
+        CRC8_BYTE((i) + 9), CRC8_BYTE((i) + 10), CRC8_BYTE((i) + 11),  \
+        CRC8_BYTE((i) + 12), CRC8_BYTE((i) + 13), CRC8_BYTE((i) + 14), \
+        CRC8_BYTE((i) + 15)
+
+#ifdef CONFIG_SENSIRION_CRC8_TABLE_RAM
+#include "esp_attr.h"
+/* IRAM only allows 32-bit accesses, a byte table goes to internal DRAM which
+ * is never behind the flash cache. */
+#define CRC8_TABLE_ATTR DRAM_ATTR
+#else
+#define CRC8_TABLE_ATTR
+#endif
+
+/* crc8_table[i] is the CRC register after shifting in byte i on top of 0 */
+static const uint8_t CRC8_TABLE_ATTR crc8_table[256] = {
+    CRC8_ROW(0x00), CRC8_ROW(0x10), CRC8_ROW(0x20), CRC8_ROW(0x30),
+    CRC8_ROW(0x40), CRC8_ROW(0x50), CRC8_ROW(0x60), CRC8_ROW(0x70),
+    CRC8_ROW(0x80), CRC8_ROW(0x90), CRC8_ROW(0xA0), CRC8_ROW(0xB0),
+    CRC8_ROW(0xC0), CRC8_ROW(0xD0), CRC8_ROW(0xE0), CRC8_ROW(0xF0),
+};
+
+uint8_t sensirion_i2c_generate_crc(const uint8_t* data, uint16_t count) {
+    uint16_t current_byte;
+    uint8_t crc = CRC8_INIT;
+
+    for (current_byte = 0; current_byte < count; ++current_byte)
+        crc = crc8_table[crc ^ data[current_byte]];
+    return crc;
+}
+
+uint8_t sensirion_i2c_generate_crc_word(const uint8_t* word) {
+    return crc8_table[crc8_table[CRC8_INIT ^ word[0]] ^ word[1]];
+}
+
+#else /* CONFIG_SENSIRION_CRC8_BITWISE */
 
 uint8_t sensirion_i2c_generate_crc(const uint8_t* data, uint16_t count) {
     uint16_t current_byte;
@@ -52,6 +107,12 @@ uint8_t sensirion_i2c_generate_crc(const uint8_t* data, uint16_t count) {
     return crc;
 }
 
+uint8_t sensirion_i2c_generate_crc_word(const uint8_t* word) {
+    return sensirion_i2c_generate_crc(word, SENSIRION_WORD_SIZE);
+}
+
+#endif
+
 int8_t sensirion_i2c_check_crc(const uint8_t* data, uint16_t count,
                                uint8_t checksum) {
     if (sensirion_i2c_generate_crc(data, count) != checksum)
@@ -77,17 +138,33 @@ uint16_t sensirion_i2c_fill_cmd_send_buf(uint8_t* buf, uint16_t cmd,
         buf[idx++] = (uint8_t)((args[i] & 0xFF00) >> 8);
         buf[idx++] = (uint8_t)((args[i] & 0x00FF) >> 0);
 
-        uint8_t crc = sensirion_i2c_generate_crc((uint8_t*)&buf[idx - 2],
-                                                 SENSIRION_WORD_SIZE);
-        buf[idx++] = crc;
+        buf[idx] = sensirion_i2c_generate_crc_word(&buf[idx - 2]);
+        idx++;
     }
     return idx;
 }
 
+/* Check the CRC of each word in buf and copy the words without their CRC to
+ * data, which may be the same buffer as buf. */
+static int16_t sensirion_i2c_unpack_words(const uint8_t* buf, uint16_t size,
+                                          uint8_t* data) {
+    uint16_t i, j;
+
+    for (i = 0, j = 0; i < size; i += SENSIRION_WORD_SIZE + CRC8_LEN) {
+        if (sensirion_i2c_generate_crc_word(&buf[i]) !=
+            buf[i + SENSIRION_WORD_SIZE])
+            return CRC_ERROR;
+
+        data[j++] = buf[i];
+        data[j++] = buf[i + 1];
+    }
+
+    return NO_ERROR;
+}
+
 int16_t sensirion_i2c_read_words_as_bytes(uint8_t address, uint8_t* data,
                                           uint16_t num_words) {
     int16_t ret;
-    uint16_t i, j;
     uint16_t size = num_words * (SENSIRION_WORD_SIZE + CRC8_LEN);
     uint16_t word_buf[SENSIRION_MAX_BUFFER_WORDS];
     uint8_t* const buf8 = (uint8_t*)word_buf;
@@ -96,36 +173,49 @@ int16_t sensirion_i2c_read_words_as_bytes(uint8_t address, uint8_t* data,
     if (ret != NO_ERROR)
         return ret;
 
-    /* check the CRC for each word */
-    for (i = 0, j = 0; i < size; i += SENSIRION_WORD_SIZE + CRC8_LEN) {
+    return sensirion_i2c_unpack_words(buf8, size, data);
+}
 
-        ret = sensirion_i2c_check_crc(&buf8[i], SENSIRION_WORD_SIZE,
-                                      buf8[i + SENSIRION_WORD_SIZE]);
-        if (ret != NO_ERROR)
-            return ret;
+int16_t sensirion_i2c_delayed_read_words_as_bytes(uint8_t address, uint16_t cmd,
+                                                  uint32_t delay_us,
+                                                  uint8_t* data,
+                                                  uint16_t num_words) {
+    int16_t ret;
+    uint8_t cmd_buf[SENSIRION_COMMAND_SIZE];
+    uint16_t size = num_words * (SENSIRION_WORD_SIZE + CRC8_LEN);
+    uint16_t word_buf[SENSIRION_MAX_BUFFER_WORDS];
+    uint8_t* const buf8 = (uint8_t*)word_buf;
 
-        data[j++] = buf8[i];
-        data[j++] = buf8[i + 1];
-    }
+    sensirion_i2c_fill_cmd_send_buf(cmd_buf, cmd, NULL, 0);
+    ret = sensirion_i2c_hal_write_read(address, cmd_buf, SENSIRION_COMMAND_SIZE,
+                                       delay_us, buf8, size);
+    if (ret != NO_ERROR)
+        return ret;
 
-    return NO_ERROR;
+    return sensirion_i2c_unpack_words(buf8, size, data);
+}
+
+/* Convert words read as big endian byte-stream to the uP's word-order */
+static void sensirion_i2c_bytes_to_words(uint16_t* data_words,
+                                         uint16_t num_words) {
+    uint16_t i;
+
+    for (i = 0; i < num_words; ++i) {
+        const uint8_t* word_bytes = (uint8_t*)&data_words[i];
+        data_words[i] = ((uint16_t)word_bytes[0] << 8) | word_bytes[1];
+    }
 }
 
 int16_t sensirion_i2c_read_words(uint8_t address, uint16_t* data_words,
                                  uint16_t num_words) {
     int16_t ret;
-    uint8_t i;
 
     ret = sensirion_i2c_read_words_as_bytes(address, (uint8_t*)data_words,
                                             num_words);
     if (ret != NO_ERROR)
         return ret;
 
-    for (i = 0; i < num_words; ++i) {
-        const uint8_t* word_bytes = (uint8_t*)&data_words[i];
-        data_words[i] = ((uint16_t)word_bytes[0] << 8) | word_bytes[1];
-    }
-
+    sensirion_i2c_bytes_to_words(data_words, num_words);
     return NO_ERROR;
 }
 
@@ -151,17 +241,14 @@ int16_t sensirion_i2c_delayed_read_cmd(uint8_t address, uint16_t cmd,
                                        uint32_t delay_us, uint16_t* data_words,
                                        uint16_t num_words) {
     int16_t ret;
-    uint8_t buf[SENSIRION_COMMAND_SIZE];
 
-    sensirion_i2c_fill_cmd_send_buf(buf, cmd, NULL, 0);
-    ret = sensirion_i2c_hal_write(address, buf, SENSIRION_COMMAND_SIZE);
+    ret = sensirion_i2c_delayed_read_words_as_bytes(
+        address, cmd, delay_us, (uint8_t*)data_words, num_words);
     if (ret != NO_ERROR)
         return ret;
 
-    if (delay_us)
-        sensirion_i2c_hal_sleep_usec(delay_us);
-
-    return sensirion_i2c_read_words(address, data_words, num_words);
+    sensirion_i2c_bytes_to_words(data_words, num_words);
+    return NO_ERROR;
 }
 
 int16_t sensirion_i2c_read_cmd(uint8_t address, uint16_t cmd,
@@ -181,13 +268,13 @@ uint16_t sensirion_i2c_add_uint32_t_to_buffer(uint8_t* buffer, uint16_t offset,
                                               uint32_t data) {
     buffer[offset++] = (uint8_t)((data & 0xFF000000) >> 24);
     buffer[offset++] = (uint8_t)((data & 0x00FF0000) >> 16);
-    buffer[offset] = sensirion_i2c_generate_crc(
-        &buffer[offset - SENSIRION_WORD_SIZE], SENSIRION_WORD_SIZE);
+    buffer[offset] = sensirion_i2c_generate_crc_word(
+        &buffer[offset - SENSIRION_WORD_SIZE]);
     offset++;
     buffer[offset++] = (uint8_t)((data & 0x0000FF00) >> 8);
     buffer[offset++] = (uint8_t)((data & 0x000000FF) >> 0);
-    buffer[offset] = sensirion_i2c_generate_crc(
-        &buffer[offset - SENSIRION_WORD_SIZE], SENSIRION_WORD_SIZE);
+    buffer[offset] = sensirion_i2c_generate_crc_word(
+        &buffer[offset - SENSIRION_WORD_SIZE]);
     offset++;
 
     return offset;
@@ -202,8 +289,8 @@ uint16_t sensirion_i2c_add_uint16_t_to_buffer(uint8_t* buffer, uint16_t offset,
                                               uint16_t data) {
     buffer[offset++] = (uint8_t)((data & 0xFF00) >> 8);
     buffer[offset++] = (uint8_t)((data & 0x00FF) >> 0);
-    buffer[offset] = sensirion_i2c_generate_crc(
-        &buffer[offset - SENSIRION_WORD_SIZE], SENSIRION_WORD_SIZE);
+    buffer[offset] = sensirion_i2c_generate_crc_word(
+        &buffer[offset - SENSIRION_WORD_SIZE]);
     offset++;
 
     return offset;
@@ -225,13 +312,13 @@ uint16_t sensirion_i2c_add_float_to_buffer(uint8_t* buffer, uint16_t offset,
 
     buffer[offset++] = (uint8_t)((convert.uint32_data & 0xFF000000) >> 24);
     buffer[offset++] = (uint8_t)((convert.uint32_data & 0x00FF0000) >> 16);
-    buffer[offset] = sensirion_i2c_generate_crc(
-        &buffer[offset - SENSIRION_WORD_SIZE], SENSIRION_WORD_SIZE);
+    buffer[offset] = sensirion_i2c_generate_crc_word(
+        &buffer[offset - SENSIRION_WORD_SIZE]);
     offset++;
     buffer[offset++] = (uint8_t)((convert.uint32_data & 0x0000FF00) >> 8);
     buffer[offset++] = (uint8_t)((convert.uint32_data & 0x000000FF) >> 0);
-    buffer[offset] = sensirion_i2c_generate_crc(
-        &buffer[offset - SENSIRION_WORD_SIZE], SENSIRION_WORD_SIZE);
+    buffer[offset] = sensirion_i2c_generate_crc_word(
+        &buffer[offset - SENSIRION_WORD_SIZE]);
     offset++;
 
     return offset;
@@ -250,8 +337,8 @@ uint16_t sensirion_i2c_add_bytes_to_buffer(uint8_t* buffer, uint16_t offset,
         buffer[offset++] = data[i];
         buffer[offset++] = data[i + 1];
 
-        buffer[offset] = sensirion_i2c_generate_crc(
-            &buffer[offset - SENSIRION_WORD_SIZE], SENSIRION_WORD_SIZE);
+        buffer[offset] = sensirion_i2c_generate_crc_word(
+            &buffer[offset - SENSIRION_WORD_SIZE]);
         offset++;
     }
 
@@ -266,7 +353,6 @@ int16_t sensirion_i2c_write_data(uint8_t address, const uint8_t* data,
 int16_t sensirion_i2c_read_data_inplace(uint8_t address, uint8_t* buffer,
                                         uint16_t expected_data_length) {
     int16_t error;
-    uint16_t i, j;
     uint16_t size = (expected_data_length / SENSIRION_WORD_SIZE) *
                     (SENSIRION_WORD_SIZE + CRC8_LEN);
 
@@ -279,16 +365,30 @@ int16_t sensirion_i2c_read_data_inplace(uint8_t address, uint8_t* buffer,
         return error;
     }
 
-    for (i = 0, j = 0; i < size; i += SENSIRION_WORD_SIZE + CRC8_LEN) {
+    return sensirion_i2c_unpack_words(buffer, size, buffer);
+}
 
-        error = sensirion_i2c_check_crc(&buffer[i], SENSIRION_WORD_SIZE,
-                                        buffer[i + SENSIRION_WORD_SIZE]);
-        if (error) {
-            return error;
-        }
-        buffer[j++] = buffer[i];
-        buffer[j++] = buffer[i + 1];
+int16_t sensirion_i2c_write_read_data_inplace(uint8_t address, uint8_t* buffer,
+                                              uint16_t data_length,
+                                              uint32_t delay_us,
+                                              uint16_t expected_data_length) {
+    int16_t error;
+    uint8_t tx_buf[SENSIRION_MAX_BUFFER_WORDS];
+    uint16_t size = (expected_data_length / SENSIRION_WORD_SIZE) *
+                    (SENSIRION_WORD_SIZE + CRC8_LEN);
+
+    if (expected_data_length % SENSIRION_WORD_SIZE != 0 ||
+        data_length > sizeof(tx_buf)) {
+        return BYTE_NUM_ERROR;
     }
 
-    return NO_ERROR;
+    /* The read may already fill buffer while the driver still sends from it */
+    memcpy(tx_buf, buffer, data_length);
+    error = sensirion_i2c_hal_write_read(address, tx_buf, data_length, delay_us,
+                                         buffer, size);
+    if (error) {
+        return error;
+    }
+
+    return sensirion_i2c_unpack_words(buffer, size, buffer);
 }
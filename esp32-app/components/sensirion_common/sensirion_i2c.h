@@ -54,6 +54,16 @@ extern "C" {
 
 uint8_t sensirion_i2c_generate_crc(const uint8_t* data, uint16_t count);
 
+/**
+ * sensirion_i2c_generate_crc_word() - Same as
+ * sensirion_i2c_generate_crc(word, SENSIRION_WORD_SIZE), unrolled for the
+ * single word case which is all the I2C protocol ever needs.
+ * @word:   Pointer to the two bytes of the word
+ *
+ * Return:  The CRC of the word
+ */
+uint8_t sensirion_i2c_generate_crc_word(const uint8_t* word);
+
 int8_t sensirion_i2c_check_crc(const uint8_t* data, uint16_t count,
                                uint8_t checksum);
 
@@ -116,6 +126,27 @@ int16_t sensirion_i2c_read_words(uint8_t address, uint16_t* data_words,
 int16_t sensirion_i2c_read_words_as_bytes(uint8_t address, uint8_t* data,
                                           uint16_t num_words);
 
+/**
+ * sensirion_i2c_delayed_read_words_as_bytes() - send a command and read data
+ *                                               words back as byte-stream
+ *
+ * Same as sensirion_i2c_read_words_as_bytes() preceded by the command. Command
+ * and read are a single I2C transaction when delay_us is 0.
+ *
+ * @address:    Sensor i2c address
+ * @cmd:        Command
+ * @delay_us:   Time in microseconds to delay sending the read request
+ * @data:       Allocated buffer to store the read bytes.
+ *              The buffer may also have been modified in case of an error.
+ * @num_words:  Number of data words(!) to read (without CRC bytes)
+ *
+ * @return      NO_ERROR on success, an error code otherwise
+ */
+int16_t sensirion_i2c_delayed_read_words_as_bytes(uint8_t address, uint16_t cmd,
+                                                  uint32_t delay_us,
+                                                  uint8_t* data,
+                                                  uint16_t num_words);
+
 /**
  * sensirion_i2c_write_cmd() - writes a command to the sensor
  * @address:    Sensor i2c address
@@ -308,6 +339,30 @@ int16_t sensirion_i2c_write_data(uint8_t address, const uint8_t* data,
  */
 int16_t sensirion_i2c_read_data_inplace(uint8_t address, uint8_t* buffer,
                                         uint16_t expected_data_length);
+
+/**
+ * sensirion_i2c_write_read_data_inplace() - Writes a frame to the sensor and
+ * reads the response into the same buffer. Command and read are a single I2C
+ * transaction when delay_us is 0.
+ *
+ * @param address              Sensor I2C address
+ * @param buffer               Frame to send, overwritten with the read data.
+ *                             Needs to be big enough to store the data
+ *                             including CRC.
+ * @param data_length          Number of bytes to send, at most
+ *                             SENSIRION_MAX_BUFFER_WORDS.
+ * @param delay_us             Time in microseconds the sensor needs to process
+ *                             the frame before it can be read.
+ * @param expected_data_length Number of bytes to read (without CRC). Needs
+ *                             to be a multiple of SENSIRION_WORD_SIZE,
+ *                             otherwise the function returns BYTE_NUM_ERROR.
+ *
+ * @return            NO_ERROR on success, an error code otherwise
+ */
+int16_t sensirion_i2c_write_read_data_inplace(uint8_t address, uint8_t* buffer,
+                                              uint16_t data_length,
+                                              uint32_t delay_us,
+                                              uint16_t expected_data_length);
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,199 @@
+#include "sensirion_i2c_arbiter.h"
+#include "sensirion_common.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "driver/i2c.h"
+#include "esp_timer.h"
+
+/* Above the sensor tasks so that the bus never sits idle while requests are pending */
+#define ARBITER_TASK_PRIORITY 6
+#define ARBITER_TASK_STACK_SIZE (1024 * 3)
+
+typedef struct
+{
+    TaskHandle_t task;
+    SemaphoreHandle_t pending_count; // Number of used slots in pending
+    sensirion_i2c_transfer_t transfer;
+    sensirion_i2c_request_t *pending[SENSIRION_I2C_ARBITER_MAX_PENDING];
+    uint32_t next_order;
+} arbiter_bus_t;
+
+typedef struct
+{
+    uint8_t address;
+    sensirion_i2c_device_stats_t stats;
+} arbiter_device_t;
+
+static arbiter_bus_t s_buses[I2C_NUM_MAX];
+static arbiter_device_t s_devices[SENSIRION_I2C_ARBITER_MAX_DEVICES];
+static uint8_t s_device_count;
+
+/* Protects the pending slots of every bus and the statistics */
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Must be called with s_lock held */
+static sensirion_i2c_device_stats_t *arbiter_device_stats(uint8_t address)
+{
+    for (uint8_t i = 0; i < s_device_count; i++)
+    {
+        if (s_devices[i].address == address)
+        {
+            return &s_devices[i].stats;
+        }
+    }
+    if (s_device_count == SENSIRION_I2C_ARBITER_MAX_DEVICES)
+    {
+        return NULL;
+    }
+    s_devices[s_device_count].address = address;
+    return &s_devices[s_device_count++].stats;
+}
+
+/* Must be called with s_lock held */
+static void arbiter_account(const sensirion_i2c_request_t *request, uint32_t busy_us, int64_t now_us)
+{
+    sensirion_i2c_device_stats_t *stats = arbiter_device_stats(request->address);
+    if (stats == NULL)
+    {
+        return;
+    }
+
+    uint32_t latency_us = (uint32_t)(now_us - request->submitted_us);
+    stats->total_latency_us += latency_us;
+    if (latency_us > stats->max_latency_us)
+    {
+        stats->max_latency_us = latency_us;
+    }
+    if (request->result != 0)
+    {
+        stats->errors++;
+    }
+
+    stats->transactions++;
+    stats->busy_us += busy_us;
+    if (busy_us > stats->max_busy_us)
+    {
+        stats->max_busy_us = busy_us;
+    }
+}
+
+static void sensirion_i2c_arbiter_task(void *pvParameters)
+{
+    arbiter_bus_t *bus = pvParameters;
+    uint8_t port = bus - s_buses;
+
+    while (1)
+    {
+        xSemaphoreTake(bus->pending_count, portMAX_DELAY);
+
+        /* Highest priority first, oldest first within a priority */
+        int best = -1;
+        portENTER_CRITICAL(&s_lock);
+        for (int i = 0; i < SENSIRION_I2C_ARBITER_MAX_PENDING; i++)
+        {
+            sensirion_i2c_request_t *candidate = bus->pending[i];
+            if (candidate == NULL)
+            {
+                continue;
+            }
+            if (best < 0 || candidate->priority < bus->pending[best]->priority ||
+                (candidate->priority == bus->pending[best]->priority &&
+                 (int32_t)(candidate->order - bus->pending[best]->order) < 0))
+            {
+                best = i;
+            }
+        }
+        sensirion_i2c_request_t *request = bus->pending[best];
+        bus->pending[best] = NULL;
+        portEXIT_CRITICAL(&s_lock);
+
+        int64_t start_us = esp_timer_get_time();
+        request->result = bus->transfer(port, request);
+        int64_t end_us = esp_timer_get_time();
+
+        portENTER_CRITICAL(&s_lock);
+        arbiter_account(request, (uint32_t)(end_us - start_us), end_us);
+        portEXIT_CRITICAL(&s_lock);
+
+        /* A request must not be touched after its requester was woken up */
+        xTaskNotifyGive(request->requester);
+    }
+}
+
+int8_t sensirion_i2c_arbiter_start(uint8_t port, sensirion_i2c_transfer_t transfer)
+{
+    arbiter_bus_t *bus = &s_buses[port];
+
+    if (bus->task != NULL)
+    {
+        return 0;
+    }
+
+    bus->transfer = transfer;
+    bus->pending_count = xSemaphoreCreateCounting(SENSIRION_I2C_ARBITER_MAX_PENDING, 0);
+    if (bus->pending_count == NULL)
+    {
+        return -1;
+    }
+    if (xTaskCreate(sensirion_i2c_arbiter_task, "i2c arbiter", ARBITER_TASK_STACK_SIZE, bus,
+                    ARBITER_TASK_PRIORITY, &bus->task) != pdPASS)
+    {
+        vSemaphoreDelete(bus->pending_count);
+        bus->pending_count = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+int8_t sensirion_i2c_arbiter_submit(uint8_t port, sensirion_i2c_request_t *request)
+{
+    arbiter_bus_t *bus = &s_buses[port];
+    bool queued = false;
+
+    request->requester = xTaskGetCurrentTaskHandle();
+    request->submitted_us = esp_timer_get_time();
+    request->result = -1;
+
+    portENTER_CRITICAL(&s_lock);
+    for (int i = 0; i < SENSIRION_I2C_ARBITER_MAX_PENDING; i++)
+    {
+        if (bus->pending[i] == NULL)
+        {
+            request->order = bus->next_order++;
+            bus->pending[i] = request;
+            queued = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (!queued)
+    {
+        return -1;
+    }
+
+    xSemaphoreGive(bus->pending_count);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    return request->result;
+}
+
+bool sensirion_i2c_arbiter_get_stats(uint8_t address, sensirion_i2c_device_stats_t *stats)
+{
+    bool found = false;
+
+    portENTER_CRITICAL(&s_lock);
+    for (uint8_t i = 0; i < s_device_count; i++)
+    {
+        if (s_devices[i].address == address)
+        {
+            *stats = s_devices[i].stats;
+            found = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    return found;
+}
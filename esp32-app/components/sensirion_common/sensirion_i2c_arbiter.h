@@ -0,0 +1,99 @@
+#ifndef SENSIRION_I2C_ARBITER_H
+#define SENSIRION_I2C_ARBITER_H
+
+#include "sensirion_config.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/* Requests that can be pending on one bus at the same time, every sensor task has at most one */
+#define SENSIRION_I2C_ARBITER_MAX_PENDING 8
+
+/* Devices for which statistics are kept */
+#define SENSIRION_I2C_ARBITER_MAX_DEVICES 8
+
+typedef enum
+{
+    SENSIRION_I2C_PRIORITY_HIGH = 0,
+    SENSIRION_I2C_PRIORITY_NORMAL,
+    SENSIRION_I2C_PRIORITY_LOW,
+} sensirion_i2c_priority_t;
+
+/**
+ * One bus transaction: tx_count bytes are written, then rx_count bytes are read
+ * after a repeated start. Either part may be empty. The request lives on the
+ * stack of the submitting task, which is blocked until it is completed.
+ */
+typedef struct
+{
+    uint8_t address;
+    const uint8_t* tx_data;
+    uint16_t tx_count;
+    uint8_t* rx_data;
+    uint16_t rx_count;
+    sensirion_i2c_priority_t priority;
+
+    /* Filled in by the arbiter */
+    TaskHandle_t requester;
+    int64_t submitted_us;
+    uint32_t order;
+    int8_t result;
+} sensirion_i2c_request_t;
+
+/**
+ * Executes one request on the bus, called from the arbiter task only.
+ */
+typedef int8_t (*sensirion_i2c_transfer_t)(uint8_t port,
+                                           const sensirion_i2c_request_t* request);
+
+typedef struct
+{
+    uint32_t transactions; // Transactions executed on the bus for this device
+    uint32_t errors;
+    uint32_t max_latency_us; // From submission until the result is available
+    uint64_t total_latency_us;
+    uint64_t busy_us; // Time the bus was occupied by this device
+    uint32_t max_busy_us;
+} sensirion_i2c_device_stats_t;
+
+/**
+ * Start the arbiter task owning a bus. Does nothing if it already runs.
+ *
+ * @param port     the bus
+ * @param transfer executes a request on the bus
+ * @returns 0 on success, -1 if the task could not be created
+ */
+int8_t sensirion_i2c_arbiter_start(uint8_t port,
+                                   sensirion_i2c_transfer_t transfer);
+
+/**
+ * Queue a request on a bus and wait until it was executed. Pending requests
+ * are served highest priority first, in submission order within a priority. Uses
+ * the task notification of the calling task.
+ *
+ * @param port    the bus, its arbiter must be started
+ * @param request the request
+ * @returns the result of the transfer, -1 if the queue is full
+ */
+int8_t sensirion_i2c_arbiter_submit(uint8_t port,
+                                    sensirion_i2c_request_t* request);
+
+/**
+ * Get a snapshot of the statistics of one device.
+ *
+ * @param address    7-bit I2C address of the device
+ * @param[out] stats the statistics
+ * @returns true if the device was accessed at least once
+ */
+bool sensirion_i2c_arbiter_get_stats(uint8_t address,
+                                     sensirion_i2c_device_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* SENSIRION_I2C_ARBITER_H */
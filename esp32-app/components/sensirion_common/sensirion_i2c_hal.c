@@ -29,7 +29,11 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+
+#include <inttypes.h>
+
 #include "sensirion_i2c_hal.h"
+#include "sensirion_i2c_arbiter.h"
 #include "sensirion_common.h"
 #include "sensirion_config.h"
 
@@ -37,17 +41,235 @@
 #include "freertos/task.h"
 #include "driver/i2c.h"
 #include "esp_err.h"
+#include "esp_idf_version.h"
+#include "esp_log.h"
+#include "esp_rom_sys.h"
+
+#ifdef CONFIG_SENSIRION_SIMULATED_SENSORS
+#include "sensirion_i2c_sim.h"
+#endif
+
+#define TAG "sensirion_i2c_hal.c"
+
+/* Used for addresses that are not in the device table, e.g. the general call address */
+#define I2C_HAL_DEFAULT_TIMEOUT_MS 200
+
+/* Command links are built in a buffer on the arbiter's stack when the driver supports it, so a
+transfer never touches the heap. The largest link is a write followed by a read: start, address,
+data, start, address, data, stop. */
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(4, 4, 0)
+#define I2C_HAL_STATIC_LINKS
+#define I2C_HAL_LINK_SIZE I2C_LINK_RECOMMENDED_SIZE(2)
+#endif
+
+typedef struct
+{
+    int sda_io_num;
+    int scl_io_num;
+    uint32_t clk_speed;
+} i2c_hal_bus_t;
+
+typedef struct
+{
+    uint8_t address;
+    i2c_port_t port;
+    uint32_t max_clk_speed; // The bus the device is on never runs faster than this
+    uint32_t timeout_ms;
+    sensirion_i2c_priority_t priority;
+} i2c_hal_device_t;
+
+typedef struct
+{
+#ifdef I2C_HAL_STATIC_LINKS
+    uint8_t buffer[I2C_HAL_LINK_SIZE];
+#else
+    uint8_t unused;
+#endif
+} i2c_hal_link_t;
+
+static const i2c_hal_bus_t s_buses[I2C_NUM_MAX] = {
+    [I2C_NUM_0] = {
+        .sda_io_num = CONFIG_SENSIRION_I2C0_SDA,
+        .scl_io_num = CONFIG_SENSIRION_I2C0_SCL,
+        .clk_speed = CONFIG_SENSIRION_I2C0_CLK_SPEED,
+    },
+    [I2C_NUM_1] = {
+        .sda_io_num = CONFIG_SENSIRION_I2C1_SDA,
+        .scl_io_num = CONFIG_SENSIRION_I2C1_SCL,
+        .clk_speed = CONFIG_SENSIRION_I2C1_CLK_SPEED,
+    },
+};
+
+/* Every bus is owned by an arbiter task that executes the transfers of all devices on it one at a
+time. Sensors on different buses are accessed in parallel. The SVM40 gets priority as its VOC
+algorithm expects a sample every second. */
+static const i2c_hal_device_t s_devices[] = {
+    {.address = 0x62, .port = CONFIG_SENSIRION_SCD4X_I2C_PORT, .max_clk_speed = 400000, .timeout_ms = 200, .priority = SENSIRION_I2C_PRIORITY_NORMAL}, // SCD4x
+    {.address = 0x6A, .port = CONFIG_SENSIRION_SVM40_I2C_PORT, .max_clk_speed = 400000, .timeout_ms = 200, .priority = SENSIRION_I2C_PRIORITY_HIGH},   // SVM40
+#ifdef CONFIG_SENSIRION_SPS30_INTERFACE_I2C
+    {.address = 0x69, .port = CONFIG_SENSIRION_SPS30_I2C_PORT, .max_clk_speed = 100000, .timeout_ms = 200, .priority = SENSIRION_I2C_PRIORITY_NORMAL}, // SPS30
+#endif
+};
 
-/* NOTE: This sensor is set to connect to I2C_NUM_1 I2C bus. */
+/* Bus used for addresses that are not in the device table */
+static i2c_port_t s_selected_port = I2C_NUM_1;
+static bool s_initialized;
+
+static const i2c_hal_device_t *i2c_hal_lookup(uint8_t address)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(s_devices); i++)
+    {
+        if (s_devices[i].address == address)
+        {
+            return &s_devices[i];
+        }
+    }
+    return NULL;
+}
+
+#ifndef CONFIG_SENSIRION_SIMULATED_SENSORS
+
+static i2c_cmd_handle_t i2c_hal_link_create(i2c_hal_link_t *link)
+{
+#ifdef I2C_HAL_STATIC_LINKS
+    return i2c_cmd_link_create_static(link->buffer, sizeof(link->buffer));
+#else
+    return i2c_cmd_link_create();
+#endif
+}
+
+static void i2c_hal_link_delete(i2c_cmd_handle_t cmd)
+{
+#ifdef I2C_HAL_STATIC_LINKS
+    i2c_cmd_link_delete_static(cmd);
+#else
+    i2c_cmd_link_delete(cmd);
+#endif
+}
+
+#endif /* CONFIG_SENSIRION_SIMULATED_SENSORS */
+
+/* Executes a request on the bus, only ever called from the arbiter task of the port */
+static int8_t i2c_hal_transfer(uint8_t port, const sensirion_i2c_request_t *request)
+{
+#ifdef CONFIG_SENSIRION_SIMULATED_SENSORS
+    (void)port;
+    int8_t ret = 0;
+    if (request->tx_count > 0)
+    {
+        ret = sensirion_i2c_sim_write(request->address, request->tx_data, request->tx_count);
+    }
+    if (ret == 0 && request->rx_count > 0)
+    {
+        ret = sensirion_i2c_sim_read(request->address, request->rx_data, request->rx_count);
+    }
+    return ret;
+#else
+    const i2c_hal_device_t *device = i2c_hal_lookup(request->address);
+    TickType_t timeout = pdMS_TO_TICKS(device != NULL ? device->timeout_ms : I2C_HAL_DEFAULT_TIMEOUT_MS);
+    esp_err_t err;
+    i2c_hal_link_t link;
+    i2c_cmd_handle_t cmd = i2c_hal_link_create(&link);
+    if (cmd == NULL)
+    {
+        return ESP_FAIL;
+    }
+
+    if (request->tx_count > 0)
+    {
+        i2c_master_start(cmd);
+        i2c_master_write_byte(cmd, (request->address << 1) | I2C_MASTER_WRITE, 1);
+        i2c_master_write(cmd, request->tx_data, request->tx_count, 1);
+    }
+    if (request->rx_count > 0)
+    {
+        /* Repeated start if there was a write before */
+        i2c_master_start(cmd);
+        i2c_master_write_byte(cmd, (request->address << 1) | I2C_MASTER_READ, 1);
+        i2c_master_read(cmd, request->rx_data, request->rx_count, I2C_MASTER_LAST_NACK);
+    }
+    i2c_master_stop(cmd);
+    err = i2c_master_cmd_begin(port, cmd, timeout);
+    i2c_hal_link_delete(cmd);
+
+    return err;
+#endif
+}
+
+static int8_t i2c_hal_submit(uint8_t address, const uint8_t *tx_data, uint16_t tx_count, uint8_t *rx_data,
+                             uint16_t rx_count)
+{
+    const i2c_hal_device_t *device = i2c_hal_lookup(address);
+    sensirion_i2c_request_t request = {
+        .address = address,
+        .tx_data = tx_data,
+        .tx_count = tx_count,
+        .rx_data = rx_data,
+        .rx_count = rx_count,
+        .priority = device != NULL ? device->priority : SENSIRION_I2C_PRIORITY_LOW,
+    };
+
+    return sensirion_i2c_arbiter_submit(device != NULL ? device->port : s_selected_port, &request);
+}
 
 int16_t sensirion_i2c_hal_select_bus(uint8_t bus_idx)
 {
+    if (bus_idx >= I2C_NUM_MAX)
+    {
+        return ESP_FAIL;
+    }
+    s_selected_port = bus_idx;
     return 0;
 }
 
 void sensirion_i2c_hal_init(void)
 {
-    // Initialization of I2C bus is implemented in 'main.c'
+    /* First called from system_init() before any sensor task runs, later calls do nothing */
+    if (s_initialized)
+    {
+        return;
+    }
+    s_initialized = true;
+
+    for (i2c_port_t port = 0; port < I2C_NUM_MAX; port++)
+    {
+        bool used = port == s_selected_port;
+        uint32_t clk_speed = s_buses[port].clk_speed;
+
+        for (size_t i = 0; i < ARRAY_SIZE(s_devices); i++)
+        {
+            if (s_devices[i].port == port)
+            {
+                used = true;
+                if (s_devices[i].max_clk_speed < clk_speed)
+                {
+                    ESP_LOGW(TAG, "I2C%d limited to %" PRIu32 " Hz by device 0x%02x", port, s_devices[i].max_clk_speed, s_devices[i].address);
+                    clk_speed = s_devices[i].max_clk_speed;
+                }
+            }
+        }
+        if (!used)
+        {
+            continue;
+        }
+
+#ifndef CONFIG_SENSIRION_SIMULATED_SENSORS
+        i2c_config_t config = {
+            .mode = I2C_MODE_MASTER,
+            .sda_io_num = s_buses[port].sda_io_num,
+            .scl_io_num = s_buses[port].scl_io_num,
+            .sda_pullup_en = true,
+            .scl_pullup_en = true,
+            .master.clk_speed = clk_speed};
+        ESP_ERROR_CHECK(i2c_param_config(port, &config));
+        ESP_ERROR_CHECK(i2c_driver_install(port, config.mode, 0, 0, 0));
+        ESP_LOGI(TAG, "I2C%d at %" PRIu32 " Hz on SDA %d SCL %d", port, clk_speed, config.sda_io_num, config.scl_io_num);
+#endif
+        if (sensirion_i2c_arbiter_start(port, i2c_hal_transfer) != 0)
+        {
+            ESP_LOGE(TAG, "Failed to start the arbiter of I2C%d", port);
+        }
+    }
 }
 
 void sensirion_i2c_hal_free(void)
@@ -57,36 +279,49 @@ void sensirion_i2c_hal_free(void)
 
 int8_t sensirion_i2c_hal_read(uint8_t address, uint8_t *data, uint16_t count)
 {
-    esp_err_t err;
-
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (address << 1) | I2C_MASTER_READ, 1);
-    i2c_master_read(cmd, data, count, I2C_MASTER_LAST_NACK);
-    i2c_master_stop(cmd);
-    err = i2c_master_cmd_begin(I2C_NUM_1, cmd, 200 / portTICK_PERIOD_MS);
-    i2c_cmd_link_delete(cmd);
-
-    return err;
+    return i2c_hal_submit(address, NULL, 0, data, count);
 }
 
 int8_t sensirion_i2c_hal_write(uint8_t address, const uint8_t *data,
                                uint16_t count)
 {
-    esp_err_t err;
+    return i2c_hal_submit(address, data, count, NULL, 0);
+}
 
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (address << 1) | I2C_MASTER_WRITE, 1);
-    i2c_master_write(cmd, data, count, 1);
-    i2c_master_stop(cmd);
-    err = i2c_master_cmd_begin(I2C_NUM_1, cmd, 200 / portTICK_PERIOD_MS);
-    i2c_cmd_link_delete(cmd);
+int8_t sensirion_i2c_hal_write_read(uint8_t address, const uint8_t *tx_data,
+                                    uint16_t tx_count, uint32_t delay_usec,
+                                    uint8_t *rx_data, uint16_t rx_count)
+{
+    int8_t ret;
 
-    return err;
+    if (delay_usec == 0)
+    {
+        /* Repeated start, the whole exchange is a single bus transaction */
+        return i2c_hal_submit(address, tx_data, tx_count, rx_data, rx_count);
+    }
+
+    /* The sensor needs the bus released while it processes the command, other devices can use it
+    in the meantime */
+    ret = i2c_hal_submit(address, tx_data, tx_count, NULL, 0);
+    if (ret != 0)
+    {
+        return ret;
+    }
+    sensirion_i2c_hal_sleep_usec(delay_usec);
+    return i2c_hal_submit(address, NULL, 0, rx_data, rx_count);
 }
 
 void sensirion_i2c_hal_sleep_usec(uint32_t useconds)
 {
-    vTaskDelay(pdMS_TO_TICKS(useconds / 1000));
+    /* Never shorter than requested, the sensor NACKs or answers garbage when read before its
+    processing time. Waits under one tick, the usual 1 ms command delays, spin instead of taking a
+    whole tick; the longer ones are rounded up to whole ticks. */
+    const uint32_t tick_usec = 1000000 / configTICK_RATE_HZ;
+
+    if (useconds < tick_usec)
+    {
+        esp_rom_delay_us(useconds);
+        return;
+    }
+    vTaskDelay((useconds + tick_usec - 1) / tick_usec);
 }
@@ -52,7 +52,9 @@ int16_t sensirion_i2c_hal_select_bus(uint8_t bus_idx);
 
 /**
  * Initialize all hard- and software components that are needed for the I2C
- * communication.
+ * communication. Installs the driver of every bus that has a sensor on it at
+ * the speed of its slowest sensor. Only the first call has an effect, it must
+ * happen before sensor tasks start.
  */
 void sensirion_i2c_hal_init(void);
 
@@ -87,6 +89,23 @@ int8_t sensirion_i2c_hal_read(uint8_t address, uint8_t* data, uint16_t count);
 int8_t sensirion_i2c_hal_write(uint8_t address, const uint8_t* data,
                                uint16_t count);
 
+/**
+ * Send a command and read its response. With a delay of 0 both are done in a
+ * single transaction using a repeated start condition, otherwise the bus is
+ * released for the given time between the write and the read transaction.
+ *
+ * @param address    7-bit I2C address of the device
+ * @param tx_data    pointer to the buffer containing the data to write
+ * @param tx_count   number of bytes to send
+ * @param delay_usec time the device needs between the write and the read
+ * @param rx_data    pointer to the buffer where the read data is to be stored
+ * @param rx_count   number of bytes to read
+ * @returns 0 on success, error code otherwise
+ */
+int8_t sensirion_i2c_hal_write_read(uint8_t address, const uint8_t* tx_data,
+                                    uint16_t tx_count, uint32_t delay_usec,
+                                    uint8_t* rx_data, uint16_t rx_count);
+
 /**
  * Sleep for a given number of microseconds. The function should delay the
  * execution approximately, but no less than, the given time.
@@ -0,0 +1,433 @@
+#include <math.h>
+#include <string.h>
+
+#include "sensirion_i2c_sim.h"
+#include "sensirion_common.h"
+#include "sensirion_i2c.h"
+
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+
+#define SIM_NACK -1
+
+#define SCD4X_ADDRESS 0x62
+#define SVM40_ADDRESS 0x6A
+#define SPS30_ADDRESS 0x69
+
+#define SCD4X_PERIOD_USEC 5000000
+#define SCD4X_LOW_POWER_PERIOD_USEC 30000000
+#define SPS30_PERIOD_USEC 1000000
+
+#define SIM_MAX_RESPONSE_WORDS 20
+
+typedef struct
+{
+    uint8_t address;
+    uint16_t command;
+    bool measuring;
+    bool sleeping;
+    bool single_shot; // stop measuring once the sample was read
+    int64_t period_usec;
+    int64_t next_sample_usec; // time at which the next measurement becomes ready
+    bool data_ready;
+} sim_device_t;
+
+static sim_device_t s_devices[] = {
+    {.address = SCD4X_ADDRESS},
+    {.address = SVM40_ADDRESS},
+    {.address = SPS30_ADDRESS},
+};
+
+/* Serializes the simulated devices, the drivers may be called from several tasks */
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t s_noise_state = 0x12345678;
+
+static sim_device_t *sim_find_device(uint8_t address)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(s_devices); i++)
+    {
+        if (s_devices[i].address == address)
+        {
+            return &s_devices[i];
+        }
+    }
+    return NULL;
+}
+
+/* xorshift32, returns a value in [-1, 1] */
+static float sim_noise(void)
+{
+    s_noise_state ^= s_noise_state << 13;
+    s_noise_state ^= s_noise_state >> 17;
+    s_noise_state ^= s_noise_state << 5;
+    return ((float)(s_noise_state & 0xFFFF) / 32767.5f) - 1.0f;
+}
+
+/* Slow oscillation with the given period so that values drift like in a real room */
+static float sim_wave(int64_t now_usec, float period_sec, float phase)
+{
+    return sinf(2.0f * (float)M_PI * ((float)now_usec / 1e6f / period_sec) + phase);
+}
+
+static void sim_update_data_ready(sim_device_t *device, int64_t now_usec)
+{
+    if (device->measuring && now_usec >= device->next_sample_usec)
+    {
+        device->data_ready = true;
+        /* Keep the sensor cadence even when the host reads late */
+        while (device->next_sample_usec <= now_usec)
+        {
+            device->next_sample_usec += device->period_usec;
+        }
+    }
+}
+
+static void sim_start_measurement(sim_device_t *device, int64_t period_usec, int64_t now_usec)
+{
+    device->measuring = true;
+    device->single_shot = false;
+    device->data_ready = false;
+    device->period_usec = period_usec;
+    device->next_sample_usec = now_usec + period_usec;
+}
+
+static uint16_t sim_float_word(float value, bool high)
+{
+    union
+    {
+        uint32_t u32_value;
+        float float32;
+    } tmp;
+
+    tmp.float32 = value;
+    return high ? (uint16_t)(tmp.u32_value >> 16) : (uint16_t)tmp.u32_value;
+}
+
+static uint16_t sim_ascii_words(const char *text, uint16_t *words, uint16_t num_words)
+{
+    uint8_t bytes[2 * SIM_MAX_RESPONSE_WORDS] = {0};
+
+    strncpy((char *)bytes, text, sizeof(bytes) - 1);
+    for (uint16_t i = 0; i < num_words; i++)
+    {
+        words[i] = sensirion_common_bytes_to_uint16_t(&bytes[2 * i]);
+    }
+    return num_words;
+}
+
+/* Fill the response words for the last command of the SCD41. Returns the number of words, 0 to NACK */
+static uint16_t sim_scd4x_response(sim_device_t *device, int64_t now_usec, uint16_t *words)
+{
+    switch (device->command)
+    {
+    case 0x3682: // get_serial_number
+        words[0] = 0x5C41;
+        words[1] = 0x0000;
+        words[2] = 0x0001;
+        return 3;
+    case 0xE4B8: // get_data_ready_status, the lower 11 bits are non zero when data is ready
+        words[0] = device->data_ready ? 0x8006 : 0x8000;
+        return 1;
+    case 0xEC05: // read_measurement
+    {
+        if (!device->data_ready)
+        {
+            return 0;
+        }
+        device->data_ready = false;
+        if (device->single_shot)
+        {
+            device->measuring = false;
+        }
+        float co2 = 650.0f + 250.0f * sim_wave(now_usec, 3600.0f, 0.0f) + 15.0f * sim_noise();
+        float temperature = 23.0f + 1.5f * sim_wave(now_usec, 7200.0f, 1.0f) + 0.05f * sim_noise();
+        float humidity = 45.0f + 8.0f * sim_wave(now_usec, 5400.0f, 2.0f) + 0.2f * sim_noise();
+        words[0] = (uint16_t)co2;
+        words[1] = (uint16_t)((temperature + 45.0f) * 65536.0f / 175.0f);
+        words[2] = (uint16_t)(humidity * 65536.0f / 100.0f);
+        return 3;
+    }
+    case 0x2318: // get_temperature_offset, 4 C
+        words[0] = 0x05D9;
+        return 1;
+    case 0x2322: // get_sensor_altitude
+        words[0] = 0;
+        return 1;
+    case 0x2313: // get_automatic_self_calibration
+        words[0] = 1;
+        return 1;
+    case 0x3639: // perform_self_test
+    case 0x362F: // perform_forced_recalibration
+        words[0] = 0;
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+static void sim_scd4x_command(sim_device_t *device, int64_t now_usec)
+{
+    switch (device->command)
+    {
+    case 0x21B1: // start_periodic_measurement
+        sim_start_measurement(device, SCD4X_PERIOD_USEC, now_usec);
+        break;
+    case 0x21AC: // start_low_power_periodic_measurement
+        sim_start_measurement(device, SCD4X_LOW_POWER_PERIOD_USEC, now_usec);
+        break;
+    case 0x219D: // measure_single_shot, data is ready after 5 seconds and then measuring stops
+        sim_start_measurement(device, SCD4X_PERIOD_USEC, now_usec);
+        device->single_shot = true;
+        break;
+    case 0x3F86: // stop_periodic_measurement
+    case 0x36E0: // power_down
+    case 0x3646: // reinit
+        device->measuring = false;
+        break;
+    default:
+        break;
+    }
+}
+
+static uint16_t sim_svm40_response(sim_device_t *device, int64_t now_usec, uint16_t *words)
+{
+    float voc_index = 100.0f + 60.0f * sim_wave(now_usec, 2700.0f, 0.5f) + 3.0f * sim_noise();
+    float humidity = 45.0f + 8.0f * sim_wave(now_usec, 5400.0f, 2.0f) + 0.2f * sim_noise();
+    float temperature = 23.0f + 1.5f * sim_wave(now_usec, 7200.0f, 1.0f) + 0.05f * sim_noise();
+
+    switch (device->command)
+    {
+    case 0x03A6: // read_measured_values_as_integers
+        if (!device->measuring)
+        {
+            return 0;
+        }
+        words[0] = (uint16_t)(int16_t)(voc_index * 10.0f);
+        words[1] = (uint16_t)(int16_t)(humidity * 100.0f);
+        words[2] = (uint16_t)(int16_t)(temperature * 200.0f);
+        return 3;
+    case 0x03B0: // read_measured_values_as_integers_with_raw_parameters
+        if (!device->measuring)
+        {
+            return 0;
+        }
+        words[0] = (uint16_t)(int16_t)(voc_index * 10.0f);
+        words[1] = (uint16_t)(int16_t)(humidity * 100.0f);
+        words[2] = (uint16_t)(int16_t)(temperature * 200.0f);
+        words[3] = (uint16_t)(30000.0f - 40.0f * voc_index);
+        words[4] = words[1];
+        words[5] = words[2];
+        return 6;
+    case 0x6014: // get_temperature_offset_for_rht_measurements
+        words[0] = 0;
+        return 1;
+    case 0x6083: // get_voc_algorithm_tuning_parameters
+        words[0] = 100;
+        words[1] = 12;
+        words[2] = 180;
+        words[3] = 50;
+        return 4;
+    case 0x6181: // get_voc_algorithm_state
+        memset(words, 0, 4 * sizeof(*words));
+        return 4;
+    case 0xD100: // get_version: firmware 2.2, no debug, hardware 1.0, protocol 1.0
+        words[0] = 0x0202;
+        words[1] = 0x0001;
+        words[2] = 0x0001;
+        words[3] = 0x0000;
+        return 4;
+    case 0xD033: // get_serial_number
+        return sim_ascii_words("SVM40SIM00000001", words, 13);
+    default:
+        return 0;
+    }
+}
+
+static void sim_svm40_command(sim_device_t *device, int64_t now_usec)
+{
+    switch (device->command)
+    {
+    case 0x0010: // start_continuous_measurement
+        sim_start_measurement(device, SPS30_PERIOD_USEC, now_usec);
+        break;
+    case 0x0104: // stop_measurement
+    case 0xD304: // device_reset
+        device->measuring = false;
+        break;
+    default:
+        break;
+    }
+}
+
+static uint16_t sim_sps30_response(sim_device_t *device, int64_t now_usec, uint16_t *words)
+{
+    if (device->sleeping)
+    {
+        return 0;
+    }
+
+    switch (device->command)
+    {
+    case 0x0202: // read_data_ready
+        words[0] = device->data_ready ? 1 : 0;
+        return 1;
+    case 0x0300: // read_measurement, ten big endian floats
+    {
+        if (!device->measuring)
+        {
+            return 0;
+        }
+        device->data_ready = false;
+        float pm2p5 = 9.0f + 6.0f * sim_wave(now_usec, 1800.0f, 0.3f) + 0.8f * sim_noise();
+        if (pm2p5 < 0.5f)
+        {
+            pm2p5 = 0.5f;
+        }
+        const float values[10] = {
+            0.75f * pm2p5,   // mc_1p0
+            pm2p5,           // mc_2p5
+            1.10f * pm2p5,   // mc_4p0
+            1.20f * pm2p5,   // mc_10p0
+            5.40f * pm2p5,   // nc_0p5
+            6.30f * pm2p5,   // nc_1p0
+            6.40f * pm2p5,   // nc_2p5
+            6.41f * pm2p5,   // nc_4p0
+            6.42f * pm2p5,   // nc_10p0
+            0.55f};          // typical_particle_size
+        for (uint16_t i = 0; i < 10; i++)
+        {
+            words[2 * i] = sim_float_word(values[i], true);
+            words[2 * i + 1] = sim_float_word(values[i], false);
+        }
+        return 20;
+    }
+    case 0xD100: // read_firmware_version, 2.2
+        words[0] = 0x0202;
+        return 1;
+    case 0xD033: // get_serial
+        return sim_ascii_words("SPS30SIM00000001", words, 16);
+    case 0x8004: // get_fan_auto_cleaning_interval, one week
+        words[0] = 0x0009;
+        words[1] = 0x3A80;
+        return 2;
+    case 0xD206: // read_device_status_register
+        words[0] = 0;
+        words[1] = 0;
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+static int8_t sim_sps30_command(sim_device_t *device, int64_t now_usec)
+{
+    /* A sleeping SPS30 only reacts to the wake-up command and does not acknowledge the first one */
+    if (device->sleeping)
+    {
+        if (device->command == 0x1103)
+        {
+            device->sleeping = false;
+        }
+        return SIM_NACK;
+    }
+
+    switch (device->command)
+    {
+    case 0x0010: // start_measurement
+        sim_start_measurement(device, SPS30_PERIOD_USEC, now_usec);
+        break;
+    case 0x0104: // stop_measurement
+    case 0xD304: // reset
+        device->measuring = false;
+        break;
+    case 0x1001: // sleep
+        device->measuring = false;
+        device->sleeping = true;
+        break;
+    default:
+        break;
+    }
+    return NO_ERROR;
+}
+
+int8_t sensirion_i2c_sim_write(uint8_t address, const uint8_t* data,
+                               uint16_t count)
+{
+    int8_t ret = NO_ERROR;
+    sim_device_t *device = sim_find_device(address);
+    int64_t now_usec = esp_timer_get_time();
+
+    if (device == NULL || count < SENSIRION_COMMAND_SIZE)
+    {
+        return SIM_NACK;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    device->command = sensirion_common_bytes_to_uint16_t(data);
+    switch (address)
+    {
+    case SCD4X_ADDRESS:
+        sim_scd4x_command(device, now_usec);
+        break;
+    case SVM40_ADDRESS:
+        sim_svm40_command(device, now_usec);
+        break;
+    case SPS30_ADDRESS:
+        ret = sim_sps30_command(device, now_usec);
+        break;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    return ret;
+}
+
+int8_t sensirion_i2c_sim_read(uint8_t address, uint8_t* data, uint16_t count)
+{
+    uint16_t words[SIM_MAX_RESPONSE_WORDS];
+    uint16_t num_words = 0;
+    sim_device_t *device = sim_find_device(address);
+    int64_t now_usec = esp_timer_get_time();
+
+    if (device == NULL)
+    {
+        return SIM_NACK;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    sim_update_data_ready(device, now_usec);
+    switch (address)
+    {
+    case SCD4X_ADDRESS:
+        num_words = sim_scd4x_response(device, now_usec, words);
+        break;
+    case SVM40_ADDRESS:
+        num_words = sim_svm40_response(device, now_usec, words);
+        break;
+    case SPS30_ADDRESS:
+        num_words = sim_sps30_response(device, now_usec, words);
+        break;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (num_words == 0 || count > num_words * (SENSIRION_WORD_SIZE + CRC8_LEN))
+    {
+        return SIM_NACK;
+    }
+
+    /* Same layout as on the wire: every word is followed by its CRC */
+    for (uint16_t i = 0, j = 0; j < count; i++)
+    {
+        uint8_t word_bytes[SENSIRION_WORD_SIZE];
+        sensirion_common_uint16_t_to_bytes(words[i], word_bytes);
+        data[j++] = word_bytes[0];
+        if (j < count)
+        {
+            data[j++] = word_bytes[1];
+        }
+        if (j < count)
+        {
+            data[j++] = sensirion_i2c_generate_crc_word(word_bytes);
+        }
+    }
+    return NO_ERROR;
+}
@@ -0,0 +1,48 @@
+#ifndef SENSIRION_I2C_SIM_H
+#define SENSIRION_I2C_SIM_H
+
+#include "sensirion_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * Simulated SCD41 (0x62), SVM40 (0x6A) and SPS30 (0x69). The simulated devices
+ * decode the commands sent by the drivers, keep the measurement state of the
+ * real sensors (periodic measurement, data ready, sleep) and answer with the
+ * same byte streams, including a valid CRC after every word. Measured values
+ * follow slow daily-like cycles with some noise.
+ *
+ * Enabled with CONFIG_SENSIRION_SIMULATED_SENSORS, in which case
+ * sensirion_i2c_hal.c forwards every transfer to these functions instead of
+ * the I2C driver.
+ */
+
+/**
+ * Handle a write transaction to a simulated device.
+ *
+ * @param address 7-bit I2C address of the simulated device
+ * @param data    command, optionally followed by arguments with CRC
+ * @param count   number of bytes in data
+ * @returns 0 on success, -1 if the address is not simulated (NACK)
+ */
+int8_t sensirion_i2c_sim_write(uint8_t address, const uint8_t* data,
+                               uint16_t count);
+
+/**
+ * Handle a read transaction from a simulated device. The response depends on
+ * the last command written to the device.
+ *
+ * @param address 7-bit I2C address of the simulated device
+ * @param data    buffer where the response words and their CRC are stored
+ * @param count   number of bytes to read
+ * @returns 0 on success, -1 if the device does not acknowledge (NACK)
+ */
+int8_t sensirion_i2c_sim_read(uint8_t address, uint8_t* data, uint16_t count);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* SENSIRION_I2C_SIM_H */
@@ -29,6 +29,8 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <string.h>
+
 #include "sensirion_shdlc.h"
 #include "sensirion_common.h"
 #include "sensirion_config.h"
@@ -37,14 +39,31 @@
 #define SHDLC_START 0x7e
 #define SHDLC_STOP 0x7e
 
+#define SHDLC_ESCAPE 0x7d
+
 #define SHDLC_MIN_TX_FRAME_SIZE 6
 /** start/stop + (4 header + 255 data) * 2 because of byte stuffing */
 #define SHDLC_FRAME_MAX_TX_FRAME_SIZE (2 + (4 + 255) * 2)
 
-/** start/stop + (5 header + 255 data) * 2 because of byte stuffing */
-#define SHDLC_FRAME_MAX_RX_FRAME_SIZE (2 + (5 + 255) * 2)
-
-#define RX_DELAY_US 20000
+/** Bytes taken from the UART per read. A response is usually a few reads as
+ * the HAL returns what has arrived so far. */
+#define SHDLC_RX_CHUNK_SIZE 32
+
+enum sensirion_shdlc_decoder_state {
+    SHDLC_DECODER_WAIT_START,
+    SHDLC_DECODER_HEADER,
+    SHDLC_DECODER_DATA,
+    SHDLC_DECODER_CHECKSUM,
+    SHDLC_DECODER_STOP,
+};
+
+/** Received bytes that follow the last decoded frame, they belong to the next
+ * one */
+static struct {
+    uint8_t data[SHDLC_RX_CHUNK_SIZE];
+    uint16_t offset;
+    uint16_t count;
+} s_rx_pending;
 
 static uint8_t sensirion_shdlc_checksum(uint8_t header_sum, uint8_t data_len,
                                         const uint8_t* data) {
@@ -56,48 +75,246 @@ static uint8_t sensirion_shdlc_checksum(uint8_t header_sum, uint8_t data_len,
     return ~header_sum;
 }
 
+static bool sensirion_shdlc_needs_stuffing(uint8_t c) {
+    return c == 0x11 || c == 0x13 || c == SHDLC_ESCAPE || c == SHDLC_START;
+}
+
+/**
+ * Non-zero if any byte of v is zero. Only usable as a flag, which bytes are
+ * marked may be off after the first zero byte.
+ */
+static uint32_t sensirion_shdlc_has_zero_byte(uint32_t v) {
+    return (v - 0x01010101) & ~v & 0x80808080;
+}
+
+/**
+ * True if none of the four bytes of word is escaped by byte stuffing. 0x11 and
+ * 0x13 only differ in bit 1 and share one comparison.
+ */
+static bool sensirion_shdlc_word_is_clean(uint32_t word) {
+    return !(sensirion_shdlc_has_zero_byte((word | 0x02020202) ^ 0x13131313) |
+             sensirion_shdlc_has_zero_byte(word ^ 0x7d7d7d7d) |
+             sensirion_shdlc_has_zero_byte(word ^ 0x7e7e7e7e));
+}
+
 static uint16_t sensirion_shdlc_stuff_data(uint8_t data_len,
                                            const uint8_t* data,
                                            uint8_t* stuffed_data) {
     uint16_t output_data_len = 0;
-
-    while (data_len--) {
-        uint8_t c = *(data++);
-        switch (c) {
-            case 0x11:
-            case 0x13:
-            case 0x7d:
-            case 0x7e:
-                /* byte stuffing is done by inserting 0x7d and inverting bit 5
-                 */
-                *(stuffed_data++) = 0x7d;
-                *(stuffed_data++) = c ^ (1 << 5);
-                output_data_len += 2;
-                break;
-            default:
-                *(stuffed_data++) = c;
-                output_data_len += 1;
+    uint16_t i = 0;
+    uint32_t word;
+
+    while (i < data_len) {
+        /* Clean words are copied at once, the others byte by byte */
+        uint16_t end = i + sizeof(word) <= data_len ? i + sizeof(word)
+                                                    : data_len;
+        if (end - i == sizeof(word)) {
+            memcpy(&word, &data[i], sizeof(word));
+            if (sensirion_shdlc_word_is_clean(word)) {
+                memcpy(&stuffed_data[output_data_len], &word, sizeof(word));
+                output_data_len += sizeof(word);
+                i += sizeof(word);
+                continue;
+            }
+        }
+        while (i < end) {
+            uint8_t c = data[i++];
+
+            if (sensirion_shdlc_needs_stuffing(c)) {
+                /* byte stuffing is done by inserting 0x7d and inverting
+                 * bit 5 */
+                stuffed_data[output_data_len++] = SHDLC_ESCAPE;
+                c ^= (1 << 5);
+            }
+            stuffed_data[output_data_len++] = c;
         }
     }
     return output_data_len;
 }
 
-static uint8_t sensirion_shdlc_check_unstuff(uint8_t data) {
-    return data == 0x7d;
+void sensirion_shdlc_decoder_init(struct sensirion_shdlc_decoder* decoder,
+                                  uint8_t* data, uint8_t max_data_len) {
+    decoder->data = data;
+    decoder->max_data_len = max_data_len;
+    decoder->state = SHDLC_DECODER_WAIT_START;
 }
 
-static uint8_t sensirion_shdlc_unstuff_byte(uint8_t data) {
-    switch (data) {
-        case 0x31:
-            return 0x11;
-        case 0x33:
-            return 0x13;
-        case 0x5d:
-            return 0x7d;
-        case 0x5e:
-            return 0x7e;
-        default:
-            return data;
+static void sensirion_shdlc_decoder_start(
+    struct sensirion_shdlc_decoder* decoder) {
+    decoder->state = SHDLC_DECODER_HEADER;
+    decoder->index = 0;
+    decoder->checksum = 0;
+    decoder->escape = false;
+}
+
+int16_t sensirion_shdlc_decoder_feed(struct sensirion_shdlc_decoder* decoder,
+                                     const uint8_t* bytes, uint16_t count,
+                                     uint16_t* consumed) {
+    uint8_t* header = (uint8_t*)&decoder->header;
+    uint16_t i;
+
+    for (i = 0; i < count;) {
+        if (decoder->state == SHDLC_DECODER_DATA) {
+            /* Data path, the state is kept in locals as the stores to the
+             * data could alias the decoder. Clean words are taken at once. */
+            uint8_t* data = decoder->data;
+            uint8_t index = decoder->index;
+            uint8_t sum = decoder->checksum;
+            bool escape = decoder->escape;
+            const uint8_t data_len = decoder->header.data_len;
+            uint32_t word;
+
+            while (i < count && index < data_len) {
+                uint8_t c = bytes[i];
+
+                if (!escape && i + sizeof(word) <= count &&
+                    index + sizeof(word) <= data_len) {
+                    memcpy(&word, &bytes[i], sizeof(word));
+                    if (sensirion_shdlc_word_is_clean(word)) {
+                        memcpy(&data[index], &word, sizeof(word));
+                        sum += bytes[i] + bytes[i + 1] + bytes[i + 2] +
+                               bytes[i + 3];
+                        index += sizeof(word);
+                        i += sizeof(word);
+                        continue;
+                    }
+                }
+                if (c == SHDLC_START)
+                    break;
+                i++;
+                if (escape) {
+                    /* byte stuffing is undone by inverting bit 5 */
+                    c ^= (1 << 5);
+                    escape = false;
+                } else if (c == SHDLC_ESCAPE) {
+                    escape = true;
+                    continue;
+                }
+                data[index++] = c;
+                sum += c;
+            }
+            decoder->index = index;
+            decoder->checksum = sum;
+            decoder->escape = escape;
+            if (index == data_len)
+                decoder->state = SHDLC_DECODER_CHECKSUM;
+            if (i == count || index == data_len)
+                continue;
+            /* A start byte, the frame was cut short */
+        }
+
+        uint8_t c = bytes[i++];
+
+        if (c == SHDLC_START) {
+            if (decoder->state == SHDLC_DECODER_STOP) {
+                decoder->state = SHDLC_DECODER_WAIT_START;
+                *consumed = i;
+                if (0x7F & decoder->header.state)
+                    return SENSIRION_SHDLC_ERR_EXECUTION_FAILURE;
+                return NO_ERROR;
+            }
+            if (decoder->state == SHDLC_DECODER_WAIT_START ||
+                (decoder->state == SHDLC_DECODER_HEADER &&
+                 decoder->index == 0 && !decoder->escape)) {
+                /* A start byte, or the stop byte of an earlier frame
+                 * followed by the start byte of this one */
+                sensirion_shdlc_decoder_start(decoder);
+                continue;
+            }
+            /* The frame was cut short, this byte starts the next one */
+            sensirion_shdlc_decoder_start(decoder);
+            *consumed = i;
+            return SENSIRION_SHDLC_ERR_ENCODING_ERROR;
+        }
+
+        switch (decoder->state) {
+            case SHDLC_DECODER_WAIT_START:
+                continue;
+            case SHDLC_DECODER_STOP:
+                decoder->state = SHDLC_DECODER_WAIT_START;
+                *consumed = i;
+                return SENSIRION_SHDLC_ERR_MISSING_STOP;
+            default:
+                break;
+        }
+
+        if (decoder->escape) {
+            /* byte stuffing is undone by inverting bit 5 */
+            c ^= (1 << 5);
+            decoder->escape = false;
+        } else if (c == SHDLC_ESCAPE) {
+            decoder->escape = true;
+            continue;
+        }
+        decoder->checksum += c;
+
+        switch (decoder->state) {
+            case SHDLC_DECODER_HEADER:
+                header[decoder->index++] = c;
+                if (decoder->index < sizeof(decoder->header))
+                    break;
+                if (decoder->header.data_len > decoder->max_data_len) {
+                    decoder->state = SHDLC_DECODER_WAIT_START;
+                    *consumed = i;
+                    return SENSIRION_SHDLC_ERR_FRAME_TOO_LONG;
+                }
+                decoder->index = 0;
+                decoder->state = decoder->header.data_len
+                                     ? SHDLC_DECODER_DATA
+                                     : SHDLC_DECODER_CHECKSUM;
+                break;
+            case SHDLC_DECODER_DATA:
+                decoder->data[decoder->index++] = c;
+                if (decoder->index == decoder->header.data_len)
+                    decoder->state = SHDLC_DECODER_CHECKSUM;
+                break;
+            case SHDLC_DECODER_CHECKSUM:
+                /* (CHECKSUM + ~CHECKSUM) = 0xFF */
+                if (decoder->checksum != 0xFF) {
+                    decoder->state = SHDLC_DECODER_WAIT_START;
+                    *consumed = i;
+                    return SENSIRION_SHDLC_ERR_CRC_MISMATCH;
+                }
+                decoder->state = SHDLC_DECODER_STOP;
+                break;
+        }
+    }
+
+    *consumed = i;
+    return SENSIRION_SHDLC_DECODER_INCOMPLETE;
+}
+
+/**
+ * Feed received bytes to the decoder until it completes a frame or fails.
+ * Bytes after the end of the frame are kept for the next call.
+ */
+static int16_t
+sensirion_shdlc_decode_next(struct sensirion_shdlc_decoder* decoder) {
+    int16_t ret;
+    int16_t len;
+    uint16_t consumed;
+
+    while (1) {
+        if (s_rx_pending.offset == s_rx_pending.count) {
+            len = sensirion_uart_hal_rx(sizeof(s_rx_pending.data),
+                                        s_rx_pending.data);
+            s_rx_pending.offset = 0;
+            s_rx_pending.count = len > 0 ? len : 0;
+            if (len <= 0) {
+                /* Nothing received in time */
+                if (decoder->state == SHDLC_DECODER_WAIT_START)
+                    return SENSIRION_SHDLC_ERR_MISSING_START;
+                decoder->state = SHDLC_DECODER_WAIT_START;
+                return SENSIRION_SHDLC_ERR_MISSING_STOP;
+            }
+        }
+
+        ret = sensirion_shdlc_decoder_feed(
+            decoder, &s_rx_pending.data[s_rx_pending.offset],
+            s_rx_pending.count - s_rx_pending.offset, &consumed);
+        s_rx_pending.offset += consumed;
+        if (ret != SENSIRION_SHDLC_DECODER_INCOMPLETE)
+            return ret;
     }
 }
 
@@ -105,14 +322,25 @@ int16_t sensirion_shdlc_xcv(uint8_t addr, uint8_t cmd, uint8_t tx_data_len,
                             const uint8_t* tx_data, uint8_t max_rx_data_len,
                             struct sensirion_shdlc_rx_header* rx_header,
                             uint8_t* rx_data) {
+    struct sensirion_shdlc_decoder decoder;
     int16_t ret;
 
     ret = sensirion_shdlc_tx(addr, cmd, tx_data_len, tx_data);
     if (ret != 0)
         return ret;
 
-    sensirion_uart_hal_sleep_usec(RX_DELAY_US);
-    return sensirion_shdlc_rx(max_rx_data_len, rx_header, rx_data);
+    /* No delay before receiving, the response is decoded as it arrives. A
+     * response to an earlier request that timed out is skipped, also when it
+     * holds more data than this one expects. */
+    sensirion_shdlc_decoder_init(&decoder, rx_data, max_rx_data_len);
+    do {
+        ret = sensirion_shdlc_decode_next(&decoder);
+    } while ((ret == NO_ERROR || ret == SENSIRION_SHDLC_ERR_EXECUTION_FAILURE ||
+              ret == SENSIRION_SHDLC_ERR_FRAME_TOO_LONG) &&
+             (decoder.header.addr != addr || decoder.header.cmd != cmd));
+
+    *rx_header = decoder.header;
+    return ret;
 }
 
 int16_t sensirion_shdlc_tx(uint8_t addr, uint8_t cmd, uint8_t data_len,
@@ -143,67 +371,13 @@ int16_t sensirion_shdlc_tx(uint8_t addr, uint8_t cmd, uint8_t data_len,
 int16_t sensirion_shdlc_rx(uint8_t max_data_len,
                            struct sensirion_shdlc_rx_header* rxh,
                            uint8_t* data) {
-    int16_t len;
-    uint16_t i;
-    uint8_t rx_frame[SHDLC_FRAME_MAX_RX_FRAME_SIZE];
-    uint8_t* rx_header = (uint8_t*)rxh;
-    uint8_t j;
-    uint8_t crc;
-    uint8_t unstuff_next;
-
-    len = sensirion_uart_hal_rx(2 + (5 + (uint16_t)max_data_len) * 2, rx_frame);
-    if (len < 1 || rx_frame[0] != SHDLC_START)
-        return SENSIRION_SHDLC_ERR_MISSING_START;
-
-    for (unstuff_next = 0, i = 1, j = 0; j < sizeof(*rxh) && i < len - 2; ++i) {
-        if (unstuff_next) {
-            rx_header[j++] = sensirion_shdlc_unstuff_byte(rx_frame[i]);
-            unstuff_next = 0;
-        } else {
-            unstuff_next = sensirion_shdlc_check_unstuff(rx_frame[i]);
-            if (!unstuff_next)
-                rx_header[j++] = rx_frame[i];
-        }
-    }
-    if (j != sizeof(*rxh) || unstuff_next)
-        return SENSIRION_SHDLC_ERR_ENCODING_ERROR;
-
-    if (max_data_len < rxh->data_len)
-        return SENSIRION_SHDLC_ERR_FRAME_TOO_LONG; /* more data than expected */
-
-    for (unstuff_next = 0, j = 0; j < rxh->data_len && i < len - 2; ++i) {
-        if (unstuff_next) {
-            data[j++] = sensirion_shdlc_unstuff_byte(rx_frame[i]);
-            unstuff_next = 0;
-        } else {
-            unstuff_next = sensirion_shdlc_check_unstuff(rx_frame[i]);
-            if (!unstuff_next)
-                data[j++] = rx_frame[i];
-        }
-    }
-
-    if (unstuff_next)
-        return SENSIRION_SHDLC_ERR_ENCODING_ERROR;
-
-    if (j < rxh->data_len)
-        return SENSIRION_SHDLC_ERR_ENCODING_ERROR;
-
-    crc = rx_frame[i++];
-    if (sensirion_shdlc_check_unstuff(crc))
-        crc = sensirion_shdlc_unstuff_byte(rx_frame[i++]);
-
-    if (sensirion_shdlc_checksum(rxh->addr + rxh->cmd + rxh->state,
-                                 rxh->data_len, data) != crc)
-        return SENSIRION_SHDLC_ERR_CRC_MISMATCH;
-
-    if (i >= len || rx_frame[i] != SHDLC_STOP)
-        return SENSIRION_SHDLC_ERR_MISSING_STOP;
-
-    if (0x7F & rxh->state) {
-        return SENSIRION_SHDLC_ERR_EXECUTION_FAILURE;
-    }
+    struct sensirion_shdlc_decoder decoder;
+    int16_t ret;
 
-    return 0;
+    sensirion_shdlc_decoder_init(&decoder, data, max_data_len);
+    ret = sensirion_shdlc_decode_next(&decoder);
+    *rxh = decoder.header;
+    return ret;
 }
 
 static void sensirion_shdlc_stuff_byte(struct sensirion_shdlc_buffer* tx_frame,
@@ -297,8 +471,16 @@ void sensirion_shdlc_add_bytes_to_frame(struct sensirion_shdlc_buffer* tx_frame,
                                         uint16_t data_length) {
     uint16_t i;
 
-    for (i = 0; i < data_length; i++) {
-        sensirion_shdlc_add_uint8_t_to_frame(tx_frame, data[i]);
+    /* A frame holds at most 255 data bytes */
+    while (data_length > 0) {
+        uint8_t len = data_length > 255 ? 255 : (uint8_t)data_length;
+
+        tx_frame->offset += sensirion_shdlc_stuff_data(
+            len, data, &tx_frame->data[tx_frame->offset]);
+        for (i = 0; i < len; i++)
+            tx_frame->checksum += data[i];
+        data += len;
+        data_length -= len;
     }
 }
 
@@ -321,66 +503,19 @@ int16_t sensirion_shdlc_tx_frame(struct sensirion_shdlc_buffer* tx_frame) {
     return NO_ERROR;
 }
 
-static uint8_t
-sensirion_shdlc_unstuff_next_byte(struct sensirion_shdlc_buffer* rx_frame) {
-
-    uint8_t data = rx_frame->data[rx_frame->offset++];
-
-    if (data == 0x7d) {
-        data = rx_frame->data[rx_frame->offset++];
-        data = data ^ (1 << 5);
-    }
-    rx_frame->checksum += data;
-    return data;
-}
-
 int16_t sensirion_shdlc_rx_inplace(struct sensirion_shdlc_buffer* rx_frame,
                                    uint8_t expected_data_length,
                                    struct sensirion_shdlc_rx_header* header) {
-    int16_t rx_length;
-    uint16_t i;
-    rx_frame->offset = 0;
-    rx_frame->checksum = 0;
-
-    rx_length = sensirion_uart_hal_rx(
-        2 + (5 + (uint16_t)expected_data_length) * 2, rx_frame->data);
-    if (rx_length < 1 || rx_frame->data[rx_frame->offset++] != SHDLC_START) {
-        return SENSIRION_SHDLC_ERR_MISSING_START;
-    }
-
-    header->addr = sensirion_shdlc_unstuff_next_byte(rx_frame);
-    header->cmd = sensirion_shdlc_unstuff_next_byte(rx_frame);
-    header->state = sensirion_shdlc_unstuff_next_byte(rx_frame);
-    header->data_len = sensirion_shdlc_unstuff_next_byte(rx_frame);
-
-    if (expected_data_length < header->data_len) {
-        return SENSIRION_SHDLC_ERR_FRAME_TOO_LONG; /* more data than
-                                                      expected */
-    }
-
-    for (i = 0; i < header->data_len && rx_frame->offset < rx_length - 2; i++) {
-        rx_frame->data[i] = sensirion_shdlc_unstuff_next_byte(rx_frame);
-    }
-
-    if (i < header->data_len) {
-        return SENSIRION_SHDLC_ERR_ENCODING_ERROR;
-    }
-
-    sensirion_shdlc_unstuff_next_byte(rx_frame);
-
-    /* (CHECKSUM + ~CHECKSUM) = 0xFF */
-    if (rx_frame->checksum != 0xFF) {
-        return SENSIRION_SHDLC_ERR_CRC_MISMATCH;
-    }
-
-    if (rx_frame->offset >= rx_length ||
-        rx_frame->data[rx_frame->offset] != SHDLC_STOP) {
-        return SENSIRION_SHDLC_ERR_MISSING_STOP;
-    }
-
-    if (0x7F & header->state) {
-        return SENSIRION_SHDLC_ERR_EXECUTION_FAILURE;
-    }
+    struct sensirion_shdlc_decoder decoder;
+    int16_t ret;
 
-    return NO_ERROR;
+    /* The data is unstuffed straight into the buffer, which thus only needs
+     * to hold expected_data_length bytes */
+    sensirion_shdlc_decoder_init(&decoder, rx_frame->data,
+                                 expected_data_length);
+    ret = sensirion_shdlc_decode_next(&decoder);
+    *header = decoder.header;
+    rx_frame->offset = decoder.header.data_len;
+    rx_frame->checksum = decoder.checksum;
+    return ret;
 }
@@ -60,6 +60,27 @@ struct sensirion_shdlc_rx_header {
     uint8_t data_len;
 };
 
+/* Returned by sensirion_shdlc_decoder_feed() while the frame is incomplete */
+#define SENSIRION_SHDLC_DECODER_INCOMPLETE 1
+
+/**
+ * Incremental decoder for MISO frames. Bytes are unstuffed and summed up as
+ * they are fed, the data is written straight to its destination, so no frame
+ * buffer is needed and decoding overlaps with the reception. Frames may be
+ * split across any number of feeds and one feed may hold several frames.
+ * Anything before a start byte is skipped, so the decoder resynchronizes by
+ * itself after an error.
+ */
+struct sensirion_shdlc_decoder {
+    struct sensirion_shdlc_rx_header header;
+    uint8_t* data;
+    uint8_t max_data_len;
+    uint8_t state;
+    uint8_t index;
+    uint8_t checksum;
+    bool escape;
+};
+
 /**
  * sensirion_shdlc_tx() - transmit an SHDLC frame
  *
@@ -90,6 +111,10 @@ int16_t sensirion_shdlc_rx(uint8_t max_data_len,
 /**
  * sensirion_shdlc_xcv() - transceive (transmit then receive) an SHDLC frame
  *
+ * Received frames from another address or for another command, e.g. late
+ * responses to an earlier request that timed out, are skipped, whatever their
+ * length.
+ *
  * Note that rx_header and rx_data must be discarded on failure
  *
  * @addr:           recipient address
@@ -106,6 +131,37 @@ int16_t sensirion_shdlc_xcv(uint8_t addr, uint8_t cmd, uint8_t tx_data_len,
                             struct sensirion_shdlc_rx_header* rx_header,
                             uint8_t* rx_data);
 
+/**
+ * sensirion_shdlc_decoder_init() - prepare a decoder for the next frame
+ *
+ * @decoder:        the decoder
+ * @data:           Memory where the data of the frame is stored
+ * @max_data_len:   size of data, longer frames are rejected
+ */
+void sensirion_shdlc_decoder_init(struct sensirion_shdlc_decoder* decoder,
+                                  uint8_t* data, uint8_t max_data_len);
+
+/**
+ * sensirion_shdlc_decoder_feed() - decode received bytes
+ *
+ * Stops after the stop byte of a frame, feed the remaining bytes again to
+ * decode the next frame into the same or another decoder. After a complete
+ * frame or an error the decoder waits for the next start byte.
+ *
+ * @decoder:    the decoder
+ * @bytes:      received bytes
+ * @count:      number of bytes
+ * @consumed:   Memory where the number of bytes used is stored
+ * Return:      0 when a frame is complete, its header and data are valid,
+ *              SENSIRION_SHDLC_DECODER_INCOMPLETE if all bytes were used
+ *              without completing a frame, an error code otherwise.
+ *              SENSIRION_SHDLC_ERR_EXECUTION_FAILURE is returned for a
+ *              complete frame whose state reports an error.
+ */
+int16_t sensirion_shdlc_decoder_feed(struct sensirion_shdlc_decoder* decoder,
+                                     const uint8_t* bytes, uint16_t count,
+                                     uint16_t* consumed);
+
 /**
  * sensirion_shdlc_add_uint8_t_to_frame() - Add a uint8_t to the frame at
  *                                          offset.
@@ -34,40 +34,123 @@
 #include "sensirion_config.h"
 
 #include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "driver/gpio.h"
 #include "driver/uart.h"
 #include "esp_err.h"
+#include "esp_log.h"
 
-#define SENSIRION_UART UART_NUM_1
-#define TXD_PIN_UART1 GPIO_NUM_25
-#define RXD_PIN_UART1 GPIO_NUM_26
+#ifdef CONFIG_SENSIRION_SIMULATED_SENSORS
+#include "sensirion_uart_sim.h"
+#endif
+
+#define SENSIRION_UART_BAUD_RATE 115200
 #define RX_BUF_SIZE (1024 * 1)
-// #define TX_BUF_SIZE (1024 * 1)
+#define RX_TIMEOUT_MS 200
 #define TAG "sensirion_uart_hal.c"
 
+static bool s_initialized;
+
 int16_t sensirion_uart_hal_init()
 {
-    /* NOTE: UART initialization is assumed to be done in 'main.c' */
+    if (s_initialized)
+    {
+        return 0;
+    }
+
+#ifndef CONFIG_SENSIRION_SIMULATED_SENSORS
+    uart_config_t config = {
+        .baud_rate = SENSIRION_UART_BAUD_RATE,
+        .data_bits = UART_DATA_8_BITS,
+        .parity = UART_PARITY_DISABLE,
+        .stop_bits = UART_STOP_BITS_1,
+        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+    };
+    esp_err_t err = uart_param_config(CONFIG_SENSIRION_UART_PORT, &config);
+    if (err == ESP_OK)
+    {
+        err = uart_set_pin(CONFIG_SENSIRION_UART_PORT, CONFIG_SENSIRION_UART_TX, CONFIG_SENSIRION_UART_RX,
+                           UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+    }
+    if (err == ESP_OK)
+    {
+        /* Blocking writes, a frame is at most a few hundred bytes */
+        err = uart_driver_install(CONFIG_SENSIRION_UART_PORT, RX_BUF_SIZE, 0, 0, NULL, 0);
+    }
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "UART%d init failed: %s", CONFIG_SENSIRION_UART_PORT, esp_err_to_name(err));
+        return err;
+    }
+    ESP_LOGI(TAG, "UART%d at %d baud on TX %d RX %d", CONFIG_SENSIRION_UART_PORT, SENSIRION_UART_BAUD_RATE,
+             CONFIG_SENSIRION_UART_TX, CONFIG_SENSIRION_UART_RX);
+#endif
+    s_initialized = true;
     return 0;
 }
 
 int16_t sensirion_uart_hal_free()
 {
-    int16_t err;
-    err = uart_driver_delete(SENSIRION_UART);
-    return err;
+    if (!s_initialized)
+    {
+        return 0;
+    }
+    s_initialized = false;
+#ifdef CONFIG_SENSIRION_SIMULATED_SENSORS
+    return 0;
+#else
+    return uart_driver_delete(CONFIG_SENSIRION_UART_PORT);
+#endif
 }
 
 int16_t sensirion_uart_hal_tx(uint16_t data_len, const uint8_t *data)
 {
-    return uart_write_bytes(SENSIRION_UART, (const char *)data, data_len);
+#ifdef CONFIG_SENSIRION_SIMULATED_SENSORS
+    return sensirion_uart_sim_write(data, data_len);
+#else
+    return uart_write_bytes(CONFIG_SENSIRION_UART_PORT, (const char *)data, data_len);
+#endif
 }
 
 int16_t sensirion_uart_hal_rx(uint16_t max_data_len, uint8_t *data)
 {
-    return uart_read_bytes(SENSIRION_UART, (uint8_t *)data, max_data_len, pdMS_TO_TICKS(200));
+#ifdef CONFIG_SENSIRION_SIMULATED_SENSORS
+    return sensirion_uart_sim_read(data, max_data_len);
+#else
+    /* Returns as soon as something arrived so that the SHDLC decoder works on the start of a frame
+    while the rest is still on the line. Only the first byte is waited for. */
+    size_t buffered = 0;
+    int count = uart_read_bytes(CONFIG_SENSIRION_UART_PORT, data, 1, pdMS_TO_TICKS(RX_TIMEOUT_MS));
+    if (count <= 0 || max_data_len == 1)
+    {
+        return count;
+    }
+    uart_get_buffered_data_len(CONFIG_SENSIRION_UART_PORT, &buffered);
+    if (buffered > (size_t)max_data_len - 1)
+    {
+        buffered = max_data_len - 1;
+    }
+    if (buffered > 0)
+    {
+        int more = uart_read_bytes(CONFIG_SENSIRION_UART_PORT, &data[1], buffered, 0);
+        if (more > 0)
+        {
+            count += more;
+        }
+    }
+    return count;
+#endif
 }
 
 void sensirion_uart_hal_sleep_usec(uint32_t useconds)
 {
+    /* Rounded up to whole ticks, a delay shorter than requested lets the next frame reach the sensor
+    before it is ready for it */
+    const uint32_t tick_usec = 1000000 / configTICK_RATE_HZ;
+    TickType_t ticks = (useconds + tick_usec - 1) / tick_usec;
+
+    if (ticks > 0)
+    {
+        vTaskDelay(ticks);
+    }
 }
@@ -64,6 +64,10 @@ int16_t sensirion_uart_hal_tx(uint16_t data_len, const uint8_t* data);
 /**
  * sensirion_uart_hal_rx() - receive data over UART
  *
+ * Waits a bounded time for the first byte and returns as soon as some bytes
+ * were received, which may be less than a frame. No data within the timeout
+ * returns 0.
+ *
  * @data_len:   max number of bytes to receive
  * @data:       Memory where received data is stored
  * Return:      Number of bytes received or a negative error code
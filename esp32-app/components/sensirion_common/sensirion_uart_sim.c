@@ -0,0 +1,273 @@
+#include <math.h>
+#include <string.h>
+
+#include "sensirion_uart_sim.h"
+#include "sensirion_common.h"
+
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+
+#define SHDLC_START 0x7E
+#define SHDLC_STOP 0x7E
+#define SHDLC_ESCAPE 0x7D
+
+#define SPS30_PERIOD_USEC 1000000
+
+/* start + (4 header + 255 data + checksum) * 2 + stop */
+#define SIM_MAX_FRAME_SIZE (2 + (4 + 255 + 1) * 2)
+
+typedef struct
+{
+    bool measuring;
+    bool sleeping;
+    bool woken; // The 0xFF byte that starts the wake-up sequence was received
+    int64_t next_sample_usec;
+    bool data_ready;
+    uint32_t auto_cleaning_interval;
+} sim_sps30_t;
+
+static sim_sps30_t s_device = {.auto_cleaning_interval = 604800};
+
+/* Response frame waiting to be read, s_response_offset bytes of it were read already */
+static uint8_t s_response[SIM_MAX_FRAME_SIZE];
+static uint16_t s_response_length;
+static uint16_t s_response_offset;
+
+/* Serializes the simulated device, the driver may be called from several tasks */
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t s_noise_state = 0x9E3779B9;
+
+/* xorshift32, returns a value in [-1, 1] */
+static float sim_noise(void)
+{
+    s_noise_state ^= s_noise_state << 13;
+    s_noise_state ^= s_noise_state >> 17;
+    s_noise_state ^= s_noise_state << 5;
+    return ((float)(s_noise_state & 0xFFFF) / 32767.5f) - 1.0f;
+}
+
+static float sim_wave(int64_t now_usec, float period_sec, float phase)
+{
+    return sinf(2.0f * (float)M_PI * ((float)now_usec / 1e6f / period_sec) + phase);
+}
+
+static void sim_update_data_ready(int64_t now_usec)
+{
+    if (s_device.measuring && now_usec >= s_device.next_sample_usec)
+    {
+        s_device.data_ready = true;
+        while (s_device.next_sample_usec <= now_usec)
+        {
+            s_device.next_sample_usec += SPS30_PERIOD_USEC;
+        }
+    }
+}
+
+static void sim_put_stuffed(uint16_t *length, uint8_t value)
+{
+    if (value == 0x11 || value == 0x13 || value == SHDLC_ESCAPE || value == SHDLC_START)
+    {
+        s_response[(*length)++] = SHDLC_ESCAPE;
+        value ^= 0x20;
+    }
+    s_response[(*length)++] = value;
+}
+
+/* Queue the MISO frame: address, command, state, length, data and the inverted byte sum */
+static void sim_respond(uint8_t address, uint8_t command, uint8_t state, const uint8_t *data, uint8_t data_len)
+{
+    uint8_t sum = address + command + state + data_len;
+    uint16_t length = 0;
+
+    s_response[length++] = SHDLC_START;
+    sim_put_stuffed(&length, address);
+    sim_put_stuffed(&length, command);
+    sim_put_stuffed(&length, state);
+    sim_put_stuffed(&length, data_len);
+    for (uint8_t i = 0; i < data_len; i++)
+    {
+        sim_put_stuffed(&length, data[i]);
+        sum += data[i];
+    }
+    sim_put_stuffed(&length, ~sum);
+    s_response[length++] = SHDLC_STOP;
+    s_response_length = length;
+    s_response_offset = 0;
+}
+
+/* Decodes a MOSI frame into address, command, length and data. Returns false if it is malformed,
+the real sensor does not answer in that case. */
+static bool sim_decode(const uint8_t *frame, uint16_t count, uint8_t *decoded, uint16_t *decoded_len)
+{
+    uint8_t sum = 0;
+    uint16_t length = 0;
+
+    if (count < 6 || frame[0] != SHDLC_START || frame[count - 1] != SHDLC_STOP)
+    {
+        return false;
+    }
+    for (uint16_t i = 1; i < count - 1; i++)
+    {
+        uint8_t value = frame[i];
+        if (value == SHDLC_ESCAPE)
+        {
+            if (++i == count - 1)
+            {
+                return false;
+            }
+            value = frame[i] ^ 0x20;
+        }
+        decoded[length++] = value;
+        sum += value;
+    }
+    /* Checksum included, the sum of all bytes is 0xFF. Length byte must match. */
+    if (length < 4 || sum != 0xFF || decoded[2] != length - 4)
+    {
+        return false;
+    }
+    *decoded_len = length;
+    return true;
+}
+
+static void sim_command(uint8_t address, uint8_t command, const uint8_t *data, uint8_t data_len, int64_t now_usec)
+{
+    uint8_t response[40];
+    uint8_t response_len = 0;
+
+    switch (command)
+    {
+    case 0x00: // start_measurement, sub command 0x01 and output format 0x03 (float)
+        if (data_len != 2 || data[0] != 0x01 || data[1] != 0x03)
+        {
+            sim_respond(address, command, 0x04, NULL, 0); // illegal command parameter
+            return;
+        }
+        s_device.measuring = true;
+        s_device.data_ready = false;
+        s_device.next_sample_usec = now_usec + SPS30_PERIOD_USEC;
+        break;
+    case 0x01: // stop_measurement
+        s_device.measuring = false;
+        break;
+    case 0x03: // read_measured_values, no data if there is no new measurement
+    {
+        if (!s_device.measuring)
+        {
+            sim_respond(address, command, 0x43, NULL, 0); // command not allowed in this state
+            return;
+        }
+        if (!s_device.data_ready)
+        {
+            break;
+        }
+        s_device.data_ready = false;
+        float pm2p5 = 9.0f + 6.0f * sim_wave(now_usec, 1800.0f, 0.3f) + 0.8f * sim_noise();
+        if (pm2p5 < 0.5f)
+        {
+            pm2p5 = 0.5f;
+        }
+        const float values[10] = {0.75f * pm2p5, pm2p5, 1.10f * pm2p5, 1.20f * pm2p5, 5.40f * pm2p5,
+                                  6.30f * pm2p5, 6.40f * pm2p5, 6.41f * pm2p5, 6.42f * pm2p5, 0.55f};
+        for (uint8_t i = 0; i < 10; i++)
+        {
+            sensirion_common_float_to_bytes(values[i], &response[4 * i]);
+        }
+        response_len = 40;
+        break;
+    }
+    case 0x10: // sleep, only from idle
+        if (s_device.measuring)
+        {
+            sim_respond(address, command, 0x43, NULL, 0);
+            return;
+        }
+        sim_respond(address, command, 0x00, NULL, 0);
+        s_device.sleeping = true;
+        return;
+    case 0x56: // start_fan_cleaning
+        break;
+    case 0x80: // read/write auto cleaning interval
+        if (data_len == 5)
+        {
+            s_device.auto_cleaning_interval = sensirion_common_bytes_to_uint32_t(&data[1]);
+            break;
+        }
+        sensirion_common_uint32_t_to_bytes(s_device.auto_cleaning_interval, response);
+        response_len = 4;
+        break;
+    case 0xD0: // device_information, the serial number is sub command 0x03
+    {
+        const char *text = (data_len == 1 && data[0] == 0x03) ? "SPS30SIM00000001" : "00080000";
+        response_len = strlen(text) + 1;
+        memcpy(response, text, response_len);
+        break;
+    }
+    case 0xD1: // read_version: firmware 2.2, hardware 7, SHDLC 2.0
+    {
+        const uint8_t version[] = {0x02, 0x02, 0x00, 0x07, 0x00, 0x02, 0x00};
+        memcpy(response, version, sizeof(version));
+        response_len = sizeof(version);
+        break;
+    }
+    case 0xD2: // read_device_status_register
+        memset(response, 0, 5);
+        response_len = 5;
+        break;
+    case 0xD3: // device_reset
+        s_device.measuring = false;
+        break;
+    default:
+        sim_respond(address, command, 0x02, NULL, 0); // unknown command
+        return;
+    }
+    sim_respond(address, command, 0x00, response, response_len);
+}
+
+int16_t sensirion_uart_sim_write(const uint8_t *data, uint16_t count)
+{
+    uint8_t decoded[SIM_MAX_FRAME_SIZE];
+    uint16_t decoded_len = 0;
+    bool wake_up_pulse = count == 1 && data[0] == 0xFF;
+    bool valid = !wake_up_pulse && sim_decode(data, count, decoded, &decoded_len);
+    int64_t now_usec = esp_timer_get_time();
+
+    portENTER_CRITICAL(&s_lock);
+    s_response_length = 0;
+    s_response_offset = 0;
+    if (wake_up_pulse)
+    {
+        /* The low pulse of the 0xFF byte wakes up the UART of a sleeping sensor */
+        s_device.woken = s_device.sleeping;
+    }
+    else if (valid && !s_device.sleeping)
+    {
+        sim_update_data_ready(now_usec);
+        sim_command(decoded[0], decoded[1], &decoded[3], decoded[2], now_usec);
+    }
+    else if (valid && s_device.woken && decoded[1] == 0x11)
+    {
+        s_device.sleeping = false;
+        s_device.woken = false;
+        sim_respond(decoded[0], decoded[1], 0x00, NULL, 0);
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    return count;
+}
+
+int16_t sensirion_uart_sim_read(uint8_t *data, uint16_t max_count)
+{
+    uint16_t count;
+
+    portENTER_CRITICAL(&s_lock);
+    count = s_response_length - s_response_offset;
+    if (count > max_count)
+    {
+        count = max_count;
+    }
+    memcpy(data, &s_response[s_response_offset], count);
+    s_response_offset += count;
+    portEXIT_CRITICAL(&s_lock);
+
+    return count;
+}
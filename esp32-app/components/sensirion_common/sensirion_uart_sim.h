@@ -0,0 +1,47 @@
+#ifndef SENSIRION_UART_SIM_H
+#define SENSIRION_UART_SIM_H
+
+#include "sensirion_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * Simulated SPS30 on the UART. The simulated device decodes the SHDLC frames
+ * sent by the driver, keeps the measurement state of the real sensor
+ * (measurement, sleep) and queues the response frame it would send back,
+ * stuffed and with a valid checksum, so that the SHDLC layer is exercised as
+ * on the wire. Measured values follow the same kind of slow cycles as the
+ * simulated I2C sensors.
+ *
+ * Enabled with CONFIG_SENSIRION_SIMULATED_SENSORS, in which case
+ * sensirion_uart_hal.c forwards every transfer to these functions instead of
+ * the UART driver.
+ */
+
+/**
+ * Handle bytes sent to the simulated device. Either a complete SHDLC frame or
+ * the single 0xFF byte that precedes the wake-up command.
+ *
+ * @param data  bytes sent
+ * @param count number of bytes in data
+ * @returns count, the simulated line never drops bytes
+ */
+int16_t sensirion_uart_sim_write(const uint8_t* data, uint16_t count);
+
+/**
+ * Take the next bytes of the pending response frame. A frame can be read in
+ * several parts.
+ *
+ * @param data      buffer where the response is stored
+ * @param max_count size of the buffer
+ * @returns number of bytes stored, 0 if the device did not respond (timeout)
+ */
+int16_t sensirion_uart_sim_read(uint8_t* data, uint16_t max_count);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* SENSIRION_UART_SIM_H */
@@ -0,0 +1,148 @@
+/* Exhaustive test and benchmark of the Sensirion CRC8 on Linux, built once per
+ * CONFIG_SENSIRION_CRC8_IMPLEMENTATION choice.
+ *
+ *   sensirion_crc8_test unit
+ *   sensirion_crc8_test bench [rounds]
+ *
+ * The unit test compares sensirion_i2c_generate_crc_word() and
+ * sensirion_i2c_generate_crc() with the bitwise algorithm of the datasheet for
+ * all 65536 words, and for random buffers of every length up to 64 bytes. The
+ * benchmark prints the time per word of the configured implementation and of
+ * the bitwise algorithm, in TSC cycles too on x86. */
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TEST_HAVE_TSC 1
+#endif
+
+#include "host_test.h"
+#include "sensirion_common.h"
+#include "sensirion_i2c.h"
+
+#define TEST_BENCH_WORDS 4096
+
+/* The algorithm of the datasheet, what CONFIG_SENSIRION_CRC8_BITWISE builds */
+static uint8_t reference_crc(const uint8_t* data, uint16_t count) {
+    uint8_t crc = CRC8_INIT;
+
+    for (uint16_t i = 0; i < count; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++)
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ CRC8_POLYNOMIAL)
+                               : (uint8_t)(crc << 1);
+    }
+    return crc;
+}
+
+static uint64_t test_cycles(void) {
+#ifdef TEST_HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static void test_unit_datasheet(void) {
+    /* Example of the SCD4x and SHT datasheets */
+    static const uint8_t word[SENSIRION_WORD_SIZE] = {0xBE, 0xEF};
+
+    HOST_CHECK_EQUAL(sensirion_i2c_generate_crc_word(word), 0x92);
+    HOST_CHECK_EQUAL(sensirion_i2c_generate_crc(word, sizeof(word)), 0x92);
+    HOST_CHECK_EQUAL(sensirion_i2c_check_crc(word, sizeof(word), 0x92),
+                     NO_ERROR);
+    HOST_CHECK_EQUAL(sensirion_i2c_check_crc(word, sizeof(word), 0x93),
+                     CRC_ERROR);
+    HOST_CHECK_EQUAL(sensirion_i2c_generate_crc(word, 0), CRC8_INIT);
+}
+
+static void test_unit_all_words(void) {
+    for (uint32_t value = 0; value <= 0xFFFF; value++) {
+        const uint8_t word[SENSIRION_WORD_SIZE] = {(uint8_t)(value >> 8),
+                                                   (uint8_t)value};
+        uint8_t expected = reference_crc(word, sizeof(word));
+
+        HOST_CHECK_EQUAL(sensirion_i2c_generate_crc_word(word), expected);
+        HOST_CHECK_EQUAL(sensirion_i2c_generate_crc(word, sizeof(word)),
+                         expected);
+        HOST_CHECK_EQUAL(sensirion_i2c_check_crc(word, sizeof(word), expected),
+                         NO_ERROR);
+        HOST_CHECK_EQUAL(
+            sensirion_i2c_check_crc(word, sizeof(word), expected ^ 0x01),
+            CRC_ERROR);
+    }
+}
+
+static void test_unit_buffers(void) {
+    uint32_t random = 0x5EED;
+    uint8_t buffer[64];
+
+    for (int round = 0; round < 1000; round++) {
+        for (size_t i = 0; i < sizeof(buffer); i++)
+            buffer[i] = (uint8_t)host_test_random(&random);
+        for (uint16_t count = 0; count <= sizeof(buffer); count++)
+            HOST_CHECK_EQUAL(sensirion_i2c_generate_crc(buffer, count),
+                             reference_crc(buffer, count));
+    }
+}
+
+static int test_bench(unsigned long rounds) {
+    static uint8_t words[TEST_BENCH_WORDS][SENSIRION_WORD_SIZE];
+    uint32_t random = 0xC0FFEE;
+    volatile uint8_t sink = 0;
+    uint8_t crc = 0;
+
+    for (size_t i = 0; i < TEST_BENCH_WORDS; i++) {
+        words[i][0] = (uint8_t)host_test_random(&random);
+        words[i][1] = (uint8_t)host_test_random(&random);
+    }
+
+    uint64_t start_ns = host_test_now_ns();
+    uint64_t start_cycles = test_cycles();
+    for (unsigned long round = 0; round < rounds; round++)
+        for (size_t i = 0; i < TEST_BENCH_WORDS; i++)
+            crc ^= sensirion_i2c_generate_crc_word(words[i]);
+    uint64_t word_cycles = test_cycles() - start_cycles;
+    uint64_t word_ns = host_test_now_ns() - start_ns;
+    sink = crc;
+
+    start_ns = host_test_now_ns();
+    start_cycles = test_cycles();
+    for (unsigned long round = 0; round < rounds; round++)
+        for (size_t i = 0; i < TEST_BENCH_WORDS; i++)
+            crc ^= reference_crc(words[i], SENSIRION_WORD_SIZE);
+    uint64_t reference_cycles = test_cycles() - start_cycles;
+    uint64_t reference_ns = host_test_now_ns() - start_ns;
+    sink = crc;
+    (void)sink;
+
+    double total = (double)rounds * TEST_BENCH_WORDS;
+    printf("%lu words: generate_crc_word %.2f ns/word", (unsigned long)total,
+           word_ns / total);
+#ifdef TEST_HAVE_TSC
+    printf(" %.2f cycles/word", word_cycles / total);
+#endif
+    printf(", bitwise %.2f ns/word", reference_ns / total);
+#ifdef TEST_HAVE_TSC
+    printf(" %.2f cycles/word", reference_cycles / total);
+#endif
+    printf("\n");
+    (void)word_cycles;
+    (void)reference_cycles;
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv) {
+    if (argc >= 2 && strcmp(argv[1], "unit") == 0) {
+        test_unit_datasheet();
+        test_unit_all_words();
+        test_unit_buffers();
+        printf("CRC8 unit tests passed\n");
+        return EXIT_SUCCESS;
+    }
+    if (argc >= 2 && strcmp(argv[1], "bench") == 0)
+        return test_bench(host_test_arg(argc, argv, 2, 2000));
+    fprintf(stderr, "usage: %s unit | bench [rounds]\n", argv[0]);
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,837 @@
+/* Tests, fuzzing and benchmark of the streaming SHDLC decoder and of the byte
+ * stuffing on Linux. The UART HAL is a scripted line: what the driver sends is
+ * recorded, what it receives is handed over in random pieces.
+ *
+ *   sensirion_shdlc_test unit
+ *   sensirion_shdlc_test stuffing
+ *   sensirion_shdlc_test fuzz [iterations]
+ *   sensirion_shdlc_test bench [rounds]
+ *
+ * The unit test decodes frames of every length split in every way, several
+ * frames in one buffer, every error, and checks that sensirion_shdlc_xcv()
+ * skips stale responses of any length. The stuffing test checks the word at a
+ * time stuffing and unstuffing against the byte switch of the original driver:
+ * the clean word test on all 2^32 words, every pair of bytes at every
+ * alignment, random data of every length. The fuzzer feeds mutated frames, line
+ * noise and random pieces: the decoder must never write past its buffer, must
+ * always make progress and must decode the intact frame that follows. The
+ * benchmark prints the decoding and stuffing throughput for a few frame shapes,
+ * next to the whole frame decoder and the stuffing of the original Sensirion
+ * driver. */
+
+#include <string.h>
+
+#include "host_test.h"
+#include "sensirion_common.h"
+#include "sensirion_uart_hal.h"
+
+/* The source itself, to test its static stuffing functions directly */
+#include "sensirion_shdlc.c"
+
+#define TEST_SHDLC_START 0x7e
+#define TEST_SHDLC_ESCAPE 0x7d
+
+/* start + (4 header + 255 data + checksum) * 2 + stop */
+#define TEST_MAX_FRAME (2 + (4 + 255 + 1) * 2)
+#define TEST_MAX_LINE (4 * TEST_MAX_FRAME)
+#define TEST_MAX_NOISE 16
+
+#define TEST_BENCH_FRAMES 64
+
+/* The scripted line behind the UART HAL */
+static uint8_t s_line[TEST_MAX_LINE];
+static uint16_t s_line_length;
+static uint16_t s_line_offset;
+static uint8_t s_sent[TEST_MAX_FRAME];
+static uint16_t s_sent_length;
+static uint32_t s_random = 0x5D1C;
+
+int16_t sensirion_uart_hal_init() {
+    return 0;
+}
+
+int16_t sensirion_uart_hal_free() {
+    return 0;
+}
+
+int16_t sensirion_uart_hal_tx(uint16_t data_len, const uint8_t* data) {
+    HOST_CHECK(data_len <= sizeof(s_sent));
+    memcpy(s_sent, data, data_len);
+    s_sent_length = data_len;
+    return data_len;
+}
+
+/* Whatever arrived so far, a random part of what is left. 0 at the end, as
+ * after the timeout. */
+int16_t sensirion_uart_hal_rx(uint16_t max_data_len, uint8_t* data) {
+    uint16_t count = 1 + host_test_random(&s_random) % max_data_len;
+
+    if (count > s_line_length - s_line_offset)
+        count = s_line_length - s_line_offset;
+    memcpy(data, &s_line[s_line_offset], count);
+    s_line_offset += count;
+    return count;
+}
+
+void sensirion_uart_hal_sleep_usec(uint32_t useconds) {
+    (void)useconds;
+}
+
+/* The byte stuffing of the original Sensirion driver */
+static uint16_t reference_stuff_data(uint8_t data_len, const uint8_t* data,
+                                     uint8_t* stuffed_data) {
+    uint16_t output_data_len = 0;
+
+    while (data_len--) {
+        uint8_t c = *(data++);
+        switch (c) {
+            case 0x11:
+            case 0x13:
+            case 0x7d:
+            case 0x7e:
+                *(stuffed_data++) = 0x7d;
+                *(stuffed_data++) = c ^ (1 << 5);
+                output_data_len += 2;
+                break;
+            default:
+                *(stuffed_data++) = c;
+                output_data_len += 1;
+        }
+    }
+    return output_data_len;
+}
+
+static uint8_t reference_unstuff_byte(uint8_t data) {
+    switch (data) {
+        case 0x31:
+            return 0x11;
+        case 0x33:
+            return 0x13;
+        case 0x5d:
+            return 0x7d;
+        case 0x5e:
+            return 0x7e;
+        default:
+            return data;
+    }
+}
+
+/* The whole frame decoder of the original Sensirion driver, without its
+ * checks of the frame length: a complete frame from start to stop byte */
+static int16_t reference_decode(const uint8_t* frame, uint16_t len,
+                                struct sensirion_shdlc_rx_header* rxh,
+                                uint8_t* data) {
+    uint8_t* rx_header = (uint8_t*)rxh;
+    uint8_t sum = 0;
+    uint16_t i = 1;
+    uint16_t j;
+
+    if (frame[0] != TEST_SHDLC_START)
+        return SENSIRION_SHDLC_ERR_MISSING_START;
+    for (j = 0; j < sizeof(*rxh); j++) {
+        uint8_t c = frame[i++];
+        rx_header[j] = c == TEST_SHDLC_ESCAPE ? reference_unstuff_byte(frame[i++])
+                                              : c;
+        sum += rx_header[j];
+    }
+    for (j = 0; j < rxh->data_len; j++) {
+        uint8_t c = frame[i++];
+        data[j] = c == TEST_SHDLC_ESCAPE ? reference_unstuff_byte(frame[i++]) : c;
+        sum += data[j];
+    }
+    uint8_t crc = frame[i++];
+    if (crc == TEST_SHDLC_ESCAPE)
+        crc = reference_unstuff_byte(frame[i++]);
+    if ((uint8_t)(sum + crc) != 0xFF)
+        return SENSIRION_SHDLC_ERR_CRC_MISMATCH;
+    if (i >= len || frame[i] != TEST_SHDLC_START)
+        return SENSIRION_SHDLC_ERR_MISSING_STOP;
+    return (0x7F & rxh->state) ? SENSIRION_SHDLC_ERR_EXECUTION_FAILURE : 0;
+}
+
+/* A MISO frame as the sensor sends it */
+static uint16_t test_encode(const struct sensirion_shdlc_rx_header* header,
+                            const uint8_t* data, uint8_t* frame) {
+    uint16_t len = 0;
+    uint8_t sum = header->addr + header->cmd + header->state + header->data_len;
+
+    for (uint8_t i = 0; i < header->data_len; i++)
+        sum += data[i];
+    sum = ~sum;
+
+    frame[len++] = TEST_SHDLC_START;
+    len += reference_stuff_data(sizeof(*header), (const uint8_t*)header,
+                                &frame[len]);
+    len += reference_stuff_data(header->data_len, data, &frame[len]);
+    len += reference_stuff_data(1, &sum, &frame[len]);
+    frame[len++] = TEST_SHDLC_START;
+    return len;
+}
+
+/* Random data, special bytes one time in four when rich */
+static void test_random_data(uint8_t* data, uint16_t len, bool rich) {
+    static const uint8_t special[] = {0x11, 0x13, 0x7d, 0x7e};
+
+    for (uint16_t i = 0; i < len; i++) {
+        uint32_t r = host_test_random(&s_random);
+        data[i] = rich && (r & 0x300) == 0 ? special[r & 3] : (uint8_t)r;
+    }
+}
+
+static void test_random_frame(struct sensirion_shdlc_rx_header* header,
+                              uint8_t* data, uint8_t max_len) {
+    header->addr = (uint8_t)host_test_random(&s_random);
+    header->cmd = (uint8_t)host_test_random(&s_random);
+    header->state = host_test_random(&s_random) % 8 == 0
+                        ? (uint8_t)host_test_random(&s_random)
+                        : 0;
+    header->data_len = host_test_random(&s_random) % (max_len + 1);
+    test_random_data(data, header->data_len, host_test_random(&s_random) & 1);
+}
+
+static void test_check_frame(const struct sensirion_shdlc_decoder* decoder,
+                             const struct sensirion_shdlc_rx_header* header,
+                             const uint8_t* data) {
+    HOST_CHECK(memcmp(&decoder->header, header, sizeof(*header)) == 0);
+    HOST_CHECK(memcmp(decoder->data, data, header->data_len) == 0);
+}
+
+static int16_t test_expected(const struct sensirion_shdlc_rx_header* header) {
+    return (0x7F & header->state) ? SENSIRION_SHDLC_ERR_EXECUTION_FAILURE : 0;
+}
+
+/* Empties the line and the bytes the driver kept of it */
+static void test_line_reset(void) {
+    struct sensirion_shdlc_rx_header header;
+    uint8_t data[255];
+
+    s_line_length = 0;
+    s_line_offset = 0;
+    while (sensirion_shdlc_rx(sizeof(data), &header, data) !=
+           SENSIRION_SHDLC_ERR_MISSING_START)
+        ;
+}
+
+static void test_line_append(const uint8_t* bytes, uint16_t len) {
+    HOST_CHECK(s_line_length + len <= sizeof(s_line));
+    memcpy(&s_line[s_line_length], bytes, len);
+    s_line_length += len;
+}
+
+static void test_unit_lengths(void) {
+    struct sensirion_shdlc_rx_header header = {.addr = 0, .cmd = 0x03};
+    struct sensirion_shdlc_decoder decoder;
+    uint8_t data[255];
+    uint8_t decoded[255];
+    uint8_t frame[TEST_MAX_FRAME];
+    uint16_t consumed;
+
+    for (int rich = 0; rich < 2; rich++) {
+        for (uint16_t len = 0; len <= 255; len++) {
+            header.data_len = len;
+            test_random_data(data, len, rich);
+            uint16_t frame_len = test_encode(&header, data, frame);
+
+            /* At once */
+            sensirion_shdlc_decoder_init(&decoder, decoded, sizeof(decoded));
+            HOST_CHECK_EQUAL(sensirion_shdlc_decoder_feed(&decoder, frame,
+                                                          frame_len, &consumed),
+                             0);
+            HOST_CHECK_EQUAL(consumed, frame_len);
+            test_check_frame(&decoder, &header, data);
+
+            /* A byte at a time */
+            sensirion_shdlc_decoder_init(&decoder, decoded, len);
+            for (uint16_t i = 0; i < frame_len; i++) {
+                int16_t ret = sensirion_shdlc_decoder_feed(&decoder, &frame[i],
+                                                           1, &consumed);
+                HOST_CHECK_EQUAL(consumed, 1);
+                HOST_CHECK_EQUAL(ret, i + 1 < frame_len
+                                          ? SENSIRION_SHDLC_DECODER_INCOMPLETE
+                                          : 0);
+            }
+            test_check_frame(&decoder, &header, data);
+
+            /* In two parts, split everywhere */
+            for (uint16_t split = 1; len <= 40 && split < frame_len; split++) {
+                sensirion_shdlc_decoder_init(&decoder, decoded, len);
+                HOST_CHECK_EQUAL(
+                    sensirion_shdlc_decoder_feed(&decoder, frame, split,
+                                                 &consumed),
+                    SENSIRION_SHDLC_DECODER_INCOMPLETE);
+                HOST_CHECK_EQUAL(sensirion_shdlc_decoder_feed(
+                                     &decoder, &frame[split], frame_len - split,
+                                     &consumed),
+                                 0);
+                HOST_CHECK_EQUAL(consumed, frame_len - split);
+                test_check_frame(&decoder, &header, data);
+            }
+        }
+    }
+}
+
+static void test_unit_stream(void) {
+    struct sensirion_shdlc_rx_header first = {0, 0xD0, 0x00, 17};
+    struct sensirion_shdlc_rx_header second = {0, 0x03, 0x43, 0};
+    struct sensirion_shdlc_decoder decoder;
+    uint8_t data[17] = "SPS30SIM00000001";
+    uint8_t decoded[32];
+    uint8_t line[2 * TEST_MAX_FRAME + TEST_MAX_NOISE];
+    uint16_t len = 0;
+    uint16_t consumed;
+
+    /* Noise, two frames back to back, the state of the second is an error */
+    memcpy(line, "\x00\xff\x13\x7d", 4);
+    len = 4;
+    len += test_encode(&first, data, &line[len]);
+    uint16_t first_end = len;
+    len += test_encode(&second, NULL, &line[len]);
+
+    sensirion_shdlc_decoder_init(&decoder, decoded, sizeof(decoded));
+    HOST_CHECK_EQUAL(sensirion_shdlc_decoder_feed(&decoder, line, len, &consumed),
+                     0);
+    HOST_CHECK_EQUAL(consumed, first_end);
+    test_check_frame(&decoder, &first, data);
+    HOST_CHECK_EQUAL(sensirion_shdlc_decoder_feed(&decoder, &line[first_end],
+                                                  len - first_end, &consumed),
+                     SENSIRION_SHDLC_ERR_EXECUTION_FAILURE);
+    HOST_CHECK_EQUAL(consumed, len - first_end);
+    HOST_CHECK(memcmp(&decoder.header, &second, sizeof(second)) == 0);
+
+    /* Bit 7 of the state only flags a warning */
+    second.state = 0x80;
+    len = test_encode(&second, NULL, line);
+    HOST_CHECK_EQUAL(sensirion_shdlc_decoder_feed(&decoder, line, len, &consumed),
+                     0);
+}
+
+static void test_unit_errors(void) {
+    struct sensirion_shdlc_rx_header header = {0, 0x03, 0x00, 8};
+    struct sensirion_shdlc_decoder decoder;
+    uint8_t data[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    uint8_t decoded[8];
+    uint8_t frame[TEST_MAX_FRAME];
+    uint8_t line[2 * TEST_MAX_FRAME];
+    uint16_t len = test_encode(&header, data, frame);
+    uint16_t consumed;
+
+    sensirion_shdlc_decoder_init(&decoder, decoded, sizeof(decoded));
+
+    /* Checksum */
+    memcpy(line, frame, len);
+    line[len - 2] ^= 0x01;
+    HOST_CHECK_EQUAL(sensirion_shdlc_decoder_feed(&decoder, line, len, &consumed),
+                     SENSIRION_SHDLC_ERR_CRC_MISMATCH);
+
+    /* No stop byte after the checksum */
+    memcpy(line, frame, len);
+    line[len - 1] = 0x00;
+    HOST_CHECK_EQUAL(sensirion_shdlc_decoder_feed(&decoder, line, len, &consumed),
+                     SENSIRION_SHDLC_ERR_MISSING_STOP);
+    HOST_CHECK_EQUAL(consumed, len);
+
+    /* More data than the buffer holds, not a byte of it is written */
+    sensirion_shdlc_decoder_init(&decoder, decoded, 4);
+    memset(decoded, 0xAA, sizeof(decoded));
+    HOST_CHECK_EQUAL(sensirion_shdlc_decoder_feed(&decoder, frame, len, &consumed),
+                     SENSIRION_SHDLC_ERR_FRAME_TOO_LONG);
+    HOST_CHECK_EQUAL(consumed, 5);
+    HOST_CHECK_EQUAL(decoded[0], 0xAA);
+    /* The rest of it is skipped up to the next frame */
+    memcpy(line, &frame[consumed], len - consumed);
+    header.data_len = 2;
+    uint16_t line_len = len - consumed;
+    line_len += test_encode(&header, data, &line[line_len]);
+    HOST_CHECK_EQUAL(
+        sensirion_shdlc_decoder_feed(&decoder, line, line_len, &consumed), 0);
+    HOST_CHECK_EQUAL(consumed, line_len);
+    test_check_frame(&decoder, &header, data);
+
+    /* Cut short by the start of the next frame, which is then decoded */
+    sensirion_shdlc_decoder_init(&decoder, decoded, sizeof(decoded));
+    memcpy(line, frame, len - 4);
+    line_len = len - 4;
+    line_len += test_encode(&header, data, &line[line_len]);
+    HOST_CHECK_EQUAL(
+        sensirion_shdlc_decoder_feed(&decoder, line, line_len, &consumed),
+        SENSIRION_SHDLC_ERR_ENCODING_ERROR);
+    HOST_CHECK_EQUAL(consumed, len - 3);
+    HOST_CHECK_EQUAL(sensirion_shdlc_decoder_feed(&decoder, &line[consumed],
+                                                  line_len - consumed,
+                                                  &consumed),
+                     0);
+    test_check_frame(&decoder, &header, data);
+}
+
+static void test_unit_xcv(void) {
+    struct sensirion_shdlc_rx_header stale_long = {0, 0x03, 0x00, 40};
+    struct sensirion_shdlc_rx_header stale_error = {0, 0x01, 0x43, 0};
+    struct sensirion_shdlc_rx_header other_addr = {1, 0xD1, 0x00, 7};
+    struct sensirion_shdlc_rx_header response = {0, 0xD1, 0x00, 7};
+    struct sensirion_shdlc_rx_header header;
+    uint8_t data[40];
+    uint8_t version[7] = {2, 2, 0, 7, 0, 2, 0};
+    uint8_t received[7];
+    uint8_t frame[TEST_MAX_FRAME];
+    const uint8_t subcmd = 0x7e;
+
+    test_random_data(data, sizeof(data), true);
+    for (int round = 0; round < 1000; round++) {
+        test_line_reset();
+        /* Late responses to earlier commands, one longer than the buffer,
+         * and one from another device */
+        test_line_append(frame, test_encode(&stale_long, data, frame));
+        test_line_append(frame, test_encode(&stale_error, NULL, frame));
+        test_line_append(frame, test_encode(&other_addr, data, frame));
+        test_line_append(frame, test_encode(&response, version, frame));
+
+        HOST_CHECK_EQUAL(sensirion_shdlc_xcv(0, 0xD1, 1, &subcmd,
+                                             sizeof(received), &header,
+                                             received),
+                         0);
+        HOST_CHECK(memcmp(&header, &response, sizeof(header)) == 0);
+        HOST_CHECK(memcmp(received, version, sizeof(version)) == 0);
+        HOST_CHECK_EQUAL(s_line_offset, s_line_length);
+
+        /* The request: no state byte, the sub command is stuffed */
+        const uint8_t expected[] = {0x7e, 0x00, 0xd1, 0x01, 0x7d,
+                                    0x5e, 0xaf, 0x7e};
+        HOST_CHECK_EQUAL(s_sent_length, sizeof(expected));
+        HOST_CHECK(memcmp(s_sent, expected, sizeof(expected)) == 0);
+    }
+
+    /* The response itself too long is an error */
+    test_line_reset();
+    test_line_append(frame, test_encode(&stale_long, data, frame));
+    HOST_CHECK_EQUAL(sensirion_shdlc_xcv(0, 0x03, 0, NULL, 8, &header, data),
+                     SENSIRION_SHDLC_ERR_FRAME_TOO_LONG);
+
+    /* Nothing, then only the start of a response */
+    test_line_reset();
+    HOST_CHECK_EQUAL(sensirion_shdlc_xcv(0, 0xD1, 0, NULL, sizeof(received),
+                                         &header, received),
+                     SENSIRION_SHDLC_ERR_MISSING_START);
+    test_line_append(frame, test_encode(&response, version, frame) - 3);
+    HOST_CHECK_EQUAL(sensirion_shdlc_xcv(0, 0xD1, 0, NULL, sizeof(received),
+                                         &header, received),
+                     SENSIRION_SHDLC_ERR_MISSING_STOP);
+    test_line_reset();
+}
+
+static bool reference_needs_stuffing(uint8_t c) {
+    switch (c) {
+        case 0x11:
+        case 0x13:
+        case 0x7d:
+        case 0x7e:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/* The clean word test against four byte tests, for all 2^32 words */
+static void test_stuffing_words(void) {
+    static bool clean_half[0x10000];
+    uint64_t clean = 0;
+    uint32_t mismatches = 0;
+
+    for (uint32_t half = 0; half < 0x10000; half++)
+        clean_half[half] = !reference_needs_stuffing((uint8_t)half) &&
+                           !reference_needs_stuffing((uint8_t)(half >> 8));
+    for (uint32_t high = 0; high < 0x10000; high++) {
+        for (uint32_t low = 0; low < 0x10000; low++) {
+            bool expected = clean_half[high] && clean_half[low];
+            mismatches +=
+                sensirion_shdlc_word_is_clean(high << 16 | low) != expected;
+            clean += expected;
+        }
+    }
+    HOST_CHECK_EQUAL(mismatches, 0);
+    /* 252 of 256 byte values are not escaped */
+    HOST_CHECK_EQUAL(clean, 252ull * 252 * 252 * 252);
+}
+
+static void test_stuffing_check(const uint8_t* data, uint8_t len) {
+    uint8_t stuffed[2 * 255];
+    uint8_t expected[2 * 255];
+
+    uint16_t stuffed_len = sensirion_shdlc_stuff_data(len, data, stuffed);
+    HOST_CHECK_EQUAL(stuffed_len, reference_stuff_data(len, data, expected));
+    HOST_CHECK(memcmp(stuffed, expected, stuffed_len) == 0);
+}
+
+/* Checks a frame with data against the original decoder, given at once and
+ * in pieces of 5 bytes, so that words straddle the reads */
+static void test_unstuffing_check(struct sensirion_shdlc_rx_header* header,
+                                  const uint8_t* data) {
+    struct sensirion_shdlc_rx_header expected_header;
+    struct sensirion_shdlc_decoder decoder;
+    uint8_t frame[TEST_MAX_FRAME];
+    uint8_t expected[255];
+    uint8_t decoded[255];
+    uint16_t consumed;
+
+    uint16_t len = test_encode(header, data, frame);
+    HOST_CHECK_EQUAL(reference_decode(frame, len, &expected_header, expected),
+                     0);
+    HOST_CHECK(memcmp(&expected_header, header, sizeof(*header)) == 0);
+    HOST_CHECK(memcmp(expected, data, header->data_len) == 0);
+
+    sensirion_shdlc_decoder_init(&decoder, decoded, header->data_len);
+    HOST_CHECK_EQUAL(
+        sensirion_shdlc_decoder_feed(&decoder, frame, len, &consumed), 0);
+    HOST_CHECK_EQUAL(consumed, len);
+    test_check_frame(&decoder, &expected_header, expected);
+
+    sensirion_shdlc_decoder_init(&decoder, decoded, header->data_len);
+    for (uint16_t offset = 0; offset < len; offset += consumed) {
+        uint16_t piece = len - offset < 5 ? len - offset : 5;
+        int16_t ret = sensirion_shdlc_decoder_feed(&decoder, &frame[offset],
+                                                   piece, &consumed);
+        HOST_CHECK_EQUAL(consumed, piece);
+        HOST_CHECK_EQUAL(ret, offset + piece < len
+                                  ? SENSIRION_SHDLC_DECODER_INCOMPLETE
+                                  : 0);
+    }
+    test_check_frame(&decoder, &expected_header, expected);
+}
+
+/* Every pair of byte values at every position of 12 bytes, which puts it at
+ * every alignment to the words and right before and after escapes, stuffed
+ * and unstuffed */
+static void test_stuffing_pairs(void) {
+    struct sensirion_shdlc_rx_header header = {0, 0x03, 0x00, 12};
+    uint8_t buffer[12 + 3];
+
+    for (uint32_t pair = 0; pair < 0x10000; pair++) {
+        for (int align = 0; align < 4; align++) {
+            uint8_t* data = &buffer[align];
+
+            for (uint8_t at = 0; at + 1 < header.data_len; at++) {
+                memset(buffer, 0x55, sizeof(buffer));
+                data[at] = (uint8_t)(pair >> 8);
+                data[at + 1] = (uint8_t)pair;
+                test_stuffing_check(data, header.data_len);
+                if (align == 0)
+                    test_unstuffing_check(&header, data);
+            }
+        }
+    }
+}
+
+/* Random data of every length, clean and rich in special bytes */
+static void test_stuffing_lengths(void) {
+    struct sensirion_shdlc_rx_header header;
+    uint8_t data[255];
+
+    for (int round = 0; round < 100; round++) {
+        for (uint16_t len = 0; len <= 255; len++) {
+            for (int rich = 0; rich < 2; rich++) {
+                test_random_data(data, len, rich);
+                test_stuffing_check(data, (uint8_t)len);
+                test_random_frame(&header, data, 255);
+                header.state = 0;
+                test_unstuffing_check(&header, data);
+            }
+        }
+    }
+}
+
+/* A frame built with sensirion_shdlc_add_bytes_to_frame() against one built
+ * byte by byte with the original stuffing, longer than 255 bytes too */
+static void test_stuffing_frames(void) {
+    static uint8_t buffer[2 * 1024 + 8];
+    static uint8_t expected[2 * 1024 + 8];
+    struct sensirion_shdlc_buffer tx_frame;
+    uint8_t data[1024];
+
+    for (int round = 0; round < 2000; round++) {
+        uint16_t data_len = host_test_random(&s_random) % (sizeof(data) + 1);
+        uint16_t len = 0;
+        uint8_t sum = 0;
+
+        test_random_data(data, data_len, round & 1);
+        sensirion_shdlc_begin_frame(&tx_frame, buffer, 0x7e, 0x11, 0x13);
+        sensirion_shdlc_add_bytes_to_frame(&tx_frame, data, data_len);
+        sensirion_shdlc_finish_frame(&tx_frame);
+
+        const uint8_t header[] = {0x11, 0x7e, 0x13};
+        expected[len++] = TEST_SHDLC_START;
+        for (uint16_t i = 0; i < sizeof(header); i++) {
+            len += reference_stuff_data(1, &header[i], &expected[len]);
+            sum += header[i];
+        }
+        for (uint16_t i = 0; i < data_len; i++) {
+            len += reference_stuff_data(1, &data[i], &expected[len]);
+            sum += data[i];
+        }
+        sum = ~sum;
+        len += reference_stuff_data(1, &sum, &expected[len]);
+        expected[len++] = TEST_SHDLC_START;
+
+        HOST_CHECK_EQUAL(tx_frame.offset, len);
+        HOST_CHECK(memcmp(buffer, expected, len) == 0);
+    }
+}
+
+/* Damages a frame in place, returns the new length */
+static uint16_t test_mutate(uint8_t* frame, uint16_t len, uint32_t* kinds) {
+    uint16_t at = host_test_random(&s_random) % len;
+    uint32_t kind = host_test_random(&s_random) % 6;
+
+    kinds[kind]++;
+    switch (kind) {
+        case 0: /* intact */
+            break;
+        case 1: /* a bit flipped */
+            frame[at] ^= 1 << (host_test_random(&s_random) % 8);
+            break;
+        case 2: /* a byte lost */
+            memmove(&frame[at], &frame[at + 1], len - at - 1);
+            len--;
+            break;
+        case 3: /* a byte more */
+            memmove(&frame[at + 1], &frame[at], len - at);
+            frame[at] = (uint8_t)host_test_random(&s_random);
+            len++;
+            break;
+        case 4: /* cut short */
+            len = at;
+            break;
+        default: /* garbage */
+            len = host_test_random(&s_random) % len;
+            for (uint16_t i = 0; i < len; i++)
+                frame[i] = (uint8_t)host_test_random(&s_random);
+            break;
+    }
+    return len;
+}
+
+static void test_fuzz(unsigned long iterations) {
+    static const char* const kind_names[] = {"intact", "bit flip", "lost",
+                                             "inserted", "cut", "garbage"};
+    uint32_t kinds[6] = {0};
+    uint32_t results[10] = {0};
+    struct sensirion_shdlc_rx_header header;
+    struct sensirion_shdlc_rx_header damaged_header;
+    struct sensirion_shdlc_decoder decoder;
+    uint8_t data[255];
+    uint8_t damaged_data[255];
+    uint8_t stream[3 * TEST_MAX_FRAME];
+
+    for (unsigned long iteration = 0; iteration < iterations; iteration++) {
+        uint8_t max_len = host_test_random(&s_random) % 4 == 0
+                              ? (uint8_t)host_test_random(&s_random)
+                              : 64;
+        /* Exactly the size given to the decoder, a write past it is caught by
+         * the address sanitizer */
+        uint8_t* decoded = malloc(max_len ? max_len : 1);
+        uint16_t len = 0;
+        uint16_t offset = 0;
+        int16_t last = SENSIRION_SHDLC_DECODER_INCOMPLETE;
+        bool damaged_intact = false;
+
+        HOST_CHECK(decoded != NULL);
+        /* Noise without a start byte, a damaged frame, an intact frame */
+        uint16_t noise = host_test_random(&s_random) % TEST_MAX_NOISE;
+        for (; len < noise; len++) {
+            do
+                stream[len] = (uint8_t)host_test_random(&s_random);
+            while (stream[len] == TEST_SHDLC_START);
+        }
+        test_random_frame(&damaged_header, damaged_data, 255);
+        uint16_t damaged_len = test_encode(&damaged_header, damaged_data,
+                                           &stream[len]);
+        uint32_t intact_before = kinds[0];
+        damaged_len = test_mutate(&stream[len], damaged_len, kinds);
+        damaged_intact = kinds[0] != intact_before;
+        len += damaged_len;
+        /* An extra start byte ends whatever the damaged frame left open */
+        stream[len++] = TEST_SHDLC_START;
+        test_random_frame(&header, data, max_len);
+        len += test_encode(&header, data, &stream[len]);
+
+        sensirion_shdlc_decoder_init(&decoder, decoded, max_len);
+        bool damaged_seen = false;
+        while (offset < len) {
+            uint16_t piece = 1 + host_test_random(&s_random) % 48;
+            uint16_t consumed;
+
+            if (piece > len - offset)
+                piece = len - offset;
+            int16_t ret = sensirion_shdlc_decoder_feed(&decoder, &stream[offset],
+                                                       piece, &consumed);
+            HOST_CHECK(consumed <= piece);
+            if (ret == SENSIRION_SHDLC_DECODER_INCOMPLETE) {
+                HOST_CHECK_EQUAL(consumed, piece);
+            } else {
+                /* Progress on every result, or the caller loops forever */
+                HOST_CHECK(consumed > 0);
+                results[-ret + 1]++;
+                if (ret == 0 || ret == SENSIRION_SHDLC_ERR_EXECUTION_FAILURE) {
+                    HOST_CHECK(decoder.header.data_len <= max_len);
+                    if (damaged_intact && !damaged_seen &&
+                        damaged_header.data_len <= max_len) {
+                        /* An intact damaged frame is just a frame */
+                        HOST_CHECK_EQUAL(ret, test_expected(&damaged_header));
+                        test_check_frame(&decoder, &damaged_header,
+                                         damaged_data);
+                    }
+                }
+                damaged_seen = true;
+            }
+            last = ret;
+            offset += consumed;
+        }
+
+        /* Whatever came before, the last frame is decoded */
+        HOST_CHECK_EQUAL(last, test_expected(&header));
+        test_check_frame(&decoder, &header, data);
+        free(decoded);
+    }
+
+    printf("%lu streams:", iterations);
+    for (int i = 0; i < 6; i++)
+        printf(" %s %u", kind_names[i], kinds[i]);
+    printf("\nresults: ok %u, missing stop %u, crc %u, encoding %u, too long "
+           "%u, execution failure %u\n",
+           results[1], results[4], results[5], results[6], results[8],
+           results[9]);
+}
+
+typedef struct {
+    const char* name;
+    uint8_t data_len;
+    bool rich;
+} test_bench_shape_t;
+
+static void test_bench(unsigned long rounds) {
+    static const test_bench_shape_t shapes[] = {
+        {"measurement, 40 bytes", 40, false},
+        {"255 bytes", 255, false},
+        {"255 bytes, 1 in 4 stuffed", 255, true},
+    };
+    static uint8_t frames[TEST_BENCH_FRAMES][TEST_MAX_FRAME];
+    static uint16_t lengths[TEST_BENCH_FRAMES];
+    static uint8_t data[TEST_BENCH_FRAMES][255];
+    struct sensirion_shdlc_rx_header header = {0, 0x03, 0x00, 0};
+    struct sensirion_shdlc_decoder decoder;
+    uint8_t decoded[255];
+    uint8_t stuffed[2 * 255];
+    volatile uint8_t sink = 0;
+
+    for (size_t shape = 0; shape < sizeof(shapes) / sizeof(shapes[0]);
+         shape++) {
+        uint64_t bytes = 0;
+
+        header.data_len = shapes[shape].data_len;
+        for (int i = 0; i < TEST_BENCH_FRAMES; i++) {
+            test_random_data(data[i], header.data_len, shapes[shape].rich);
+            lengths[i] = test_encode(&header, data[i], frames[i]);
+            bytes += lengths[i];
+        }
+        bytes *= rounds;
+
+        /* Whole frames, in the 32 byte reads of the driver, and the original
+         * decoder */
+        uint64_t elapsed_ns[3];
+        for (int mode = 0; mode < 3; mode++) {
+            uint64_t start_ns = host_test_now_ns();
+            for (unsigned long round = 0; round < rounds; round++) {
+                for (int i = 0; i < TEST_BENCH_FRAMES; i++) {
+                    uint16_t offset = 0;
+                    uint16_t consumed;
+                    int16_t ret;
+
+                    if (mode == 2) {
+                        HOST_CHECK_EQUAL(reference_decode(frames[i], lengths[i],
+                                                          &decoder.header,
+                                                          decoded),
+                                         0);
+                        sink ^= decoded[0];
+                        continue;
+                    }
+                    sensirion_shdlc_decoder_init(&decoder, decoded,
+                                                 sizeof(decoded));
+                    uint16_t piece = mode == 0 ? lengths[i] : 32;
+                    do {
+                        uint16_t count = lengths[i] - offset < piece
+                                             ? lengths[i] - offset
+                                             : piece;
+                        ret = sensirion_shdlc_decoder_feed(
+                            &decoder, &frames[i][offset], count, &consumed);
+                        offset += consumed;
+                    } while (ret == SENSIRION_SHDLC_DECODER_INCOMPLETE);
+                    HOST_CHECK_EQUAL(ret, 0);
+                    sink ^= decoded[0];
+                }
+            }
+            elapsed_ns[mode] = host_test_now_ns() - start_ns;
+        }
+        double frame_count = (double)rounds * TEST_BENCH_FRAMES;
+        printf("%s: decoder %.0f ns/frame %.0f MB/s, in 32 byte reads %.0f "
+               "ns/frame, original %.0f ns/frame %.0f MB/s\n",
+               shapes[shape].name, elapsed_ns[0] / frame_count,
+               bytes * 1e3 / elapsed_ns[0], elapsed_ns[1] / frame_count,
+               elapsed_ns[2] / frame_count, bytes * 1e3 / elapsed_ns[2]);
+
+        /* The stuffing of the data, word at a time and the original */
+        for (int mode = 0; mode < 2; mode++) {
+            uint64_t start_ns = host_test_now_ns();
+            for (unsigned long round = 0; round < rounds; round++) {
+                for (int i = 0; i < TEST_BENCH_FRAMES; i++) {
+                    uint16_t len =
+                        mode == 0
+                            ? sensirion_shdlc_stuff_data(header.data_len,
+                                                         data[i], stuffed)
+                            : reference_stuff_data(header.data_len, data[i],
+                                                   stuffed);
+                    sink ^= stuffed[len - 1];
+                }
+            }
+            elapsed_ns[mode] = host_test_now_ns() - start_ns;
+        }
+        printf("%s: stuffing %.0f ns/frame %.0f MB/s, original %.0f ns/frame "
+               "%.0f MB/s\n",
+               shapes[shape].name, elapsed_ns[0] / frame_count,
+               frame_count * header.data_len * 1e3 / elapsed_ns[0],
+               elapsed_ns[1] / frame_count,
+               frame_count * header.data_len * 1e3 / elapsed_ns[1]);
+    }
+    (void)sink;
+}
+
+int main(int argc, char** argv) {
+    if (argc >= 2 && strcmp(argv[1], "unit") == 0) {
+        test_unit_lengths();
+        test_unit_stream();
+        test_unit_errors();
+        test_unit_xcv();
+        printf("SHDLC unit tests passed\n");
+        return EXIT_SUCCESS;
+    }
+    if (argc >= 2 && strcmp(argv[1], "stuffing") == 0) {
+        uint64_t start_ns = host_test_now_ns();
+        test_stuffing_words();
+        printf("2^32 words in %.1f s\n", (host_test_now_ns() - start_ns) / 1e9);
+        test_stuffing_pairs();
+        test_stuffing_lengths();
+        test_stuffing_frames();
+        printf("SHDLC stuffing tests passed\n");
+        return EXIT_SUCCESS;
+    }
+    if (argc >= 2 && strcmp(argv[1], "fuzz") == 0) {
+        test_fuzz(host_test_arg(argc, argv, 2, 100000));
+        printf("SHDLC fuzz tests passed\n");
+        return EXIT_SUCCESS;
+    }
+    if (argc >= 2 && strcmp(argv[1], "bench") == 0) {
+        test_bench(host_test_arg(argc, argv, 2, 2000));
+        return EXIT_SUCCESS;
+    }
+    fprintf(stderr,
+            "usage: %s unit | stuffing | fuzz [iterations] | bench [rounds]\n",
+            argv[0]);
+    return EXIT_FAILURE;
+}
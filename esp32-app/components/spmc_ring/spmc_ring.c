@@ -0,0 +1,115 @@
+#include <string.h>
+
+#include "spmc_ring.h"
+
+/**
+ * Every slot starts with a sequence counter written only by the producer:
+ *   2 * position + 1 while the item at position is being copied in,
+ *   2 * position + 2 once the item at position is complete.
+ * A reader that finds the value it expects before and after copying the payload knows that the
+ * copy is not torn. Positions are free running, the slot index is position & (capacity - 1).
+ */
+#define SEQUENCE_WRITING(position) (2 * (position) + 1)
+#define SEQUENCE_COMPLETE(position) (2 * (position) + 2)
+
+static inline _Atomic uint32_t *spmc_ring_slot_sequence(const spmc_ring_t *ring, uint32_t position)
+{
+    return (_Atomic uint32_t *)&ring->storage[(position & (ring->capacity - 1)) * ring->slot_size];
+}
+
+static inline uint8_t *spmc_ring_slot_payload(const spmc_ring_t *ring, uint32_t position)
+{
+    return &ring->storage[(position & (ring->capacity - 1)) * ring->slot_size + sizeof(uint32_t)];
+}
+
+void spmc_ring_push(spmc_ring_t *ring, const void *item)
+{
+    uint32_t position = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    _Atomic uint32_t *sequence = spmc_ring_slot_sequence(ring, position);
+
+    atomic_store_explicit(sequence, SEQUENCE_WRITING(position), memory_order_relaxed);
+    /* Readers must not see any payload byte of the new item before the slot is marked as busy */
+    atomic_thread_fence(memory_order_release);
+    memcpy(spmc_ring_slot_payload(ring, position), item, ring->payload_size);
+    atomic_store_explicit(sequence, SEQUENCE_COMPLETE(position), memory_order_release);
+
+    atomic_store_explicit(&ring->head, position + 1, memory_order_release);
+}
+
+uint32_t spmc_ring_head(const spmc_ring_t *ring)
+{
+    return atomic_load_explicit(&ring->head, memory_order_acquire);
+}
+
+spmc_ring_status_t spmc_ring_read(const spmc_ring_t *ring, uint32_t position, void *item)
+{
+    _Atomic uint32_t *sequence = spmc_ring_slot_sequence(ring, position);
+    uint32_t expected = SEQUENCE_COMPLETE(position);
+
+    uint32_t before = atomic_load_explicit(sequence, memory_order_acquire);
+    if (before != expected)
+    {
+        /* Slot still holds an older position or is being written for this one */
+        return (int32_t)(before - expected) > 0 ? SPMC_RING_OVERWRITTEN : SPMC_RING_EMPTY;
+    }
+
+    memcpy(item, spmc_ring_slot_payload(ring, position), ring->payload_size);
+
+    /* The payload copy must complete before the sequence is checked again */
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(sequence, memory_order_relaxed) != before)
+    {
+        return SPMC_RING_OVERWRITTEN;
+    }
+    return SPMC_RING_OK;
+}
+
+void spmc_ring_reader_init(const spmc_ring_t *ring, spmc_ring_reader_t *reader, uint32_t backlog)
+{
+    uint32_t head = spmc_ring_head(ring);
+
+    if (backlog > ring->capacity)
+    {
+        backlog = ring->capacity;
+    }
+    if (backlog > head)
+    {
+        backlog = head;
+    }
+    reader->next = head - backlog;
+    reader->dropped = 0;
+}
+
+spmc_ring_status_t spmc_ring_pop(const spmc_ring_t *ring, spmc_ring_reader_t *reader, void *item)
+{
+    uint32_t head = spmc_ring_head(ring);
+
+    if (reader->next == head)
+    {
+        return SPMC_RING_EMPTY;
+    }
+
+    if (head - reader->next > ring->capacity)
+    {
+        /* Everything before head - capacity is already gone */
+        reader->dropped += head - ring->capacity - reader->next;
+        reader->next = head - ring->capacity;
+    }
+
+    spmc_ring_status_t status = spmc_ring_read(ring, reader->next, item);
+    if (status == SPMC_RING_OVERWRITTEN)
+    {
+        /* The producer wrapped around while copying, skip to the oldest slot it cannot be
+        writing to right now */
+        head = spmc_ring_head(ring);
+        uint32_t oldest_safe = head - ring->capacity + 1;
+        reader->dropped += oldest_safe - reader->next;
+        reader->next = oldest_safe;
+        return SPMC_RING_OVERWRITTEN;
+    }
+    if (status == SPMC_RING_OK)
+    {
+        reader->next++;
+    }
+    return status;
+}
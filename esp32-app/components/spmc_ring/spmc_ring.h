@@ -0,0 +1,106 @@
+#ifndef COMPONENTS_SPMC_RING_H
+#define COMPONENTS_SPMC_RING_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+/* Slots are padded to this size so that a slot being written never shares a cache line with a
+slot that is being read */
+#define SPMC_RING_CACHE_LINE_SIZE 32
+
+/* Size of one slot: the sequence counter followed by the payload, rounded up to a cache line */
+#define SPMC_RING_SLOT_SIZE(payload_size) \
+    ((sizeof(uint32_t) + (payload_size) + SPMC_RING_CACHE_LINE_SIZE - 1) & ~(SPMC_RING_CACHE_LINE_SIZE - 1))
+
+/* Number of bytes of storage needed by a ring. capacity must be a power of two. */
+#define SPMC_RING_STORAGE_SIZE(payload_size, capacity) (SPMC_RING_SLOT_SIZE(payload_size) * (capacity))
+
+/* Static initializer. storage must be SPMC_RING_STORAGE_SIZE() bytes, zeroed and aligned to
+SPMC_RING_CACHE_LINE_SIZE. */
+#define SPMC_RING_INITIALIZER(storage_ptr, item_size, item_capacity) \
+    {                                                                \
+        .storage = (uint8_t *)(storage_ptr),                         \
+        .slot_size = SPMC_RING_SLOT_SIZE(item_size),                 \
+        .payload_size = (item_size),                                 \
+        .capacity = (item_capacity),                                 \
+    }
+
+typedef enum
+{
+    SPMC_RING_OK = 0,
+    SPMC_RING_EMPTY,      // The reader has seen every item that was pushed.
+    SPMC_RING_OVERWRITTEN // The producer lapped the reader, the reader skipped ahead.
+} spmc_ring_status_t;
+
+/**
+ * Fixed capacity ring buffer with one producer and any number of readers. The producer never
+ * blocks and overwrites the oldest item when the ring is full. Readers never block the producer
+ * nor each other: every slot carries a sequence counter that tells a reader whether the slot holds
+ * the item it expects and whether it was overwritten while being copied.
+ */
+typedef struct
+{
+    uint8_t *storage;
+    uint32_t slot_size;
+    uint32_t payload_size;
+    uint32_t capacity;
+    _Atomic uint32_t head; // Number of items pushed since the ring was created.
+} spmc_ring_t;
+
+typedef struct
+{
+    uint32_t next;    // Position of the next item to read.
+    uint32_t dropped; // Number of items that were overwritten before this reader could read them.
+} spmc_ring_reader_t;
+
+/**
+ * @brief Push an item, overwriting the oldest one if the ring is full. Must only be called from a
+ * single producer task.
+ *
+ * @param[in] ring the ring to push to.
+ * @param[in] item payload_size bytes to copy into the ring.
+ */
+void spmc_ring_push(spmc_ring_t *ring, const void *item);
+
+/**
+ * @brief Get the number of items pushed since the ring was created. The newest item is at
+ * position head - 1.
+ */
+uint32_t spmc_ring_head(const spmc_ring_t *ring);
+
+/**
+ * @brief Copy the item at an absolute position without any retry loop.
+ *
+ * @param[in] ring the ring to read from.
+ * @param[in] position absolute position, between head - capacity and head - 1.
+ * @param[out] item payload_size bytes. Content is undefined unless SPMC_RING_OK is returned.
+ *
+ * @return SPMC_RING_OK, SPMC_RING_EMPTY if the position was not pushed yet or SPMC_RING_OVERWRITTEN
+ * if the producer reused the slot before or while it was copied.
+ */
+spmc_ring_status_t spmc_ring_read(const spmc_ring_t *ring, uint32_t position, void *item);
+
+/**
+ * @brief Initialize a reader.
+ *
+ * @param[in] ring the ring to read from.
+ * @param[out] reader the reader to initialize.
+ * @param[in] backlog number of already pushed items the reader should still see, 0 to only see
+ * items pushed from now on.
+ */
+void spmc_ring_reader_init(const spmc_ring_t *ring, spmc_ring_reader_t *reader, uint32_t backlog);
+
+/**
+ * @brief Copy the next unread item of a reader, oldest first.
+ *
+ * @param[in] ring the ring to read from.
+ * @param[in,out] reader the reader state.
+ * @param[out] item payload_size bytes. Content is undefined unless SPMC_RING_OK is returned.
+ *
+ * @return SPMC_RING_OK when an item was copied, SPMC_RING_EMPTY when there is nothing new and
+ * SPMC_RING_OVERWRITTEN when the reader fell behind. In the last case reader->dropped is updated
+ * and the next call continues with the oldest item still in the ring.
+ */
+spmc_ring_status_t spmc_ring_pop(const spmc_ring_t *ring, spmc_ring_reader_t *reader, void *item);
+
+#endif
@@ -0,0 +1,303 @@
+/* Unit and stress tests of the SPMC ring on Linux.
+ *
+ *   spmc_ring_test unit
+ *   spmc_ring_test stress [readers] [items]
+ *
+ * The stress test runs one producer thread against several reader threads. Every item carries its
+ * position and a pattern derived from it, so a reader detects torn copies, items out of order and
+ * wrong drop accounting. It prints the push and read throughput. */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "host_test.h"
+#include "spmc_ring.h"
+
+#define TEST_CAPACITY 64
+#define TEST_MAX_READERS 32
+
+typedef struct
+{
+    uint32_t position;
+    uint32_t pattern[7];
+} test_item_t;
+
+typedef struct
+{
+    pthread_t thread;
+    uint32_t index;
+    uint64_t reads;
+    uint64_t overwritten; // Calls that returned SPMC_RING_OVERWRITTEN.
+    uint32_t dropped;
+    uint64_t elapsed_ns;
+} test_reader_t;
+
+static uint8_t s_storage[SPMC_RING_STORAGE_SIZE(sizeof(test_item_t), TEST_CAPACITY)]
+    __attribute__((aligned(SPMC_RING_CACHE_LINE_SIZE)));
+static spmc_ring_t s_ring;
+static uint32_t s_items;
+static atomic_bool s_started;
+static atomic_bool s_done;
+
+static void test_ring_reset(uint32_t capacity)
+{
+    memset(s_storage, 0, sizeof(s_storage));
+    s_ring = (spmc_ring_t)SPMC_RING_INITIALIZER(s_storage, sizeof(test_item_t), capacity);
+}
+
+static void test_item_make(test_item_t *item, uint32_t position)
+{
+    item->position = position;
+    for (uint32_t i = 0; i < 7; i++)
+    {
+        item->pattern[i] = position * 2654435761u + i;
+    }
+}
+
+static bool test_item_valid(const test_item_t *item)
+{
+    for (uint32_t i = 0; i < 7; i++)
+    {
+        if (item->pattern[i] != item->position * 2654435761u + i)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void test_push(uint32_t position)
+{
+    test_item_t item;
+    test_item_make(&item, position);
+    spmc_ring_push(&s_ring, &item);
+}
+
+static void test_unit_empty(void)
+{
+    spmc_ring_reader_t reader;
+    test_item_t item;
+
+    test_ring_reset(8);
+    spmc_ring_reader_init(&s_ring, &reader, 0);
+    HOST_CHECK_EQUAL(spmc_ring_head(&s_ring), 0);
+    HOST_CHECK_EQUAL(spmc_ring_pop(&s_ring, &reader, &item), SPMC_RING_EMPTY);
+    HOST_CHECK_EQUAL(spmc_ring_read(&s_ring, 0, &item), SPMC_RING_EMPTY);
+    HOST_CHECK_EQUAL(reader.dropped, 0);
+}
+
+static void test_unit_in_order(void)
+{
+    spmc_ring_reader_t reader;
+    test_item_t item;
+
+    test_ring_reset(8);
+    spmc_ring_reader_init(&s_ring, &reader, 0);
+    for (uint32_t position = 0; position < 3; position++)
+    {
+        test_push(position);
+    }
+    for (uint32_t position = 0; position < 3; position++)
+    {
+        HOST_CHECK_EQUAL(spmc_ring_pop(&s_ring, &reader, &item), SPMC_RING_OK);
+        HOST_CHECK_EQUAL(item.position, position);
+        HOST_CHECK(test_item_valid(&item));
+    }
+    HOST_CHECK_EQUAL(spmc_ring_pop(&s_ring, &reader, &item), SPMC_RING_EMPTY);
+    HOST_CHECK_EQUAL(reader.dropped, 0);
+
+    /* The newest item is at head - 1 */
+    HOST_CHECK_EQUAL(spmc_ring_read(&s_ring, spmc_ring_head(&s_ring) - 1, &item), SPMC_RING_OK);
+    HOST_CHECK_EQUAL(item.position, 2);
+}
+
+static void test_unit_backlog(void)
+{
+    spmc_ring_reader_t reader;
+    test_item_t item;
+
+    test_ring_reset(8);
+    spmc_ring_reader_init(&s_ring, &reader, 5);
+    HOST_CHECK_EQUAL(reader.next, 0); // Clamped to what was pushed
+
+    for (uint32_t position = 0; position < 10; position++)
+    {
+        test_push(position);
+    }
+    spmc_ring_reader_init(&s_ring, &reader, 3);
+    HOST_CHECK_EQUAL(reader.next, 7);
+    spmc_ring_reader_init(&s_ring, &reader, 100);
+    HOST_CHECK_EQUAL(reader.next, 2); // Clamped to the capacity
+    HOST_CHECK_EQUAL(spmc_ring_pop(&s_ring, &reader, &item), SPMC_RING_OK);
+    HOST_CHECK_EQUAL(item.position, 2);
+}
+
+static void test_unit_overwrite(void)
+{
+    spmc_ring_reader_t reader;
+    test_item_t item;
+
+    test_ring_reset(8);
+    spmc_ring_reader_init(&s_ring, &reader, 0);
+    for (uint32_t position = 0; position < 13; position++)
+    {
+        test_push(position);
+    }
+
+    /* Positions 0 to 4 were overwritten, the reader continues with the oldest item left */
+    HOST_CHECK_EQUAL(spmc_ring_pop(&s_ring, &reader, &item), SPMC_RING_OK);
+    HOST_CHECK_EQUAL(item.position, 5);
+    HOST_CHECK_EQUAL(reader.dropped, 5);
+    for (uint32_t position = 6; position < 13; position++)
+    {
+        HOST_CHECK_EQUAL(spmc_ring_pop(&s_ring, &reader, &item), SPMC_RING_OK);
+        HOST_CHECK_EQUAL(item.position, position);
+    }
+    HOST_CHECK_EQUAL(spmc_ring_pop(&s_ring, &reader, &item), SPMC_RING_EMPTY);
+    HOST_CHECK_EQUAL(reader.dropped, 5);
+
+    HOST_CHECK_EQUAL(spmc_ring_read(&s_ring, 4, &item), SPMC_RING_OVERWRITTEN);
+    HOST_CHECK_EQUAL(spmc_ring_read(&s_ring, 5, &item), SPMC_RING_OK);
+    HOST_CHECK_EQUAL(spmc_ring_read(&s_ring, 13, &item), SPMC_RING_EMPTY);
+}
+
+static void test_unit_position_wraps(void)
+{
+    spmc_ring_reader_t reader;
+    test_item_t item;
+    const uint32_t first = UINT32_MAX - 3;
+
+    /* Positions are free running and wrap after 2^32 items */
+    test_ring_reset(8);
+    atomic_store(&s_ring.head, first);
+    spmc_ring_reader_init(&s_ring, &reader, 0);
+    for (uint32_t i = 0; i < 8; i++)
+    {
+        test_push(first + i);
+    }
+    for (uint32_t i = 0; i < 8; i++)
+    {
+        HOST_CHECK_EQUAL(spmc_ring_pop(&s_ring, &reader, &item), SPMC_RING_OK);
+        HOST_CHECK_EQUAL(item.position, (uint32_t)(first + i));
+    }
+    HOST_CHECK_EQUAL(spmc_ring_pop(&s_ring, &reader, &item), SPMC_RING_EMPTY);
+    HOST_CHECK_EQUAL(reader.dropped, 0);
+}
+
+static void *test_reader_thread(void *arg)
+{
+    test_reader_t *state = arg;
+    spmc_ring_reader_t reader;
+    test_item_t item;
+    uint32_t random = 0x9E3779B9u ^ (state->index + 1);
+
+    /* Initialized before the producer starts, so every item is either read or dropped */
+    spmc_ring_reader_init(&s_ring, &reader, 0);
+    while (!atomic_load(&s_started))
+    {
+        sched_yield();
+    }
+
+    uint64_t start = host_test_now_ns();
+    while (true)
+    {
+        spmc_ring_status_t status = spmc_ring_pop(&s_ring, &reader, &item);
+        if (status == SPMC_RING_OK)
+        {
+            state->reads++;
+            HOST_CHECK(test_item_valid(&item));
+            /* Every position before this one was either read or dropped */
+            HOST_CHECK_EQUAL(item.position + 1, state->reads + reader.dropped);
+        }
+        else if (status == SPMC_RING_OVERWRITTEN)
+        {
+            state->overwritten++;
+        }
+        else if (atomic_load(&s_done) && reader.next == spmc_ring_head(&s_ring))
+        {
+            break;
+        }
+        else
+        {
+            sched_yield();
+        }
+
+        /* Readers fall behind now and then so that the producer laps them */
+        if ((host_test_random(&random) & 0xFFF) == 0)
+        {
+            sched_yield();
+        }
+    }
+    state->elapsed_ns = host_test_now_ns() - start;
+    state->dropped = reader.dropped;
+    return NULL;
+}
+
+static int test_stress(uint32_t reader_count, uint32_t items)
+{
+    test_reader_t readers[TEST_MAX_READERS] = {0};
+
+    if (reader_count == 0 || reader_count > TEST_MAX_READERS)
+    {
+        fprintf(stderr, "1 to %d readers\n", TEST_MAX_READERS);
+        return EXIT_FAILURE;
+    }
+    test_ring_reset(TEST_CAPACITY);
+    s_items = items;
+
+    for (uint32_t i = 0; i < reader_count; i++)
+    {
+        readers[i].index = i;
+        HOST_CHECK(pthread_create(&readers[i].thread, NULL, test_reader_thread, &readers[i]) == 0);
+    }
+    /* Let the readers initialize before the first push */
+    usleep(10000);
+    atomic_store(&s_started, true);
+
+    uint64_t start = host_test_now_ns();
+    for (uint32_t position = 0; position < s_items; position++)
+    {
+        test_push(position);
+        /* Give the readers a chance to run in between on machines with fewer cores than threads */
+        if ((position & 0xFF) == 0xFF)
+        {
+            sched_yield();
+        }
+    }
+    uint64_t push_ns = host_test_now_ns() - start;
+    atomic_store(&s_done, true);
+
+    printf("producer: %u items in %.3f s, %.1f M pushes/s\n", s_items, push_ns / 1e9, s_items / (push_ns / 1e3));
+    for (uint32_t i = 0; i < reader_count; i++)
+    {
+        HOST_CHECK(pthread_join(readers[i].thread, NULL) == 0);
+        HOST_CHECK_EQUAL(readers[i].reads + readers[i].dropped, s_items);
+        printf("reader %u: %llu read, %u dropped (%.1f %%), %llu overwritten while reading, %.1f M reads/s\n", i,
+               (unsigned long long)readers[i].reads, readers[i].dropped, 100.0 * readers[i].dropped / s_items,
+               (unsigned long long)readers[i].overwritten, readers[i].reads / (readers[i].elapsed_ns / 1e3));
+    }
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc >= 2 && strcmp(argv[1], "unit") == 0)
+    {
+        test_unit_empty();
+        test_unit_in_order();
+        test_unit_backlog();
+        test_unit_overwrite();
+        test_unit_position_wraps();
+        printf("spmc_ring unit tests passed\n");
+        return EXIT_SUCCESS;
+    }
+    if (argc >= 2 && strcmp(argv[1], "stress") == 0)
+    {
+        return test_stress(host_test_arg(argc, argv, 2, 4), host_test_arg(argc, argv, 3, 2000000));
+    }
+    fprintf(stderr, "usage: %s unit | stress [readers] [items]\n", argv[0]);
+    return EXIT_FAILURE;
+}
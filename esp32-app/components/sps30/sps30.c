@@ -82,14 +82,9 @@ int16_t sps30_read_firmware_version(uint8_t* major, uint8_t* minor) {
 int16_t sps30_get_serial(char* serial) {
     int16_t error;
 
-    error = sensirion_i2c_write_cmd(SPS30_I2C_ADDRESS, SPS_CMD_GET_SERIAL);
-
-    if (error != NO_ERROR) {
-        return error;
-    }
-
-    error = sensirion_i2c_read_words_as_bytes(
-        SPS30_I2C_ADDRESS, (uint8_t*)serial, SPS30_SERIAL_NUM_WORDS);
+    error = sensirion_i2c_delayed_read_words_as_bytes(
+        SPS30_I2C_ADDRESS, SPS_CMD_GET_SERIAL, 0, (uint8_t*)serial,
+        SPS30_SERIAL_NUM_WORDS);
 
     /* ensure a final '\0'. The firmware should always set this so this is just
      * in case something goes wrong.
@@ -127,14 +122,9 @@ int16_t sps30_read_measurement(struct sps30_measurement* measurement) {
     int16_t error;
     uint8_t data[10][4];
 
-    error =
-        sensirion_i2c_write_cmd(SPS30_I2C_ADDRESS, SPS_CMD_READ_MEASUREMENT);
-    if (error != NO_ERROR) {
-        return error;
-    }
-
-    error = sensirion_i2c_read_words_as_bytes(SPS30_I2C_ADDRESS, &data[0][0],
-                                              SENSIRION_NUM_WORDS(data));
+    error = sensirion_i2c_delayed_read_words_as_bytes(
+        SPS30_I2C_ADDRESS, SPS_CMD_READ_MEASUREMENT, 0, &data[0][0],
+        SENSIRION_NUM_WORDS(data));
 
     if (error != NO_ERROR) {
         return error;
@@ -158,16 +148,9 @@ int16_t sps30_get_fan_auto_cleaning_interval(uint32_t* interval_seconds) {
     uint8_t data[4];
     int16_t error;
 
-    error =
-        sensirion_i2c_write_cmd(SPS30_I2C_ADDRESS, SPS_CMD_AUTOCLEAN_INTERVAL);
-    if (error != NO_ERROR) {
-        return error;
-    }
-
-    sensirion_i2c_hal_sleep_usec(SPS_CMD_DELAY_USEC);
-
-    error = sensirion_i2c_read_words_as_bytes(SPS30_I2C_ADDRESS, data,
-                                              SENSIRION_NUM_WORDS(data));
+    error = sensirion_i2c_delayed_read_words_as_bytes(
+        SPS30_I2C_ADDRESS, SPS_CMD_AUTOCLEAN_INTERVAL, SPS_CMD_DELAY_USEC, data,
+        SENSIRION_NUM_WORDS(data));
     if (error != NO_ERROR) {
         return error;
     }
@@ -194,7 +177,7 @@ int16_t sps30_get_fan_auto_cleaning_interval_days(uint8_t* interval_days) {
     uint32_t interval_seconds;
 
     ret = sps30_get_fan_auto_cleaning_interval(&interval_seconds);
-    if (ret < 0)
+    if (ret != NO_ERROR)
         return ret;
 
     *interval_days = interval_seconds / (24 * 60 * 60);
@@ -76,8 +76,9 @@ const char* sps_get_driver_version(void);
  * sps30_probe() - check if SPS sensor is available and initialize it
  *
  * Note that Pin 4 must be pulled to ground for the sensor to operate in i2c
- * mode (this driver). When left floating, the sensor operates in UART mode
- * which is not compatible with this i2c driver.
+ * mode (sps30.c). When left floating, the sensor operates in UART mode, which
+ * needs the SHDLC driver in sps30_uart.c (CONFIG_SENSIRION_SPS30_INTERFACE).
+ * The UART driver also initializes the UART.
  *
  * Return:  0 on success, an error code otherwise
  */
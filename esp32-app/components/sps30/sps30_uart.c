@@ -0,0 +1,280 @@
+/*
+ * SPS30 driver for the UART interface (SHDLC). Implements the same API as the
+ * I2C driver in sps30.c, which one is built is selected with
+ * CONFIG_SENSIRION_SPS30_INTERFACE.
+ *
+ * The UART interface has no data-ready flag: reading the measured values
+ * returns an empty frame when there is no new measurement. The flag is
+ * emulated by reading the measurement in sps30_read_data_ready() and keeping
+ * it until sps30_read_measurement() is called, so a new sample costs one
+ * exchange like on I2C.
+ */
+
+#include <string.h>
+
+#include "sps30.h"
+#include "sensirion_common.h"
+#include "sensirion_config.h"
+#include "sensirion_shdlc.h"
+#include "sensirion_uart_hal.h"
+#include "sps_git_version.h"
+
+#define SPS30_SHDLC_ADDR 0x00
+
+#define SPS_CMD_START_MEASUREMENT 0x00
+#define SPS_SUBCMD_START_MEASUREMENT 0x01
+#define SPS_START_MEASUREMENT_FORMAT_FLOAT 0x03
+#define SPS_CMD_STOP_MEASUREMENT 0x01
+#define SPS_CMD_READ_MEASUREMENT 0x03
+#define SPS_CMD_SLEEP 0x10
+#define SPS_CMD_WAKE_UP 0x11
+#define SPS_CMD_START_MANUAL_FAN_CLEANING 0x56
+#define SPS_CMD_AUTOCLEAN_INTERVAL 0x80
+#define SPS_SUBCMD_AUTOCLEAN_INTERVAL 0x00
+#define SPS_CMD_DEVICE_INFO 0xd0
+#define SPS_SUBCMD_DEVICE_INFO_SERIAL 0x03
+#define SPS_CMD_READ_VERSION 0xd1
+#define SPS_CMD_READ_DEVICE_STATUS_REG 0xd2
+#define SPS_CMD_RESET 0xd3
+#define SPS_CMD_START_STOP_DELAY_USEC 20000
+#define SPS_CMD_DELAY_USEC 5000
+#define SPS_CMD_DELAY_WRITE_FLASH_USEC 20000
+
+/* The sensor listens for the wake-up command within 100ms after the pulse */
+#define SPS_WAKE_UP_PULSE 0xff
+
+#define SPS30_MEASUREMENT_LEN 40
+
+static struct {
+    uint8_t data[SPS30_MEASUREMENT_LEN];
+    bool ready;
+} s_pending;
+
+static int16_t sps30_xcv(uint8_t cmd, uint8_t tx_data_len,
+                         const uint8_t* tx_data, uint8_t max_rx_data_len,
+                         struct sensirion_shdlc_rx_header* rx_header,
+                         uint8_t* rx_data) {
+    return sensirion_shdlc_xcv(SPS30_SHDLC_ADDR, cmd, tx_data_len, tx_data,
+                               max_rx_data_len, rx_header, rx_data);
+}
+
+static int16_t sps30_cmd(uint8_t cmd, uint8_t tx_data_len,
+                         const uint8_t* tx_data) {
+    struct sensirion_shdlc_rx_header header;
+
+    return sps30_xcv(cmd, tx_data_len, tx_data, 0, &header, NULL);
+}
+
+const char* sps_get_driver_version(void) {
+    return SPS_DRV_VERSION_STR;
+}
+
+int16_t sps30_probe(void) {
+    char serial[SPS30_MAX_SERIAL_LEN];
+    int16_t ret;
+
+    ret = sensirion_uart_hal_init();
+    if (ret)
+        return ret;
+
+    // Try to wake up, but ignore failure if it is not in sleep mode
+    (void)sps30_wake_up();
+
+    return sps30_get_serial(serial);
+}
+
+int16_t sps30_read_firmware_version(uint8_t* major, uint8_t* minor) {
+    struct sensirion_shdlc_rx_header header;
+    uint8_t version[7];
+    int16_t ret;
+
+    ret = sps30_xcv(SPS_CMD_READ_VERSION, 0, NULL, sizeof(version), &header,
+                    version);
+    if (ret)
+        return ret;
+    if (header.data_len < 2)
+        return SENSIRION_SHDLC_ERR_ENCODING_ERROR;
+
+    *major = version[0];
+    *minor = version[1];
+    return 0;
+}
+
+int16_t sps30_get_serial(char* serial) {
+    struct sensirion_shdlc_rx_header header;
+    const uint8_t subcmd = SPS_SUBCMD_DEVICE_INFO_SERIAL;
+    int16_t ret;
+
+    ret = sps30_xcv(SPS_CMD_DEVICE_INFO, sizeof(subcmd), &subcmd,
+                    SPS30_MAX_SERIAL_LEN, &header, (uint8_t*)serial);
+    if (ret)
+        return ret;
+
+    /* ensure a final '\0', the string sent by the sensor is terminated */
+    serial[header.data_len < SPS30_MAX_SERIAL_LEN ? header.data_len
+                                                  : SPS30_MAX_SERIAL_LEN - 1] =
+        '\0';
+    return 0;
+}
+
+int16_t sps30_start_measurement(void) {
+    const uint8_t data[] = {SPS_SUBCMD_START_MEASUREMENT,
+                            SPS_START_MEASUREMENT_FORMAT_FLOAT};
+    int16_t ret;
+
+    s_pending.ready = false;
+    ret = sps30_cmd(SPS_CMD_START_MEASUREMENT, sizeof(data), data);
+    sensirion_uart_hal_sleep_usec(SPS_CMD_START_STOP_DELAY_USEC);
+    return ret;
+}
+
+int16_t sps30_stop_measurement(void) {
+    int16_t ret;
+
+    s_pending.ready = false;
+    ret = sps30_cmd(SPS_CMD_STOP_MEASUREMENT, 0, NULL);
+    sensirion_uart_hal_sleep_usec(SPS_CMD_START_STOP_DELAY_USEC);
+    return ret;
+}
+
+int16_t sps30_read_data_ready(uint16_t* data_ready) {
+    struct sensirion_shdlc_rx_header header;
+    int16_t ret;
+
+    if (!s_pending.ready) {
+        ret = sps30_xcv(SPS_CMD_READ_MEASUREMENT, 0, NULL,
+                        sizeof(s_pending.data), &header, s_pending.data);
+        if (ret)
+            return ret;
+        /* An empty frame means no new measurement */
+        s_pending.ready = header.data_len == SPS30_MEASUREMENT_LEN;
+    }
+    *data_ready = s_pending.ready;
+    return 0;
+}
+
+int16_t sps30_read_measurement(struct sps30_measurement* measurement) {
+    uint16_t data_ready;
+    int16_t ret;
+
+    ret = sps30_read_data_ready(&data_ready);
+    if (ret)
+        return ret;
+    if (!data_ready)
+        return SENSIRION_SHDLC_ERR_NO_DATA;
+    s_pending.ready = false;
+
+    measurement->mc_1p0 = sensirion_common_bytes_to_float(&s_pending.data[0]);
+    measurement->mc_2p5 = sensirion_common_bytes_to_float(&s_pending.data[4]);
+    measurement->mc_4p0 = sensirion_common_bytes_to_float(&s_pending.data[8]);
+    measurement->mc_10p0 = sensirion_common_bytes_to_float(&s_pending.data[12]);
+    measurement->nc_0p5 = sensirion_common_bytes_to_float(&s_pending.data[16]);
+    measurement->nc_1p0 = sensirion_common_bytes_to_float(&s_pending.data[20]);
+    measurement->nc_2p5 = sensirion_common_bytes_to_float(&s_pending.data[24]);
+    measurement->nc_4p0 = sensirion_common_bytes_to_float(&s_pending.data[28]);
+    measurement->nc_10p0 = sensirion_common_bytes_to_float(&s_pending.data[32]);
+    measurement->typical_particle_size =
+        sensirion_common_bytes_to_float(&s_pending.data[36]);
+
+    return 0;
+}
+
+int16_t sps30_get_fan_auto_cleaning_interval(uint32_t* interval_seconds) {
+    struct sensirion_shdlc_rx_header header;
+    const uint8_t subcmd = SPS_SUBCMD_AUTOCLEAN_INTERVAL;
+    uint8_t data[4];
+    int16_t ret;
+
+    ret = sps30_xcv(SPS_CMD_AUTOCLEAN_INTERVAL, sizeof(subcmd), &subcmd,
+                    sizeof(data), &header, data);
+    if (ret)
+        return ret;
+    if (header.data_len != sizeof(data))
+        return SENSIRION_SHDLC_ERR_ENCODING_ERROR;
+
+    *interval_seconds = sensirion_common_bytes_to_uint32_t(data);
+    return 0;
+}
+
+int16_t sps30_set_fan_auto_cleaning_interval(uint32_t interval_seconds) {
+    uint8_t data[5];
+    int16_t ret;
+
+    data[0] = SPS_SUBCMD_AUTOCLEAN_INTERVAL;
+    sensirion_common_uint32_t_to_bytes(interval_seconds, &data[1]);
+    ret = sps30_cmd(SPS_CMD_AUTOCLEAN_INTERVAL, sizeof(data), data);
+    sensirion_uart_hal_sleep_usec(SPS_CMD_DELAY_WRITE_FLASH_USEC);
+    return ret;
+}
+
+int16_t sps30_get_fan_auto_cleaning_interval_days(uint8_t* interval_days) {
+    int16_t ret;
+    uint32_t interval_seconds;
+
+    ret = sps30_get_fan_auto_cleaning_interval(&interval_seconds);
+    if (ret != NO_ERROR)
+        return ret;
+
+    *interval_days = interval_seconds / (24 * 60 * 60);
+    return ret;
+}
+
+int16_t sps30_set_fan_auto_cleaning_interval_days(uint8_t interval_days) {
+    return sps30_set_fan_auto_cleaning_interval((uint32_t)interval_days * 24 *
+                                                60 * 60);
+}
+
+int16_t sps30_start_manual_fan_cleaning(void) {
+    return sps30_cmd(SPS_CMD_START_MANUAL_FAN_CLEANING, 0, NULL);
+}
+
+int16_t sps30_reset(void) {
+    s_pending.ready = false;
+    return sps30_cmd(SPS_CMD_RESET, 0, NULL);
+}
+
+int16_t sps30_sleep(void) {
+    int16_t ret;
+
+    ret = sps30_cmd(SPS_CMD_SLEEP, 0, NULL);
+    if (ret)
+        return ret;
+
+    sensirion_uart_hal_sleep_usec(SPS_CMD_DELAY_USEC);
+    return 0;
+}
+
+int16_t sps30_wake_up(void) {
+    const uint8_t pulse = SPS_WAKE_UP_PULSE;
+    int16_t ret;
+
+    /* The falling edge of the start bit wakes up the UART of the sensor, the
+     * byte itself is lost */
+    ret = sensirion_uart_hal_tx(sizeof(pulse), &pulse);
+    if (ret < 0)
+        return ret;
+
+    ret = sps30_cmd(SPS_CMD_WAKE_UP, 0, NULL);
+    if (ret)
+        return ret;
+
+    sensirion_uart_hal_sleep_usec(SPS_CMD_DELAY_USEC);
+    return 0;
+}
+
+int16_t sps30_read_device_status_register(uint32_t* device_status_flags) {
+    struct sensirion_shdlc_rx_header header;
+    const uint8_t clear = 0;
+    uint8_t data[5];
+    int16_t ret;
+
+    ret = sps30_xcv(SPS_CMD_READ_DEVICE_STATUS_REG, sizeof(clear), &clear,
+                    sizeof(data), &header, data);
+    if (ret)
+        return ret;
+    if (header.data_len < 4)
+        return SENSIRION_SHDLC_ERR_ENCODING_ERROR;
+
+    *device_status_flags = sensirion_common_bytes_to_uint32_t(data);
+    return 0;
+}
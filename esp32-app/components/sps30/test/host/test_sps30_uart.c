@@ -0,0 +1,253 @@
+/* Loopback test of the SPS30 UART driver on Linux: sps30_uart.c, sensirion_shdlc.c
+ * and sensirion_uart_hal.c on the pty of the uart shim, with the simulated sensor
+ * of sensirion_uart_sim.c on the other end of the line.
+ *
+ *   sps30_uart_test loopback [measurements]
+ *
+ * A device thread cuts what arrives on the line into frames for the simulator and
+ * sends each response back in random pieces, after random line noise and now and
+ * then after a stale response to an earlier command, so that the decoder works on
+ * partial reads, resynchronises and skips what it did not ask for. The driver goes
+ * through probe, version, serial number, auto cleaning interval, measurements,
+ * sleep and wake-up. Prints the round trip time of a command. */
+
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "host_shim.h"
+#include "host_test.h"
+#include "sdkconfig.h"
+#include "sensirion_shdlc.h"
+#include "sensirion_uart_hal.h"
+#include "sensirion_uart_sim.h"
+#include "sps30.h"
+
+#define TEST_SHDLC_START 0x7e
+#define TEST_SHDLC_ESCAPE 0x7d
+#define TEST_WAKE_UP_PULSE 0xff
+
+/* start + (4 header + 255 data + checksum) * 2 + stop */
+#define TEST_MAX_FRAME (2 + (4 + 255 + 1) * 2)
+
+#define TEST_MAX_PIECE 16
+#define TEST_MAX_PIECE_GAP_US 300
+#define TEST_MAX_NOISE 8
+
+#define TEST_ROUND_TRIPS 200
+#define TEST_MEASUREMENT_TIMEOUT_US 3000000
+
+static int s_device_fd;
+static uint32_t s_random = 0x5B530;
+
+/* Last response sent, replayed before a later one */
+static uint8_t s_stale[TEST_MAX_FRAME];
+static uint16_t s_stale_length;
+
+static uint32_t s_noise_count;
+static uint32_t s_stale_count;
+
+/* Address, command, state and length of a stuffed frame */
+static void test_header(const uint8_t* frame, uint8_t header[4]) {
+    uint16_t i = 1;
+
+    for (int n = 0; n < 4; n++) {
+        uint8_t c = frame[i++];
+        if (c == TEST_SHDLC_ESCAPE)
+            c = frame[i++] ^ (1 << 5);
+        header[n] = c;
+    }
+}
+
+static void test_device_write(const uint8_t* data, uint16_t length) {
+    HOST_CHECK(write(s_device_fd, data, length) == length);
+}
+
+/* Sends a frame in random pieces with random gaps, as the UART of the
+ * sensor and the FIFO of the ESP32 would hand it over */
+static void test_device_send(const uint8_t* frame, uint16_t length) {
+    uint16_t offset = 0;
+
+    while (offset < length) {
+        uint16_t piece = 1 + host_test_random(&s_random) % TEST_MAX_PIECE;
+        if (piece > length - offset)
+            piece = length - offset;
+        test_device_write(&frame[offset], piece);
+        offset += piece;
+        usleep(host_test_random(&s_random) % TEST_MAX_PIECE_GAP_US);
+    }
+}
+
+static void test_device_respond(const uint8_t* frame, uint16_t length) {
+    uint8_t response[TEST_MAX_FRAME];
+    uint8_t header[4];
+    uint8_t stale_header[4];
+
+    sensirion_uart_sim_write(frame, length);
+    uint16_t count = sensirion_uart_sim_read(response, sizeof(response));
+    if (count == 0)
+        return; /* the sensor sleeps or ignored the frame */
+
+    /* Noise on the line before the start byte */
+    if (host_test_random(&s_random) % 4 == 0) {
+        uint8_t noise[TEST_MAX_NOISE];
+        uint16_t noise_length =
+            1 + host_test_random(&s_random) % TEST_MAX_NOISE;
+        for (uint16_t i = 0; i < noise_length; i++) {
+            do
+                noise[i] = (uint8_t)host_test_random(&s_random);
+            while (noise[i] == TEST_SHDLC_START);
+        }
+        test_device_write(noise, noise_length);
+        s_noise_count++;
+    }
+
+    /* The response to an earlier command, late */
+    test_header(response, header);
+    if (s_stale_length > 0 && host_test_random(&s_random) % 4 == 0) {
+        test_header(s_stale, stale_header);
+        if (stale_header[1] != header[1]) {
+            test_device_send(s_stale, s_stale_length);
+            s_stale_count++;
+        }
+    }
+
+    test_device_send(response, count);
+    memcpy(s_stale, response, count);
+    s_stale_length = count;
+}
+
+/* The sensor end of the line: the wake-up pulse alone, frames from start to
+ * stop byte */
+static void* test_device_thread(void* arg) {
+    uint8_t frame[TEST_MAX_FRAME];
+    uint16_t length = 0;
+    uint8_t c;
+
+    (void)arg;
+    while (read(s_device_fd, &c, 1) == 1) {
+        if (length == 0) {
+            if (c == TEST_WAKE_UP_PULSE)
+                sensirion_uart_sim_write(&c, 1);
+            else if (c == TEST_SHDLC_START)
+                frame[length++] = c;
+            continue;
+        }
+        HOST_CHECK(length < sizeof(frame));
+        frame[length++] = c;
+        if (c == TEST_SHDLC_START) {
+            test_device_respond(frame, length);
+            length = 0;
+        }
+    }
+    return NULL;
+}
+
+static void test_check_close(float actual, float expected) {
+    float difference = actual - expected;
+
+    HOST_CHECK(difference < 1e-4f * expected && difference > -1e-4f * expected);
+}
+
+static void test_measurements(unsigned long count) {
+    struct sps30_measurement m;
+    uint16_t data_ready;
+
+    HOST_CHECK_EQUAL(sps30_start_measurement(), 0);
+    for (unsigned long i = 0; i < count; i++) {
+        uint64_t start_ns = host_test_now_ns();
+
+        do {
+            HOST_CHECK(host_test_now_ns() - start_ns <
+                       TEST_MEASUREMENT_TIMEOUT_US * 1000ull);
+            sensirion_uart_hal_sleep_usec(100000);
+            HOST_CHECK_EQUAL(sps30_read_data_ready(&data_ready), 0);
+        } while (!data_ready);
+        HOST_CHECK_EQUAL(sps30_read_measurement(&m), 0);
+        printf("measurement %lu: PM2.5 %.2f ug/m3, typical size %.2f um\n",
+               i + 1, m.mc_2p5, m.typical_particle_size);
+
+        /* The ratios of the simulated sensor */
+        HOST_CHECK(m.mc_2p5 >= 0.5f);
+        test_check_close(m.mc_1p0, 0.75f * m.mc_2p5);
+        test_check_close(m.mc_10p0, 1.20f * m.mc_2p5);
+        test_check_close(m.nc_10p0, 6.42f * m.mc_2p5);
+        test_check_close(m.typical_particle_size, 0.55f);
+        /* Read once only */
+        HOST_CHECK_EQUAL(sps30_read_measurement(&m),
+                         SENSIRION_SHDLC_ERR_NO_DATA);
+    }
+    HOST_CHECK_EQUAL(sps30_stop_measurement(), 0);
+}
+
+static void test_loopback(unsigned long measurements) {
+    char serial[SPS30_MAX_SERIAL_LEN];
+    uint8_t major;
+    uint8_t minor;
+    uint8_t days;
+    uint32_t status;
+    pthread_t thread;
+
+    s_device_fd = host_uart_get_device_fd(CONFIG_SENSIRION_UART_PORT);
+    HOST_CHECK(s_device_fd >= 0);
+    HOST_CHECK(pthread_create(&thread, NULL, test_device_thread, NULL) == 0);
+
+    HOST_CHECK_EQUAL(sps30_probe(), 0);
+    HOST_CHECK_EQUAL(sps30_get_serial(serial), 0);
+    HOST_CHECK(strcmp(serial, "SPS30SIM00000001") == 0);
+    HOST_CHECK_EQUAL(sps30_read_firmware_version(&major, &minor), 0);
+    HOST_CHECK_EQUAL(major, 2);
+    HOST_CHECK_EQUAL(minor, 2);
+    HOST_CHECK_EQUAL(sps30_set_fan_auto_cleaning_interval_days(4), 0);
+    HOST_CHECK_EQUAL(sps30_get_fan_auto_cleaning_interval_days(&days), 0);
+    HOST_CHECK_EQUAL(days, 4);
+    HOST_CHECK_EQUAL(sps30_read_device_status_register(&status), 0);
+    HOST_CHECK_EQUAL(status, 0);
+    HOST_CHECK_EQUAL(sps30_start_manual_fan_cleaning(), 0);
+
+    test_measurements(measurements);
+
+    /* A sleeping sensor does not answer until it was woken up */
+    HOST_CHECK_EQUAL(sps30_sleep(), 0);
+    HOST_CHECK_EQUAL(sps30_get_serial(serial),
+                     SENSIRION_SHDLC_ERR_MISSING_START);
+    HOST_CHECK_EQUAL(sps30_wake_up(), 0);
+    HOST_CHECK_EQUAL(sps30_get_serial(serial), 0);
+
+    uint64_t max_ns = 0;
+    uint64_t start_ns = host_test_now_ns();
+    for (int i = 0; i < TEST_ROUND_TRIPS; i++) {
+        uint64_t command_ns = host_test_now_ns();
+        /* A stale serial number is longer than the buffer for the version */
+        if (i % 2 == 0) {
+            HOST_CHECK_EQUAL(sps30_get_serial(serial), 0);
+            HOST_CHECK(strcmp(serial, "SPS30SIM00000001") == 0);
+        } else {
+            HOST_CHECK_EQUAL(sps30_read_firmware_version(&major, &minor), 0);
+            HOST_CHECK_EQUAL(major, 2);
+        }
+        command_ns = host_test_now_ns() - command_ns;
+        if (command_ns > max_ns)
+            max_ns = command_ns;
+    }
+    uint64_t elapsed_ns = host_test_now_ns() - start_ns;
+    printf("%d commands: %.0f us per round trip, %.0f us max, %u responses "
+           "after noise, %u after a stale one\n",
+           TEST_ROUND_TRIPS, elapsed_ns / 1e3 / TEST_ROUND_TRIPS, max_ns / 1e3,
+           s_noise_count, s_stale_count);
+    HOST_CHECK(s_noise_count > 0);
+    HOST_CHECK(s_stale_count > 0);
+
+    HOST_CHECK_EQUAL(sps30_reset(), 0);
+    HOST_CHECK_EQUAL(sensirion_uart_hal_free(), 0);
+}
+
+int main(int argc, char** argv) {
+    if (argc >= 2 && strcmp(argv[1], "loopback") == 0) {
+        test_loopback(host_test_arg(argc, argv, 2, 3));
+        printf("SPS30 UART loopback tests passed\n");
+        return EXIT_SUCCESS;
+    }
+    fprintf(stderr, "usage: %s loopback [measurements]\n", argv[0]);
+    return EXIT_FAILURE;
+}
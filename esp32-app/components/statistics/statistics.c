@@ -0,0 +1,357 @@
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "sample_bus.h"
+#include "statistics.h"
+
+#define TAG "statistics.c"
+
+/* Windows are closed on time even when no sensor publishes */
+#define STATISTICS_PERIOD_MS 1000
+
+/* Estimated quantiles, in the order of the percentiles in statistics_summary_t */
+#define STATISTICS_QUANTILE_COUNT 2
+static const float s_quantiles[STATISTICS_QUANTILE_COUNT] = {0.50f, 0.95f};
+
+/* Windows with up to this many samples get exact percentiles, the estimators are still inaccurate
+after so few samples */
+#define STATISTICS_EXACT_SAMPLES 16
+
+#define PSQUARE_MARKERS 5
+
+static const uint32_t s_window_durations[STATISTICS_WINDOW_MAX] = {
+    [STATISTICS_WINDOW_1MIN] = 60,
+    [STATISTICS_WINDOW_15MIN] = 15 * 60,
+    [STATISTICS_WINDOW_24H] = 24 * 60 * 60,
+};
+
+/* P-square estimator of one quantile (Jain and Chlamtac, 1985). Five markers track the minimum,
+the p/2, p and (1+p)/2 quantiles and the maximum. Every sample moves the markers towards their
+desired positions by a parabolic interpolation of their heights, which takes constant memory and
+a few float operations however many samples the window holds. The desired positions are computed
+from the count, adding their increments up in float drifts over long windows. */
+typedef struct
+{
+    float height[PSQUARE_MARKERS];
+    int32_t position[PSQUARE_MARKERS];
+} statistics_psquare_t;
+
+typedef struct
+{
+    uint32_t count;
+    int64_t sum;
+    int32_t min;
+    int32_t max;
+    int32_t first[STATISTICS_EXACT_SAMPLES]; // Sorted
+    statistics_psquare_t quantiles[STATISTICS_QUANTILE_COUNT];
+} statistics_accumulator_t;
+
+typedef struct
+{
+    uint32_t start; // Unit in seconds since boot.
+    statistics_accumulator_t metrics[STATISTICS_METRIC_MAX];
+} statistics_window_state_t;
+
+/* Only accessed by the statistics task */
+static statistics_window_state_t s_windows[STATISTICS_WINDOW_MAX];
+static spmc_ring_reader_t s_readers[SAMPLE_BUS_SOURCE_MAX];
+
+/* Completed windows, read by other tasks */
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static statistics_result_t s_results[STATISTICS_WINDOW_MAX];
+
+/* count is the number of samples the estimator saw before this one */
+static void statistics_psquare_add(statistics_psquare_t *estimator, float p, uint32_t count, float value)
+{
+    float *height = estimator->height;
+    int32_t *position = estimator->position;
+    const float increments[PSQUARE_MARKERS] = {0, p / 2, p, (1 + p) / 2, 1};
+
+    if (count < PSQUARE_MARKERS)
+    {
+        /* Insertion sort of the first samples, they become the initial markers */
+        uint32_t i = count;
+        for (; i > 0 && height[i - 1] > value; i--)
+        {
+            height[i] = height[i - 1];
+        }
+        height[i] = value;
+
+        if (count == PSQUARE_MARKERS - 1)
+        {
+            for (uint8_t marker = 0; marker < PSQUARE_MARKERS; marker++)
+            {
+                position[marker] = marker;
+            }
+        }
+        return;
+    }
+
+    /* Cell the sample falls in, the extreme markers follow the minimum and maximum */
+    uint8_t cell;
+    if (value < height[0])
+    {
+        height[0] = value;
+        cell = 0;
+    }
+    else if (value >= height[4])
+    {
+        height[4] = value;
+        cell = 3;
+    }
+    else
+    {
+        for (cell = 0; value >= height[cell + 1]; cell++)
+        {
+        }
+    }
+
+    for (uint8_t marker = cell + 1; marker < PSQUARE_MARKERS; marker++)
+    {
+        position[marker]++;
+    }
+    for (uint8_t marker = 1; marker < PSQUARE_MARKERS - 1; marker++)
+    {
+        float offset = count * increments[marker] - position[marker];
+        int32_t below = position[marker - 1] - position[marker];
+        int32_t above = position[marker + 1] - position[marker];
+        if ((offset < 1 || above <= 1) && (offset > -1 || below >= -1))
+        {
+            continue;
+        }
+
+        int32_t step = offset > 0 ? 1 : -1;
+        float parabolic = height[marker] +
+                          (float)step / (above - below) *
+                              ((step - below) * (height[marker + 1] - height[marker]) / above +
+                               (above - step) * (height[marker] - height[marker - 1]) / -below);
+        if (height[marker - 1] < parabolic && parabolic < height[marker + 1])
+        {
+            height[marker] = parabolic;
+        }
+        else
+        {
+            /* The parabola overshoots a neighbour, fall back to a linear step */
+            height[marker] += step * (height[marker + step] - height[marker]) /
+                              (position[marker + step] - position[marker]);
+        }
+        position[marker] += step;
+    }
+}
+
+/* p of the sorted samples, interpolated between the closest ranks */
+static float statistics_exact_get(const int32_t *sorted, float p, uint32_t count)
+{
+    float rank = p * (count - 1);
+    uint32_t lower = (uint32_t)rank;
+    if (lower + 1 >= count)
+    {
+        return sorted[count - 1];
+    }
+    return sorted[lower] + (rank - lower) * (sorted[lower + 1] - sorted[lower]);
+}
+
+static void statistics_accumulator_add(statistics_accumulator_t *accumulator, int32_t value)
+{
+    if (accumulator->count < STATISTICS_EXACT_SAMPLES)
+    {
+        uint32_t i = accumulator->count;
+        for (; i > 0 && accumulator->first[i - 1] > value; i--)
+        {
+            accumulator->first[i] = accumulator->first[i - 1];
+        }
+        accumulator->first[i] = value;
+    }
+    for (uint8_t i = 0; i < STATISTICS_QUANTILE_COUNT; i++)
+    {
+        statistics_psquare_add(&accumulator->quantiles[i], s_quantiles[i], accumulator->count, value);
+    }
+    if (accumulator->count == 0 || value < accumulator->min)
+    {
+        accumulator->min = value;
+    }
+    if (accumulator->count == 0 || value > accumulator->max)
+    {
+        accumulator->max = value;
+    }
+    accumulator->sum += value;
+    accumulator->count++;
+}
+
+static void statistics_accumulator_summarize(const statistics_accumulator_t *accumulator, statistics_summary_t *summary)
+{
+    float percentiles[STATISTICS_QUANTILE_COUNT];
+
+    memset(summary, 0, sizeof(*summary));
+    if (accumulator->count == 0)
+    {
+        return;
+    }
+
+    for (uint8_t i = 0; i < STATISTICS_QUANTILE_COUNT; i++)
+    {
+        float estimate = accumulator->count <= STATISTICS_EXACT_SAMPLES
+                             ? statistics_exact_get(accumulator->first, s_quantiles[i], accumulator->count)
+                             : accumulator->quantiles[i].height[2];
+        /* Float rounding may move an estimate just outside of the exact range */
+        if (estimate < accumulator->min)
+        {
+            estimate = accumulator->min;
+        }
+        else if (estimate > accumulator->max)
+        {
+            estimate = accumulator->max;
+        }
+        percentiles[i] = estimate;
+    }
+    summary->count = accumulator->count;
+    summary->min = accumulator->min;
+    summary->max = accumulator->max;
+    summary->mean = (float)accumulator->sum / accumulator->count;
+    summary->p50 = percentiles[0];
+    summary->p95 = percentiles[1];
+}
+
+/* Completes every window that ends at or before now and starts the window now falls in */
+static void statistics_close_windows(uint32_t now)
+{
+    for (uint8_t window = 0; window < STATISTICS_WINDOW_MAX; window++)
+    {
+        statistics_window_state_t *state = &s_windows[window];
+        uint32_t duration = s_window_durations[window];
+        if (now < state->start + duration)
+        {
+            continue;
+        }
+
+        statistics_result_t result = {
+            .end = state->start + duration,
+            .duration = duration};
+        for (uint8_t metric = 0; metric < STATISTICS_METRIC_MAX; metric++)
+        {
+            statistics_accumulator_summarize(&state->metrics[metric], &result.metrics[metric]);
+        }
+
+        portENTER_CRITICAL(&s_lock);
+        result.sequence = s_results[window].sequence + 1;
+        s_results[window] = result;
+        portEXIT_CRITICAL(&s_lock);
+
+        /* Windows without any sensor running are skipped, not completed empty one by one */
+        memset(state, 0, sizeof(*state));
+        state->start = now - now % duration;
+    }
+}
+
+static void statistics_add_sample(sample_bus_source_t source, const sample_bus_sample_t *sample)
+{
+    /* A sample that is read after its window was closed counts into the next one */
+    statistics_close_windows((uint32_t)(sample->timestamp_us / 1000000));
+
+    for (uint8_t window = 0; window < STATISTICS_WINDOW_MAX; window++)
+    {
+        statistics_accumulator_t *metrics = s_windows[window].metrics;
+        switch (source)
+        {
+        case SAMPLE_BUS_SOURCE_VOC:
+            statistics_accumulator_add(&metrics[STATISTICS_METRIC_VOC], sample->voc.voc_index);
+            statistics_accumulator_add(&metrics[STATISTICS_METRIC_TEMPERATURE], sample->voc.temperature);
+            statistics_accumulator_add(&metrics[STATISTICS_METRIC_RHUMIDITY], sample->voc.rhumidity);
+            break;
+        case SAMPLE_BUS_SOURCE_CO2:
+            statistics_accumulator_add(&metrics[STATISTICS_METRIC_CO2], sample->co2.co2);
+            break;
+        case SAMPLE_BUS_SOURCE_PM:
+            statistics_accumulator_add(&metrics[STATISTICS_METRIC_PM2P5], sample->pm.mc_2p5);
+            statistics_accumulator_add(&metrics[STATISTICS_METRIC_PM10P0], sample->pm.mc_10p0);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+static void statistics_task(void *pvParameters)
+{
+    sample_bus_subscriber_t subscriber = pvParameters;
+    sample_bus_sample_t sample;
+
+    while (1)
+    {
+        sample_bus_wait(subscriber, pdMS_TO_TICKS(STATISTICS_PERIOD_MS));
+
+        /* Every sample from the history, not only the latest one, so that a window sees all the
+        samples of a sensor even when this task was delayed */
+        for (uint8_t source = 0; source < SAMPLE_BUS_SOURCE_MAX; source++)
+        {
+            const spmc_ring_t *history = sample_bus_history(source);
+            spmc_ring_status_t status;
+            while ((status = spmc_ring_pop(history, &s_readers[source], &sample)) != SPMC_RING_EMPTY)
+            {
+                if (status == SPMC_RING_OK)
+                {
+                    statistics_add_sample(source, &sample);
+                }
+            }
+        }
+
+        statistics_close_windows((uint32_t)(esp_timer_get_time() / 1000000));
+    }
+}
+
+void statistics_init()
+{
+    sample_bus_subscriber_t subscriber = sample_bus_subscribe(SAMPLE_BUS_ALL_SOURCES);
+    if (subscriber == NULL)
+    {
+        ESP_LOGE(TAG, "Error subscribing to the sample bus");
+        return;
+    }
+
+    for (uint8_t source = 0; source < SAMPLE_BUS_SOURCE_MAX; source++)
+    {
+        spmc_ring_reader_init(sample_bus_history(source), &s_readers[source], 0);
+    }
+
+    uint32_t now = (uint32_t)(esp_timer_get_time() / 1000000);
+    for (uint8_t window = 0; window < STATISTICS_WINDOW_MAX; window++)
+    {
+        s_windows[window].start = now - now % s_window_durations[window];
+    }
+
+    xTaskCreate(statistics_task, "statistics task", 1024 * 3, subscriber, 4, NULL);
+}
+
+uint32_t statistics_window_duration(statistics_window_t window)
+{
+    return s_window_durations[window];
+}
+
+bool statistics_get(statistics_window_t window, statistics_result_t *result)
+{
+    portENTER_CRITICAL(&s_lock);
+    *result = s_results[window];
+    portEXIT_CRITICAL(&s_lock);
+
+    return result->sequence != 0;
+}
+
+bool statistics_get_if_newer(statistics_window_t window, uint32_t *last_sequence, statistics_result_t *result)
+{
+    bool newer = false;
+
+    portENTER_CRITICAL(&s_lock);
+    if (s_results[window].sequence != *last_sequence)
+    {
+        *result = s_results[window];
+        *last_sequence = result->sequence;
+        newer = true;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    return newer;
+}
\ No newline at end of file
@@ -0,0 +1,85 @@
+#ifndef COMPONENTS_STATISTICS_H
+#define COMPONENTS_STATISTICS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Metrics the statistics are kept for. Values use the scaling of the sample bus, see the comment
+of each member. */
+typedef enum
+{
+    STATISTICS_METRIC_VOC = 0,     // Divide by 10 to get real value.
+    STATISTICS_METRIC_TEMPERATURE, // Divide by 200 to get real value. Unit in C.
+    STATISTICS_METRIC_RHUMIDITY,   // Divide by 100 to get real value. Unit in %.
+    STATISTICS_METRIC_CO2,         // Unit in ppm.
+    STATISTICS_METRIC_PM2P5,       // Divide by 10 to get real value. Unit in ug/m3.
+    STATISTICS_METRIC_PM10P0,      // Divide by 10 to get real value. Unit in ug/m3.
+    STATISTICS_METRIC_MAX
+} statistics_metric_t;
+
+/* Windows are tumbling and aligned to the time since boot: the 15 min window covers minute 0 to
+15, then 15 to 30 and so on. */
+typedef enum
+{
+    STATISTICS_WINDOW_1MIN = 0,
+    STATISTICS_WINDOW_15MIN,
+    STATISTICS_WINDOW_24H,
+    STATISTICS_WINDOW_MAX
+} statistics_window_t;
+
+typedef struct
+{
+    uint32_t count; // Samples in the window. The other fields are 0 when there were none.
+    int32_t min;
+    int32_t max;
+    float mean;
+    float p50; // Estimated, exact up to 16 samples.
+    float p95; // Estimated, exact up to 16 samples.
+} statistics_summary_t;
+
+typedef struct
+{
+    uint32_t sequence; // Incremented every time a window of this length completes.
+    uint32_t end;      // Unit in seconds since boot.
+    uint32_t duration; // Unit in seconds.
+    statistics_summary_t metrics[STATISTICS_METRIC_MAX];
+} statistics_result_t;
+
+/**
+ * @brief Start the task that feeds every sample published on the sample bus into the windows.
+ * Call before the sensors are started so that no sample is missed.
+ */
+void statistics_init();
+
+/**
+ * @brief Get the length of a window.
+ *
+ * @param[in] window the window.
+ *
+ * @return the length in seconds.
+ */
+uint32_t statistics_window_duration(statistics_window_t window);
+
+/**
+ * @brief Get the last completed window of a length.
+ *
+ * @param[in] window the window length.
+ * @param[out] result copy of the statistics of the window.
+ *
+ * @return false if no window of this length completed yet.
+ */
+bool statistics_get(statistics_window_t window, statistics_result_t *result);
+
+/**
+ * @brief Get the last completed window of a length only if the caller did not see it yet.
+ *
+ * @param[in] window the window length.
+ * @param[in,out] last_sequence sequence number of the last result seen by the caller. Updated when
+ * a newer result is returned.
+ * @param[out] result copy of the statistics of the window, only written when true is returned.
+ *
+ * @return true if a new result was copied, false otherwise.
+ */
+bool statistics_get_if_newer(statistics_window_t window, uint32_t *last_sequence, statistics_result_t *result);
+
+#endif
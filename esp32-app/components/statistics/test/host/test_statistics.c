@@ -0,0 +1,356 @@
+/* Tests of the window statistics on Linux. The test includes statistics.c to feed its estimators
+ * and windows directly, without the statistics task.
+ *
+ *   statistics_test psquare [samples]
+ *   statistics_test windows
+ *
+ * psquare compares the P-square estimates of the median and of the 95th percentile with the exact
+ * percentiles of the same samples, for synthetic streams shaped like sensor data and for the
+ * orders that are hard for the estimator, over a minute and 15 minutes of samples and over the
+ * given count, and prints the errors. windows checks which window a
+ * sample counts into at the boundaries, the summaries of empty, short and long windows, windows
+ * skipped while no sensor runs and the sequence numbers of the results. */
+
+#include <math.h>
+#include <string.h>
+
+#include "host_test.h"
+
+/* The source itself, to test its static estimator and windows directly */
+#include "statistics.c"
+
+#define TEST_MAX_SAMPLES 1000000
+
+typedef enum
+{
+    TEST_STREAM_UNIFORM = 0,
+    TEST_STREAM_NORMAL,
+    TEST_STREAM_EXPONENTIAL,
+    TEST_STREAM_BIMODAL,
+    TEST_STREAM_RANDOM_WALK,
+    TEST_STREAM_ASCENDING,
+    TEST_STREAM_DESCENDING,
+    TEST_STREAM_SAWTOOTH,
+    TEST_STREAM_CONSTANT,
+    TEST_STREAM_MAX
+} test_stream_t;
+
+static const char *const s_stream_names[TEST_STREAM_MAX] = {
+    [TEST_STREAM_UNIFORM] = "uniform",
+    [TEST_STREAM_NORMAL] = "normal",
+    [TEST_STREAM_EXPONENTIAL] = "exponential",
+    [TEST_STREAM_BIMODAL] = "bimodal",
+    [TEST_STREAM_RANDOM_WALK] = "random walk",
+    [TEST_STREAM_ASCENDING] = "ascending",
+    [TEST_STREAM_DESCENDING] = "descending",
+    [TEST_STREAM_SAWTOOTH] = "sawtooth",
+    [TEST_STREAM_CONSTANT] = "constant",
+};
+
+static int32_t s_samples[TEST_MAX_SAMPLES];
+static int32_t s_sorted[TEST_MAX_SAMPLES];
+
+static void test_generate(test_stream_t stream, uint32_t count)
+{
+    uint32_t random = 0x5EED + stream;
+    int32_t walk = 800;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        int32_t value = 0;
+        switch (stream)
+        {
+        case TEST_STREAM_UNIFORM:
+            value = host_test_random(&random) % 10000;
+            break;
+        case TEST_STREAM_NORMAL:
+            /* Irwin-Hall, close enough to a normal distribution */
+            for (uint8_t j = 0; j < 12; j++)
+            {
+                value += host_test_random(&random) % 1000;
+            }
+            break;
+        case TEST_STREAM_EXPONENTIAL:
+            value = (int32_t)(-500 * logf((host_test_random(&random) + 1.0f) / 4294967296.0f));
+            break;
+        case TEST_STREAM_BIMODAL:
+            /* CO2 of an empty and of an occupied room */
+            value = host_test_random(&random) % 4 != 0 ? 420 + host_test_random(&random) % 40
+                                                        : 1800 + host_test_random(&random) % 400;
+            break;
+        case TEST_STREAM_RANDOM_WALK:
+            /* Drifts like a sensor reading, pulled back to where it started */
+            walk += (int32_t)(host_test_random(&random) % 11) - 5 - (walk - 800) / 256;
+            value = walk;
+            break;
+        case TEST_STREAM_ASCENDING:
+            value = i;
+            break;
+        case TEST_STREAM_DESCENDING:
+            value = count - i;
+            break;
+        case TEST_STREAM_SAWTOOTH:
+            value = i % 1000;
+            break;
+        default:
+            value = 42;
+            break;
+        }
+        s_samples[i] = value;
+    }
+}
+
+static int test_compare(const void *a, const void *b)
+{
+    int32_t x = *(const int32_t *)a;
+    int32_t y = *(const int32_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* Exact percentile with the interpolation of statistics_exact_get() */
+static float test_exact(const int32_t *samples, uint32_t count, float p)
+{
+    memcpy(s_sorted, samples, count * sizeof(*samples));
+    qsort(s_sorted, count, sizeof(*s_sorted), test_compare);
+    return statistics_exact_get(s_sorted, p, count);
+}
+
+/* Largest error of an estimate, in percent of the range of the samples, from 1000 samples on. The
+markers lag behind slow drifts, which the random walk and the sawtooth have. */
+static const float s_max_error_percent[TEST_STREAM_MAX] = {
+    [TEST_STREAM_UNIFORM] = 1.0f,
+    [TEST_STREAM_NORMAL] = 1.0f,
+    [TEST_STREAM_EXPONENTIAL] = 1.0f,
+    [TEST_STREAM_BIMODAL] = 1.0f,
+    [TEST_STREAM_RANDOM_WALK] = 5.0f,
+    [TEST_STREAM_ASCENDING] = 1.0f,
+    [TEST_STREAM_DESCENDING] = 1.0f,
+    [TEST_STREAM_SAWTOOTH] = 3.0f,
+    [TEST_STREAM_CONSTANT] = 0.0f,
+};
+
+/* Short windows, e.g. the 60 samples of a minute, only get a rough estimate of the tail */
+#define TEST_SHORT_SAMPLES 1000
+#define TEST_SHORT_MAX_ERROR_PERCENT 10.0f
+
+static float test_max_error_percent(test_stream_t stream, uint32_t count)
+{
+    return count < TEST_SHORT_SAMPLES ? TEST_SHORT_MAX_ERROR_PERCENT : s_max_error_percent[stream];
+}
+
+static void test_psquare(uint32_t count)
+{
+    HOST_CHECK(count > STATISTICS_EXACT_SAMPLES && count <= TEST_MAX_SAMPLES);
+
+    for (test_stream_t stream = 0; stream < TEST_STREAM_MAX; stream++)
+    {
+        statistics_accumulator_t accumulator;
+        statistics_summary_t summary;
+
+        test_generate(stream, count);
+        memset(&accumulator, 0, sizeof(accumulator));
+        for (uint32_t i = 0; i < count; i++)
+        {
+            statistics_accumulator_add(&accumulator, s_samples[i]);
+        }
+        statistics_accumulator_summarize(&accumulator, &summary);
+
+        float p50 = test_exact(s_samples, count, 0.50f);
+        float p95 = test_exact(s_samples, count, 0.95f);
+        float range = s_sorted[count - 1] - s_sorted[0];
+        float error50 = range > 0 ? fabsf(summary.p50 - p50) * 100 / range : fabsf(summary.p50 - p50);
+        float error95 = range > 0 ? fabsf(summary.p95 - p95) * 100 / range : fabsf(summary.p95 - p95);
+        printf("%-12s p50 %9.1f exact %9.1f error %5.2f%%, p95 %9.1f exact %9.1f error %5.2f%%\n",
+               s_stream_names[stream], summary.p50, p50, error50, summary.p95, p95, error95);
+
+        HOST_CHECK_EQUAL(summary.count, count);
+        HOST_CHECK_EQUAL(summary.min, s_sorted[0]);
+        HOST_CHECK_EQUAL(summary.max, s_sorted[count - 1]);
+        HOST_CHECK(summary.min <= summary.p50 && summary.p50 <= summary.p95 && summary.p95 <= summary.max);
+        HOST_CHECK(error50 <= test_max_error_percent(stream, count));
+        HOST_CHECK(error95 <= test_max_error_percent(stream, count));
+    }
+}
+
+/* Up to STATISTICS_EXACT_SAMPLES the percentiles are the exact ones */
+static void test_exact_samples(void)
+{
+    uint32_t random = 0xE8AC;
+
+    for (uint32_t count = 1; count <= STATISTICS_EXACT_SAMPLES; count++)
+    {
+        for (uint32_t round = 0; round < 100; round++)
+        {
+            statistics_accumulator_t accumulator;
+            statistics_summary_t summary;
+            int64_t sum = 0;
+
+            memset(&accumulator, 0, sizeof(accumulator));
+            for (uint32_t i = 0; i < count; i++)
+            {
+                s_samples[i] = (int32_t)(host_test_random(&random) % 2001) - 1000;
+                sum += s_samples[i];
+                statistics_accumulator_add(&accumulator, s_samples[i]);
+            }
+            statistics_accumulator_summarize(&accumulator, &summary);
+            HOST_CHECK_EQUAL(summary.count, count);
+            HOST_CHECK(summary.p50 == test_exact(s_samples, count, 0.50f));
+            HOST_CHECK(summary.p95 == test_exact(s_samples, count, 0.95f));
+            HOST_CHECK_EQUAL(summary.min, s_sorted[0]);
+            HOST_CHECK_EQUAL(summary.max, s_sorted[count - 1]);
+            HOST_CHECK(summary.mean == (float)sum / count);
+        }
+    }
+}
+
+/* The estimator alone: the markers stay sorted and within the samples seen, for every count right
+after the initial markers */
+static void test_psquare_markers(void)
+{
+    uint32_t random = 0x3A4C;
+
+    for (uint32_t count = 1; count <= 64; count++)
+    {
+        statistics_psquare_t estimator;
+        float min = INFINITY;
+        float max = -INFINITY;
+
+        memset(&estimator, 0, sizeof(estimator));
+        for (uint32_t i = 0; i < count; i++)
+        {
+            float value = (float)(host_test_random(&random) % 100);
+            min = value < min ? value : min;
+            max = value > max ? value : max;
+            statistics_psquare_add(&estimator, 0.95f, i, value);
+        }
+        if (count < PSQUARE_MARKERS)
+        {
+            continue;
+        }
+        HOST_CHECK(estimator.height[0] == min);
+        HOST_CHECK(estimator.height[PSQUARE_MARKERS - 1] == max);
+        for (uint8_t marker = 1; marker < PSQUARE_MARKERS; marker++)
+        {
+            HOST_CHECK(estimator.height[marker - 1] <= estimator.height[marker]);
+            HOST_CHECK(estimator.position[marker - 1] < estimator.position[marker]);
+        }
+        HOST_CHECK_EQUAL(estimator.position[PSQUARE_MARKERS - 1], count - 1);
+    }
+}
+
+static void test_add_co2(uint64_t timestamp_ms, uint16_t co2)
+{
+    sample_bus_sample_t sample = {.timestamp_us = (int64_t)timestamp_ms * 1000, .co2 = {.co2 = co2}};
+    statistics_add_sample(SAMPLE_BUS_SOURCE_CO2, &sample);
+}
+
+static void test_check_result(statistics_window_t window, uint32_t sequence, uint32_t end, uint32_t count)
+{
+    statistics_result_t result;
+
+    HOST_CHECK(statistics_get(window, &result));
+    HOST_CHECK_EQUAL(result.sequence, sequence);
+    HOST_CHECK_EQUAL(result.end, end);
+    HOST_CHECK_EQUAL(result.duration, statistics_window_duration(window));
+    HOST_CHECK_EQUAL(result.metrics[STATISTICS_METRIC_CO2].count, count);
+    /* Only CO2 was published */
+    HOST_CHECK_EQUAL(result.metrics[STATISTICS_METRIC_PM2P5].count, 0);
+    HOST_CHECK(result.metrics[STATISTICS_METRIC_PM2P5].mean == 0);
+}
+
+static void test_windows(void)
+{
+    statistics_result_t result;
+    uint32_t sequence = 0;
+
+    /* Started at boot, nothing completed yet */
+    memset(s_windows, 0, sizeof(s_windows));
+    memset(s_results, 0, sizeof(s_results));
+    for (statistics_window_t window = 0; window < STATISTICS_WINDOW_MAX; window++)
+    {
+        HOST_CHECK(!statistics_get(window, &result));
+    }
+    HOST_CHECK(!statistics_get_if_newer(STATISTICS_WINDOW_1MIN, &sequence, &result));
+
+    /* The last millisecond of the first minute still counts into it */
+    test_add_co2(0, 400);
+    test_add_co2(30000, 500);
+    test_add_co2(59999, 600);
+    HOST_CHECK(!statistics_get(STATISTICS_WINDOW_1MIN, &result));
+
+    /* The first sample of the next minute closes it and counts into the next one */
+    test_add_co2(60000, 1000);
+    test_check_result(STATISTICS_WINDOW_1MIN, 1, 60, 3);
+    statistics_get(STATISTICS_WINDOW_1MIN, &result);
+    HOST_CHECK_EQUAL(result.metrics[STATISTICS_METRIC_CO2].min, 400);
+    HOST_CHECK_EQUAL(result.metrics[STATISTICS_METRIC_CO2].max, 600);
+    HOST_CHECK(result.metrics[STATISTICS_METRIC_CO2].mean == 500);
+    HOST_CHECK(result.metrics[STATISTICS_METRIC_CO2].p50 == 500);
+    HOST_CHECK(!statistics_get(STATISTICS_WINDOW_15MIN, &result));
+
+    HOST_CHECK(statistics_get_if_newer(STATISTICS_WINDOW_1MIN, &sequence, &result));
+    HOST_CHECK_EQUAL(sequence, 1);
+    HOST_CHECK(!statistics_get_if_newer(STATISTICS_WINDOW_1MIN, &sequence, &result));
+
+    /* Closing on time without a sample, as the task does every second */
+    statistics_close_windows(119);
+    HOST_CHECK(!statistics_get_if_newer(STATISTICS_WINDOW_1MIN, &sequence, &result));
+    statistics_close_windows(120);
+    test_check_result(STATISTICS_WINDOW_1MIN, 2, 120, 1);
+
+    /* An empty minute completes with a count of 0 */
+    statistics_close_windows(180);
+    test_check_result(STATISTICS_WINDOW_1MIN, 3, 180, 0);
+    statistics_get(STATISTICS_WINDOW_1MIN, &result);
+    HOST_CHECK(result.metrics[STATISTICS_METRIC_CO2].p95 == 0);
+
+    /* Minutes without any sensor running are skipped: one result for the window before the gap,
+    the next window is the one the sample falls in */
+    test_add_co2(185000, 700);
+    test_add_co2(899999, 800);
+    test_check_result(STATISTICS_WINDOW_1MIN, 4, 240, 1);
+    HOST_CHECK(!statistics_get(STATISTICS_WINDOW_15MIN, &result));
+    test_add_co2(900000, 900);
+    test_check_result(STATISTICS_WINDOW_1MIN, 5, 900, 1);
+    test_check_result(STATISTICS_WINDOW_15MIN, 1, 900, 6);
+
+    /* A sample every second for the rest of the day, the 24 h window sees all of them */
+    for (uint32_t second = 901; second < 24 * 60 * 60; second++)
+    {
+        test_add_co2(second * 1000ull, 400 + second % 1000);
+    }
+    HOST_CHECK(!statistics_get(STATISTICS_WINDOW_24H, &result));
+    statistics_close_windows(24 * 60 * 60);
+    test_check_result(STATISTICS_WINDOW_24H, 1, 24 * 60 * 60, 7 + 24 * 60 * 60 - 901);
+    test_check_result(STATISTICS_WINDOW_15MIN, 96, 24 * 60 * 60, 15 * 60);
+    test_check_result(STATISTICS_WINDOW_1MIN, 5 + 24 * 60 - 15, 24 * 60 * 60, 60);
+
+    statistics_get(STATISTICS_WINDOW_24H, &result);
+    HOST_CHECK_EQUAL(result.metrics[STATISTICS_METRIC_CO2].min, 400);
+    HOST_CHECK_EQUAL(result.metrics[STATISTICS_METRIC_CO2].max, 1399);
+    HOST_CHECK(fabsf(result.metrics[STATISTICS_METRIC_CO2].p50 - 900) < 10);
+    HOST_CHECK(fabsf(result.metrics[STATISTICS_METRIC_CO2].p95 - 1350) < 10);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc >= 2 && strcmp(argv[1], "psquare") == 0)
+    {
+        test_exact_samples();
+        test_psquare_markers();
+        /* A minute and 15 minutes of samples once a second, then many more */
+        test_psquare(60);
+        test_psquare(900);
+        test_psquare(host_test_arg(argc, argv, 2, 100000));
+        printf("statistics P-square tests passed\n");
+        return EXIT_SUCCESS;
+    }
+    if (argc >= 2 && strcmp(argv[1], "windows") == 0)
+    {
+        test_windows();
+        printf("statistics window tests passed\n");
+        return EXIT_SUCCESS;
+    }
+    fprintf(stderr, "usage: %s psquare [samples] | windows\n", argv[0]);
+    return EXIT_FAILURE;
+}
@@ -79,14 +79,8 @@ int16_t svm40_read_measured_values_as_integers(int16_t* voc_index,
     uint16_t offset = 0;
     offset = sensirion_i2c_add_command_to_buffer(&buffer[0], offset, 0x3A6);
 
-    error = sensirion_i2c_write_data(SVM40_I2C_ADDRESS, &buffer[0], offset);
-    if (error) {
-        return error;
-    }
-
-    sensirion_i2c_hal_sleep_usec(1000);
-
-    error = sensirion_i2c_read_data_inplace(SVM40_I2C_ADDRESS, &buffer[0], 6);
+    error = sensirion_i2c_write_read_data_inplace(
+        SVM40_I2C_ADDRESS, &buffer[0], offset, 1000, 6);
     if (error) {
         return error;
     }
@@ -104,14 +98,8 @@ int16_t svm40_read_measured_values_as_integers_with_raw_parameters(
     uint16_t offset = 0;
     offset = sensirion_i2c_add_command_to_buffer(&buffer[0], offset, 0x3B0);
 
-    error = sensirion_i2c_write_data(SVM40_I2C_ADDRESS, &buffer[0], offset);
-    if (error) {
-        return error;
-    }
-
-    sensirion_i2c_hal_sleep_usec(1000);
-
-    error = sensirion_i2c_read_data_inplace(SVM40_I2C_ADDRESS, &buffer[0], 12);
+    error = sensirion_i2c_write_read_data_inplace(
+        SVM40_I2C_ADDRESS, &buffer[0], offset, 1000, 12);
     if (error) {
         return error;
     }
@@ -140,14 +128,8 @@ int16_t svm40_get_temperature_offset_for_rht_measurements(int16_t* t_offset) {
     uint16_t offset = 0;
     offset = sensirion_i2c_add_command_to_buffer(&buffer[0], offset, 0x6014);
 
-    error = sensirion_i2c_write_data(SVM40_I2C_ADDRESS, &buffer[0], offset);
-    if (error) {
-        return error;
-    }
-
-    sensirion_i2c_hal_sleep_usec(1000);
-
-    error = sensirion_i2c_read_data_inplace(SVM40_I2C_ADDRESS, &buffer[0], 2);
+    error = sensirion_i2c_write_read_data_inplace(
+        SVM40_I2C_ADDRESS, &buffer[0], offset, 1000, 2);
     if (error) {
         return error;
     }
@@ -182,14 +164,8 @@ int16_t svm40_get_voc_algorithm_tuning_parameters(
     uint16_t offset = 0;
     offset = sensirion_i2c_add_command_to_buffer(&buffer[0], offset, 0x6083);
 
-    error = sensirion_i2c_write_data(SVM40_I2C_ADDRESS, &buffer[0], offset);
-    if (error) {
-        return error;
-    }
-
-    sensirion_i2c_hal_sleep_usec(1000);
-
-    error = sensirion_i2c_read_data_inplace(SVM40_I2C_ADDRESS, &buffer[0], 8);
+    error = sensirion_i2c_write_read_data_inplace(
+        SVM40_I2C_ADDRESS, &buffer[0], offset, 1000, 8);
     if (error) {
         return error;
     }
@@ -233,14 +209,8 @@ int16_t svm40_get_voc_algorithm_state(uint8_t* state, uint8_t state_size) {
     uint16_t offset = 0;
     offset = sensirion_i2c_add_command_to_buffer(&buffer[0], offset, 0x6181);
 
-    error = sensirion_i2c_write_data(SVM40_I2C_ADDRESS, &buffer[0], offset);
-    if (error) {
-        return error;
-    }
-
-    sensirion_i2c_hal_sleep_usec(1000);
-
-    error = sensirion_i2c_read_data_inplace(SVM40_I2C_ADDRESS, &buffer[0], 8);
+    error = sensirion_i2c_write_read_data_inplace(
+        SVM40_I2C_ADDRESS, &buffer[0], offset, 1000, 8);
     if (error) {
         return error;
     }
@@ -257,14 +227,8 @@ int16_t svm40_get_version(uint8_t* firmware_major, uint8_t* firmware_minor,
     uint16_t offset = 0;
     offset = sensirion_i2c_add_command_to_buffer(&buffer[0], offset, 0xD100);
 
-    error = sensirion_i2c_write_data(SVM40_I2C_ADDRESS, &buffer[0], offset);
-    if (error) {
-        return error;
-    }
-
-    sensirion_i2c_hal_sleep_usec(1000);
-
-    error = sensirion_i2c_read_data_inplace(SVM40_I2C_ADDRESS, &buffer[0], 8);
+    error = sensirion_i2c_write_read_data_inplace(
+        SVM40_I2C_ADDRESS, &buffer[0], offset, 1000, 8);
     if (error) {
         return error;
     }
@@ -285,14 +249,8 @@ int16_t svm40_get_serial_number(unsigned char* serial_number,
     uint16_t offset = 0;
     offset = sensirion_i2c_add_command_to_buffer(&buffer[0], offset, 0xD033);
 
-    error = sensirion_i2c_write_data(SVM40_I2C_ADDRESS, &buffer[0], offset);
-    if (error) {
-        return error;
-    }
-
-    sensirion_i2c_hal_sleep_usec(1000);
-
-    error = sensirion_i2c_read_data_inplace(SVM40_I2C_ADDRESS, &buffer[0], 26);
+    error = sensirion_i2c_write_read_data_inplace(
+        SVM40_I2C_ADDRESS, &buffer[0], offset, 1000, 26);
     if (error) {
         return error;
     }
@@ -1,65 +1,396 @@
+#include <math.h>
+
 #include "telemetry.h"
 #include "telemetry_data_structures.h"
 #include "telemetry_enums.h"
+#include "telemetry_frame.h"
+#include "telemetry_store.h"
+#include "telemetry_mqtt.h"
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 
-#include "voc_index.h"
-#include "co2.h"
-#include "particulate_matter.h"
+#include "sample_bus.h"
+#include "statistics.h"
+#include "aqi.h"
 
 #define TAG "telemetry.c"
 
+#define TELEMETRY_SAMPLE_PERIOD_MS 10000
+
+/* Samples per frame, one frame per minute */
+#define TELEMETRY_BATCH_SIZE 6
+
+/* The forward task wakes up at least this often to retry and to expire frames in flight */
+#define TELEMETRY_FORWARD_PERIOD_MS 5000
+
+/* A frame in flight that is not acknowledged within this time is sent again. Longer than the
+MQTT outbox expiry so that the transport gave up retransmitting it first. */
+#define TELEMETRY_ACK_TIMEOUT_MS 60000
+
+typedef struct
+{
+    bool in_use;
+    int32_t token;
+    telemetry_store_position_t position;
+    int64_t sent_us;
+} telemetry_in_flight_t;
+
+/* Kept off the task stack */
+static telemetry_frame_encoder_t s_encoder;
+static char s_hex[2 * TELEMETRY_FRAME_MAX_SIZE + 1];
+static uint8_t s_batch[TELEMETRY_STORE_SECTOR_SIZE];
+static telemetry_store_record_t s_records[TELEMETRY_MAX_WINDOW];
+static telemetry_in_flight_t s_in_flight[TELEMETRY_MAX_WINDOW];
+
+static bool s_store_ready;
+static TaskHandle_t s_forward_task;
+static QueueHandle_t s_acks;
+
+/* Set from the transport, read by the forward task */
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static telemetry_send_t s_send;
+static uint8_t s_window;
+static telemetry_uplink_stats_t s_uplink_stats;
+
+#ifdef CONFIG_TELEMETRY_STATISTICS
+static void telemetry_send_statistics_task(void *pvParameters);
+#else
 static void telemetry_send_airqualitydata_task(void *pvParameters);
+#endif
+static void telemetry_forward_task(void *pvParameters);
 
+static void telemetry_log_frame(const uint8_t *frame, size_t length)
+{
+    static const char digits[] = "0123456789abcdef";
+
+    /* Two hex digits per byte so that the payload can be decoded again */
+    for (size_t i = 0; i < length; i++)
+    {
+        s_hex[2 * i] = digits[frame[i] >> 4];
+        s_hex[2 * i + 1] = digits[frame[i] & 0x0F];
+    }
+    s_hex[2 * length] = '\0';
+    ESP_LOGI(TAG, "airquality telemetry frame, %zu bytes: %s", length, s_hex);
+}
+
+#ifndef CONFIG_TELEMETRY_STATISTICS
 static void telemetry_send_airqualitydata_task(void *pvParameters)
 {
+    (void)pvParameters;
+    const telemetry_header_t header = {
+        .type = TELEMETRY_TYPE_AIRQUALITY,
+        .device_type = TELEMETRY_DEVICE_TYPE_ECM,
+        .serial = 0x1122334455667788};
+
+    telemetry_frame_begin(&s_encoder, &header);
+
     while (1)
     {
-        vTaskDelay(pdMS_TO_TICKS(10000));
+        vTaskDelay(pdMS_TO_TICKS(TELEMETRY_SAMPLE_PERIOD_MS));
         telemetry_airquality_t data;
 
-        int16_t raw_voc;
-        int16_t raw_temp;
-        int16_t raw_hum;
-        uint16_t raw_co2;
-        uint16_t raw_pm2p5;
-        uint16_t raw_pm10p0;
-
-        data.type = TELEMETRY_TYPE_AIRQUALITY;
-        data.device_type = TELEMETRY_DEVICE_TYPE_ECM;
-        data.serial = 0x1122334455667788;
-        data.timestamp = 0xDEADBEEF;
-
-        voc_index_get_voc(&raw_voc);
-        data.voc = raw_voc;
-        voc_index_get_temperature(&raw_temp);
-        data.temperature = raw_temp;
-        voc_index_get_rhumidity(&raw_hum);
-        data.rhumidity = raw_hum;
-        co2_get_co2(&raw_co2);
-        data.co2 = raw_co2;
-        particulate_matter_get_pm2p5(&raw_pm2p5);
-        data.pm2p5 = raw_pm2p5;
-        particulate_matter_get_pm10p0(&raw_pm10p0);
-        data.pm10p0 = raw_pm10p0;
-
-        // Logging on serial the packed air quality data.
-        size_t data_size = sizeof(data);
-        ESP_LOGI(TAG, "%zu", data_size);
-        char *data_ptr = (char *)&data;
-        printf("telemetry.c, airquality telemetry payload: ");
-        while (data_size--)
+        sample_bus_sample_t voc_sample;
+        sample_bus_sample_t co2_sample;
+        sample_bus_sample_t pm_sample;
+        aqi_t aqi;
+
+        /* No wall clock yet, seconds since boot */
+        data.timestamp = (uint32_t)(esp_timer_get_time() / 1000000);
+
+        /* One snapshot per sensor so that fields of the same sensor always belong together */
+        sample_bus_get(SAMPLE_BUS_SOURCE_VOC, &voc_sample);
+        data.voc = voc_sample.voc.voc_index;
+        data.temperature = voc_sample.voc.temperature;
+        data.rhumidity = voc_sample.voc.rhumidity;
+        sample_bus_get(SAMPLE_BUS_SOURCE_CO2, &co2_sample);
+        data.co2 = co2_sample.co2.co2;
+        sample_bus_get(SAMPLE_BUS_SOURCE_PM, &pm_sample);
+        data.pm2p5 = pm_sample.pm.mc_2p5;
+        data.pm10p0 = pm_sample.pm.mc_10p0;
+        /* Computed once per sample by the aqi component, the same index the display shows */
+        aqi_get(&aqi);
+        data.aqi = aqi.index;
+
+        telemetry_frame_add(&s_encoder, &data);
+        if (s_encoder.count == TELEMETRY_BATCH_SIZE)
+        {
+            const uint8_t *frame;
+            size_t length = telemetry_frame_finish(&s_encoder, &frame);
+            telemetry_log_frame(frame, length);
+            if (s_store_ready && telemetry_store_append(frame, length) == ESP_OK)
+            {
+                xTaskNotifyGive(s_forward_task);
+            }
+            telemetry_frame_begin(&s_encoder, &header);
+        }
+    }
+}
+#else
+static void telemetry_statistic_from_summary(const statistics_summary_t *summary, telemetry_statistic_t *statistic)
+{
+    statistic->count = summary->count;
+    statistic->mean = lroundf(summary->mean);
+    statistic->min = summary->min;
+    statistic->max = summary->max;
+    statistic->p50 = lroundf(summary->p50);
+    statistic->p95 = lroundf(summary->p95);
+}
+
+/* Sends every window of the configured lengths once it completed. Windows that complete at the
+same time, e.g. the last 15 minutes of a day, share a frame. */
+static void telemetry_send_statistics_task(void *pvParameters)
+{
+    const telemetry_header_t header = {
+        .type = TELEMETRY_TYPE_AIRQUALITY_STATISTICS,
+        .device_type = TELEMETRY_DEVICE_TYPE_ECM,
+        .serial = 0x1122334455667788};
+    const bool enabled[STATISTICS_WINDOW_MAX] = {
+#ifdef CONFIG_TELEMETRY_STATISTICS_1MIN
+        [STATISTICS_WINDOW_1MIN] = true,
+#endif
+#ifdef CONFIG_TELEMETRY_STATISTICS_15MIN
+        [STATISTICS_WINDOW_15MIN] = true,
+#endif
+#ifdef CONFIG_TELEMETRY_STATISTICS_24H
+        [STATISTICS_WINDOW_24H] = true,
+#endif
+    };
+    uint32_t last_sequence[STATISTICS_WINDOW_MAX] = {0};
+    statistics_result_t result;
+
+    while (1)
+    {
+        vTaskDelay(pdMS_TO_TICKS(TELEMETRY_SAMPLE_PERIOD_MS));
+
+        telemetry_frame_begin(&s_encoder, &header);
+        for (uint8_t window = 0; window < STATISTICS_WINDOW_MAX; window++)
+        {
+            if (!enabled[window] || !statistics_get_if_newer(window, &last_sequence[window], &result))
+            {
+                continue;
+            }
+
+            telemetry_airquality_statistics_t data = {
+                .timestamp = result.end,
+                .duration = result.duration};
+            telemetry_statistic_from_summary(&result.metrics[STATISTICS_METRIC_VOC], &data.voc);
+            telemetry_statistic_from_summary(&result.metrics[STATISTICS_METRIC_TEMPERATURE], &data.temperature);
+            telemetry_statistic_from_summary(&result.metrics[STATISTICS_METRIC_RHUMIDITY], &data.rhumidity);
+            telemetry_statistic_from_summary(&result.metrics[STATISTICS_METRIC_CO2], &data.co2);
+            telemetry_statistic_from_summary(&result.metrics[STATISTICS_METRIC_PM2P5], &data.pm2p5);
+            telemetry_statistic_from_summary(&result.metrics[STATISTICS_METRIC_PM10P0], &data.pm10p0);
+            telemetry_frame_add_statistics(&s_encoder, &data);
+        }
+        if (s_encoder.count == 0)
+        {
+            continue;
+        }
+
+        const uint8_t *frame;
+        size_t length = telemetry_frame_finish(&s_encoder, &frame);
+        telemetry_log_frame(frame, length);
+        if (s_store_ready && telemetry_store_append(frame, length) == ESP_OK)
+        {
+            xTaskNotifyGive(s_forward_task);
+        }
+    }
+}
+#endif
+
+/* Must be called with s_lock held */
+static uint8_t telemetry_count_in_flight(void)
+{
+    uint8_t in_flight = 0;
+    for (uint8_t i = 0; i < TELEMETRY_MAX_WINDOW; i++)
+    {
+        in_flight += s_in_flight[i].in_use;
+    }
+    return in_flight;
+}
+
+/* Consumes the frames that were acknowledged and gives up on the ones that were not in time.
+Returns true if a frame expired. */
+static bool telemetry_collect_acks(int64_t now_us)
+{
+    int32_t token;
+    bool expired = false;
+
+    while (xQueueReceive(s_acks, &token, 0) == pdTRUE)
+    {
+        for (uint8_t i = 0; i < TELEMETRY_MAX_WINDOW; i++)
         {
-            printf("%x", *data_ptr++);
+            telemetry_in_flight_t *frame = &s_in_flight[i];
+            if (frame->in_use && frame->token == token)
+            {
+                /* Acks may arrive in any order, the store keeps track of what is left */
+                telemetry_store_consume(&frame->position);
+
+                uint32_t latency_ms = (now_us - frame->sent_us) / 1000;
+                portENTER_CRITICAL(&s_lock);
+                frame->in_use = false;
+                s_uplink_stats.acked++;
+                s_uplink_stats.total_ack_latency_ms += latency_ms;
+                if (latency_ms > s_uplink_stats.max_ack_latency_ms)
+                {
+                    s_uplink_stats.max_ack_latency_ms = latency_ms;
+                }
+                portEXIT_CRITICAL(&s_lock);
+                break;
+            }
+        }
+    }
+
+    for (uint8_t i = 0; i < TELEMETRY_MAX_WINDOW; i++)
+    {
+        telemetry_in_flight_t *frame = &s_in_flight[i];
+        if (frame->in_use && now_us - frame->sent_us > (int64_t)TELEMETRY_ACK_TIMEOUT_MS * 1000)
+        {
+            portENTER_CRITICAL(&s_lock);
+            frame->in_use = false;
+            s_uplink_stats.expired++;
+            portEXIT_CRITICAL(&s_lock);
+            expired = true;
+        }
+    }
+    return expired;
+}
+
+/* Sends the backlog oldest first. Up to window frames are in flight at the same time instead of
+waiting for the acknowledgement of each one, frames are consumed once they are acknowledged. */
+static void telemetry_forward_task(void *pvParameters)
+{
+    (void)pvParameters;
+    telemetry_store_position_t cursor = {0};
+    bool rewind = false;
+    size_t count;
+
+    while (1)
+    {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(TELEMETRY_FORWARD_PERIOD_MS));
+        rewind |= telemetry_collect_acks(esp_timer_get_time());
+
+        portENTER_CRITICAL(&s_lock);
+        telemetry_send_t send = s_send;
+        uint8_t window = s_window;
+        uint8_t in_flight = telemetry_count_in_flight();
+        portEXIT_CRITICAL(&s_lock);
+
+        if (send == NULL)
+        {
+            continue;
+        }
+        if (rewind)
+        {
+            /* Frames that expired are sent again once the window drained, from the oldest one
+            that was not consumed */
+            if (in_flight > 0)
+            {
+                continue;
+            }
+            cursor.sequence = 0;
+            rewind = false;
+        }
+
+        bool sending = true;
+        while (sending && in_flight < window &&
+               telemetry_store_read_batch(&cursor, s_batch, sizeof(s_batch), s_records, window - in_flight, &count) == ESP_OK &&
+               count > 0)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                int32_t token = send(s_records[i].data, s_records[i].length);
+                if (token < 0)
+                {
+                    /* Continue with this frame next time */
+                    cursor = s_records[i].position;
+                    sending = false;
+                    break;
+                }
+
+                for (uint8_t slot = 0; slot < TELEMETRY_MAX_WINDOW; slot++)
+                {
+                    if (!s_in_flight[slot].in_use)
+                    {
+                        portENTER_CRITICAL(&s_lock);
+                        s_in_flight[slot] = (telemetry_in_flight_t){
+                            .in_use = true,
+                            .token = token,
+                            .position = s_records[i].position,
+                            .sent_us = esp_timer_get_time()};
+                        s_uplink_stats.published++;
+                        in_flight = telemetry_count_in_flight();
+                        if (in_flight > s_uplink_stats.max_in_flight)
+                        {
+                            s_uplink_stats.max_in_flight = in_flight;
+                        }
+                        portEXIT_CRITICAL(&s_lock);
+                        break;
+                    }
+                }
+            }
         }
-        printf("\n");
     }
 }
 
 void telemetry_init()
 {
-    xTaskCreate(telemetry_send_airqualitydata_task, "airqualirt sending task", 1024 * 2, NULL, 5, NULL);
+    s_store_ready = telemetry_store_init() == ESP_OK;
+    if (s_store_ready)
+    {
+        s_acks = xQueueCreate(TELEMETRY_MAX_WINDOW, sizeof(int32_t));
+        xTaskCreate(telemetry_forward_task, "telemetry forward task", 1024 * 3, NULL, 4, &s_forward_task);
+        telemetry_mqtt_start();
+    }
+    else
+    {
+        ESP_LOGE(TAG, "No telemetry store, frames are lost while the uplink is down");
+    }
+#ifdef CONFIG_TELEMETRY_STATISTICS
+    xTaskCreate(telemetry_send_statistics_task, "statistics sending task", 1024 * 3, NULL, 5, NULL);
+#else
+    xTaskCreate(telemetry_send_airqualitydata_task, "airqualirt sending task", 1024 * 3, NULL, 5, NULL);
+#endif
+}
+
+void telemetry_set_sender(telemetry_send_t send, uint8_t window)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_send = send;
+    s_window = window < TELEMETRY_MAX_WINDOW ? window : TELEMETRY_MAX_WINDOW;
+    portEXIT_CRITICAL(&s_lock);
+
+    if (s_forward_task != NULL)
+    {
+        xTaskNotifyGive(s_forward_task);
+    }
+}
+
+void telemetry_frame_delivered(int32_t token)
+{
+    if (s_forward_task != NULL && xQueueSend(s_acks, &token, 0) == pdTRUE)
+    {
+        xTaskNotifyGive(s_forward_task);
+    }
+}
+
+void telemetry_get_uplink_stats(telemetry_uplink_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_uplink_stats;
+    stats->in_flight = telemetry_count_in_flight();
+    portEXIT_CRITICAL(&s_lock);
+}
+
+bool telemetry_get_backlog(telemetry_store_backlog_t *backlog)
+{
+    if (!s_store_ready)
+    {
+        return false;
+    }
+    telemetry_store_get_backlog(backlog);
+    return true;
 }
\ No newline at end of file
@@ -1,9 +1,72 @@
 #ifndef COMPONENTS_TELEMETRY_TELEMETRY_H
 #define COMPONENTS_TELEMETRY_TELEMETRY_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "telemetry_store.h"
+
+/* Frames that can be in flight at the same time */
+#define TELEMETRY_MAX_WINDOW 16
+
+/**
+ * @brief Start delivering one frame to the uplink. The frame is only valid during the call.
+ *
+ * @param[in] frame the encoded frame.
+ * @param[in] length length of the frame in bytes.
+ *
+ * @return a token that is passed to telemetry_frame_delivered() once the frame was acknowledged,
+ * -1 if the frame could not be sent.
+ */
+typedef int32_t (*telemetry_send_t)(const uint8_t *frame, size_t length);
+
+typedef struct
+{
+    uint32_t published;            // Frames handed to the sender.
+    uint32_t acked;                // Frames acknowledged and consumed.
+    uint32_t expired;              // Frames not acknowledged in time, sent again.
+    uint8_t in_flight;             // Frames sent but not acknowledged yet.
+    uint8_t max_in_flight;
+    uint32_t max_ack_latency_ms;   // From sending until the acknowledgement.
+    uint64_t total_ack_latency_ms;
+} telemetry_uplink_stats_t;
+
 /**
  * @brief Start the task for sending telemetry data.
  */ 
 void telemetry_init();
 
-#endif
\ No newline at end of file
+/**
+ * @brief Set the function that delivers frames. Frames are kept in flash until they were
+ * acknowledged.
+ *
+ * @param[in] send the sender, NULL while the uplink is down.
+ * @param[in] window frames that may be in flight at the same time, at most TELEMETRY_MAX_WINDOW.
+ */
+void telemetry_set_sender(telemetry_send_t send, uint8_t window);
+
+/**
+ * @brief Report that the uplink acknowledged a frame. May be called from any task.
+ *
+ * @param[in] token the token returned by the sender for the frame.
+ */
+void telemetry_frame_delivered(int32_t token);
+
+/**
+ * @brief Get the statistics of the uplink.
+ *
+ * @param[out] stats copy of the statistics.
+ */
+void telemetry_get_uplink_stats(telemetry_uplink_stats_t *stats);
+
+/**
+ * @brief Get the number of frames waiting to be sent.
+ *
+ * @param[out] backlog the backlog.
+ *
+ * @return false if there is no telemetry store.
+ */
+bool telemetry_get_backlog(telemetry_store_backlog_t *backlog);
+
+#endif
@@ -4,18 +4,49 @@
 #include <stdint.h>
 #include "telemetry_enums.h"
 
+/* Identifies the device that sent a frame, sent once per frame */
 typedef struct
 {
-    telemetry_type_t type; // 16 bits (?)
-    telemetry_device_type_t device_type; // 16 bits (?)
+    telemetry_type_t type;
+    telemetry_device_type_t device_type;
     uint64_t serial;
-    uint32_t timestamp;
-    int16_t voc;
-    int16_t temperature;
-    int16_t rhumidity;
-    uint16_t co2;
-    uint16_t pm2p5;
-    uint16_t pm10p0;
-} __attribute__((packed)) telemetry_airquality_t;
+} telemetry_header_t;
 
-#endif
\ No newline at end of file
+/* One air quality sample, a frame carries a batch of them */
+typedef struct
+{
+    uint32_t timestamp;  // Unit in seconds.
+    int16_t voc;         // Divide by 10 to get real value.
+    int16_t temperature; // Divide by 200 to get real value. Unit in C.
+    int16_t rhumidity;   // Divide by 100 to get real value. Unit in %.
+    uint16_t co2;        // Unit in ppm.
+    uint16_t pm2p5;      // Divide by 10 to get real value. Unit in ug/m3.
+    uint16_t pm10p0;     // Divide by 10 to get real value. Unit in ug/m3.
+    uint16_t aqi;        // Air quality index of the aqi component, 0 until it is known.
+} telemetry_airquality_t;
+
+/* Statistics of one field of telemetry_airquality_t over a window, in the scaling of the field */
+typedef struct
+{
+    uint32_t count; // Samples in the window. The other fields are 0 when there were none.
+    int32_t mean;
+    int32_t min;
+    int32_t max;
+    int32_t p50;
+    int32_t p95;
+} telemetry_statistic_t;
+
+/* Air quality statistics over a window, sent instead of the samples when configured */
+typedef struct
+{
+    uint32_t timestamp; // End of the window. Unit in seconds.
+    uint32_t duration;  // Unit in seconds.
+    telemetry_statistic_t voc;
+    telemetry_statistic_t temperature;
+    telemetry_statistic_t rhumidity;
+    telemetry_statistic_t co2;
+    telemetry_statistic_t pm2p5;
+    telemetry_statistic_t pm10p0;
+} telemetry_airquality_statistics_t;
+
+#endif
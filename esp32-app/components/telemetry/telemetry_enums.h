@@ -3,7 +3,8 @@
 
 typedef enum
 {
-    TELEMETRY_TYPE_AIRQUALITY = 0
+    TELEMETRY_TYPE_AIRQUALITY = 0,
+    TELEMETRY_TYPE_AIRQUALITY_STATISTICS = 1
 } telemetry_type_t;
 
 typedef enum
@@ -0,0 +1,314 @@
+#include <string.h>
+
+#include "telemetry_frame.h"
+
+#define FRAME_MAGIC_0 'A'
+#define FRAME_MAGIC_1 'Q'
+#define FRAME_COUNT_OFFSET 13
+
+/* CRC-16/CCITT-FALSE, one nibble at a time */
+static const uint16_t s_crc16_nibble_table[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF};
+
+uint16_t telemetry_frame_crc16(const uint8_t *data, size_t length)
+{
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < length; i++)
+    {
+        crc = (crc << 4) ^ s_crc16_nibble_table[(crc >> 12) ^ (data[i] >> 4)];
+        crc = (crc << 4) ^ s_crc16_nibble_table[(crc >> 12) ^ (data[i] & 0x0F)];
+    }
+    return crc;
+}
+
+static uint8_t *telemetry_frame_put_varint(uint8_t *out, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        *out++ = (uint8_t)value | 0x80;
+        value >>= 7;
+    }
+    *out++ = (uint8_t)value;
+    return out;
+}
+
+static uint8_t *telemetry_frame_put_delta(uint8_t *out, int32_t current, int32_t previous)
+{
+    int32_t delta = current - previous;
+    /* Zigzag: small magnitudes of either sign become small unsigned values */
+    return telemetry_frame_put_varint(out, ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31));
+}
+
+/* Returns NULL if the varint runs past end or is longer than 32 bits */
+static const uint8_t *telemetry_frame_get_varint(const uint8_t *in, const uint8_t *end, uint32_t *value)
+{
+    *value = 0;
+    for (uint8_t shift = 0; shift < 35; shift += 7)
+    {
+        if (in == end)
+        {
+            return NULL;
+        }
+        uint8_t byte = *in++;
+        *value |= (uint32_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            return in;
+        }
+    }
+    return NULL;
+}
+
+static const uint8_t *telemetry_frame_get_delta(const uint8_t *in, const uint8_t *end, int32_t previous, int32_t *current)
+{
+    uint32_t zigzag;
+    in = telemetry_frame_get_varint(in, end, &zigzag);
+    *current = previous + (int32_t)((zigzag >> 1) ^ -(zigzag & 1));
+    return in;
+}
+
+void telemetry_frame_begin(telemetry_frame_encoder_t *encoder, const telemetry_header_t *header)
+{
+    uint8_t *out = encoder->buffer;
+
+    *out++ = FRAME_MAGIC_0;
+    *out++ = FRAME_MAGIC_1;
+    *out++ = TELEMETRY_FRAME_VERSION;
+    *out++ = (uint8_t)header->type;
+    *out++ = (uint8_t)header->device_type;
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        *out++ = (uint8_t)(header->serial >> (8 * i));
+    }
+    *out++ = 0; // Sample count, filled in by telemetry_frame_finish()
+
+    encoder->length = out - encoder->buffer;
+    encoder->count = 0;
+    memset(&encoder->previous, 0, sizeof(encoder->previous));
+    memset(&encoder->previous_statistics, 0, sizeof(encoder->previous_statistics));
+}
+
+bool telemetry_frame_add(telemetry_frame_encoder_t *encoder, const telemetry_airquality_t *sample)
+{
+    const telemetry_airquality_t *previous = &encoder->previous;
+
+    if (encoder->count == TELEMETRY_FRAME_MAX_SAMPLES)
+    {
+        return false;
+    }
+
+    uint8_t *out = encoder->buffer + encoder->length;
+    out = telemetry_frame_put_varint(out, sample->timestamp - previous->timestamp);
+    out = telemetry_frame_put_delta(out, sample->voc, previous->voc);
+    out = telemetry_frame_put_delta(out, sample->temperature, previous->temperature);
+    out = telemetry_frame_put_delta(out, sample->rhumidity, previous->rhumidity);
+    out = telemetry_frame_put_delta(out, sample->co2, previous->co2);
+    out = telemetry_frame_put_delta(out, sample->pm2p5, previous->pm2p5);
+    out = telemetry_frame_put_delta(out, sample->pm10p0, previous->pm10p0);
+    out = telemetry_frame_put_delta(out, sample->aqi, previous->aqi);
+
+    encoder->length = out - encoder->buffer;
+    encoder->count++;
+    encoder->previous = *sample;
+    return true;
+}
+
+static uint8_t *telemetry_frame_put_statistic(uint8_t *out, const telemetry_statistic_t *statistic,
+                                              const telemetry_statistic_t *previous)
+{
+    out = telemetry_frame_put_varint(out, statistic->count);
+    out = telemetry_frame_put_delta(out, statistic->mean, previous->mean);
+    /* The other values are close to the mean of the same window */
+    out = telemetry_frame_put_delta(out, statistic->min, statistic->mean);
+    out = telemetry_frame_put_delta(out, statistic->max, statistic->mean);
+    out = telemetry_frame_put_delta(out, statistic->p50, statistic->mean);
+    out = telemetry_frame_put_delta(out, statistic->p95, statistic->mean);
+    return out;
+}
+
+bool telemetry_frame_add_statistics(telemetry_frame_encoder_t *encoder, const telemetry_airquality_statistics_t *statistics)
+{
+    const telemetry_airquality_statistics_t *previous = &encoder->previous_statistics;
+
+    if (encoder->count == TELEMETRY_FRAME_MAX_STATISTICS)
+    {
+        return false;
+    }
+
+    uint8_t *out = encoder->buffer + encoder->length;
+    out = telemetry_frame_put_varint(out, statistics->timestamp - previous->timestamp);
+    out = telemetry_frame_put_varint(out, statistics->duration);
+    out = telemetry_frame_put_statistic(out, &statistics->voc, &previous->voc);
+    out = telemetry_frame_put_statistic(out, &statistics->temperature, &previous->temperature);
+    out = telemetry_frame_put_statistic(out, &statistics->rhumidity, &previous->rhumidity);
+    out = telemetry_frame_put_statistic(out, &statistics->co2, &previous->co2);
+    out = telemetry_frame_put_statistic(out, &statistics->pm2p5, &previous->pm2p5);
+    out = telemetry_frame_put_statistic(out, &statistics->pm10p0, &previous->pm10p0);
+
+    encoder->length = out - encoder->buffer;
+    encoder->count++;
+    encoder->previous_statistics = *statistics;
+    return true;
+}
+
+size_t telemetry_frame_finish(telemetry_frame_encoder_t *encoder, const uint8_t **frame)
+{
+    encoder->buffer[FRAME_COUNT_OFFSET] = encoder->count;
+
+    uint16_t crc = telemetry_frame_crc16(encoder->buffer, encoder->length);
+    encoder->buffer[encoder->length] = (uint8_t)crc;
+    encoder->buffer[encoder->length + 1] = (uint8_t)(crc >> 8);
+
+    *frame = encoder->buffer;
+    return encoder->length + TELEMETRY_FRAME_CRC_SIZE;
+}
+
+/* Checks everything but the records. Returns the record count and the end of the records, a
+telemetry_frame_err_t if the frame is invalid. */
+static int telemetry_frame_decode_header(const uint8_t *frame, size_t length, telemetry_type_t type,
+                                         telemetry_header_t *header, size_t max_records, const uint8_t **end)
+{
+    if (length < TELEMETRY_FRAME_HEADER_SIZE + TELEMETRY_FRAME_CRC_SIZE)
+    {
+        return TELEMETRY_FRAME_ERR_TRUNCATED;
+    }
+    if (frame[0] != FRAME_MAGIC_0 || frame[1] != FRAME_MAGIC_1)
+    {
+        return TELEMETRY_FRAME_ERR_MAGIC;
+    }
+    if (frame[2] != TELEMETRY_FRAME_VERSION)
+    {
+        return TELEMETRY_FRAME_ERR_VERSION;
+    }
+
+    *end = frame + length - TELEMETRY_FRAME_CRC_SIZE;
+    uint16_t crc = (uint16_t)(*end)[0] | (uint16_t)(*end)[1] << 8;
+    if (telemetry_frame_crc16(frame, *end - frame) != crc)
+    {
+        return TELEMETRY_FRAME_ERR_CRC;
+    }
+
+    header->type = (telemetry_type_t)frame[3];
+    header->device_type = (telemetry_device_type_t)frame[4];
+    header->serial = 0;
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        header->serial |= (uint64_t)frame[5 + i] << (8 * i);
+    }
+    if (header->type != type)
+    {
+        return TELEMETRY_FRAME_ERR_TYPE;
+    }
+    uint8_t count = frame[FRAME_COUNT_OFFSET];
+    if (count > max_records)
+    {
+        return TELEMETRY_FRAME_ERR_OVERFLOW;
+    }
+    return count;
+}
+
+int telemetry_frame_decode(const uint8_t *frame, size_t length, telemetry_header_t *header,
+                           telemetry_airquality_t *samples, size_t max_samples)
+{
+    const uint8_t *end;
+    int count = telemetry_frame_decode_header(frame, length, TELEMETRY_TYPE_AIRQUALITY, header, max_samples, &end);
+    if (count < 0)
+    {
+        return count;
+    }
+
+    const uint8_t *in = frame + TELEMETRY_FRAME_HEADER_SIZE;
+    telemetry_airquality_t previous = {0};
+    for (int i = 0; i < count; i++)
+    {
+        telemetry_airquality_t *sample = &samples[i];
+        uint32_t timestamp_delta;
+        int32_t value[7];
+
+        in = telemetry_frame_get_varint(in, end, &timestamp_delta);
+        in = in ? telemetry_frame_get_delta(in, end, previous.voc, &value[0]) : NULL;
+        in = in ? telemetry_frame_get_delta(in, end, previous.temperature, &value[1]) : NULL;
+        in = in ? telemetry_frame_get_delta(in, end, previous.rhumidity, &value[2]) : NULL;
+        in = in ? telemetry_frame_get_delta(in, end, previous.co2, &value[3]) : NULL;
+        in = in ? telemetry_frame_get_delta(in, end, previous.pm2p5, &value[4]) : NULL;
+        in = in ? telemetry_frame_get_delta(in, end, previous.pm10p0, &value[5]) : NULL;
+        in = in ? telemetry_frame_get_delta(in, end, previous.aqi, &value[6]) : NULL;
+        if (in == NULL)
+        {
+            return TELEMETRY_FRAME_ERR_TRUNCATED;
+        }
+
+        sample->timestamp = previous.timestamp + timestamp_delta;
+        sample->voc = (int16_t)value[0];
+        sample->temperature = (int16_t)value[1];
+        sample->rhumidity = (int16_t)value[2];
+        sample->co2 = (uint16_t)value[3];
+        sample->pm2p5 = (uint16_t)value[4];
+        sample->pm10p0 = (uint16_t)value[5];
+        sample->aqi = (uint16_t)value[6];
+        previous = *sample;
+    }
+    if (in != end)
+    {
+        /* Bytes left over, the count does not match the samples */
+        return TELEMETRY_FRAME_ERR_TRUNCATED;
+    }
+
+    return count;
+}
+
+static const uint8_t *telemetry_frame_get_statistic(const uint8_t *in, const uint8_t *end,
+                                                    const telemetry_statistic_t *previous, telemetry_statistic_t *statistic)
+{
+    in = telemetry_frame_get_varint(in, end, &statistic->count);
+    in = in ? telemetry_frame_get_delta(in, end, previous->mean, &statistic->mean) : NULL;
+    in = in ? telemetry_frame_get_delta(in, end, statistic->mean, &statistic->min) : NULL;
+    in = in ? telemetry_frame_get_delta(in, end, statistic->mean, &statistic->max) : NULL;
+    in = in ? telemetry_frame_get_delta(in, end, statistic->mean, &statistic->p50) : NULL;
+    in = in ? telemetry_frame_get_delta(in, end, statistic->mean, &statistic->p95) : NULL;
+    return in;
+}
+
+int telemetry_frame_decode_statistics(const uint8_t *frame, size_t length, telemetry_header_t *header,
+                                      telemetry_airquality_statistics_t *statistics, size_t max_statistics)
+{
+    const uint8_t *end;
+    int count = telemetry_frame_decode_header(frame, length, TELEMETRY_TYPE_AIRQUALITY_STATISTICS, header,
+                                              max_statistics, &end);
+    if (count < 0)
+    {
+        return count;
+    }
+
+    const uint8_t *in = frame + TELEMETRY_FRAME_HEADER_SIZE;
+    telemetry_airquality_statistics_t previous = {0};
+    for (int i = 0; i < count; i++)
+    {
+        telemetry_airquality_statistics_t *record = &statistics[i];
+        uint32_t timestamp_delta;
+
+        in = telemetry_frame_get_varint(in, end, &timestamp_delta);
+        in = in ? telemetry_frame_get_varint(in, end, &record->duration) : NULL;
+        in = in ? telemetry_frame_get_statistic(in, end, &previous.voc, &record->voc) : NULL;
+        in = in ? telemetry_frame_get_statistic(in, end, &previous.temperature, &record->temperature) : NULL;
+        in = in ? telemetry_frame_get_statistic(in, end, &previous.rhumidity, &record->rhumidity) : NULL;
+        in = in ? telemetry_frame_get_statistic(in, end, &previous.co2, &record->co2) : NULL;
+        in = in ? telemetry_frame_get_statistic(in, end, &previous.pm2p5, &record->pm2p5) : NULL;
+        in = in ? telemetry_frame_get_statistic(in, end, &previous.pm10p0, &record->pm10p0) : NULL;
+        if (in == NULL)
+        {
+            return TELEMETRY_FRAME_ERR_TRUNCATED;
+        }
+
+        record->timestamp = previous.timestamp + timestamp_delta;
+        previous = *record;
+    }
+    if (in != end)
+    {
+        /* Bytes left over, the count does not match the records */
+        return TELEMETRY_FRAME_ERR_TRUNCATED;
+    }
+
+    return count;
+}
@@ -0,0 +1,159 @@
+#ifndef COMPONENTS_TELEMETRY_FRAME_H
+#define COMPONENTS_TELEMETRY_FRAME_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "telemetry_data_structures.h"
+
+/**
+ * Frame layout, all multi byte header fields little endian:
+ *
+ *   magic       2 bytes "AQ"
+ *   version     1 byte  TELEMETRY_FRAME_VERSION
+ *   type        1 byte  telemetry_type_t
+ *   device type 1 byte  telemetry_device_type_t
+ *   serial      8 bytes
+ *   count       1 byte  number of samples or statistics
+ *   samples     count times, see below
+ *   crc         2 bytes CRC-16/CCITT-FALSE of everything before it
+ *
+ * Each sample is the timestamp followed by voc, temperature, rhumidity, co2, pm2p5, pm10p0 and aqi. The
+ * first sample of a frame is encoded against an all zero sample, every other one against the
+ * sample before it. The timestamp difference is an unsigned varint (LEB128), the field differences
+ * are zigzag encoded signed varints. Slowly changing values therefore take one byte per field.
+ *
+ * Frames of type TELEMETRY_TYPE_AIRQUALITY_STATISTICS carry telemetry_airquality_statistics_t
+ * records instead of samples: the timestamp difference and the duration as unsigned varints, then
+ * for each field the count as unsigned varint followed by the mean, min, max, p50 and p95. The mean
+ * is encoded against the mean of the record before, the other four against the mean of the same
+ * record, all as zigzag encoded signed varints.
+ *
+ * Version 2 changed the scaling of pm2p5 and pm10p0 from 0.001 to 0.1 ug/m3, see
+ * telemetry_airquality_t. Version 3 added the aqi field to the samples.
+ *
+ * This file only depends on the C library so that the decoder can be built on a host.
+ */
+
+#define TELEMETRY_FRAME_VERSION 3
+
+#define TELEMETRY_FRAME_MAX_SAMPLES 32
+
+#define TELEMETRY_FRAME_HEADER_SIZE 14
+#define TELEMETRY_FRAME_CRC_SIZE 2
+
+/* Worst case: 5 bytes of timestamp and 3 bytes for each of the seven 16 bit field differences */
+#define TELEMETRY_FRAME_MAX_SAMPLE_SIZE (5 + 7 * 3)
+
+/* Worst case: 5 bytes of timestamp, 3 of duration and for each of the six fields 3 bytes of count
+and 3 bytes for each of the five value differences */
+#define TELEMETRY_FRAME_MAX_STATISTICS_SIZE (5 + 3 + 6 * (3 + 5 * 3))
+
+/* Statistics records that fit into the room of TELEMETRY_FRAME_MAX_SAMPLES samples */
+#define TELEMETRY_FRAME_MAX_STATISTICS \
+    (TELEMETRY_FRAME_MAX_SAMPLES * TELEMETRY_FRAME_MAX_SAMPLE_SIZE / TELEMETRY_FRAME_MAX_STATISTICS_SIZE)
+
+#define TELEMETRY_FRAME_MAX_SIZE                                                                   \
+    (TELEMETRY_FRAME_HEADER_SIZE + TELEMETRY_FRAME_MAX_SAMPLES * TELEMETRY_FRAME_MAX_SAMPLE_SIZE + \
+     TELEMETRY_FRAME_CRC_SIZE)
+
+typedef enum
+{
+    TELEMETRY_FRAME_OK = 0,
+    TELEMETRY_FRAME_ERR_TRUNCATED = -1, // The frame ends before its last field, or a field is malformed.
+    TELEMETRY_FRAME_ERR_MAGIC = -2,     // Not a telemetry frame.
+    TELEMETRY_FRAME_ERR_VERSION = -3,   // Frame version not supported by this decoder.
+    TELEMETRY_FRAME_ERR_CRC = -4,       // Corrupted frame.
+    TELEMETRY_FRAME_ERR_OVERFLOW = -5,  // More samples than the caller has room for.
+    TELEMETRY_FRAME_ERR_TYPE = -6,      // The frame holds other records than the decoder was asked for.
+} telemetry_frame_err_t;
+
+typedef struct
+{
+    uint8_t buffer[TELEMETRY_FRAME_MAX_SIZE];
+    size_t length;
+    uint8_t count;
+    telemetry_airquality_t previous;
+    telemetry_airquality_statistics_t previous_statistics;
+} telemetry_frame_encoder_t;
+
+/**
+ * @brief CRC-16/CCITT-FALSE, as used in the frame trailer.
+ *
+ * @param[in] data the data.
+ * @param[in] length length of data in bytes.
+ *
+ * @return the CRC.
+ */
+uint16_t telemetry_frame_crc16(const uint8_t *data, size_t length);
+
+/**
+ * @brief Start a new frame, dropping whatever the encoder held.
+ *
+ * @param[out] encoder the encoder.
+ * @param[in] header device the samples belong to.
+ */
+void telemetry_frame_begin(telemetry_frame_encoder_t *encoder, const telemetry_header_t *header);
+
+/**
+ * @brief Append a sample to the current frame.
+ *
+ * @param[in,out] encoder the encoder.
+ * @param[in] sample the sample.
+ *
+ * @return false if the frame already holds TELEMETRY_FRAME_MAX_SAMPLES samples.
+ */
+bool telemetry_frame_add(telemetry_frame_encoder_t *encoder, const telemetry_airquality_t *sample);
+
+/**
+ * @brief Append statistics to the current frame. A frame holds either samples or statistics, see
+ * the type in the header passed to telemetry_frame_begin().
+ *
+ * @param[in,out] encoder the encoder.
+ * @param[in] statistics the statistics.
+ *
+ * @return false if the frame already holds TELEMETRY_FRAME_MAX_STATISTICS records.
+ */
+bool telemetry_frame_add_statistics(telemetry_frame_encoder_t *encoder, const telemetry_airquality_statistics_t *statistics);
+
+/**
+ * @brief Complete the frame with the sample count and CRC. The frame stays valid until the next
+ * call to telemetry_frame_begin().
+ *
+ * @param[in,out] encoder the encoder.
+ * @param[out] frame start of the encoded frame.
+ *
+ * @return length of the frame in bytes.
+ */
+size_t telemetry_frame_finish(telemetry_frame_encoder_t *encoder, const uint8_t **frame);
+
+/**
+ * @brief Decode a frame of samples.
+ *
+ * @param[in] frame the encoded frame.
+ * @param[in] length length of the frame in bytes.
+ * @param[out] header device the samples belong to.
+ * @param[out] samples the decoded samples.
+ * @param[in] max_samples room in samples.
+ *
+ * @return the number of samples, a telemetry_frame_err_t if the frame is invalid.
+ */
+int telemetry_frame_decode(const uint8_t *frame, size_t length, telemetry_header_t *header,
+                           telemetry_airquality_t *samples, size_t max_samples);
+
+/**
+ * @brief Decode a frame of statistics.
+ *
+ * @param[in] frame the encoded frame.
+ * @param[in] length length of the frame in bytes.
+ * @param[out] header device the statistics belong to.
+ * @param[out] statistics the decoded statistics.
+ * @param[in] max_statistics room in statistics.
+ *
+ * @return the number of statistics records, a telemetry_frame_err_t if the frame is invalid.
+ */
+int telemetry_frame_decode_statistics(const uint8_t *frame, size_t length, telemetry_header_t *header,
+                                      telemetry_airquality_statistics_t *statistics, size_t max_statistics);
+
+#endif
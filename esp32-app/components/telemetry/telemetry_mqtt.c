@@ -0,0 +1,79 @@
+#include <stdio.h>
+
+#include "esp_log.h"
+#include "esp_system.h"
+#include "mqtt_client.h"
+
+#include "telemetry.h"
+#include "telemetry_mqtt.h"
+
+#define TAG "telemetry_mqtt.c"
+
+#define TELEMETRY_MQTT_QOS 1
+#define TELEMETRY_MQTT_KEEPALIVE_S 60
+
+static esp_mqtt_client_handle_t s_client;
+static char s_client_id[16];
+static char s_topic[64];
+
+static int32_t telemetry_mqtt_send(const uint8_t *frame, size_t length)
+{
+    /* Returns as soon as the frame is written to the connection, the acknowledgement arrives as
+    MQTT_EVENT_PUBLISHED */
+    return esp_mqtt_client_publish(s_client, s_topic, (const char *)frame, length, TELEMETRY_MQTT_QOS, 0);
+}
+
+static void telemetry_mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data)
+{
+    (void)handler_args;
+    (void)base;
+    esp_mqtt_event_handle_t event = event_data;
+
+    switch ((esp_mqtt_event_id_t)event_id)
+    {
+    case MQTT_EVENT_CONNECTED:
+        ESP_LOGI(TAG, "Connected, session %s", event->session_present ? "resumed" : "new");
+        telemetry_set_sender(telemetry_mqtt_send, CONFIG_TELEMETRY_MQTT_WINDOW);
+        break;
+    case MQTT_EVENT_DISCONNECTED:
+        ESP_LOGW(TAG, "Disconnected");
+        telemetry_set_sender(NULL, 0);
+        break;
+    case MQTT_EVENT_PUBLISHED:
+        telemetry_frame_delivered(event->msg_id);
+        break;
+    default:
+        break;
+    }
+}
+
+void telemetry_mqtt_start(void)
+{
+    uint8_t mac[6];
+
+    if (CONFIG_TELEMETRY_MQTT_BROKER_URI[0] == '\0')
+    {
+        ESP_LOGW(TAG, "No MQTT broker configured, telemetry is only stored");
+        return;
+    }
+
+    esp_efuse_mac_get_default(mac);
+    snprintf(s_client_id, sizeof(s_client_id), "aq-%02x%02x%02x%02x%02x%02x", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    snprintf(s_topic, sizeof(s_topic), "%s/%s", CONFIG_TELEMETRY_MQTT_TOPIC, s_client_id);
+
+    const esp_mqtt_client_config_t config = {
+        .uri = CONFIG_TELEMETRY_MQTT_BROKER_URI,
+        .client_id = s_client_id,
+        .disable_clean_session = true,
+        .keepalive = TELEMETRY_MQTT_KEEPALIVE_S};
+
+    s_client = esp_mqtt_client_init(&config);
+    if (s_client == NULL)
+    {
+        ESP_LOGE(TAG, "Error executing esp_mqtt_client_init()");
+        return;
+    }
+    esp_mqtt_client_register_event(s_client, ESP_EVENT_ANY_ID, telemetry_mqtt_event_handler, NULL);
+    /* Connects once the network is up and reconnects by itself */
+    esp_mqtt_client_start(s_client);
+}
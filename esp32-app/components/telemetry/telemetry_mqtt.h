@@ -0,0 +1,12 @@
+#ifndef COMPONENTS_TELEMETRY_MQTT_H
+#define COMPONENTS_TELEMETRY_MQTT_H
+
+/**
+ * @brief Connect to the MQTT broker configured in CONFIG_TELEMETRY_MQTT_BROKER_URI and register as
+ * the telemetry sender while connected. The session is persistent, frames published with QoS 1
+ * are retransmitted by the broker connection after a reconnect. Does nothing if no broker is
+ * configured.
+ */
+void telemetry_mqtt_start(void);
+
+#endif
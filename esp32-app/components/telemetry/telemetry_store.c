@@ -0,0 +1,470 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_partition.h"
+#include "esp_log.h"
+
+#include "telemetry_store.h"
+#include "telemetry_frame.h"
+
+#define TAG "telemetry_store.c"
+
+#define STORE_MAGIC 0x31535154 // "TQS1"
+#define STORE_ERASED_WORD 0xFFFFFFFF
+#define STORE_ERASED_LENGTH 0xFFFF
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t sequence; // Incremented every time a sector is formatted, never 0.
+    uint32_t consumed; // Cleared once every record of the sector was consumed.
+    uint32_t reserved;
+} store_sector_header_t;
+
+typedef struct
+{
+    uint16_t length;
+    uint16_t crc;      // CRC-16/CCITT-FALSE of the record data.
+    uint32_t consumed; // Cleared once the record was delivered.
+} store_record_header_t;
+
+#define STORE_SECTOR_HEADER_SIZE sizeof(store_sector_header_t)
+#define STORE_RECORD_HEADER_SIZE sizeof(store_record_header_t)
+
+_Static_assert(STORE_SECTOR_HEADER_SIZE == 16 && STORE_RECORD_HEADER_SIZE == 8,
+               "TELEMETRY_STORE_MAX_RECORD_SIZE depends on the header sizes");
+
+static const esp_partition_t *s_partition;
+static uint16_t s_sector_count;
+
+/* Held during flash accesses, which take too long for a critical section */
+static SemaphoreHandle_t s_mutex;
+
+static uint32_t s_write_sequence;
+static uint16_t s_write_sector;
+static uint16_t s_write_offset;
+
+/* Oldest record that was not consumed, equal to the write position when nothing is pending */
+static telemetry_store_position_t s_head;
+
+static uint32_t s_pending_records;
+static uint32_t s_dropped_records;
+
+static size_t store_record_size(uint16_t length)
+{
+    return STORE_RECORD_HEADER_SIZE + ((length + 3) & ~3);
+}
+
+static size_t store_address(uint16_t sector, size_t offset)
+{
+    return (size_t)sector * TELEMETRY_STORE_SECTOR_SIZE + offset;
+}
+
+static bool store_read_sector_header(uint16_t sector, store_sector_header_t *header)
+{
+    return esp_partition_read(s_partition, store_address(sector, 0), header, sizeof(*header)) == ESP_OK &&
+           header->magic == STORE_MAGIC;
+}
+
+static esp_err_t store_clear_word(size_t address)
+{
+    const uint32_t cleared = 0;
+    return esp_partition_write(s_partition, address, &cleared, sizeof(cleared));
+}
+
+static esp_err_t store_format_sector(uint16_t sector, uint32_t sequence)
+{
+    const store_sector_header_t header = {
+        .magic = STORE_MAGIC,
+        .sequence = sequence,
+        .consumed = STORE_ERASED_WORD,
+        .reserved = STORE_ERASED_WORD};
+
+    esp_err_t err = esp_partition_erase_range(s_partition, store_address(sector, 0), TELEMETRY_STORE_SECTOR_SIZE);
+    if (err == ESP_OK)
+    {
+        err = esp_partition_write(s_partition, store_address(sector, 0), &header, sizeof(header));
+    }
+    return err;
+}
+
+/* Reads the header of the record at offset. Returns false at the end of the written part of the
+sector. A length that cannot be valid, e.g. after a power loss while writing the header, also
+ends the sector since the records behind it cannot be found. */
+static bool store_read_record_header(uint16_t sector, size_t offset, store_record_header_t *record)
+{
+    if (offset + STORE_RECORD_HEADER_SIZE > TELEMETRY_STORE_SECTOR_SIZE ||
+        esp_partition_read(s_partition, store_address(sector, offset), record, sizeof(*record)) != ESP_OK)
+    {
+        return false;
+    }
+    return record->length != 0 && record->length <= TELEMETRY_STORE_MAX_RECORD_SIZE &&
+           offset + store_record_size(record->length) <= TELEMETRY_STORE_SECTOR_SIZE;
+}
+
+static bool store_at_write_position(const telemetry_store_position_t *position)
+{
+    return position->sector == s_write_sector && position->offset >= s_write_offset;
+}
+
+/* Moves position to the next record if it is at the end of a sector. Returns false when position
+reached the write position, otherwise the header of the record is returned. Sectors that are left
+behind are marked consumed if requested. Must be called with s_mutex held. */
+static bool store_seek_record(telemetry_store_position_t *position, bool mark_consumed, store_record_header_t *record)
+{
+    while (!store_at_write_position(position))
+    {
+        if (store_read_record_header(position->sector, position->offset, record))
+        {
+            return true;
+        }
+        if (position->sector == s_write_sector)
+        {
+            /* Behind a failed write, nothing more can be found in this sector */
+            position->offset = s_write_offset;
+            return false;
+        }
+
+        if (mark_consumed)
+        {
+            store_clear_word(store_address(position->sector, offsetof(store_sector_header_t, consumed)));
+        }
+        store_sector_header_t header;
+        position->sector = (position->sector + 1) % s_sector_count;
+        position->offset = STORE_SECTOR_HEADER_SIZE;
+        position->sequence = store_read_sector_header(position->sector, &header) ? header.sequence : 0;
+    }
+    return false;
+}
+
+/* Moves the head past consumed records. Must be called with s_mutex held. */
+static void store_advance_head(void)
+{
+    store_record_header_t record;
+    while (store_seek_record(&s_head, true, &record) && record.consumed != STORE_ERASED_WORD)
+    {
+        s_head.offset += store_record_size(record.length);
+    }
+}
+
+/* Counts the pending records from position up to the end of its sector. Must be called with
+s_mutex held. */
+static uint32_t store_count_pending_in_sector(telemetry_store_position_t position)
+{
+    store_record_header_t record;
+    uint32_t pending = 0;
+
+    while (!store_at_write_position(&position) &&
+           store_read_record_header(position.sector, position.offset, &record))
+    {
+        if (record.consumed == STORE_ERASED_WORD)
+        {
+            pending++;
+        }
+        position.offset += store_record_size(record.length);
+    }
+    return pending;
+}
+
+/* Continues writing in the next sector of the ring, dropping its records if it still holds
+pending ones. Must be called with s_mutex held. */
+static esp_err_t store_open_next_sector(void)
+{
+    uint16_t next = (s_write_sector + 1) % s_sector_count;
+    bool head_dropped = s_head.sector == next;
+
+    if (head_dropped)
+    {
+        uint32_t dropped = store_count_pending_in_sector(s_head);
+        s_dropped_records += dropped;
+        s_pending_records -= dropped;
+        ESP_LOGW(TAG, "Log full, dropped %u record(s)", dropped);
+    }
+
+    esp_err_t err = store_format_sector(next, s_write_sequence + 1);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Error formatting sector %u: %s", next, esp_err_to_name(err));
+        return err;
+    }
+    s_write_sequence++;
+    s_write_sector = next;
+    s_write_offset = STORE_SECTOR_HEADER_SIZE;
+
+    if (head_dropped)
+    {
+        store_sector_header_t header;
+        s_head.sector = (next + 1) % s_sector_count;
+        s_head.offset = STORE_SECTOR_HEADER_SIZE;
+        s_head.sequence = store_read_sector_header(s_head.sector, &header) ? header.sequence : 0;
+        store_advance_head();
+    }
+    return ESP_OK;
+}
+
+esp_err_t telemetry_store_init(void)
+{
+    s_partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, TELEMETRY_STORE_PARTITION_SUBTYPE,
+                                           TELEMETRY_STORE_PARTITION_LABEL);
+    if (s_partition == NULL)
+    {
+        ESP_LOGE(TAG, "No %s partition", TELEMETRY_STORE_PARTITION_LABEL);
+        return ESP_ERR_NOT_FOUND;
+    }
+    s_sector_count = s_partition->size / TELEMETRY_STORE_SECTOR_SIZE;
+    if (s_sector_count < 2)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    s_mutex = xSemaphoreCreateMutex();
+    if (s_mutex == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    /* The newest sector is written next, the oldest one not marked consumed holds the head */
+    uint32_t newest_sequence = 0;
+    uint32_t oldest_pending_sequence = UINT32_MAX;
+    for (uint16_t sector = 0; sector < s_sector_count; sector++)
+    {
+        store_sector_header_t header;
+        if (!store_read_sector_header(sector, &header))
+        {
+            continue;
+        }
+        if (header.sequence > newest_sequence)
+        {
+            newest_sequence = header.sequence;
+            s_write_sector = sector;
+        }
+        if (header.consumed == STORE_ERASED_WORD && header.sequence < oldest_pending_sequence)
+        {
+            oldest_pending_sequence = header.sequence;
+            s_head.sector = sector;
+        }
+    }
+
+    if (newest_sequence == 0)
+    {
+        ESP_LOGI(TAG, "Formatting the log");
+        esp_err_t err = store_format_sector(0, 1);
+        if (err != ESP_OK)
+        {
+            return err;
+        }
+        newest_sequence = 1;
+        oldest_pending_sequence = 1;
+        s_write_sector = 0;
+        s_head.sector = 0;
+    }
+    s_write_sequence = newest_sequence;
+
+    /* Find the end of the records in the sector being written. Anything but erased flash behind
+    the last record means a write failed there, the sector is then not written any more. */
+    telemetry_store_position_t end = {.sequence = s_write_sequence, .sector = s_write_sector, .offset = STORE_SECTOR_HEADER_SIZE};
+    store_record_header_t record;
+    while (store_read_record_header(end.sector, end.offset, &record))
+    {
+        end.offset += store_record_size(record.length);
+    }
+    uint16_t length = 0;
+    if (end.offset + sizeof(length) <= TELEMETRY_STORE_SECTOR_SIZE)
+    {
+        esp_partition_read(s_partition, store_address(end.sector, end.offset), &length, sizeof(length));
+    }
+    s_write_offset = length == STORE_ERASED_LENGTH ? end.offset : TELEMETRY_STORE_SECTOR_SIZE;
+
+    s_head.sequence = oldest_pending_sequence;
+    s_head.offset = STORE_SECTOR_HEADER_SIZE;
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    store_advance_head();
+
+    /* Count the backlog, only the sectors that are not consumed are read */
+    telemetry_store_position_t position = s_head;
+    s_pending_records = 0;
+    while (store_seek_record(&position, false, &record))
+    {
+        if (record.consumed == STORE_ERASED_WORD)
+        {
+            s_pending_records++;
+        }
+        position.offset += store_record_size(record.length);
+    }
+    xSemaphoreGive(s_mutex);
+
+    ESP_LOGI(TAG, "%u sectors, %u record(s) pending", s_sector_count, s_pending_records);
+    return ESP_OK;
+}
+
+esp_err_t telemetry_store_append(const void *data, size_t length)
+{
+    esp_err_t err = ESP_OK;
+
+    if (length == 0 || length > TELEMETRY_STORE_MAX_RECORD_SIZE)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    const store_record_header_t record = {
+        .length = length,
+        .crc = telemetry_frame_crc16(data, length),
+        .consumed = STORE_ERASED_WORD};
+    size_t record_size = store_record_size(length);
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    if (s_write_offset + record_size > TELEMETRY_STORE_SECTOR_SIZE)
+    {
+        err = store_open_next_sector();
+    }
+    if (err == ESP_OK)
+    {
+        size_t address = store_address(s_write_sector, s_write_offset);
+        /* Header first, data that was written without its header would end the sector */
+        err = esp_partition_write(s_partition, address, &record, sizeof(record));
+        if (err == ESP_OK)
+        {
+            err = esp_partition_write(s_partition, address + sizeof(record), data, length);
+        }
+        if (err == ESP_OK)
+        {
+            s_write_offset += record_size;
+            s_pending_records++;
+        }
+        else
+        {
+            /* The flash there is not erased any more and the length of the record may be wrong,
+            continue in the next sector */
+            ESP_LOGE(TAG, "Error writing record: %s", esp_err_to_name(err));
+            s_write_offset = TELEMETRY_STORE_SECTOR_SIZE;
+        }
+    }
+    xSemaphoreGive(s_mutex);
+
+    return err;
+}
+
+void telemetry_store_rewind(telemetry_store_position_t *position)
+{
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    *position = s_head;
+    xSemaphoreGive(s_mutex);
+}
+
+esp_err_t telemetry_store_read_batch(telemetry_store_position_t *position, uint8_t *buffer, size_t size,
+                                     telemetry_store_record_t *records, size_t max_records, size_t *count)
+{
+    esp_err_t err = ESP_OK;
+    store_sector_header_t header;
+    store_record_header_t record;
+
+    *count = 0;
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    if (position->sequence == 0 || !store_read_sector_header(position->sector, &header) ||
+        header.sequence != position->sequence)
+    {
+        /* Never read or erased since */
+        *position = s_head;
+    }
+    /* Chunks that only hold consumed records are passed over, 0 records means the end of the log */
+    size_t used;
+    do
+    {
+        if (!store_seek_record(position, false, &record))
+        {
+            break;
+        }
+
+        size_t end = position->sector == s_write_sector ? s_write_offset : TELEMETRY_STORE_SECTOR_SIZE;
+        size_t chunk = end - position->offset < size ? end - position->offset : size;
+        err = esp_partition_read(s_partition, store_address(position->sector, position->offset), buffer, chunk);
+
+        used = 0;
+        while (err == ESP_OK && *count < max_records && used + STORE_RECORD_HEADER_SIZE <= chunk)
+        {
+            memcpy(&record, &buffer[used], sizeof(record));
+            if (record.length == 0 || record.length > TELEMETRY_STORE_MAX_RECORD_SIZE)
+            {
+                /* End of the sector, the next read continues in the next one */
+                break;
+            }
+            size_t record_size = store_record_size(record.length);
+            if (used + record_size > chunk)
+            {
+                if (used == 0)
+                {
+                    err = ESP_ERR_INVALID_SIZE;
+                }
+                break;
+            }
+
+            const uint8_t *data = &buffer[used + STORE_RECORD_HEADER_SIZE];
+            if (record.consumed == STORE_ERASED_WORD)
+            {
+                telemetry_store_position_t record_position = *position;
+                record_position.offset += used;
+                if (telemetry_frame_crc16(data, record.length) == record.crc)
+                {
+                    records[*count].data = data;
+                    records[*count].length = record.length;
+                    records[*count].position = record_position;
+                    (*count)++;
+                }
+                else
+                {
+                    ESP_LOGW(TAG, "Corrupted record at %u:%u skipped", record_position.sector, record_position.offset);
+                    store_clear_word(store_address(record_position.sector, record_position.offset) + offsetof(store_record_header_t, consumed));
+                    s_pending_records--;
+                }
+            }
+            used += record_size;
+        }
+        position->offset += used;
+    } while (err == ESP_OK && *count == 0 && used > 0);
+    xSemaphoreGive(s_mutex);
+
+    return err;
+}
+
+void telemetry_store_consume(const telemetry_store_position_t *position)
+{
+    store_sector_header_t header;
+    store_record_header_t record;
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    if (store_read_sector_header(position->sector, &header) && header.sequence == position->sequence &&
+        store_read_record_header(position->sector, position->offset, &record) &&
+        record.consumed == STORE_ERASED_WORD)
+    {
+        store_clear_word(store_address(position->sector, position->offset) + offsetof(store_record_header_t, consumed));
+        s_pending_records--;
+        /* The head may still be at the end of a sector that was left for the next one */
+        store_advance_head();
+    }
+    xSemaphoreGive(s_mutex);
+}
+
+void telemetry_store_get_backlog(telemetry_store_backlog_t *backlog)
+{
+    const size_t sector_capacity = TELEMETRY_STORE_SECTOR_SIZE - STORE_SECTOR_HEADER_SIZE;
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    backlog->pending_records = s_pending_records;
+    if (s_head.sector == s_write_sector)
+    {
+        backlog->pending_bytes = s_write_offset - s_head.offset;
+    }
+    else
+    {
+        uint16_t full_sectors = (s_write_sector - s_head.sector - 1 + s_sector_count) % s_sector_count;
+        backlog->pending_bytes = (TELEMETRY_STORE_SECTOR_SIZE - s_head.offset) + full_sectors * sector_capacity +
+                                 (s_write_offset - STORE_SECTOR_HEADER_SIZE);
+    }
+    backlog->capacity_bytes = s_sector_count * sector_capacity;
+    backlog->dropped_records = s_dropped_records;
+    backlog->sector_erases = s_write_sequence / s_sector_count;
+    xSemaphoreGive(s_mutex);
+}
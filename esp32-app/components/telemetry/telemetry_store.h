@@ -0,0 +1,111 @@
+#ifndef COMPONENTS_TELEMETRY_STORE_H
+#define COMPONENTS_TELEMETRY_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+/**
+ * Append-only log of telemetry frames on the "telemetry" data partition (subtype 0x40), so that
+ * frames survive outages of the uplink and reboots.
+ *
+ * The partition is used as a ring of 4 KB sectors. Each sector starts with a header holding its
+ * sequence number, records are appended behind it. Sectors are erased in ring order, which spreads
+ * the erase cycles evenly over the partition. When the ring is full the oldest sector is erased,
+ * dropping whatever it still held. Every record carries a consumed flag that is cleared in place
+ * once the frame was delivered, so the read position is found again after a reboot.
+ *
+ * RAM usage does not depend on the partition size, only positions are kept in RAM.
+ */
+
+#define TELEMETRY_STORE_PARTITION_LABEL "telemetry"
+#define TELEMETRY_STORE_PARTITION_SUBTYPE 0x40
+
+#define TELEMETRY_STORE_SECTOR_SIZE 4096
+
+/* Largest record, one record must fit in a sector after the sector and record headers */
+#define TELEMETRY_STORE_MAX_RECORD_SIZE (TELEMETRY_STORE_SECTOR_SIZE - 16 - 8)
+
+/* Location of a record in the log */
+typedef struct
+{
+    uint32_t sequence; // Sequence of the sector when the position was taken, 0 if unset.
+    uint16_t sector;
+    uint16_t offset;
+} telemetry_store_position_t;
+
+typedef struct
+{
+    const uint8_t *data; // Points into the buffer passed to telemetry_store_read_batch().
+    uint16_t length;
+    telemetry_store_position_t position; // To be passed to telemetry_store_consume().
+} telemetry_store_record_t;
+
+typedef struct
+{
+    uint32_t pending_records; // Records appended but not consumed yet.
+    uint32_t pending_bytes;   // Flash used by pending records, including headers.
+    uint32_t capacity_bytes;  // Flash available for records.
+    uint32_t dropped_records; // Records erased before being consumed, since boot.
+    uint32_t sector_erases;   // Average erase cycles of a sector since the partition was formatted.
+} telemetry_store_backlog_t;
+
+/**
+ * @brief Open the log, recovering the read and write positions from flash. A partition without
+ * a valid log is formatted.
+ *
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if there is no telemetry partition.
+ */
+esp_err_t telemetry_store_init(void);
+
+/**
+ * @brief Append a record to the log.
+ *
+ * @param[in] data the record.
+ * @param[in] length length of the record, at most TELEMETRY_STORE_MAX_RECORD_SIZE.
+ *
+ * @return ESP_OK on success, a flash error otherwise.
+ */
+esp_err_t telemetry_store_append(const void *data, size_t length);
+
+/**
+ * @brief Get the position of the oldest record that was not consumed yet.
+ *
+ * @param[out] position where reading starts.
+ */
+void telemetry_store_rewind(telemetry_store_position_t *position);
+
+/**
+ * @brief Read the pending records that follow position, with a single flash read of at most
+ * size bytes. Records are not consumed by reading them. Corrupted records are skipped.
+ *
+ * @param[in,out] position where to read, moved past the returned records. Reset to the oldest
+ * pending record if its sector was erased in the meantime.
+ * @param[out] buffer receives the records.
+ * @param[in] size size of buffer, should be TELEMETRY_STORE_SECTOR_SIZE for the largest batches.
+ * @param[out] records the records found in buffer.
+ * @param[in] max_records room in records.
+ * @param[out] count number of records returned, 0 if there is nothing more to read.
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_SIZE if buffer cannot hold the next record.
+ */
+esp_err_t telemetry_store_read_batch(telemetry_store_position_t *position, uint8_t *buffer, size_t size,
+                                     telemetry_store_record_t *records, size_t max_records, size_t *count);
+
+/**
+ * @brief Mark a record as delivered. It is not returned by reads after a reboot and its flash
+ * can be reused.
+ *
+ * @param[in] position position of the record, as returned in its telemetry_store_record_t.
+ */
+void telemetry_store_consume(const telemetry_store_position_t *position);
+
+/**
+ * @brief Get the size of the backlog.
+ *
+ * @param[out] backlog the backlog.
+ */
+void telemetry_store_get_backlog(telemetry_store_backlog_t *backlog);
+
+#endif
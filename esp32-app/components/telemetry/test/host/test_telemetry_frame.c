@@ -0,0 +1,381 @@
+/* Unit tests and benchmark of the telemetry frame encoder and decoder on Linux.
+ *
+ *   telemetry_frame_test unit
+ *   telemetry_frame_test bench [rounds]
+ *
+ * The unit tests round trip samples and statistics, including the worst case sizes, and check that
+ * the decoder rejects every truncation, a flipped bit anywhere in a frame and frames of the wrong
+ * magic, version or type. The benchmark encodes and decodes a simulated day of samples, one every
+ * 10 s like the telemetry task, and prints the bytes and the time per sample for the batch size of
+ * the firmware and for full frames. */
+
+#include <math.h>
+#include <string.h>
+
+#include "host_test.h"
+#include "telemetry_frame.h"
+
+/* Samples of the telemetry task */
+#define TEST_SAMPLE_PERIOD_S 10
+#define TEST_BATCH_SIZE 6
+#define TEST_TRACE_SAMPLES (24 * 3600 / TEST_SAMPLE_PERIOD_S)
+
+/* The record the telemetry task printed before the frames, one packed struct per sample */
+#define TEST_LEGACY_SAMPLE_SIZE 32
+
+static const telemetry_header_t s_header = {
+    .type = TELEMETRY_TYPE_AIRQUALITY,
+    .device_type = TELEMETRY_DEVICE_TYPE_ICM,
+    .serial = 0x0123456789ABCDEF};
+
+static const telemetry_header_t s_statistics_header = {
+    .type = TELEMETRY_TYPE_AIRQUALITY_STATISTICS,
+    .device_type = TELEMETRY_DEVICE_TYPE_ECM,
+    .serial = 0x1122334455667788};
+
+static telemetry_airquality_t s_trace[TEST_TRACE_SAMPLES];
+
+static void test_check_header(const telemetry_header_t *actual, const telemetry_header_t *expected)
+{
+    HOST_CHECK_EQUAL(actual->type, expected->type);
+    HOST_CHECK_EQUAL(actual->device_type, expected->device_type);
+    HOST_CHECK(actual->serial == expected->serial);
+}
+
+static void test_check_sample(const telemetry_airquality_t *actual, const telemetry_airquality_t *expected)
+{
+    HOST_CHECK_EQUAL(actual->timestamp, expected->timestamp);
+    HOST_CHECK_EQUAL(actual->voc, expected->voc);
+    HOST_CHECK_EQUAL(actual->temperature, expected->temperature);
+    HOST_CHECK_EQUAL(actual->rhumidity, expected->rhumidity);
+    HOST_CHECK_EQUAL(actual->co2, expected->co2);
+    HOST_CHECK_EQUAL(actual->pm2p5, expected->pm2p5);
+    HOST_CHECK_EQUAL(actual->pm10p0, expected->pm10p0);
+    HOST_CHECK_EQUAL(actual->aqi, expected->aqi);
+}
+
+static size_t test_encode(telemetry_frame_encoder_t *encoder, const telemetry_airquality_t *samples, size_t count,
+                          const uint8_t **frame)
+{
+    telemetry_frame_begin(encoder, &s_header);
+    for (size_t i = 0; i < count; i++)
+    {
+        HOST_CHECK(telemetry_frame_add(encoder, &samples[i]));
+    }
+    return telemetry_frame_finish(encoder, frame);
+}
+
+static void test_round_trip(const telemetry_airquality_t *samples, size_t count)
+{
+    static telemetry_frame_encoder_t encoder;
+    telemetry_airquality_t decoded[TELEMETRY_FRAME_MAX_SAMPLES];
+    telemetry_header_t header;
+    const uint8_t *frame;
+
+    size_t length = test_encode(&encoder, samples, count, &frame);
+    HOST_CHECK(length <= TELEMETRY_FRAME_MAX_SIZE);
+    HOST_CHECK_EQUAL(telemetry_frame_decode(frame, length, &header, decoded, count), count);
+    test_check_header(&header, &s_header);
+    for (size_t i = 0; i < count; i++)
+    {
+        test_check_sample(&decoded[i], &samples[i]);
+    }
+}
+
+static void test_unit_crc(void)
+{
+    /* Check value of CRC-16/CCITT-FALSE */
+    HOST_CHECK_EQUAL(telemetry_frame_crc16((const uint8_t *)"123456789", 9), 0x29B1);
+    HOST_CHECK_EQUAL(telemetry_frame_crc16(NULL, 0), 0xFFFF);
+}
+
+static void test_unit_empty(void)
+{
+    static telemetry_frame_encoder_t encoder;
+    telemetry_header_t header;
+    const uint8_t *frame;
+
+    size_t length = test_encode(&encoder, NULL, 0, &frame);
+    HOST_CHECK_EQUAL(length, TELEMETRY_FRAME_HEADER_SIZE + TELEMETRY_FRAME_CRC_SIZE);
+    HOST_CHECK_EQUAL(telemetry_frame_decode(frame, length, &header, NULL, 0), 0);
+    test_check_header(&header, &s_header);
+}
+
+static void test_unit_random(void)
+{
+    telemetry_airquality_t samples[TELEMETRY_FRAME_MAX_SAMPLES];
+    uint32_t random = 0x7E1E;
+
+    for (int round = 0; round < 10000; round++)
+    {
+        size_t count = 1 + host_test_random(&random) % TELEMETRY_FRAME_MAX_SAMPLES;
+        for (size_t i = 0; i < count; i++)
+        {
+            samples[i] = (telemetry_airquality_t){
+                .timestamp = host_test_random(&random),
+                .voc = (int16_t)host_test_random(&random),
+                .temperature = (int16_t)host_test_random(&random),
+                .rhumidity = (int16_t)host_test_random(&random),
+                .co2 = (uint16_t)host_test_random(&random),
+                .pm2p5 = (uint16_t)host_test_random(&random),
+                .pm10p0 = (uint16_t)host_test_random(&random),
+                .aqi = (uint16_t)host_test_random(&random)};
+        }
+        test_round_trip(samples, count);
+    }
+}
+
+/* Every field swings across its whole range from one sample to the next */
+static void test_unit_worst_case(void)
+{
+    telemetry_airquality_t samples[TELEMETRY_FRAME_MAX_SAMPLES];
+    static telemetry_frame_encoder_t encoder;
+    const uint8_t *frame;
+
+    for (size_t i = 0; i < TELEMETRY_FRAME_MAX_SAMPLES; i++)
+    {
+        bool high = i % 2 == 0;
+        samples[i] = (telemetry_airquality_t){
+            /* Differences of at least 2^28 take five bytes */
+            .timestamp = (uint32_t)(i + 1) * 0xF0000000u,
+            .voc = high ? INT16_MAX : INT16_MIN,
+            .temperature = high ? INT16_MIN : INT16_MAX,
+            .rhumidity = high ? INT16_MAX : INT16_MIN,
+            .co2 = high ? UINT16_MAX : 0,
+            .pm2p5 = high ? UINT16_MAX : 0,
+            .pm10p0 = high ? UINT16_MAX : 0,
+            .aqi = high ? UINT16_MAX : 0};
+    }
+    test_round_trip(samples, TELEMETRY_FRAME_MAX_SAMPLES);
+    HOST_CHECK_EQUAL(test_encode(&encoder, samples, TELEMETRY_FRAME_MAX_SAMPLES, &frame), TELEMETRY_FRAME_MAX_SIZE);
+    HOST_CHECK(!telemetry_frame_add(&encoder, &samples[0]));
+}
+
+static void test_unit_statistics(void)
+{
+    static telemetry_frame_encoder_t encoder;
+    telemetry_airquality_statistics_t records[TELEMETRY_FRAME_MAX_STATISTICS];
+    telemetry_airquality_statistics_t decoded[TELEMETRY_FRAME_MAX_STATISTICS];
+    telemetry_header_t header;
+    const uint8_t *frame;
+    uint32_t random = 0x57A7;
+
+    for (int round = 0; round < 1000; round++)
+    {
+        size_t count = 1 + host_test_random(&random) % TELEMETRY_FRAME_MAX_STATISTICS;
+        telemetry_frame_begin(&encoder, &s_statistics_header);
+        for (size_t i = 0; i < count; i++)
+        {
+            telemetry_airquality_statistics_t *record = &records[i];
+            telemetry_statistic_t *fields[] = {&record->voc, &record->temperature, &record->rhumidity,
+                                               &record->co2, &record->pm2p5, &record->pm10p0};
+
+            record->timestamp = host_test_random(&random);
+            record->duration = host_test_random(&random) % 86400;
+            for (size_t field = 0; field < sizeof(fields) / sizeof(fields[0]); field++)
+            {
+                /* The extremes in every other round, the statistics of 16 bit fields */
+                bool extreme = round % 2 == 0;
+                *fields[field] = (telemetry_statistic_t){
+                    .count = extreme ? 8640 : host_test_random(&random) % 8641,
+                    .mean = extreme ? (i % 2 ? INT16_MIN : UINT16_MAX) : (int16_t)host_test_random(&random),
+                    .min = extreme ? (i % 2 ? UINT16_MAX : INT16_MIN) : (int16_t)host_test_random(&random),
+                    .max = (int16_t)host_test_random(&random),
+                    .p50 = (int16_t)host_test_random(&random),
+                    .p95 = (int16_t)host_test_random(&random)};
+            }
+            HOST_CHECK(telemetry_frame_add_statistics(&encoder, record));
+        }
+        size_t length = telemetry_frame_finish(&encoder, &frame);
+        HOST_CHECK(length <= TELEMETRY_FRAME_MAX_SIZE);
+        HOST_CHECK_EQUAL(telemetry_frame_decode_statistics(frame, length, &header, decoded, count), count);
+        test_check_header(&header, &s_statistics_header);
+        HOST_CHECK(memcmp(decoded, records, count * sizeof(records[0])) == 0);
+
+        /* A frame holds either samples or statistics */
+        HOST_CHECK_EQUAL(telemetry_frame_decode(frame, length, &header, NULL, 0), TELEMETRY_FRAME_ERR_TYPE);
+    }
+}
+
+static void test_unit_invalid(void)
+{
+    static telemetry_frame_encoder_t encoder;
+    static uint8_t copy[TELEMETRY_FRAME_MAX_SIZE];
+    telemetry_airquality_t samples[TEST_BATCH_SIZE];
+    telemetry_airquality_t decoded[TELEMETRY_FRAME_MAX_SAMPLES];
+    telemetry_header_t header;
+    const uint8_t *frame;
+
+    for (size_t i = 0; i < TEST_BATCH_SIZE; i++)
+    {
+        samples[i] = (telemetry_airquality_t){
+            .timestamp = 1000 + 10 * i, .voc = 1000, .temperature = 4400, .rhumidity = 4500, .co2 = 600, .pm2p5 = 50, .pm10p0 = 65, .aqi = 21};
+    }
+    size_t length = test_encode(&encoder, samples, TEST_BATCH_SIZE, &frame);
+    memcpy(copy, frame, length);
+
+    /* Any truncation */
+    for (size_t truncated = 0; truncated < length; truncated++)
+    {
+        HOST_CHECK(telemetry_frame_decode(copy, truncated, &header, decoded, TELEMETRY_FRAME_MAX_SAMPLES) < 0);
+    }
+
+    /* Any single bit error */
+    for (size_t bit = 0; bit < 8 * length; bit++)
+    {
+        copy[bit / 8] ^= 1 << (bit % 8);
+        HOST_CHECK(telemetry_frame_decode(copy, length, &header, decoded, TELEMETRY_FRAME_MAX_SAMPLES) < 0);
+        copy[bit / 8] ^= 1 << (bit % 8);
+    }
+
+    HOST_CHECK_EQUAL(telemetry_frame_decode(copy, length, &header, decoded, TEST_BATCH_SIZE - 1),
+                     TELEMETRY_FRAME_ERR_OVERFLOW);
+    HOST_CHECK_EQUAL(telemetry_frame_decode_statistics(copy, length, &header, NULL, 0), TELEMETRY_FRAME_ERR_TYPE);
+
+    copy[1] = 'X';
+    HOST_CHECK_EQUAL(telemetry_frame_decode(copy, length, &header, decoded, TEST_BATCH_SIZE), TELEMETRY_FRAME_ERR_MAGIC);
+    copy[1] = frame[1];
+    copy[2] = TELEMETRY_FRAME_VERSION - 1;
+    HOST_CHECK_EQUAL(telemetry_frame_decode(copy, length, &header, decoded, TEST_BATCH_SIZE), TELEMETRY_FRAME_ERR_VERSION);
+    copy[2] = frame[2];
+
+    /* A wrong count with a matching CRC */
+    copy[13]--;
+    uint16_t crc = telemetry_frame_crc16(copy, length - TELEMETRY_FRAME_CRC_SIZE);
+    copy[length - 2] = (uint8_t)crc;
+    copy[length - 1] = (uint8_t)(crc >> 8);
+    HOST_CHECK_EQUAL(telemetry_frame_decode(copy, length, &header, decoded, TEST_BATCH_SIZE), TELEMETRY_FRAME_ERR_TRUNCATED);
+}
+
+/* A day in an office: temperature and humidity follow the sun, CO2 builds up while people are in,
+the VOC index and the dust drift with occasional peaks. noise scales the sensor noise. */
+static void test_make_trace(telemetry_airquality_t *trace, size_t count, uint32_t seed, int noise)
+{
+    uint32_t random = seed;
+    double co2 = 420;
+    double voc = 100;
+    double pm2p5 = 5;
+
+#define TEST_NOISE(amplitude) ((int)(host_test_random(&random) % (2 * (amplitude) * noise + 1)) - (amplitude) * noise)
+
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t t = i * TEST_SAMPLE_PERIOD_S;
+        double day = 2 * M_PI * t / 86400.0;
+        bool occupied = t >= 8 * 3600 && t < 18 * 3600;
+
+        /* Two people breathing in a closed room, ventilation brings it back to the outside level */
+        co2 += occupied ? 0.8 : 0;
+        co2 -= (co2 - 420) * 0.0015;
+        voc += (100 - voc) * 0.01 + (occupied ? 0.05 : 0) + TEST_NOISE(1) * 0.3;
+        pm2p5 += (5 - pm2p5) * 0.005;
+        if (host_test_random(&random) % 1000 == 0)
+        {
+            /* Cooking or cleaning */
+            pm2p5 += 40;
+        }
+
+        uint16_t pm2p5_scaled = (uint16_t)lround(pm2p5 * 10) + TEST_NOISE(2);
+        trace[i] = (telemetry_airquality_t){
+            .timestamp = 1700000000 + t,
+            .voc = (int16_t)lround(voc * 10),
+            .temperature = (int16_t)lround((22 + 2 * sin(day - M_PI / 2)) * 200) + TEST_NOISE(4),
+            .rhumidity = (int16_t)lround((45 - 5 * sin(day - M_PI / 2)) * 100) + TEST_NOISE(8),
+            .co2 = (uint16_t)lround(co2) + TEST_NOISE(2),
+            .pm2p5 = pm2p5_scaled,
+            .pm10p0 = (uint16_t)(pm2p5_scaled * 13 / 10) + TEST_NOISE(2),
+            /* The US EPA breakpoint of 0 to 12 ug/m3 for 0 to 50 */
+            .aqi = (uint16_t)(pm2p5_scaled * 50 / 120)};
+    }
+#undef TEST_NOISE
+}
+
+static void test_unit_trace(void)
+{
+    test_make_trace(s_trace, TEST_TRACE_SAMPLES, 1, 1);
+    for (size_t i = 0; i + TELEMETRY_FRAME_MAX_SAMPLES <= TEST_TRACE_SAMPLES; i += TELEMETRY_FRAME_MAX_SAMPLES)
+    {
+        test_round_trip(&s_trace[i], TELEMETRY_FRAME_MAX_SAMPLES);
+    }
+}
+
+static void test_bench_trace(const char *name, unsigned long rounds, size_t batch)
+{
+    static telemetry_frame_encoder_t encoder;
+    static uint8_t frames[TEST_TRACE_SAMPLES][TELEMETRY_FRAME_MAX_SIZE];
+    static size_t lengths[TEST_TRACE_SAMPLES];
+    telemetry_airquality_t decoded[TELEMETRY_FRAME_MAX_SAMPLES];
+    telemetry_header_t header;
+    const uint8_t *frame;
+    size_t count = TEST_TRACE_SAMPLES / batch;
+    uint64_t bytes = 0;
+    uint64_t encode_ns = 0;
+    uint64_t decode_ns = 0;
+
+    for (unsigned long round = 0; round < rounds; round++)
+    {
+        uint64_t start_ns = host_test_now_ns();
+        for (size_t i = 0; i < count; i++)
+        {
+            lengths[i] = test_encode(&encoder, &s_trace[i * batch], batch, &frame);
+            memcpy(frames[i], frame, lengths[i]);
+        }
+        encode_ns += host_test_now_ns() - start_ns;
+
+        start_ns = host_test_now_ns();
+        for (size_t i = 0; i < count; i++)
+        {
+            HOST_CHECK_EQUAL(telemetry_frame_decode(frames[i], lengths[i], &header, decoded, batch), batch);
+        }
+        decode_ns += host_test_now_ns() - start_ns;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            bytes += lengths[i];
+        }
+    }
+
+    double samples = (double)rounds * count * batch;
+    printf("%s trace, %2zu samples per frame: %5.2f bytes/sample (%d before the frames), encode %5.1f ns/sample, "
+           "decode %5.1f ns/sample\n",
+           name, batch, bytes / samples, TEST_LEGACY_SAMPLE_SIZE, encode_ns / samples, decode_ns / samples);
+}
+
+static int test_bench(unsigned long rounds)
+{
+    static const struct
+    {
+        const char *name;
+        int noise;
+    } s_traces[] = {{"quiet", 1}, {"noisy", 8}};
+
+    for (size_t i = 0; i < sizeof(s_traces) / sizeof(s_traces[0]); i++)
+    {
+        test_make_trace(s_trace, TEST_TRACE_SAMPLES, 1, s_traces[i].noise);
+        test_bench_trace(s_traces[i].name, rounds, TEST_BATCH_SIZE);
+        test_bench_trace(s_traces[i].name, rounds, TELEMETRY_FRAME_MAX_SAMPLES);
+    }
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc >= 2 && strcmp(argv[1], "unit") == 0)
+    {
+        test_unit_crc();
+        test_unit_empty();
+        test_unit_random();
+        test_unit_worst_case();
+        test_unit_statistics();
+        test_unit_invalid();
+        test_unit_trace();
+        printf("telemetry_frame unit tests passed\n");
+        return EXIT_SUCCESS;
+    }
+    if (argc >= 2 && strcmp(argv[1], "bench") == 0)
+    {
+        return test_bench(host_test_arg(argc, argv, 2, 20));
+    }
+    fprintf(stderr, "usage: %s unit | bench [rounds]\n", argv[0]);
+    return EXIT_FAILURE;
+}
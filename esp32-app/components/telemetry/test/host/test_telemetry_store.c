@@ -0,0 +1,560 @@
+/* Tests of the telemetry store on Linux, on the flash of the esp_partition shim kept in a file.
+ * Every boot of the device is a child process that opens the file again, so the log is recovered
+ * from flash like after a reboot.
+ *
+ *   telemetry_store_test unit
+ *   telemetry_store_test torn [stride]
+ *
+ * unit checks that pending records survive reboots in order, that a full log drops the oldest
+ * records and counts them, that records consumed out of order are not returned again, and that
+ * sectors are erased evenly. torn cuts the power after every stride bytes programmed while records
+ * are appended and consumed, and checks after the reboot that no acknowledged record was lost or
+ * returned again and that the log still takes records. */
+
+#include <stdbool.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "esp_log.h"
+#include "host_shim.h"
+#include "host_test.h"
+#include "telemetry_store.h"
+
+#define TEST_MAX_RECORDS 8192
+#define TEST_MAX_LENGTH 200
+
+/* Large records, 4 per sector */
+#define TEST_LARGE_LENGTH 1000
+#define TEST_LARGE_PER_SECTOR 4
+
+#define TEST_PARTITION_SIZE (2 * 1024 * 1024)
+#define TEST_SECTOR_COUNT (TEST_PARTITION_SIZE / TELEMETRY_STORE_SECTOR_SIZE)
+
+/* Torn writes: records in the log before the power loss, and appended while it happens */
+#define TEST_TORN_BASE 50
+#define TEST_TORN_BASE_CONSUMED 10
+#define TEST_TORN_APPENDS 60
+
+typedef enum
+{
+    TEST_STATE_NONE,
+    TEST_STATE_APPENDING,
+    TEST_STATE_APPENDED,
+    TEST_STATE_CONSUMING,
+    TEST_STATE_CONSUMED,
+} test_state_t;
+
+static char s_path[] = "/tmp/telemetry_store_XXXXXX";
+
+/* Progress of the boot that loses power and records left after it, shared with the boots that
+follow */
+typedef struct
+{
+    uint8_t states[TEST_MAX_RECORDS];
+    size_t survivors;
+} test_torn_t;
+
+static test_torn_t *s_torn;
+
+/* Records read by test_read_all(), by order in the log */
+static uint32_t s_numbers[TEST_MAX_RECORDS];
+static telemetry_store_position_t s_positions[TEST_MAX_RECORDS];
+
+static size_t test_length(uint32_t number)
+{
+    return 4 + number * 37 % (TEST_MAX_LENGTH - 4);
+}
+
+static void test_fill(uint32_t number, uint8_t *data, size_t length)
+{
+    memcpy(data, &number, sizeof(number));
+    for (size_t i = sizeof(number); i < length; i++)
+    {
+        data[i] = (uint8_t)(number * 31 + i);
+    }
+}
+
+static void test_append(uint32_t number, size_t length)
+{
+    uint8_t data[TEST_LARGE_LENGTH];
+
+    test_fill(number, data, length);
+    HOST_CHECK_EQUAL(telemetry_store_append(data, length), ESP_OK);
+}
+
+/* Reads every pending record from the oldest one on and checks its contents. Returns the count. */
+static size_t test_read_all(void)
+{
+    uint8_t buffer[TELEMETRY_STORE_SECTOR_SIZE];
+    uint8_t expected[TEST_LARGE_LENGTH];
+    telemetry_store_record_t records[32];
+    telemetry_store_position_t position;
+    size_t total = 0;
+    size_t count;
+
+    telemetry_store_rewind(&position);
+    do
+    {
+        HOST_CHECK_EQUAL(telemetry_store_read_batch(&position, buffer, sizeof(buffer), records, 32, &count), ESP_OK);
+        for (size_t i = 0; i < count; i++)
+        {
+            uint32_t number;
+            HOST_CHECK(records[i].length >= sizeof(number) && records[i].length <= sizeof(expected));
+            memcpy(&number, records[i].data, sizeof(number));
+            test_fill(number, expected, records[i].length);
+            HOST_CHECK(memcmp(records[i].data, expected, records[i].length) == 0);
+            HOST_CHECK(total < TEST_MAX_RECORDS);
+            s_numbers[total] = number;
+            s_positions[total] = records[i].position;
+            total++;
+        }
+    } while (count > 0);
+    return total;
+}
+
+/* Checks that the pending records are first, first + 1, ... up to end, excluded */
+static void test_check_pending(uint32_t first, uint32_t end)
+{
+    telemetry_store_backlog_t backlog;
+
+    HOST_CHECK_EQUAL(test_read_all(), end - first);
+    for (uint32_t i = 0; i < end - first; i++)
+    {
+        HOST_CHECK_EQUAL(s_numbers[i], first + i);
+    }
+    telemetry_store_get_backlog(&backlog);
+    HOST_CHECK_EQUAL(backlog.pending_records, end - first);
+}
+
+static void test_erase_flash(void)
+{
+    HOST_CHECK(truncate(s_path, 0) == 0);
+}
+
+/* Boots the device in a child process that runs boot() on the store recovered from the file.
+Returns the exit status of the child. */
+static int test_boot(void (*boot)(void), uint32_t power_loss_bytes)
+{
+    int status;
+
+    fflush(NULL);
+    pid_t pid = fork();
+    HOST_CHECK(pid >= 0);
+    if (pid == 0)
+    {
+        host_flash_set_file(s_path);
+        if (power_loss_bytes != UINT32_MAX)
+        {
+            host_flash_set_power_loss(power_loss_bytes);
+        }
+        HOST_CHECK_EQUAL(telemetry_store_init(), ESP_OK);
+        boot();
+        exit(EXIT_SUCCESS);
+    }
+    HOST_CHECK(waitpid(pid, &status, 0) == pid);
+    HOST_CHECK(WIFEXITED(status));
+    return WEXITSTATUS(status);
+}
+
+static void test_boot_ok(void (*boot)(void))
+{
+    HOST_CHECK_EQUAL(test_boot(boot, UINT32_MAX), EXIT_SUCCESS);
+}
+
+static void test_reboot_first(void)
+{
+    test_check_pending(0, 0);
+    for (uint32_t number = 0; number < 1000; number++)
+    {
+        test_append(number, test_length(number));
+    }
+    test_check_pending(0, 1000);
+    for (uint32_t i = 0; i < 300; i++)
+    {
+        telemetry_store_consume(&s_positions[i]);
+    }
+    test_check_pending(300, 1000);
+}
+
+static void test_reboot_second(void)
+{
+    test_check_pending(300, 1000);
+    for (uint32_t i = 0; i < 200; i++)
+    {
+        telemetry_store_consume(&s_positions[i]);
+    }
+    for (uint32_t number = 1000; number < 1100; number++)
+    {
+        test_append(number, test_length(number));
+    }
+    test_check_pending(500, 1100);
+}
+
+static void test_reboot_third(void)
+{
+    test_check_pending(500, 1100);
+}
+
+static void test_reboot(void)
+{
+    test_erase_flash();
+    test_boot_ok(test_reboot_first);
+    test_boot_ok(test_reboot_second);
+    test_boot_ok(test_reboot_third);
+}
+
+/* Twice the capacity of the log is appended, nothing is consumed */
+#define TEST_OVERFLOW_RECORDS (2 * TEST_SECTOR_COUNT * TEST_LARGE_PER_SECTOR)
+
+static void test_check_overflow(uint32_t dropped)
+{
+    telemetry_store_backlog_t backlog;
+
+    telemetry_store_get_backlog(&backlog);
+    HOST_CHECK_EQUAL(backlog.dropped_records, dropped);
+    /* Only the oldest sectors were dropped, the ring but the sector being written is full */
+    HOST_CHECK(backlog.pending_records >= (TEST_SECTOR_COUNT - 1) * TEST_LARGE_PER_SECTOR);
+    HOST_CHECK(backlog.pending_records <= TEST_SECTOR_COUNT * TEST_LARGE_PER_SECTOR);
+    HOST_CHECK(backlog.pending_bytes <= backlog.capacity_bytes);
+    test_check_pending(TEST_OVERFLOW_RECORDS - backlog.pending_records, TEST_OVERFLOW_RECORDS);
+}
+
+static void test_overflow_first(void)
+{
+    telemetry_store_backlog_t backlog;
+
+    for (uint32_t number = 0; number < TEST_OVERFLOW_RECORDS; number++)
+    {
+        test_append(number, TEST_LARGE_LENGTH);
+    }
+    telemetry_store_get_backlog(&backlog);
+    HOST_CHECK_EQUAL(backlog.pending_records + backlog.dropped_records, TEST_OVERFLOW_RECORDS);
+    test_check_overflow(backlog.dropped_records);
+}
+
+static void test_overflow_second(void)
+{
+    /* Drops are counted since boot */
+    test_check_overflow(0);
+}
+
+static void test_overflow(void)
+{
+    test_erase_flash();
+    test_boot_ok(test_overflow_first);
+    test_boot_ok(test_overflow_second);
+}
+
+/* Every 7th record is kept, the others are consumed in a random order */
+#define TEST_UNORDERED_RECORDS 700
+#define TEST_UNORDERED_KEPT (TEST_UNORDERED_RECORDS / 7)
+
+static void test_check_unordered(void)
+{
+    HOST_CHECK_EQUAL(test_read_all(), TEST_UNORDERED_KEPT);
+    for (uint32_t i = 0; i < TEST_UNORDERED_KEPT; i++)
+    {
+        HOST_CHECK_EQUAL(s_numbers[i], i * 7 + 3);
+    }
+}
+
+static void test_unordered_first(void)
+{
+    uint32_t order[TEST_UNORDERED_RECORDS];
+    uint32_t random = 0x0DD;
+
+    for (uint32_t number = 0; number < TEST_UNORDERED_RECORDS; number++)
+    {
+        test_append(number, test_length(number));
+        order[number] = number;
+    }
+    test_check_pending(0, TEST_UNORDERED_RECORDS);
+    for (uint32_t i = TEST_UNORDERED_RECORDS - 1; i > 0; i--)
+    {
+        uint32_t j = host_test_random(&random) % (i + 1);
+        uint32_t swap = order[i];
+        order[i] = order[j];
+        order[j] = swap;
+    }
+    for (uint32_t i = 0; i < TEST_UNORDERED_RECORDS; i++)
+    {
+        if (order[i] % 7 != 3)
+        {
+            telemetry_store_consume(&s_positions[order[i]]);
+            /* Consuming twice changes nothing */
+            telemetry_store_consume(&s_positions[order[i]]);
+        }
+    }
+    test_check_unordered();
+}
+
+static void test_unordered_second(void)
+{
+    telemetry_store_backlog_t backlog;
+
+    test_check_unordered();
+    for (uint32_t i = TEST_UNORDERED_KEPT; i > 0; i--)
+    {
+        telemetry_store_consume(&s_positions[i - 1]);
+    }
+    test_check_pending(0, 0);
+    telemetry_store_get_backlog(&backlog);
+    HOST_CHECK_EQUAL(backlog.pending_bytes, 0);
+}
+
+static void test_unordered_third(void)
+{
+    test_check_pending(0, 0);
+}
+
+static void test_unordered(void)
+{
+    test_erase_flash();
+    test_boot_ok(test_unordered_first);
+    test_boot_ok(test_unordered_second);
+    test_boot_ok(test_unordered_third);
+}
+
+/* Each boot goes 1.5 times around the ring, appending and consuming like the uplink */
+#define TEST_ERASE_RECORDS (TEST_SECTOR_COUNT * TEST_LARGE_PER_SECTOR * 3 / 2)
+
+static uint32_t s_erase_boots;
+
+static void test_erase_boot(void)
+{
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                                TELEMETRY_STORE_PARTITION_SUBTYPE,
+                                                                TELEMETRY_STORE_PARTITION_LABEL);
+    telemetry_store_backlog_t backlog;
+    uint32_t first = s_erase_boots * TEST_ERASE_RECORDS;
+
+    for (uint32_t number = first; number < first + TEST_ERASE_RECORDS; number++)
+    {
+        test_append(number, TEST_LARGE_LENGTH);
+        HOST_CHECK_EQUAL(test_read_all(), 1);
+        HOST_CHECK_EQUAL(s_numbers[0], number);
+        telemetry_store_consume(&s_positions[0]);
+    }
+
+    /* The erases of this boot are spread evenly over the sectors */
+    uint32_t total = 0;
+    uint32_t min = UINT32_MAX;
+    uint32_t max = 0;
+    for (uint32_t sector = 0; sector < TEST_SECTOR_COUNT; sector++)
+    {
+        uint32_t count = host_flash_get_erase_count(partition, sector);
+        total += count;
+        min = count < min ? count : min;
+        max = count > max ? count : max;
+    }
+    HOST_CHECK(max - min <= 1);
+    HOST_CHECK(total >= TEST_ERASE_RECORDS / TEST_LARGE_PER_SECTOR - 1);
+    HOST_CHECK(total <= TEST_ERASE_RECORDS / TEST_LARGE_PER_SECTOR + 1);
+
+    /* A sector is formatted for every 4 records since the flash was erased */
+    uint32_t sectors = (first + TEST_ERASE_RECORDS + TEST_LARGE_PER_SECTOR - 1) / TEST_LARGE_PER_SECTOR;
+    telemetry_store_get_backlog(&backlog);
+    HOST_CHECK_EQUAL(backlog.sector_erases, sectors / TEST_SECTOR_COUNT);
+    HOST_CHECK_EQUAL(backlog.dropped_records, 0);
+    HOST_CHECK_EQUAL(backlog.pending_records, 0);
+}
+
+static void test_erase_counts(void)
+{
+    test_erase_flash();
+    for (s_erase_boots = 0; s_erase_boots < 2; s_erase_boots++)
+    {
+        test_boot_ok(test_erase_boot);
+    }
+}
+
+static void test_torn_base(void)
+{
+    for (uint32_t number = 0; number < TEST_TORN_BASE; number++)
+    {
+        test_append(number, test_length(number));
+    }
+    test_check_pending(0, TEST_TORN_BASE);
+    for (uint32_t i = 0; i < TEST_TORN_BASE_CONSUMED; i++)
+    {
+        telemetry_store_consume(&s_positions[i]);
+    }
+}
+
+/* Appends and consumes, recording each step in s_torn before and after it, until the power is
+lost. */
+static void test_torn_power_loss(void)
+{
+    telemetry_store_position_t positions[TEST_TORN_BASE + TEST_TORN_APPENDS];
+
+    HOST_CHECK_EQUAL(test_read_all(), TEST_TORN_BASE - TEST_TORN_BASE_CONSUMED);
+    for (uint32_t i = 0; i < TEST_TORN_BASE - TEST_TORN_BASE_CONSUMED; i++)
+    {
+        positions[s_numbers[i]] = s_positions[i];
+    }
+    for (uint32_t i = 0; i < TEST_TORN_APPENDS; i++)
+    {
+        uint32_t number = TEST_TORN_BASE + i;
+        s_torn->states[number] = TEST_STATE_APPENDING;
+        test_append(number, test_length(number));
+        s_torn->states[number] = TEST_STATE_APPENDED;
+
+        size_t count = test_read_all();
+        HOST_CHECK(count > 0 && s_numbers[count - 1] == number);
+        positions[number] = s_positions[count - 1];
+
+        /* The oldest record, and every third one also a recent one */
+        uint32_t consumed[2] = {TEST_TORN_BASE_CONSUMED + i / 2, number - 1};
+        for (uint32_t j = 0; j < (i % 3 == 0 ? 2u : 1u); j++)
+        {
+            if (s_torn->states[consumed[j]] == TEST_STATE_APPENDED)
+            {
+                s_torn->states[consumed[j]] = TEST_STATE_CONSUMING;
+                telemetry_store_consume(&positions[consumed[j]]);
+                s_torn->states[consumed[j]] = TEST_STATE_CONSUMED;
+            }
+        }
+    }
+}
+
+static void test_torn_check(void)
+{
+    size_t count = test_read_all();
+    size_t found = 0;
+
+    for (uint32_t number = 0; number < TEST_TORN_BASE + TEST_TORN_APPENDS; number++)
+    {
+        bool pending = found < count && s_numbers[found] == number;
+        found += pending;
+        switch (s_torn->states[number])
+        {
+        case TEST_STATE_NONE:
+        case TEST_STATE_CONSUMED:
+            HOST_CHECK(!pending);
+            break;
+        case TEST_STATE_APPENDED:
+            HOST_CHECK(pending);
+            break;
+        default:
+            /* Interrupted, either way is fine */
+            break;
+        }
+    }
+    /* In order and nothing else */
+    HOST_CHECK_EQUAL(found, count);
+    s_torn->survivors = count;
+}
+
+static void test_torn_recover(void)
+{
+    telemetry_store_backlog_t backlog;
+
+    test_torn_check();
+    telemetry_store_get_backlog(&backlog);
+    HOST_CHECK_EQUAL(backlog.pending_records, s_torn->survivors);
+
+    /* The log takes records again, behind the ones that survived */
+    for (uint32_t number = TEST_TORN_BASE + TEST_TORN_APPENDS; number < TEST_TORN_BASE + TEST_TORN_APPENDS + 3; number++)
+    {
+        test_append(number, test_length(number));
+        s_torn->states[number] = TEST_STATE_APPENDED;
+    }
+    HOST_CHECK_EQUAL(test_read_all(), s_torn->survivors + 3);
+}
+
+static void test_torn_reboot(void)
+{
+    size_t survivors = s_torn->survivors;
+
+    HOST_CHECK_EQUAL(test_read_all(), survivors + 3);
+    for (size_t i = 0; i < survivors + 3; i++)
+    {
+        telemetry_store_consume(&s_positions[i]);
+    }
+    test_check_pending(0, 0);
+}
+
+static void test_save(uint8_t *image)
+{
+    FILE *file = fopen(s_path, "rb");
+    HOST_CHECK(file != NULL);
+    HOST_CHECK_EQUAL(fread(image, 1, TEST_PARTITION_SIZE, file), TEST_PARTITION_SIZE);
+    fclose(file);
+}
+
+static void test_restore(const uint8_t *image)
+{
+    FILE *file = fopen(s_path, "wb");
+    HOST_CHECK(file != NULL);
+    HOST_CHECK_EQUAL(fwrite(image, 1, TEST_PARTITION_SIZE, file), TEST_PARTITION_SIZE);
+    fclose(file);
+}
+
+static void test_torn(uint32_t stride)
+{
+    static uint8_t image[TEST_PARTITION_SIZE];
+    uint32_t cuts = 0;
+
+    s_torn = mmap(NULL, sizeof(*s_torn), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    HOST_CHECK(s_torn != MAP_FAILED);
+    esp_log_level_set("*", ESP_LOG_ERROR);
+
+    test_erase_flash();
+    test_boot_ok(test_torn_base);
+    test_save(image);
+
+    for (uint32_t cut = 0;; cut += stride)
+    {
+        test_restore(image);
+        memset(s_torn, 0, sizeof(*s_torn));
+        for (uint32_t number = TEST_TORN_BASE_CONSUMED; number < TEST_TORN_BASE; number++)
+        {
+            s_torn->states[number] = TEST_STATE_APPENDED;
+        }
+        int status = test_boot(test_torn_power_loss, cut);
+        if (status == EXIT_SUCCESS)
+        {
+            /* Everything was written before the cut */
+            break;
+        }
+        HOST_CHECK_EQUAL(status, HOST_FLASH_POWER_LOSS_STATUS);
+        test_boot_ok(test_torn_recover);
+        test_boot_ok(test_torn_reboot);
+        cuts++;
+    }
+    HOST_CHECK(cuts > 0);
+    printf("%u power losses\n", cuts);
+    munmap(s_torn, sizeof(*s_torn));
+}
+
+int main(int argc, char **argv)
+{
+    int fd = mkstemp(s_path);
+    HOST_CHECK(fd >= 0);
+    close(fd);
+
+    int result = EXIT_FAILURE;
+    if (argc >= 2 && strcmp(argv[1], "unit") == 0)
+    {
+        test_reboot();
+        test_overflow();
+        test_unordered();
+        test_erase_counts();
+        printf("telemetry store unit tests passed\n");
+        result = EXIT_SUCCESS;
+    }
+    else if (argc >= 2 && strcmp(argv[1], "torn") == 0)
+    {
+        test_torn(host_test_arg(argc, argv, 2, 1));
+        printf("telemetry store torn write tests passed\n");
+        result = EXIT_SUCCESS;
+    }
+    else
+    {
+        fprintf(stderr, "usage: %s unit | torn [stride]\n", argv[0]);
+    }
+    unlink(s_path);
+    return result;
+}
@@ -0,0 +1,293 @@
+/* Tests of the telemetry uplink on Linux: the forward task, its in-flight window and
+ * telemetry_frame_delivered(), against a fake sender or the broker of the mqtt_client shim.
+ *
+ *   telemetry_uplink_test window [frames]
+ *   telemetry_uplink_test broker [frames]
+ *
+ * Both fill the store with numbered frames and wait until the uplink drained it. window sends them
+ * to a fake sender that acknowledges every frame after a random delay, so out of order, for several
+ * window sizes. It checks that no more frames than the window are ever unacknowledged, that the
+ * window is used, that every frame is delivered once and consumed, and prints the frames per second
+ * and the acknowledgement latency. broker does the same through telemetry_mqtt.c and the broker of
+ * the shim, which acknowledges in order. */
+
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "host_shim.h"
+#include "host_test.h"
+#include "sdkconfig.h"
+#include "telemetry.h"
+#include "telemetry_frame.h"
+#include "telemetry_store.h"
+
+#define TEST_MAX_FRAMES 2000
+
+/* Acknowledgement delays of the fake sender */
+#define TEST_MIN_ACK_US 2000
+#define TEST_MAX_ACK_US 20000
+
+#define TEST_DRAIN_TIMEOUT_NS (60 * 1000000000ull)
+
+typedef struct
+{
+    bool used;
+    int32_t token;
+    uint64_t ack_ns;
+} test_pending_t;
+
+/* The fake sender, called from the forward task, and the thread that acknowledges */
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static test_pending_t s_pending[TELEMETRY_MAX_WINDOW];
+static uint8_t s_window;
+static uint8_t s_outstanding;
+static uint8_t s_max_outstanding;
+static int32_t s_next_token;
+static uint32_t s_random = 0xACC;
+
+/* Frames seen by the sender or the broker, by number */
+static uint8_t s_delivered[TEST_MAX_FRAMES];
+static uint32_t s_next_expected;
+static bool s_in_order = true;
+
+static uint32_t test_frame_number(const uint8_t *frame, size_t length)
+{
+    telemetry_header_t header;
+    telemetry_airquality_t sample;
+
+    HOST_CHECK_EQUAL(telemetry_frame_decode(frame, length, &header, &sample, 1), 1);
+    HOST_CHECK(sample.timestamp < TEST_MAX_FRAMES);
+    return sample.timestamp;
+}
+
+/* Called by whoever sees a frame leave the device */
+static void test_record_frame(const uint8_t *frame, size_t length)
+{
+    uint32_t number = test_frame_number(frame, length);
+
+    pthread_mutex_lock(&s_lock);
+    s_delivered[number]++;
+    s_in_order &= number == s_next_expected;
+    s_next_expected = number + 1;
+    pthread_mutex_unlock(&s_lock);
+}
+
+static int32_t test_send(const uint8_t *frame, size_t length)
+{
+    int32_t token = -1;
+
+    test_record_frame(frame, length);
+    pthread_mutex_lock(&s_lock);
+    for (uint8_t i = 0; i < TELEMETRY_MAX_WINDOW; i++)
+    {
+        if (!s_pending[i].used)
+        {
+            uint32_t delay_us = TEST_MIN_ACK_US + host_test_random(&s_random) % (TEST_MAX_ACK_US - TEST_MIN_ACK_US);
+            token = s_next_token++;
+            s_pending[i] = (test_pending_t){.used = true, .token = token, .ack_ns = host_test_now_ns() + delay_us * 1000ull};
+            break;
+        }
+    }
+    HOST_CHECK(token >= 0);
+    s_outstanding++;
+    HOST_CHECK(s_outstanding <= s_window);
+    if (s_outstanding > s_max_outstanding)
+    {
+        s_max_outstanding = s_outstanding;
+    }
+    pthread_mutex_unlock(&s_lock);
+    return token;
+}
+
+static void *test_ack_thread(void *arg)
+{
+    (void)arg;
+
+    while (1)
+    {
+        int32_t due = -1;
+
+        pthread_mutex_lock(&s_lock);
+        for (uint8_t i = 0; i < TELEMETRY_MAX_WINDOW; i++)
+        {
+            if (s_pending[i].used && s_pending[i].ack_ns <= host_test_now_ns())
+            {
+                due = s_pending[i].token;
+                s_pending[i].used = false;
+                s_outstanding--;
+                break;
+            }
+        }
+        pthread_mutex_unlock(&s_lock);
+
+        if (due >= 0)
+        {
+            telemetry_frame_delivered(due);
+        }
+        else
+        {
+            usleep(200);
+        }
+    }
+    return NULL;
+}
+
+static void test_fill_store(uint32_t first, uint32_t count)
+{
+    static const telemetry_header_t s_header = {.type = TELEMETRY_TYPE_AIRQUALITY, .serial = 1};
+    static telemetry_frame_encoder_t encoder;
+    const uint8_t *frame;
+
+    HOST_CHECK(first + count <= TEST_MAX_FRAMES);
+    for (uint32_t number = first; number < first + count; number++)
+    {
+        telemetry_airquality_t sample = {.timestamp = number, .co2 = 400 + number % 100, .temperature = 4400};
+        telemetry_frame_begin(&encoder, &s_header);
+        HOST_CHECK(telemetry_frame_add(&encoder, &sample));
+        size_t length = telemetry_frame_finish(&encoder, &frame);
+        HOST_CHECK_EQUAL(telemetry_store_append(frame, length), ESP_OK);
+    }
+}
+
+/* Waits until acked frames were acknowledged and the store is empty, returns the time it took */
+static uint64_t test_wait_drained(uint32_t acked, uint64_t start_ns)
+{
+    telemetry_uplink_stats_t stats;
+    telemetry_store_backlog_t backlog;
+
+    do
+    {
+        HOST_CHECK(host_test_now_ns() - start_ns < TEST_DRAIN_TIMEOUT_NS);
+        usleep(1000);
+        telemetry_get_uplink_stats(&stats);
+        HOST_CHECK(telemetry_get_backlog(&backlog));
+    } while (stats.acked < acked || backlog.pending_records > 0);
+    return host_test_now_ns() - start_ns;
+}
+
+static void test_check_delivered(uint32_t count)
+{
+    pthread_mutex_lock(&s_lock);
+    for (uint32_t number = 0; number < count; number++)
+    {
+        HOST_CHECK_EQUAL(s_delivered[number], 1);
+    }
+    pthread_mutex_unlock(&s_lock);
+}
+
+static void test_print(const char *name, uint32_t frames, uint64_t elapsed_ns, const telemetry_uplink_stats_t *before,
+                       const telemetry_uplink_stats_t *after)
+{
+    uint32_t acked = after->acked - before->acked;
+    double latency_ms = (double)(after->total_ack_latency_ms - before->total_ack_latency_ms) / acked;
+
+    printf("%s: %u frames in %.2f s, %.0f frames/s, ack latency %.1f ms average\n", name, frames, elapsed_ns / 1e9,
+           frames / (elapsed_ns / 1e9), latency_ms);
+}
+
+static void test_window(uint32_t frames)
+{
+    static const uint8_t s_windows[] = {1, 4, 8, TELEMETRY_MAX_WINDOW};
+    double rate[sizeof(s_windows)];
+    pthread_t thread;
+    uint32_t first = 0;
+    telemetry_uplink_stats_t before;
+    telemetry_uplink_stats_t after;
+
+    HOST_CHECK(frames * sizeof(s_windows) <= TEST_MAX_FRAMES);
+    /* No broker, the fake sender is the only one */
+    host_mqtt_set_available(false);
+    telemetry_init();
+    HOST_CHECK(pthread_create(&thread, NULL, test_ack_thread, NULL) == 0);
+
+    for (size_t i = 0; i < sizeof(s_windows); i++)
+    {
+        char name[32];
+
+        test_fill_store(first, frames);
+        telemetry_get_uplink_stats(&before);
+        pthread_mutex_lock(&s_lock);
+        s_window = s_windows[i];
+        s_max_outstanding = 0;
+        pthread_mutex_unlock(&s_lock);
+
+        uint64_t start_ns = host_test_now_ns();
+        telemetry_set_sender(test_send, s_windows[i]);
+        uint64_t elapsed_ns = test_wait_drained(before.acked + frames, start_ns);
+        telemetry_set_sender(NULL, 0);
+        telemetry_get_uplink_stats(&after);
+
+        snprintf(name, sizeof(name), "window %2u", s_windows[i]);
+        test_print(name, frames, elapsed_ns, &before, &after);
+        rate[i] = frames / (elapsed_ns / 1e9);
+        first += frames;
+        test_check_delivered(first);
+        HOST_CHECK(s_in_order);
+        HOST_CHECK_EQUAL(after.published - before.published, frames);
+        HOST_CHECK_EQUAL(after.expired, 0);
+        HOST_CHECK_EQUAL(after.in_flight, 0);
+        HOST_CHECK(after.max_in_flight <= TELEMETRY_MAX_WINDOW);
+        /* The window is filled, not only allowed */
+        pthread_mutex_lock(&s_lock);
+        HOST_CHECK_EQUAL(s_max_outstanding, s_windows[i]);
+        pthread_mutex_unlock(&s_lock);
+    }
+
+    /* Four frames in flight at least double the rate of one at a time */
+    HOST_CHECK(rate[1] > 2 * rate[0]);
+}
+
+static void test_broker_receiver(const char *topic, const uint8_t *data, size_t length, void *arg)
+{
+    (void)topic;
+    (void)arg;
+    test_record_frame(data, length);
+}
+
+static void test_broker(uint32_t frames)
+{
+    host_mqtt_counters_t mqtt;
+    telemetry_uplink_stats_t before;
+    telemetry_uplink_stats_t after;
+
+    HOST_CHECK(frames <= TEST_MAX_FRAMES);
+    host_mqtt_set_available(false);
+    host_mqtt_set_receiver(test_broker_receiver, NULL);
+    telemetry_init();
+    test_fill_store(0, frames);
+    telemetry_get_uplink_stats(&before);
+
+    uint64_t start_ns = host_test_now_ns();
+    host_mqtt_set_available(true);
+    uint64_t elapsed_ns = test_wait_drained(frames, start_ns);
+    telemetry_get_uplink_stats(&after);
+    host_mqtt_get_counters(&mqtt);
+
+    test_print("broker", frames, elapsed_ns, &before, &after);
+    test_check_delivered(frames);
+    HOST_CHECK(s_in_order);
+    HOST_CHECK_EQUAL(mqtt.connects, 1);
+    HOST_CHECK_EQUAL(mqtt.published, frames);
+    HOST_CHECK_EQUAL(mqtt.acked, frames);
+    HOST_CHECK_EQUAL(after.max_in_flight, CONFIG_TELEMETRY_MQTT_WINDOW);
+    HOST_CHECK_EQUAL(after.in_flight, 0);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc >= 2 && strcmp(argv[1], "window") == 0)
+    {
+        test_window(host_test_arg(argc, argv, 2, 200));
+        printf("telemetry window tests passed\n");
+        return EXIT_SUCCESS;
+    }
+    if (argc >= 2 && strcmp(argv[1], "broker") == 0)
+    {
+        test_broker(host_test_arg(argc, argv, 2, 500));
+        printf("telemetry broker tests passed\n");
+        return EXIT_SUCCESS;
+    }
+    fprintf(stderr, "usage: %s window [frames] | broker [frames]\n", argv[0]);
+    return EXIT_FAILURE;
+}
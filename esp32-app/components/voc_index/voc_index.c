@@ -5,6 +5,9 @@
 #include "esp_log.h"
 
 #include "voc_index.h"
+#include "sample_bus.h"
+#include "acquisition.h"
+#include "energy.h"
 
 #include "sensirion_common.h"
 #include "sensirion_i2c_hal.h"
@@ -12,12 +15,16 @@
 
 #define TAG "voc_index.c"
 
-static void voc_index_task(void *pvParameters);
+/* SVM40 continuous measurement interval */
+#define VOC_INDEX_MEASUREMENT_PERIOD_MS 1000
+
+static acquisition_t s_acquisition;
 
-static int16_t s_voc_index, s_relative_humidity, s_temperature;
+static void voc_index_task(void *pvParameters);
 
 static void voc_index_task(void *pvParameters)
 {
+    (void)pvParameters;
     int16_t error = 0;
 
     sensirion_i2c_hal_init();
@@ -82,11 +89,24 @@ static void voc_index_task(void *pvParameters)
         ESP_LOGE(TAG, "Error executing svm40_start_continuous_measurement(): %i\n",
                error);
     }
+    /* Always continuous, the VOC algorithm needs a sample every second */
+    energy_set_state(ENERGY_CONSUMER_SVM40, ENERGY_STATE_MEASURING);
+
+    /* The SVM40 has no data ready flag, samples are read at its cadence */
+    acquisition_init(&s_acquisition, "SVM40", VOC_INDEX_MEASUREMENT_PERIOD_MS, NULL);
+    uint32_t missed = 0;
 
     while (1)
     {
+        acquisition_wait(&s_acquisition);
+        if (s_acquisition.stats.missed != missed)
+        {
+            ESP_LOGW(TAG, "%u sample(s) missed\n", s_acquisition.stats.missed - missed);
+            missed = s_acquisition.stats.missed;
+        }
+
         // Read Measurement
-        sensirion_i2c_hal_sleep_usec(1000000);
+        energy_mcu_acquire();
         int16_t voc_index;
         int16_t humidity;
         int16_t temperature;
@@ -100,10 +120,19 @@ static void voc_index_task(void *pvParameters)
         }
         else
         {
-            s_voc_index = (voc_index);
-            s_relative_humidity = (humidity);
-            s_temperature = (temperature);
+            const int16_t raw[] = {voc_index, humidity, temperature};
+            if (acquisition_sample_read(&s_acquisition, raw, sizeof(raw)))
+            {
+                ESP_LOGW(TAG, "Duplicate sample\n");
+            }
+            sample_bus_sample_t sample = {
+                .voc = {
+                    .voc_index = voc_index,
+                    .rhumidity = humidity,
+                    .temperature = temperature}};
+            sample_bus_publish(SAMPLE_BUS_SOURCE_VOC, &sample);
         }
+        energy_mcu_release();
     }
 
     error = svm40_stop_measurement();
@@ -111,27 +140,38 @@ static void voc_index_task(void *pvParameters)
     {
         ESP_LOGE(TAG, "Error executing svm40_stop_measurement(): %i\n", error);
     }
+    energy_set_state(ENERGY_CONSUMER_SVM40, ENERGY_STATE_IDLE);
     vTaskDelete(NULL);
 }
 
 void voc_index_init()
 {
-    /* Create and run task to read sensor values and store read sensor values on
-    static variables (s_*) */
+    /* Create and run task to read sensor values and publish them on the sample bus */
     xTaskCreate(voc_index_task, "voc task", 1024 * 4, NULL, 5, NULL);
 }
 
 void voc_index_get_voc(int16_t *voc_index)
 {
-    *voc_index = s_voc_index;
+    sample_bus_sample_t sample;
+    sample_bus_get(SAMPLE_BUS_SOURCE_VOC, &sample);
+    *voc_index = sample.voc.voc_index;
 }
 
 void voc_index_get_rhumidity(int16_t *rhumidity)
 {
-    *rhumidity = s_relative_humidity;
+    sample_bus_sample_t sample;
+    sample_bus_get(SAMPLE_BUS_SOURCE_VOC, &sample);
+    *rhumidity = sample.voc.rhumidity;
 }
 
 void voc_index_get_temperature(int16_t *temperature)
 {
-    *temperature = s_temperature;
+    sample_bus_sample_t sample;
+    sample_bus_get(SAMPLE_BUS_SOURCE_VOC, &sample);
+    *temperature = sample.voc.temperature;
+}
+
+void voc_index_get_acquisition_stats(acquisition_stats_t *stats)
+{
+    acquisition_get_stats(&s_acquisition, stats);
 }
@@ -1,6 +1,8 @@
 #ifndef COMPONENTS_VOC_INDEX_H
 #define COMPONENTS_VOC_INDEX_H
 
+#include "acquisition.h"
+
 /**
  * @brief Start the task for reading values from VOC sensor and update values on VOC,
  * temperature, and relative humidty.
@@ -31,4 +33,12 @@ void voc_index_get_rhumidity(int16_t *rhumidity);
  */ 
 void voc_index_get_temperature(int16_t *temperature);
 
+/**
+ * @brief Get the sample counters of the VOC sensor.
+ *
+ * @param[out] stats samples read, missed and duplicated. The SVM40 has no data ready flag, polls
+ * stays 0.
+ */
+void voc_index_get_acquisition_stats(acquisition_stats_t *stats);
+
 #endif
\ No newline at end of file
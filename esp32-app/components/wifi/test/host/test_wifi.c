@@ -0,0 +1,202 @@
+/* Tests of the wifi connection manager on Linux, against the access point of the esp_wifi shim.
+ *
+ *   wifi_test backoff
+ *   wifi_test reconnect
+ *
+ * backoff checks the delays of wifi_backoff_t alone. reconnect runs the component against a
+ * stand-in network: it boots without a cached access point, loses the connection, follows the
+ * access point to another channel and waits out an outage. It checks which attempts scan, the
+ * reconnect latency and the delays between failed attempts, and prints the latencies. */
+
+#include <string.h>
+#include <unistd.h>
+
+#include "esp_wifi.h"
+#include "nvs_flash.h"
+
+#include "host_shim.h"
+#include "host_test.h"
+#include "wifi.h"
+#include "wifi_backoff.h"
+
+/* Short attempts keep the test quick, the ratio is about the one of a real access point */
+#define TEST_SCAN_MS 200
+#define TEST_PROBE_MS 20
+
+/* Scheduling slack of the event loop and esp_timer tasks on a loaded machine */
+#define TEST_SLACK_MS 200
+
+#define TEST_POLL_US 1000
+
+static void test_backoff(void)
+{
+    wifi_backoff_t backoff;
+
+    for (uint32_t seed = 0; seed < 1000; seed++)
+    {
+        wifi_backoff_init(&backoff, 1000, 60000, seed);
+        for (int round = 0; round < 2; round++)
+        {
+            uint32_t bound = 1000;
+            for (uint32_t attempt = 1; attempt <= 12; attempt++)
+            {
+                uint32_t delay_ms = wifi_backoff_next(&backoff);
+                HOST_CHECK(delay_ms >= bound / 2 && delay_ms <= bound);
+                HOST_CHECK_EQUAL(backoff.attempts, attempt);
+                bound = bound * 2 > 60000 ? 60000 : bound * 2;
+            }
+            wifi_backoff_reset(&backoff);
+            HOST_CHECK_EQUAL(backoff.attempts, 0);
+        }
+    }
+
+    /* An initial delay above the maximum is capped */
+    wifi_backoff_init(&backoff, 5000, 2000, 1);
+    HOST_CHECK(wifi_backoff_next(&backoff) <= 2000);
+    HOST_CHECK(wifi_backoff_next(&backoff) <= 2000);
+}
+
+/* Waits until the event loop noticed the lost connection, then until it is back. Returns the time
+from the loss of the connection in ms. */
+static uint32_t test_wait_reconnected(uint64_t lost_ns)
+{
+    while (wifi_is_connected())
+    {
+        usleep(TEST_POLL_US);
+    }
+    HOST_CHECK(wifi_wait_connected(pdMS_TO_TICKS(30000)));
+    return (host_test_now_ns() - lost_ns) / 1000000;
+}
+
+/* Follows the pending reconnects while the access point is off. Checks that every delay is within
+the bound of the backoff and that the next attempt starts after it, returns when count delays went
+by. */
+static void test_follow_backoff(uint32_t count)
+{
+    uint32_t bound = 1000;
+    wifi_stats_t stats;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        /* The retry was scheduled after the last poll that did not see it and the attempt started
+        before the poll that saw it, so the time between these polls is never shorter than the delay */
+        uint64_t not_scheduled_ns;
+        do
+        {
+            not_scheduled_ns = host_test_now_ns();
+            usleep(TEST_POLL_US);
+            wifi_get_stats(&stats);
+        } while (stats.next_retry_ms == 0);
+        uint32_t delay_ms = stats.next_retry_ms;
+        uint32_t attempts = stats.attempts;
+        HOST_CHECK(delay_ms >= bound / 2 && delay_ms <= bound);
+
+        do
+        {
+            usleep(TEST_POLL_US);
+            wifi_get_stats(&stats);
+        } while (stats.attempts == attempts);
+        uint64_t waited_ns = host_test_now_ns() - not_scheduled_ns;
+        uint32_t waited_ms = waited_ns / 1000000;
+        printf("backoff: %u ms scheduled, next attempt after %u ms\n", delay_ms, waited_ms);
+        HOST_CHECK(waited_ns >= delay_ms * 1000000ull && waited_ms <= delay_ms + TEST_SLACK_MS);
+        bound *= 2;
+    }
+}
+
+static void test_reconnect(void)
+{
+    static const uint8_t s_moved_bssid[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x02};
+    host_wifi_counters_t before;
+    host_wifi_counters_t after;
+    wifi_stats_t stats;
+
+    host_wifi_set_timing(TEST_SCAN_MS, TEST_PROBE_MS);
+    HOST_CHECK_EQUAL(nvs_flash_init(), ESP_OK);
+
+    /* First boot, nothing cached: one scan */
+    initialize_wifi();
+    HOST_CHECK(wifi_wait_connected(pdMS_TO_TICKS(5000)));
+    wifi_get_stats(&stats);
+    host_wifi_get_counters(&after);
+    printf("boot: connected in %u ms\n", stats.last_connect_ms);
+    HOST_CHECK_EQUAL(after.scans, 1);
+    HOST_CHECK_EQUAL(stats.fast_connects, 0);
+    HOST_CHECK(stats.last_connect_ms >= TEST_SCAN_MS && stats.last_connect_ms <= TEST_SCAN_MS + TEST_SLACK_MS);
+    HOST_CHECK_EQUAL(host_nvs_get_write_count(), 1);
+
+    /* Lost connections come back through the cached access point, every time */
+    for (uint32_t i = 1; i <= 3; i++)
+    {
+        uint64_t lost_ns = host_test_now_ns();
+        host_wifi_drop(WIFI_REASON_BEACON_TIMEOUT);
+        uint32_t latency_ms = test_wait_reconnected(lost_ns);
+        wifi_get_stats(&stats);
+        printf("drop %u: reconnected in %u ms\n", i, latency_ms);
+        HOST_CHECK(latency_ms <= TEST_PROBE_MS + TEST_SLACK_MS);
+        HOST_CHECK_EQUAL(stats.fast_connects, i);
+        HOST_CHECK_EQUAL(stats.disconnects, i);
+    }
+    host_wifi_get_counters(&after);
+    HOST_CHECK_EQUAL(after.scans, 1);
+    HOST_CHECK_EQUAL(host_nvs_get_write_count(), 1);
+
+    /* The access point moved to another channel: the probe fails, the scan right after it finds the
+    access point, which is cached again */
+    host_wifi_get_counters(&before);
+    uint64_t lost_ns = host_test_now_ns();
+    host_wifi_set_access_point(s_moved_bssid, 11);
+    uint32_t latency_ms = test_wait_reconnected(lost_ns);
+    host_wifi_get_counters(&after);
+    printf("moved: reconnected in %u ms\n", latency_ms);
+    HOST_CHECK(latency_ms >= TEST_PROBE_MS + TEST_SCAN_MS && latency_ms <= TEST_PROBE_MS + TEST_SCAN_MS + TEST_SLACK_MS);
+    HOST_CHECK_EQUAL(after.attempts - before.attempts, 2);
+    HOST_CHECK_EQUAL(after.scans - before.scans, 1);
+    HOST_CHECK_EQUAL(host_nvs_get_write_count(), 2);
+
+    lost_ns = host_test_now_ns();
+    host_wifi_drop(WIFI_REASON_BEACON_TIMEOUT);
+    latency_ms = test_wait_reconnected(lost_ns);
+    printf("drop after the move: reconnected in %u ms\n", latency_ms);
+    HOST_CHECK(latency_ms <= TEST_PROBE_MS + TEST_SLACK_MS);
+
+    /* Outage: the probe and a scan fail right away, then the scans back off */
+    host_wifi_set_available(false);
+    test_follow_backoff(2);
+    do
+    {
+        usleep(TEST_POLL_US);
+        wifi_get_stats(&stats);
+    } while (stats.next_retry_ms == 0);
+    host_wifi_set_available(true);
+    uint32_t pending_ms = stats.next_retry_ms;
+    lost_ns = host_test_now_ns();
+    HOST_CHECK(wifi_wait_connected(pdMS_TO_TICKS(30000)));
+    latency_ms = (host_test_now_ns() - lost_ns) / 1000000;
+    printf("outage over: reconnected in %u ms, %u ms of it backoff\n", latency_ms, pending_ms);
+    HOST_CHECK(latency_ms <= pending_ms + TEST_SCAN_MS + TEST_SLACK_MS);
+
+    /* The connection reset the backoff */
+    host_wifi_set_available(false);
+    test_follow_backoff(1);
+    host_wifi_set_available(true);
+    HOST_CHECK(wifi_wait_connected(pdMS_TO_TICKS(30000)));
+}
+
+int main(int argc, char **argv)
+{
+    if (argc >= 2 && strcmp(argv[1], "backoff") == 0)
+    {
+        test_backoff();
+        printf("wifi backoff tests passed\n");
+        return EXIT_SUCCESS;
+    }
+    if (argc >= 2 && strcmp(argv[1], "reconnect") == 0)
+    {
+        test_reconnect();
+        printf("wifi reconnect tests passed\n");
+        return EXIT_SUCCESS;
+    }
+    fprintf(stderr, "usage: %s backoff | reconnect\n", argv[0]);
+    return EXIT_FAILURE;
+}
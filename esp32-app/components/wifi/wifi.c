@@ -1,9 +1,261 @@
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_netif.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "nvs.h"
+
 #include "wifi.h"
+#include "wifi_backoff.h"
+
+#define TAG "wifi.c"
+
+#define WIFI_CONNECTED_BIT BIT0
+
+#define WIFI_BACKOFF_INITIAL_MS 1000
+
+/* Retry of a reconnect the timer could not hand over to the event loop, its queue was full */
+#define WIFI_RECONNECT_POST_RETRY_MS 100
+
+/* Access point of the last successful connection, so that reconnects skip the scan */
+#define WIFI_NVS_NAMESPACE "wifi"
+#define WIFI_NVS_KEY_AP "ap"
+
+typedef struct
+{
+    uint8_t bssid[6];
+    uint8_t channel;
+} wifi_cached_ap_t;
+
+/* Private event of the reconnect timer, so that every connection attempt starts from the event
+loop task */
+ESP_EVENT_DEFINE_BASE(WIFI_RECONNECT_EVENT);
+
+static EventGroupHandle_t s_events;
+static esp_timer_handle_t s_reconnect_timer;
+static wifi_backoff_t s_backoff;
+
+/* Only used from the default event loop task */
+static wifi_cached_ap_t s_cached_ap;
+static bool s_cached_ap_valid;
+static bool s_fast_attempt;
+static int64_t s_attempt_start_us;
+
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static wifi_stats_t s_stats;
+
+static void wifi_load_cached_ap(void)
+{
+    nvs_handle_t handle;
+    size_t length = sizeof(s_cached_ap);
+
+    if (nvs_open(WIFI_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK)
+    {
+        return;
+    }
+    s_cached_ap_valid = nvs_get_blob(handle, WIFI_NVS_KEY_AP, &s_cached_ap, &length) == ESP_OK &&
+                        length == sizeof(s_cached_ap);
+    nvs_close(handle);
+}
+
+static void wifi_save_cached_ap(void)
+{
+    wifi_ap_record_t ap;
+    nvs_handle_t handle;
+
+    if (esp_wifi_sta_get_ap_info(&ap) != ESP_OK)
+    {
+        return;
+    }
+    if (s_cached_ap_valid && s_cached_ap.channel == ap.primary && memcmp(s_cached_ap.bssid, ap.bssid, sizeof(ap.bssid)) == 0)
+    {
+        /* Unchanged, do not wear the flash */
+        return;
+    }
+
+    memcpy(s_cached_ap.bssid, ap.bssid, sizeof(ap.bssid));
+    s_cached_ap.channel = ap.primary;
+    s_cached_ap_valid = true;
+
+    if (nvs_open(WIFI_NVS_NAMESPACE, NVS_READWRITE, &handle) == ESP_OK)
+    {
+        if (nvs_set_blob(handle, WIFI_NVS_KEY_AP, &s_cached_ap, sizeof(s_cached_ap)) == ESP_OK)
+        {
+            nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+}
+
+static void wifi_connect(void)
+{
+    wifi_config_t config = {0};
+
+    strlcpy((char *)config.sta.ssid, CONFIG_WIFI_SSID, sizeof(config.sta.ssid));
+    strlcpy((char *)config.sta.password, CONFIG_WIFI_PASSWORD, sizeof(config.sta.password));
+
+    /* The cached access point is joined directly on its channel, which saves the scan of all
+    channels. If that fails the next attempt scans again. */
+    s_fast_attempt = s_cached_ap_valid;
+    if (s_fast_attempt)
+    {
+        config.sta.bssid_set = true;
+        memcpy(config.sta.bssid, s_cached_ap.bssid, sizeof(config.sta.bssid));
+        config.sta.channel = s_cached_ap.channel;
+        config.sta.scan_method = WIFI_FAST_SCAN;
+    }
+    else
+    {
+        config.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+        config.sta.sort_method = WIFI_CONNECT_AP_BY_SIGNAL;
+    }
 
-#define SSID
-#define PASSWORD
+    portENTER_CRITICAL(&s_stats_lock);
+    s_stats.attempts++;
+    s_stats.next_retry_ms = 0;
+    portEXIT_CRITICAL(&s_stats_lock);
+
+    s_attempt_start_us = esp_timer_get_time();
+    esp_wifi_set_config(WIFI_IF_STA, &config);
+    esp_err_t err = esp_wifi_connect();
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Error executing esp_wifi_connect(): %s", esp_err_to_name(err));
+    }
+}
+
+/* On the esp_timer task, which must not block */
+static void wifi_reconnect_timer_callback(void *arg)
+{
+    (void)arg;
+    if (esp_event_post(WIFI_RECONNECT_EVENT, 0, NULL, 0, 0) != ESP_OK)
+    {
+        esp_timer_start_once(s_reconnect_timer, WIFI_RECONNECT_POST_RETRY_MS * 1000);
+    }
+}
+
+static void wifi_schedule_reconnect(void)
+{
+    uint32_t delay_ms = wifi_backoff_next(&s_backoff);
+
+    portENTER_CRITICAL(&s_stats_lock);
+    s_stats.next_retry_ms = delay_ms;
+    portEXIT_CRITICAL(&s_stats_lock);
+
+    ESP_LOGI(TAG, "Reconnecting in %u ms", delay_ms);
+    esp_timer_stop(s_reconnect_timer);
+    esp_timer_start_once(s_reconnect_timer, (uint64_t)delay_ms * 1000);
+}
+
+static void wifi_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+    (void)arg;
+    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START)
+    {
+        wifi_connect();
+    }
+    else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED)
+    {
+        const wifi_event_sta_disconnected_t *event = event_data;
+        bool was_connected = xEventGroupGetBits(s_events) & WIFI_CONNECTED_BIT;
+
+        xEventGroupClearBits(s_events, WIFI_CONNECTED_BIT);
+        ESP_LOGW(TAG, "Disconnected, reason %u", event->reason);
+        if (was_connected)
+        {
+            portENTER_CRITICAL(&s_stats_lock);
+            s_stats.disconnects++;
+            portEXIT_CRITICAL(&s_stats_lock);
+        }
+
+        if (was_connected)
+        {
+            /* Lost an established connection, the cached access point is the best guess */
+            wifi_connect();
+        }
+        else if (s_fast_attempt)
+        {
+            /* The access point moved or is gone, scan right away instead of backing off */
+            s_cached_ap_valid = false;
+            wifi_connect();
+        }
+        else
+        {
+            wifi_schedule_reconnect();
+        }
+    }
+    else if (event_base == WIFI_RECONNECT_EVENT)
+    {
+        wifi_connect();
+    }
+    else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP)
+    {
+        uint32_t connect_ms = (esp_timer_get_time() - s_attempt_start_us) / 1000;
+
+        portENTER_CRITICAL(&s_stats_lock);
+        s_stats.connects++;
+        if (s_fast_attempt)
+        {
+            s_stats.fast_connects++;
+        }
+        s_stats.last_connect_ms = connect_ms;
+        portEXIT_CRITICAL(&s_stats_lock);
+
+        ESP_LOGI(TAG, "Connected in %u ms%s", connect_ms, s_fast_attempt ? " to the cached access point" : "");
+        s_fast_attempt = false;
+        wifi_backoff_reset(&s_backoff);
+        wifi_save_cached_ap();
+        xEventGroupSetBits(s_events, WIFI_CONNECTED_BIT);
+    }
+}
 
 void initialize_wifi()
 {
-    // esp_err_t
-}
\ No newline at end of file
+    s_events = xEventGroupCreate();
+    wifi_backoff_init(&s_backoff, WIFI_BACKOFF_INITIAL_MS, CONFIG_WIFI_BACKOFF_MAX_S * 1000, esp_random());
+    wifi_load_cached_ap();
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = wifi_reconnect_timer_callback,
+        .name = "wifi reconnect"};
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &s_reconnect_timer));
+
+    ESP_ERROR_CHECK(esp_netif_init());
+    ESP_ERROR_CHECK(esp_event_loop_create_default());
+    esp_netif_create_default_wifi_sta();
+
+    wifi_init_config_t init_config = WIFI_INIT_CONFIG_DEFAULT();
+    ESP_ERROR_CHECK(esp_wifi_init(&init_config));
+    /* The access point is cached in NVS by this component, only when it changes */
+    ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM));
+
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, wifi_event_handler, NULL, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, wifi_event_handler, NULL, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_RECONNECT_EVENT, ESP_EVENT_ANY_ID, wifi_event_handler, NULL, NULL));
+
+    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
+    /* Connecting starts from the WIFI_EVENT_STA_START event */
+    ESP_ERROR_CHECK(esp_wifi_start());
+}
+
+bool wifi_is_connected(void)
+{
+    return s_events != NULL && (xEventGroupGetBits(s_events) & WIFI_CONNECTED_BIT);
+}
+
+bool wifi_wait_connected(TickType_t ticks_to_wait)
+{
+    return xEventGroupWaitBits(s_events, WIFI_CONNECTED_BIT, pdFALSE, pdTRUE, ticks_to_wait) & WIFI_CONNECTED_BIT;
+}
+
+void wifi_get_stats(wifi_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_stats_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_stats_lock);
+}
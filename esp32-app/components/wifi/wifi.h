@@ -1,9 +1,48 @@
 #ifndef COMPONENTS_WIFI_WIFI_H
 #define COMPONENTS_WIFI_WIFI_H
 
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct
+{
+    uint32_t connects;        // Times an IP address was obtained.
+    uint32_t fast_connects;   // Connects that used the cached access point without scanning.
+    uint32_t disconnects;
+    uint32_t attempts;        // Connection attempts, including failed ones.
+    uint32_t last_connect_ms; // Time from the last connection attempt until the IP address.
+    uint32_t next_retry_ms;   // Delay before the pending reconnect, 0 if none is pending.
+} wifi_stats_t;
+
 /**
- * @brief Initialize the wifi and connect to access point.
+ * @brief Initialize the wifi and connect to access point. Does not wait for the connection,
+ * reconnects are handled in the background.
  */ 
 void initialize_wifi();
 
+/**
+ * @brief Tell whether the station is connected and has an IP address.
+ *
+ * @return true if connected.
+ */
+bool wifi_is_connected(void);
+
+/**
+ * @brief Wait until the station is connected and has an IP address.
+ *
+ * @param[in] ticks_to_wait maximum time to wait.
+ *
+ * @return true if connected.
+ */
+bool wifi_wait_connected(TickType_t ticks_to_wait);
+
+/**
+ * @brief Get the connection statistics.
+ *
+ * @param[out] stats copy of the statistics.
+ */
+void wifi_get_stats(wifi_stats_t *stats);
+
 #endif
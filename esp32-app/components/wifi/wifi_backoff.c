@@ -0,0 +1,30 @@
+#include "wifi_backoff.h"
+
+void wifi_backoff_init(wifi_backoff_t *backoff, uint32_t initial_ms, uint32_t max_ms, uint32_t seed)
+{
+    backoff->initial_ms = initial_ms;
+    backoff->max_ms = max_ms;
+    backoff->random = seed != 0 ? seed : 0x9E3779B9;
+    wifi_backoff_reset(backoff);
+}
+
+uint32_t wifi_backoff_next(wifi_backoff_t *backoff)
+{
+    uint32_t bound = backoff->current_ms;
+
+    backoff->random ^= backoff->random << 13;
+    backoff->random ^= backoff->random >> 17;
+    backoff->random ^= backoff->random << 5;
+
+    backoff->current_ms = bound > backoff->max_ms / 2 ? backoff->max_ms : bound * 2;
+    backoff->attempts++;
+
+    /* Half of the bound is fixed so that the delay still grows, the rest is random */
+    return bound / 2 + backoff->random % (bound - bound / 2 + 1);
+}
+
+void wifi_backoff_reset(wifi_backoff_t *backoff)
+{
+    backoff->current_ms = backoff->initial_ms < backoff->max_ms ? backoff->initial_ms : backoff->max_ms;
+    backoff->attempts = 0;
+}
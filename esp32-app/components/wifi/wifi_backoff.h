@@ -0,0 +1,46 @@
+#ifndef COMPONENTS_WIFI_BACKOFF_H
+#define COMPONENTS_WIFI_BACKOFF_H
+
+#include <stdint.h>
+
+/**
+ * Exponential backoff with jitter for reconnect attempts. Only depends on the C library so that
+ * the reconnect behaviour can be exercised on a host.
+ */
+typedef struct
+{
+    uint32_t initial_ms;
+    uint32_t max_ms;
+    uint32_t current_ms; // Upper bound of the next delay.
+    uint32_t attempts;   // Delays handed out since the last reset.
+    uint32_t random;     // xorshift32 state, never 0.
+} wifi_backoff_t;
+
+/**
+ * @brief Initialize a backoff.
+ *
+ * @param[out] backoff the backoff.
+ * @param[in] initial_ms upper bound of the first delay.
+ * @param[in] max_ms upper bound of every delay.
+ * @param[in] seed seed of the jitter, should differ between devices.
+ */
+void wifi_backoff_init(wifi_backoff_t *backoff, uint32_t initial_ms, uint32_t max_ms, uint32_t seed);
+
+/**
+ * @brief Get the delay before the next attempt. The delay is between half and all of the current
+ * bound, which doubles with every call up to max_ms.
+ *
+ * @param[in,out] backoff the backoff.
+ *
+ * @return the delay in milliseconds.
+ */
+uint32_t wifi_backoff_next(wifi_backoff_t *backoff);
+
+/**
+ * @brief Start over with the initial delay, after a successful connection.
+ *
+ * @param[in,out] backoff the backoff.
+ */
+void wifi_backoff_reset(wifi_backoff_t *backoff);
+
+#endif
@@ -0,0 +1,24 @@
+/**
+ * @file disp_spi.h
+ * Host version of the display SPI bus. A transfer completes after the time it takes at 40 MHz,
+ * behind the transfers queued before it.
+ */
+
+#ifndef DISP_SPI_H
+#define DISP_SPI_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/* Time the transfers would have kept a 40 MHz bus busy */
+uint64_t disp_spi_get_busy_time_us(void);
+void disp_wait_for_pending_transactions(void);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* DISP_SPI_H */
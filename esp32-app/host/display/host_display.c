@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+
+#include "lvgl_helpers.h"
+#include "disp_spi.h"
+#include "host_display.h"
+
+#define DISPLAY_SPI_CLOCK_MHZ 40
+
+/* CASET and RASET with their 4 byte arguments and RAMWR, sent before the pixels of every flush */
+#define DISPLAY_WINDOW_BITS ((1 + 4 + 1 + 4 + 1) * 8)
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static lv_color_t s_frame[LV_VER_RES_MAX][LV_HOR_RES_MAX];
+static uint64_t s_busy_us;
+static uint32_t s_flush_count;
+static uint64_t s_pixel_count;
+
+/* The bus is busy until s_bus_free_us. The timer plays the SPI interrupt at the end of the pixel
+transfer, which calls lv_disp_flush_ready() like the post transaction callback on the target. */
+static int64_t s_bus_free_us;
+static esp_timer_handle_t s_transfer_timer;
+
+static void disp_transfer_done(void *arg)
+{
+    lv_disp_flush_ready(arg);
+}
+
+void lvgl_driver_init(void)
+{
+}
+
+void disp_driver_flush(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_map)
+{
+    uint32_t width = lv_area_get_width(area);
+    uint32_t pixels = lv_area_get_size(area);
+    uint64_t transfer_us = ((uint64_t)pixels * LV_COLOR_DEPTH + DISPLAY_WINDOW_BITS) / DISPLAY_SPI_CLOCK_MHZ;
+
+    /* LVGL waits for lv_disp_flush_ready() before it flushes again, one transfer at a time */
+    if (s_transfer_timer == NULL)
+    {
+        const esp_timer_create_args_t timer_args = {.callback = disp_transfer_done, .arg = drv, .name = "disp_spi"};
+        ESP_ERROR_CHECK(esp_timer_create(&timer_args, &s_transfer_timer));
+    }
+
+    int64_t now_us = esp_timer_get_time();
+    portENTER_CRITICAL(&s_lock);
+    for (lv_coord_t y = area->y1; y <= area->y2; y++)
+    {
+        memcpy(&s_frame[y][area->x1], color_map, width * sizeof(lv_color_t));
+        color_map += width;
+    }
+    s_bus_free_us = (s_bus_free_us > now_us ? s_bus_free_us : now_us) + transfer_us;
+    s_busy_us += transfer_us;
+    s_flush_count++;
+    s_pixel_count += pixels;
+    int64_t done_us = s_bus_free_us - now_us;
+    portEXIT_CRITICAL(&s_lock);
+
+    ESP_ERROR_CHECK(esp_timer_start_once(s_transfer_timer, done_us));
+}
+
+uint64_t disp_spi_get_busy_time_us(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    uint64_t busy_us = s_busy_us;
+    portEXIT_CRITICAL(&s_lock);
+    return busy_us;
+}
+
+void disp_wait_for_pending_transactions(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    int64_t wait_us = s_bus_free_us - esp_timer_get_time();
+    portEXIT_CRITICAL(&s_lock);
+    if (wait_us > 0)
+    {
+        usleep(wait_us);
+    }
+}
+
+uint32_t host_display_get_flush_count(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    uint32_t count = s_flush_count;
+    portEXIT_CRITICAL(&s_lock);
+    return count;
+}
+
+uint64_t host_display_get_pixel_count(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    uint64_t count = s_pixel_count;
+    portEXIT_CRITICAL(&s_lock);
+    return count;
+}
+
+bool host_display_write_ppm(const char *path)
+{
+    FILE *file = fopen(path, "wb");
+
+    if (file == NULL)
+    {
+        return false;
+    }
+    fprintf(file, "P6\n%d %d\n255\n", LV_HOR_RES_MAX, LV_VER_RES_MAX);
+    portENTER_CRITICAL(&s_lock);
+    for (int y = 0; y < LV_VER_RES_MAX; y++)
+    {
+        for (int x = 0; x < LV_HOR_RES_MAX; x++)
+        {
+            uint32_t rgb = lv_color_to32(s_frame[y][x]);
+            uint8_t pixel[3] = {(rgb >> 16) & 0xFF, (rgb >> 8) & 0xFF, rgb & 0xFF};
+            fwrite(pixel, 1, sizeof(pixel), file);
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return fclose(file) == 0;
+}
@@ -0,0 +1,33 @@
+/**
+ * @file host_display.h
+ * Access to the frame buffer of the host display.
+ */
+
+#ifndef HOST_DISPLAY_H
+#define HOST_DISPLAY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Write what the display shows as a binary PPM image.
+ *
+ * @returns true on success
+ */
+bool host_display_write_ppm(const char *path);
+
+/** Number of flushes since start */
+uint32_t host_display_get_flush_count(void);
+
+/** Number of pixels flushed since start */
+uint64_t host_display_get_pixel_count(void);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* HOST_DISPLAY_H */
@@ -0,0 +1,26 @@
+/**
+ * @file lvgl_helpers.h
+ * Host version of the lvgl_esp32_drivers helpers: a 240x240 ST7789 that is a frame buffer in
+ * memory, see host_display.h.
+ */
+
+#ifndef LVGL_HELPERS_H
+#define LVGL_HELPERS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "lvgl.h"
+
+/* Same buffer size as for the ST7789 on the target */
+#define DISP_BUF_SIZE (LV_HOR_RES_MAX * 40)
+
+void lvgl_driver_init(void);
+void disp_driver_flush(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_map);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* LVGL_HELPERS_H */
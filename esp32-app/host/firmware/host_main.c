@@ -0,0 +1,112 @@
+/*
+ * Host entry point of the firmware. Starts app_main() in the main task like the ESP-IDF startup
+ * code, with the sensors, the network, the broker and the display simulated by the host shims.
+ *
+ *   airquality_host [--seconds N] [--port P] [--flash FILE] [--screenshot FILE] [--help]
+ *
+ * Runs for N seconds, forever by default, and serves the metrics on port P (8080). With --flash
+ * the data partitions are kept in FILE, so the telemetry log survives a restart like a reboot. On
+ * exit the display is written to the --screenshot FILE as a PPM image.
+ */
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "host_shim.h"
+#include "host_display.h"
+
+#define HOST_DEFAULT_HTTP_PORT 8080
+
+void app_main(void);
+
+static void main_task(void *arg)
+{
+    (void)arg;
+    app_main();
+    vTaskDelete(NULL);
+}
+
+static void usage(const char *program)
+{
+    fprintf(stderr, "usage: %s [--seconds N] [--port P] [--flash FILE] [--screenshot FILE] [--help]\n", program);
+}
+
+int main(int argc, char **argv)
+{
+    static const struct option s_options[] = {
+        {"seconds", required_argument, NULL, 's'},
+        {"port", required_argument, NULL, 'p'},
+        {"flash", required_argument, NULL, 'f'},
+        {"screenshot", required_argument, NULL, 'o'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}};
+    unsigned long seconds = 0;
+    unsigned long port = HOST_DEFAULT_HTTP_PORT;
+    const char *screenshot = NULL;
+    int option;
+
+    while ((option = getopt_long(argc, argv, "s:p:f:o:h", s_options, NULL)) != -1)
+    {
+        switch (option)
+        {
+        case 's':
+            seconds = strtoul(optarg, NULL, 0);
+            break;
+        case 'p':
+            port = strtoul(optarg, NULL, 0);
+            break;
+        case 'f':
+            host_flash_set_file(optarg);
+            break;
+        case 'o':
+            screenshot = optarg;
+            break;
+        case 'h':
+            usage(argv[0]);
+            return EXIT_SUCCESS;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind != argc || port > 0xFFFF)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    host_httpd_set_port(port);
+    if (xTaskCreate(main_task, "main", 3584, NULL, 1, NULL) != pdPASS)
+    {
+        return EXIT_FAILURE;
+    }
+
+    if (seconds == 0)
+    {
+        while (1)
+        {
+            pause();
+        }
+    }
+    struct timespec duration = {.tv_sec = seconds};
+    while (nanosleep(&duration, &duration) != 0)
+    {
+    }
+
+    host_mqtt_counters_t mqtt;
+    host_mqtt_get_counters(&mqtt);
+    printf("host: %lu s, %u display flushes of %llu pixels, %u frames acknowledged by the broker\n", seconds,
+           (unsigned)host_display_get_flush_count(), (unsigned long long)host_display_get_pixel_count(),
+           (unsigned)mqtt.acked);
+    if (screenshot != NULL && !host_display_write_ppm(screenshot))
+    {
+        fprintf(stderr, "Error writing %s\n", screenshot);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
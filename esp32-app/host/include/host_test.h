@@ -0,0 +1,59 @@
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* Checks stay enabled in every build type, unlike assert() */
+#define HOST_CHECK(condition)                                                          \
+    do                                                                                 \
+    {                                                                                  \
+        if (!(condition))                                                              \
+        {                                                                              \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            exit(EXIT_FAILURE);                                                        \
+        }                                                                              \
+    } while (0)
+
+#define HOST_CHECK_EQUAL(actual, expected)                                                              \
+    do                                                                                                  \
+    {                                                                                                   \
+        long long host_actual = (long long)(actual);                                                    \
+        long long host_expected = (long long)(expected);                                                \
+        if (host_actual != host_expected)                                                               \
+        {                                                                                               \
+            fprintf(stderr, "%s:%d: %s is %lld, expected %lld\n", __FILE__, __LINE__, #actual, host_actual, \
+                    host_expected);                                                                     \
+            exit(EXIT_FAILURE);                                                                         \
+        }                                                                                               \
+    } while (0)
+
+/* Monotonic time for benchmarks. Unit in nanoseconds. */
+static inline uint64_t host_test_now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+/* Deterministic pseudo random numbers, the same sequence on every run */
+static inline uint32_t host_test_random(uint32_t *state)
+{
+    /* xorshift32 */
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+/* Optional count from the command line, e.g. more iterations when run by hand */
+static inline unsigned long host_test_arg(int argc, char **argv, int index, unsigned long fallback)
+{
+    return argc > index ? strtoul(argv[index], NULL, 0) : fallback;
+}
+
+#endif
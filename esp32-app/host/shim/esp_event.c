@@ -0,0 +1,163 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_event.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+#define ESP_EVENT_QUEUE_LENGTH 32
+
+typedef struct esp_event_handler_node
+{
+    esp_event_base_t base;
+    int32_t id;
+    esp_event_handler_t handler;
+    void *arg;
+    struct esp_event_handler_node *next;
+} esp_event_handler_node_t;
+
+typedef struct
+{
+    esp_event_base_t base;
+    int32_t id;
+    void *data;
+} esp_event_posted_t;
+
+static QueueHandle_t s_queue;
+/* Handlers may register or unregister handlers while the loop calls them */
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static esp_event_handler_node_t *s_handlers;
+
+static void esp_event_loop_task(void *arg)
+{
+    (void)arg;
+    esp_event_posted_t event;
+
+    while (1)
+    {
+        xQueueReceive(s_queue, &event, portMAX_DELAY);
+        portENTER_CRITICAL(&s_lock);
+        for (esp_event_handler_node_t *node = s_handlers; node != NULL; node = node->next)
+        {
+            if ((node->base == ESP_EVENT_ANY_BASE || node->base == event.base) &&
+                (node->id == ESP_EVENT_ANY_ID || node->id == event.id))
+            {
+                node->handler(node->arg, event.base, event.id, event.data);
+            }
+        }
+        portEXIT_CRITICAL(&s_lock);
+        free(event.data);
+    }
+}
+
+esp_err_t esp_event_loop_create_default(void)
+{
+    if (s_queue != NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_queue = xQueueCreate(ESP_EVENT_QUEUE_LENGTH, sizeof(esp_event_posted_t));
+    if (s_queue == NULL || xTaskCreate(esp_event_loop_task, "sys_evt", 2304, NULL, 20, NULL) != pdPASS)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_instance_register(esp_event_base_t event_base, int32_t event_id,
+                                              esp_event_handler_t event_handler, void *event_handler_arg,
+                                              esp_event_handler_instance_t *instance)
+{
+    esp_event_handler_node_t *node = calloc(1, sizeof(*node));
+
+    if (node == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    node->base = event_base;
+    node->id = event_id;
+    node->handler = event_handler;
+    node->arg = event_handler_arg;
+
+    /* Appended, handlers run in the order they were registered */
+    portENTER_CRITICAL(&s_lock);
+    esp_event_handler_node_t **link = &s_handlers;
+    while (*link != NULL)
+    {
+        link = &(*link)->next;
+    }
+    *link = node;
+    portEXIT_CRITICAL(&s_lock);
+
+    if (instance != NULL)
+    {
+        *instance = node;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_register(esp_event_base_t event_base, int32_t event_id,
+                                     esp_event_handler_t event_handler, void *event_handler_arg)
+{
+    return esp_event_handler_instance_register(event_base, event_id, event_handler, event_handler_arg, NULL);
+}
+
+static esp_err_t esp_event_unregister_node(esp_event_base_t event_base, int32_t event_id,
+                                           esp_event_handler_t event_handler, esp_event_handler_instance_t instance)
+{
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+
+    portENTER_CRITICAL(&s_lock);
+    for (esp_event_handler_node_t **link = &s_handlers; *link != NULL; link = &(*link)->next)
+    {
+        esp_event_handler_node_t *node = *link;
+        if (node->base == event_base && node->id == event_id &&
+            (instance != NULL ? node == instance : node->handler == event_handler))
+        {
+            *link = node->next;
+            /* Not freed, the loop may be iterating over it */
+            err = ESP_OK;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return err;
+}
+
+esp_err_t esp_event_handler_unregister(esp_event_base_t event_base, int32_t event_id, esp_event_handler_t event_handler)
+{
+    return esp_event_unregister_node(event_base, event_id, event_handler, NULL);
+}
+
+esp_err_t esp_event_handler_instance_unregister(esp_event_base_t event_base, int32_t event_id,
+                                                esp_event_handler_instance_t instance)
+{
+    return esp_event_unregister_node(event_base, event_id, NULL, instance);
+}
+
+esp_err_t esp_event_post(esp_event_base_t event_base, int32_t event_id, const void *event_data,
+                         size_t event_data_size, TickType_t ticks_to_wait)
+{
+    esp_event_posted_t event = {.base = event_base, .id = event_id};
+
+    if (s_queue == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (event_data != NULL && event_data_size > 0)
+    {
+        /* Copied like on the target, the poster's buffer may be gone when the handlers run */
+        event.data = malloc(event_data_size);
+        if (event.data == NULL)
+        {
+            return ESP_ERR_NO_MEM;
+        }
+        memcpy(event.data, event_data, event_data_size);
+    }
+    if (xQueueSend(s_queue, &event, ticks_to_wait) != pdTRUE)
+    {
+        free(event.data);
+        return ESP_ERR_TIMEOUT;
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,316 @@
+#include <errno.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "esp_http_server.h"
+
+#include "host_shim.h"
+
+#define HTTPD_MAX_REQUEST_HEADER 2048
+
+struct httpd_server
+{
+    int listen_fd;
+    uint16_t recv_wait_timeout;
+    uint16_t max_uri_handlers;
+    uint16_t handler_count;
+    httpd_uri_t *handlers;
+    pthread_mutex_t lock;
+    pthread_t thread;
+};
+
+/* Response state of a request, req->aux */
+typedef struct
+{
+    int fd;
+    const char *status;
+    const char *type;
+    bool sent;
+} httpd_response_t;
+
+static pthread_mutex_t s_port_lock = PTHREAD_MUTEX_INITIALIZER;
+static int s_port_override = -1;
+static uint16_t s_bound_port;
+
+static bool httpd_send_all(int fd, const char *data, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (sent <= 0)
+        {
+            return false;
+        }
+        data += sent;
+        length -= sent;
+    }
+    return true;
+}
+
+/* Reads up to the end of the request header, the requests of the application have no body */
+static bool httpd_read_request(int fd, char *buffer, size_t size)
+{
+    size_t length = 0;
+
+    while (length < size - 1)
+    {
+        ssize_t received = recv(fd, buffer + length, size - 1 - length, 0);
+        if (received < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (received <= 0)
+        {
+            return false;
+        }
+        length += received;
+        buffer[length] = '\0';
+        if (strstr(buffer, "\r\n\r\n") != NULL)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static int httpd_parse_method(const char *method)
+{
+    static const char *const s_methods[] = {
+        [HTTP_DELETE] = "DELETE", [HTTP_GET] = "GET", [HTTP_HEAD] = "HEAD", [HTTP_POST] = "POST", [HTTP_PUT] = "PUT"};
+
+    for (size_t i = 0; i < sizeof(s_methods) / sizeof(s_methods[0]); i++)
+    {
+        if (strcmp(method, s_methods[i]) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void httpd_send_error(int fd, const char *status, const char *message)
+{
+    char response[256];
+
+    int length = snprintf(response, sizeof(response),
+                          "HTTP/1.1 %s\r\nContent-Type: text/html\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n%s",
+                          status, strlen(message), message);
+    httpd_send_all(fd, response, length);
+}
+
+static void httpd_handle_connection(struct httpd_server *server, int fd)
+{
+    char request[HTTPD_MAX_REQUEST_HEADER];
+    char method[8];
+    char uri[HTTPD_MAX_URI_LEN + 1];
+    httpd_uri_t handler = {0};
+    bool found = false;
+
+    if (!httpd_read_request(fd, request, sizeof(request)) ||
+        sscanf(request, "%7s %512s HTTP/1.", method, uri) != 2)
+    {
+        httpd_send_error(fd, "400 Bad Request", "Bad request syntax");
+        return;
+    }
+    /* The query is not part of the match, like the default matching of esp_http_server */
+    uri[strcspn(uri, "?")] = '\0';
+    int method_id = httpd_parse_method(method);
+
+    pthread_mutex_lock(&server->lock);
+    for (uint16_t i = 0; i < server->handler_count; i++)
+    {
+        if ((int)server->handlers[i].method == method_id && strcmp(server->handlers[i].uri, uri) == 0)
+        {
+            handler = server->handlers[i];
+            found = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&server->lock);
+
+    if (!found)
+    {
+        httpd_send_error(fd, "404 Not Found", "Nothing matches the given URI");
+        return;
+    }
+
+    httpd_response_t response = {.fd = fd, .status = "200 OK", .type = "text/html"};
+    httpd_req_t req = {.handle = server, .method = method_id, .aux = &response, .user_ctx = handler.user_ctx};
+    memcpy((char *)req.uri, uri, sizeof(uri));
+    if (handler.handler(&req) != ESP_OK && !response.sent)
+    {
+        httpd_send_error(fd, "500 Internal Server Error", "Server has encountered an unexpected error");
+    }
+}
+
+static void *httpd_server_task(void *arg)
+{
+    struct httpd_server *server = arg;
+
+    pthread_setname_np(pthread_self(), "httpd");
+    while (1)
+    {
+        int fd = accept(server->listen_fd, NULL, NULL);
+        if (fd < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+            {
+                continue;
+            }
+            /* httpd_stop() shut the socket down */
+            break;
+        }
+        struct timeval timeout = {.tv_sec = server->recv_wait_timeout};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        httpd_handle_connection(server, fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config)
+{
+    struct sockaddr_in address = {.sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    socklen_t address_length = sizeof(address);
+    int reuse = 1;
+
+    pthread_mutex_lock(&s_port_lock);
+    address.sin_port = htons(s_port_override >= 0 ? s_port_override : config->server_port);
+    pthread_mutex_unlock(&s_port_lock);
+
+    struct httpd_server *server = calloc(1, sizeof(*server));
+    if (server == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    server->handlers = calloc(config->max_uri_handlers, sizeof(httpd_uri_t));
+    server->max_uri_handlers = config->max_uri_handlers;
+    server->recv_wait_timeout = config->recv_wait_timeout;
+    pthread_mutex_init(&server->lock, NULL);
+    server->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (server->handlers == NULL || server->listen_fd < 0)
+    {
+        goto error;
+    }
+    setsockopt(server->listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (bind(server->listen_fd, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+        listen(server->listen_fd, config->backlog_conn) != 0 ||
+        getsockname(server->listen_fd, (struct sockaddr *)&address, &address_length) != 0)
+    {
+        goto error;
+    }
+    if (pthread_create(&server->thread, NULL, httpd_server_task, server) != 0)
+    {
+        goto error;
+    }
+
+    pthread_mutex_lock(&s_port_lock);
+    s_bound_port = ntohs(address.sin_port);
+    pthread_mutex_unlock(&s_port_lock);
+    *handle = server;
+    return ESP_OK;
+
+error:
+    if (server->listen_fd >= 0)
+    {
+        close(server->listen_fd);
+    }
+    free(server->handlers);
+    free(server);
+    return ESP_ERR_HTTPD_TASK;
+}
+
+esp_err_t httpd_stop(httpd_handle_t handle)
+{
+    struct httpd_server *server = handle;
+
+    shutdown(server->listen_fd, SHUT_RDWR);
+    pthread_join(server->thread, NULL);
+    close(server->listen_fd);
+    free(server->handlers);
+    free(server);
+    return ESP_OK;
+}
+
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t *uri_handler)
+{
+    struct httpd_server *server = handle;
+    esp_err_t err = ESP_OK;
+
+    pthread_mutex_lock(&server->lock);
+    for (uint16_t i = 0; i < server->handler_count; i++)
+    {
+        if (server->handlers[i].method == uri_handler->method && strcmp(server->handlers[i].uri, uri_handler->uri) == 0)
+        {
+            err = ESP_ERR_HTTPD_HANDLER_EXISTS;
+        }
+    }
+    if (err == ESP_OK && server->handler_count == server->max_uri_handlers)
+    {
+        err = ESP_ERR_HTTPD_HANDLERS_FULL;
+    }
+    if (err == ESP_OK)
+    {
+        server->handlers[server->handler_count++] = *uri_handler;
+    }
+    pthread_mutex_unlock(&server->lock);
+    return err;
+}
+
+esp_err_t httpd_resp_set_status(httpd_req_t *r, const char *status)
+{
+    ((httpd_response_t *)r->aux)->status = status;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_type(httpd_req_t *r, const char *type)
+{
+    ((httpd_response_t *)r->aux)->type = type;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send(httpd_req_t *r, const char *buf, ssize_t buf_len)
+{
+    httpd_response_t *response = r->aux;
+    char header[256];
+
+    if (buf_len == HTTPD_RESP_USE_STRLEN)
+    {
+        buf_len = buf != NULL ? strlen(buf) : 0;
+    }
+    int length = snprintf(header, sizeof(header), "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %zd\r\nConnection: close\r\n\r\n",
+                          response->status, response->type, buf_len);
+    response->sent = true;
+    if (!httpd_send_all(response->fd, header, length) ||
+        (r->method != HTTP_HEAD && !httpd_send_all(response->fd, buf, buf_len)))
+    {
+        return ESP_ERR_HTTPD_RESP_SEND;
+    }
+    return ESP_OK;
+}
+
+void host_httpd_set_port(uint16_t port)
+{
+    pthread_mutex_lock(&s_port_lock);
+    s_port_override = port;
+    pthread_mutex_unlock(&s_port_lock);
+}
+
+uint16_t host_httpd_get_port(void)
+{
+    pthread_mutex_lock(&s_port_lock);
+    uint16_t port = s_bound_port;
+    pthread_mutex_unlock(&s_port_lock);
+    return port;
+}
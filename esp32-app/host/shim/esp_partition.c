@@ -0,0 +1,215 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "esp_log.h"
+#include "esp_partition.h"
+
+#include "host_shim.h"
+
+#define TAG "esp_partition"
+
+#define PARTITION_COUNT (sizeof(s_partitions) / sizeof(s_partitions[0]))
+#define PARTITION_MAX_SECTORS 512
+
+static const esp_partition_t s_partitions[] = {
+    /* Same as in partitions.csv */
+    {.type = ESP_PARTITION_TYPE_DATA, .subtype = 0x40, .address = 0x190000, .size = 0x200000, .label = "telemetry"},
+};
+
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint8_t *s_flash[PARTITION_COUNT];
+static uint32_t s_erase_counts[PARTITION_COUNT][PARTITION_MAX_SECTORS];
+
+/* The file the partitions are kept in, back to back in the order of s_partitions. NULL keeps them
+in memory. */
+static const char *s_path;
+
+/* Bytes that are still programmed before the power is lost */
+static bool s_power_loss;
+static uint32_t s_power_loss_bytes;
+
+static size_t esp_partition_index(const esp_partition_t *partition)
+{
+    return partition - s_partitions;
+}
+
+/* Only called with partitions returned by esp_partition_find_first(), which opened the flash */
+static uint8_t *esp_partition_flash(const esp_partition_t *partition)
+{
+    return s_flash[esp_partition_index(partition)];
+}
+
+static bool esp_partition_in_range(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    return offset <= partition->size && size <= partition->size - offset;
+}
+
+/* Maps the file, a new file is erased flash. Called with s_lock held. */
+static bool esp_partition_open_file(void)
+{
+    size_t size = 0;
+    struct stat status;
+
+    for (size_t i = 0; i < PARTITION_COUNT; i++)
+    {
+        size += s_partitions[i].size;
+    }
+    int fd = open(s_path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0 || fstat(fd, &status) != 0)
+    {
+        ESP_LOGE(TAG, "Cannot open %s: %d", s_path, errno);
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return false;
+    }
+    bool created = status.st_size == 0;
+    if ((created && ftruncate(fd, size) != 0) || (!created && (size_t)status.st_size != size))
+    {
+        ESP_LOGE(TAG, "%s is not a flash image of %zu bytes", s_path, size);
+        close(fd);
+        return false;
+    }
+    void *flash = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (flash == MAP_FAILED)
+    {
+        ESP_LOGE(TAG, "Cannot map %s: %d", s_path, errno);
+        return false;
+    }
+    if (created)
+    {
+        memset(flash, 0xFF, size);
+    }
+    for (size_t i = 0; i < PARTITION_COUNT; i++)
+    {
+        s_flash[i] = flash;
+        flash = (uint8_t *)flash + s_partitions[i].size;
+    }
+    return true;
+}
+
+/* Opens the flash of a partition on first use. Called with s_lock held. */
+static bool esp_partition_open(size_t index)
+{
+    if (s_flash[index] != NULL)
+    {
+        return true;
+    }
+    if (s_path != NULL)
+    {
+        return esp_partition_open_file();
+    }
+    s_flash[index] = malloc(s_partitions[index].size);
+    if (s_flash[index] == NULL)
+    {
+        return false;
+    }
+    memset(s_flash[index], 0xFF, s_partitions[index].size);
+    return true;
+}
+
+void host_flash_set_file(const char *path)
+{
+    pthread_mutex_lock(&s_lock);
+    s_path = path;
+    pthread_mutex_unlock(&s_lock);
+}
+
+void host_flash_set_power_loss(uint32_t bytes)
+{
+    pthread_mutex_lock(&s_lock);
+    s_power_loss = true;
+    s_power_loss_bytes = bytes;
+    pthread_mutex_unlock(&s_lock);
+}
+
+uint32_t host_flash_get_erase_count(const esp_partition_t *partition, uint32_t sector)
+{
+    pthread_mutex_lock(&s_lock);
+    uint32_t count = sector < PARTITION_MAX_SECTORS ? s_erase_counts[esp_partition_index(partition)][sector] : 0;
+    pthread_mutex_unlock(&s_lock);
+    return count;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype, const char *label)
+{
+    for (size_t i = 0; i < PARTITION_COUNT; i++)
+    {
+        const esp_partition_t *partition = &s_partitions[i];
+        if (partition->type == type && (subtype == ESP_PARTITION_SUBTYPE_ANY || partition->subtype == subtype) &&
+            (label == NULL || strcmp(partition->label, label) == 0))
+        {
+            pthread_mutex_lock(&s_lock);
+            bool open = esp_partition_open(i);
+            pthread_mutex_unlock(&s_lock);
+            return open ? partition : NULL;
+        }
+    }
+    return NULL;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+    if (!esp_partition_in_range(partition, src_offset, size))
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    pthread_mutex_lock(&s_lock);
+    memcpy(dst, esp_partition_flash(partition) + src_offset, size);
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size)
+{
+    const uint8_t *data = src;
+
+    if (!esp_partition_in_range(partition, dst_offset, size))
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    pthread_mutex_lock(&s_lock);
+    uint8_t *flash = esp_partition_flash(partition) + dst_offset;
+    for (size_t i = 0; i < size; i++)
+    {
+        if (s_power_loss && s_power_loss_bytes-- == 0)
+        {
+            /* What was programmed so far stays in the file, the rest of the write never happens */
+            _exit(HOST_FLASH_POWER_LOSS_STATUS);
+        }
+        flash[i] &= data[i];
+    }
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    if (!esp_partition_in_range(partition, offset, size))
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (offset % SPI_FLASH_SEC_SIZE != 0 || size % SPI_FLASH_SEC_SIZE != 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_lock);
+    memset(esp_partition_flash(partition) + offset, 0xFF, size);
+    for (size_t sector = offset / SPI_FLASH_SEC_SIZE; sector < (offset + size) / SPI_FLASH_SEC_SIZE; sector++)
+    {
+        if (sector < PARTITION_MAX_SECTORS)
+        {
+            s_erase_counts[esp_partition_index(partition)][sector]++;
+        }
+    }
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
@@ -0,0 +1,221 @@
+#include <stdlib.h>
+
+#include "esp_timer.h"
+
+#include "host_shim_internal.h"
+
+struct esp_timer
+{
+    esp_timer_cb_t callback;
+    void *arg;
+    bool armed;
+    bool deleted;
+    int64_t expiry_us;
+    uint64_t period_us; // 0 for one shot timers
+    struct esp_timer *next;
+};
+
+static pthread_once_t s_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_changed;
+static struct esp_timer *s_timers;
+static struct esp_timer *s_running;
+static struct timespec s_start;
+
+__attribute__((constructor)) static void host_time_init(void)
+{
+    clock_gettime(CLOCK_MONOTONIC, &s_start);
+}
+
+int64_t host_time_us(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)(now.tv_sec - s_start.tv_sec) * 1000000 + (now.tv_nsec - s_start.tv_nsec) / 1000;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return host_time_us();
+}
+
+/* Must be called with s_lock held */
+static struct esp_timer *esp_timer_next_expiry(void)
+{
+    struct esp_timer *next = NULL;
+
+    for (struct esp_timer *timer = s_timers; timer != NULL; timer = timer->next)
+    {
+        if (timer->armed && (next == NULL || timer->expiry_us < next->expiry_us))
+        {
+            next = timer;
+        }
+    }
+    return next;
+}
+
+/* Must be called with s_lock held */
+static void esp_timer_unlink(struct esp_timer *timer)
+{
+    for (struct esp_timer **link = &s_timers; *link != NULL; link = &(*link)->next)
+    {
+        if (*link == timer)
+        {
+            *link = timer->next;
+            return;
+        }
+    }
+}
+
+static void *esp_timer_task(void *arg)
+{
+    (void)arg;
+
+    pthread_setname_np(pthread_self(), "esp_timer");
+    pthread_mutex_lock(&s_lock);
+    while (1)
+    {
+        struct esp_timer *timer = esp_timer_next_expiry();
+        if (timer == NULL)
+        {
+            pthread_cond_wait(&s_changed, &s_lock);
+            continue;
+        }
+        int64_t now_us = host_time_us();
+        if (timer->expiry_us > now_us)
+        {
+            struct timespec deadline;
+            host_deadline(timer->expiry_us - now_us, &deadline);
+            pthread_cond_timedwait(&s_changed, &s_lock, &deadline);
+            continue;
+        }
+
+        if (timer->period_us > 0)
+        {
+            timer->expiry_us += timer->period_us;
+        }
+        else
+        {
+            timer->armed = false;
+        }
+        /* Callbacks may start, stop or delete timers, including their own */
+        s_running = timer;
+        pthread_mutex_unlock(&s_lock);
+        timer->callback(timer->arg);
+        pthread_mutex_lock(&s_lock);
+        s_running = NULL;
+        if (timer->deleted)
+        {
+            free(timer);
+        }
+    }
+    return NULL;
+}
+
+static void esp_timer_start_task(void)
+{
+    pthread_t thread;
+
+    host_condition_init(&s_changed);
+    pthread_create(&thread, NULL, esp_timer_task, NULL);
+    pthread_detach(thread);
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args, esp_timer_handle_t *out_handle)
+{
+    if (create_args == NULL || create_args->callback == NULL || out_handle == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct esp_timer *timer = calloc(1, sizeof(*timer));
+    if (timer == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    timer->callback = create_args->callback;
+    timer->arg = create_args->arg;
+
+    pthread_once(&s_once, esp_timer_start_task);
+    pthread_mutex_lock(&s_lock);
+    timer->next = s_timers;
+    s_timers = timer;
+    pthread_mutex_unlock(&s_lock);
+
+    *out_handle = timer;
+    return ESP_OK;
+}
+
+static esp_err_t esp_timer_start(esp_timer_handle_t timer, uint64_t timeout_us, uint64_t period_us)
+{
+    esp_err_t err = ESP_OK;
+
+    pthread_mutex_lock(&s_lock);
+    if (timer->armed)
+    {
+        err = ESP_ERR_INVALID_STATE;
+    }
+    else
+    {
+        timer->armed = true;
+        timer->expiry_us = host_time_us() + (int64_t)timeout_us;
+        timer->period_us = period_us;
+        pthread_cond_signal(&s_changed);
+    }
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    return esp_timer_start(timer, timeout_us, 0);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period)
+{
+    return esp_timer_start(timer, period, period);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    esp_err_t err = ESP_OK;
+
+    pthread_mutex_lock(&s_lock);
+    if (!timer->armed)
+    {
+        err = ESP_ERR_INVALID_STATE;
+    }
+    timer->armed = false;
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    pthread_mutex_lock(&s_lock);
+    if (timer->armed)
+    {
+        pthread_mutex_unlock(&s_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_timer_unlink(timer);
+    if (timer == s_running)
+    {
+        /* Freed by the timer task once the callback returned */
+        timer->deleted = true;
+    }
+    else
+    {
+        free(timer);
+    }
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer)
+{
+    pthread_mutex_lock(&s_lock);
+    bool armed = timer->armed;
+    pthread_mutex_unlock(&s_lock);
+    return armed;
+}
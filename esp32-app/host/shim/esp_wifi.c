@@ -0,0 +1,288 @@
+#include <string.h>
+
+#include "esp_wifi.h"
+#include "esp_netif.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+#include "host_shim.h"
+
+ESP_EVENT_DEFINE_BASE(WIFI_EVENT);
+ESP_EVENT_DEFINE_BASE(IP_EVENT);
+
+typedef enum
+{
+    HOST_WIFI_IDLE,
+    HOST_WIFI_CONNECTING,
+    HOST_WIFI_CONNECTED,
+} host_wifi_state_t;
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static esp_timer_handle_t s_attempt_timer;
+static bool s_started;
+static wifi_config_t s_config;
+static host_wifi_state_t s_state;
+static bool s_attempt_succeeds;
+
+/* Simulated access point */
+static uint8_t s_bssid[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+static uint8_t s_channel = 6;
+static bool s_available = true;
+static uint32_t s_scan_ms = 1500;
+static uint32_t s_probe_ms = 100;
+/* Access point the station is connected to */
+static uint8_t s_joined_bssid[6];
+static uint8_t s_joined_channel;
+
+static host_wifi_counters_t s_counters;
+
+static void host_wifi_post_disconnected(uint8_t reason)
+{
+    wifi_event_sta_disconnected_t event = {.reason = reason};
+
+    memcpy(event.ssid, s_config.sta.ssid, sizeof(event.ssid));
+    event.ssid_len = strnlen((const char *)s_config.sta.ssid, sizeof(s_config.sta.ssid));
+    esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, &event, sizeof(event), portMAX_DELAY);
+}
+
+/* End of a connection attempt, on the esp_timer task */
+static void host_wifi_attempt_done(void *arg)
+{
+    (void)arg;
+    wifi_event_sta_connected_t connected = {0};
+    bool succeeded;
+
+    portENTER_CRITICAL(&s_lock);
+    if (s_state != HOST_WIFI_CONNECTING)
+    {
+        /* Cancelled by esp_wifi_disconnect() */
+        portEXIT_CRITICAL(&s_lock);
+        return;
+    }
+    succeeded = s_attempt_succeeds && s_available;
+    if (succeeded)
+    {
+        s_state = HOST_WIFI_CONNECTED;
+        memcpy(s_joined_bssid, s_bssid, sizeof(s_joined_bssid));
+        s_joined_channel = s_channel;
+        memcpy(connected.bssid, s_bssid, sizeof(connected.bssid));
+        connected.channel = s_channel;
+        s_counters.connects++;
+    }
+    else
+    {
+        s_state = HOST_WIFI_IDLE;
+        s_counters.disconnects++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (succeeded)
+    {
+        ip_event_got_ip_t got_ip = {.ip_info = {.ip = {.addr = 0x0100007F}}};
+        esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_CONNECTED, &connected, sizeof(connected), portMAX_DELAY);
+        esp_event_post(IP_EVENT, IP_EVENT_STA_GOT_IP, &got_ip, sizeof(got_ip), portMAX_DELAY);
+    }
+    else
+    {
+        host_wifi_post_disconnected(WIFI_REASON_NO_AP_FOUND);
+    }
+}
+
+/* Must be called with s_lock held. Returns true if the station was connected. */
+static bool host_wifi_drop_locked(void)
+{
+    if (s_state != HOST_WIFI_CONNECTED)
+    {
+        return false;
+    }
+    s_state = HOST_WIFI_IDLE;
+    s_counters.disconnects++;
+    return true;
+}
+
+esp_err_t esp_netif_init(void)
+{
+    return ESP_OK;
+}
+
+esp_netif_t *esp_netif_create_default_wifi_sta(void)
+{
+    static int s_netif;
+    return (esp_netif_t *)&s_netif;
+}
+
+esp_err_t esp_wifi_init(const wifi_init_config_t *config)
+{
+    (void)config;
+    const esp_timer_create_args_t timer_args = {
+        .callback = host_wifi_attempt_done,
+        .name = "wifi attempt"};
+
+    return s_attempt_timer == NULL ? esp_timer_create(&timer_args, &s_attempt_timer) : ESP_OK;
+}
+
+esp_err_t esp_wifi_set_storage(wifi_storage_t storage)
+{
+    (void)storage;
+    return s_attempt_timer != NULL ? ESP_OK : ESP_ERR_WIFI_NOT_INIT;
+}
+
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode)
+{
+    if (s_attempt_timer == NULL)
+    {
+        return ESP_ERR_WIFI_NOT_INIT;
+    }
+    return mode == WIFI_MODE_STA ? ESP_OK : ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_wifi_set_config(wifi_interface_t interface, wifi_config_t *conf)
+{
+    if (interface != WIFI_IF_STA)
+    {
+        return ESP_ERR_WIFI_IF;
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_config = *conf;
+    portEXIT_CRITICAL(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_start(void)
+{
+    if (s_attempt_timer == NULL)
+    {
+        return ESP_ERR_WIFI_NOT_INIT;
+    }
+    s_started = true;
+    return esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_START, NULL, 0, portMAX_DELAY);
+}
+
+esp_err_t esp_wifi_stop(void)
+{
+    esp_wifi_disconnect();
+    s_started = false;
+    return esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_STOP, NULL, 0, portMAX_DELAY);
+}
+
+esp_err_t esp_wifi_connect(void)
+{
+    uint32_t duration_ms;
+
+    if (!s_started)
+    {
+        return ESP_ERR_WIFI_NOT_STARTED;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    s_counters.attempts++;
+    if (s_config.sta.bssid_set && s_config.sta.channel != 0)
+    {
+        /* Probes the given channel for the given access point only */
+        duration_ms = s_probe_ms;
+        s_attempt_succeeds = memcmp(s_config.sta.bssid, s_bssid, sizeof(s_bssid)) == 0 && s_config.sta.channel == s_channel;
+    }
+    else
+    {
+        s_counters.scans++;
+        duration_ms = s_scan_ms;
+        s_attempt_succeeds = true;
+    }
+    /* A new attempt replaces the one in progress */
+    s_state = HOST_WIFI_CONNECTING;
+    esp_timer_stop(s_attempt_timer);
+    esp_timer_start_once(s_attempt_timer, (uint64_t)duration_ms * 1000);
+    portEXIT_CRITICAL(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_disconnect(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool was_connected = host_wifi_drop_locked();
+    if (s_state == HOST_WIFI_CONNECTING)
+    {
+        esp_timer_stop(s_attempt_timer);
+        s_state = HOST_WIFI_IDLE;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (was_connected)
+    {
+        host_wifi_post_disconnected(WIFI_REASON_ASSOC_LEAVE);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t *ap_info)
+{
+    esp_err_t err = ESP_ERR_WIFI_NOT_CONNECT;
+
+    portENTER_CRITICAL(&s_lock);
+    if (s_state == HOST_WIFI_CONNECTED)
+    {
+        memset(ap_info, 0, sizeof(*ap_info));
+        memcpy(ap_info->bssid, s_joined_bssid, sizeof(ap_info->bssid));
+        memcpy(ap_info->ssid, s_config.sta.ssid, sizeof(s_config.sta.ssid));
+        ap_info->primary = s_joined_channel;
+        ap_info->rssi = -50;
+        err = ESP_OK;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return err;
+}
+
+void host_wifi_set_access_point(const uint8_t bssid[6], uint8_t channel)
+{
+    portENTER_CRITICAL(&s_lock);
+    memcpy(s_bssid, bssid, sizeof(s_bssid));
+    s_channel = channel;
+    bool dropped = (memcmp(s_joined_bssid, bssid, sizeof(s_joined_bssid)) != 0 || s_joined_channel != channel) &&
+                   host_wifi_drop_locked();
+    portEXIT_CRITICAL(&s_lock);
+
+    if (dropped)
+    {
+        host_wifi_post_disconnected(WIFI_REASON_BEACON_TIMEOUT);
+    }
+}
+
+void host_wifi_set_available(bool available)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_available = available;
+    bool dropped = !available && host_wifi_drop_locked();
+    portEXIT_CRITICAL(&s_lock);
+
+    if (dropped)
+    {
+        host_wifi_post_disconnected(WIFI_REASON_BEACON_TIMEOUT);
+    }
+}
+
+void host_wifi_set_timing(uint32_t scan_ms, uint32_t probe_ms)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_scan_ms = scan_ms;
+    s_probe_ms = probe_ms;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void host_wifi_drop(uint8_t reason)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool dropped = host_wifi_drop_locked();
+    portEXIT_CRITICAL(&s_lock);
+
+    if (dropped)
+    {
+        host_wifi_post_disconnected(reason);
+    }
+}
+
+void host_wifi_get_counters(host_wifi_counters_t *counters)
+{
+    portENTER_CRITICAL(&s_lock);
+    *counters = s_counters;
+    portEXIT_CRITICAL(&s_lock);
+}
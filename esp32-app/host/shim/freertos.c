@@ -0,0 +1,512 @@
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+
+#include "host_shim_internal.h"
+
+struct host_task
+{
+    TaskFunction_t function;
+    void *parameters;
+    char name[16];
+    pthread_mutex_t mutex;
+    pthread_cond_t notified;
+    uint32_t notification;
+};
+
+struct host_queue
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t count;
+    UBaseType_t head;
+    uint8_t *storage;
+};
+
+struct host_event_group
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;
+    EventBits_t bits;
+};
+
+/* Task of the calling thread, created on first use for threads that are not FreeRTOS tasks */
+static __thread struct host_task *s_current_task;
+
+void host_condition_init(pthread_cond_t *condition)
+{
+    pthread_condattr_t attributes;
+
+    pthread_condattr_init(&attributes);
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+    pthread_cond_init(condition, &attributes);
+    pthread_condattr_destroy(&attributes);
+}
+
+void host_deadline(int64_t timeout_us, struct timespec *deadline)
+{
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+    deadline->tv_sec += timeout_us / 1000000;
+    deadline->tv_nsec += (timeout_us % 1000000) * 1000;
+    if (deadline->tv_nsec >= 1000000000)
+    {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000;
+    }
+}
+
+/* Waits on the condition until the deadline, forever with portMAX_DELAY. Returns false on timeout. */
+static bool host_wait(pthread_cond_t *condition, pthread_mutex_t *mutex, TickType_t ticks, const struct timespec *deadline)
+{
+    if (ticks == portMAX_DELAY)
+    {
+        pthread_cond_wait(condition, mutex);
+        return true;
+    }
+    return pthread_cond_timedwait(condition, mutex, deadline) != ETIMEDOUT;
+}
+
+static void host_ticks_deadline(TickType_t ticks, struct timespec *deadline)
+{
+    if (ticks != portMAX_DELAY)
+    {
+        host_deadline((int64_t)ticks * (1000000 / configTICK_RATE_HZ), deadline);
+    }
+}
+
+void vPortCPUInitializeMutex(portMUX_TYPE *mux)
+{
+    pthread_mutexattr_t attributes;
+
+    pthread_mutexattr_init(&attributes);
+    pthread_mutexattr_settype(&attributes, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&mux->mutex, &attributes);
+    pthread_mutexattr_destroy(&attributes);
+}
+
+void vPortEnterCritical(portMUX_TYPE *mux)
+{
+    pthread_mutex_lock(&mux->mutex);
+}
+
+void vPortExitCritical(portMUX_TYPE *mux)
+{
+    pthread_mutex_unlock(&mux->mutex);
+}
+
+void vPortYield(void)
+{
+    sched_yield();
+}
+
+BaseType_t xPortGetCoreID(void)
+{
+    return 0;
+}
+
+static struct host_task *host_task_new(const char *name)
+{
+    struct host_task *task = calloc(1, sizeof(*task));
+
+    if (task == NULL)
+    {
+        return NULL;
+    }
+    snprintf(task->name, sizeof(task->name), "%s", name);
+    pthread_mutex_init(&task->mutex, NULL);
+    host_condition_init(&task->notified);
+    return task;
+}
+
+static void *host_task_main(void *arg)
+{
+    struct host_task *task = arg;
+
+    s_current_task = task;
+    /* Thread names are limited to 15 characters, which is also the FreeRTOS default */
+    pthread_setname_np(pthread_self(), task->name);
+    task->function(task->parameters);
+    /* Returning from a task is a fatal error on the target */
+    fprintf(stderr, "Task %s returned from its function\n", task->name);
+    abort();
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t pvTaskCode, const char *const pcName, const uint32_t usStackDepth,
+                                   void *const pvParameters, UBaseType_t uxPriority, TaskHandle_t *const pvCreatedTask,
+                                   const BaseType_t xCoreID)
+{
+    (void)usStackDepth;
+    (void)uxPriority;
+    (void)xCoreID;
+    pthread_attr_t attributes;
+    pthread_t thread;
+
+    struct host_task *task = host_task_new(pcName);
+    if (task == NULL)
+    {
+        return pdFAIL;
+    }
+    task->function = pvTaskCode;
+    task->parameters = pvParameters;
+    if (pvCreatedTask != NULL)
+    {
+        /* Set before the task runs, tasks often notify their creator through it */
+        *pvCreatedTask = task;
+    }
+
+    pthread_attr_init(&attributes);
+    pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+    int err = pthread_create(&thread, &attributes, host_task_main, task);
+    pthread_attr_destroy(&attributes);
+    if (err != 0)
+    {
+        if (pvCreatedTask != NULL)
+        {
+            *pvCreatedTask = NULL;
+        }
+        free(task);
+        return pdFAIL;
+    }
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t xTaskToDelete)
+{
+    if (xTaskToDelete != NULL && xTaskToDelete != s_current_task)
+    {
+        fprintf(stderr, "vTaskDelete() of another task is not supported on the host\n");
+        abort();
+    }
+    /* The handle stays valid, other tasks may still notify it */
+    pthread_exit(NULL);
+}
+
+void vTaskDelay(const TickType_t xTicksToDelay)
+{
+    if (xTicksToDelay == 0)
+    {
+        sched_yield();
+        return;
+    }
+    int64_t delay_us = (int64_t)xTicksToDelay * (1000000 / configTICK_RATE_HZ);
+    struct timespec delay = {.tv_sec = delay_us / 1000000, .tv_nsec = (delay_us % 1000000) * 1000};
+    while (nanosleep(&delay, &delay) != 0 && errno == EINTR)
+    {
+    }
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(host_time_us() / (1000000 / configTICK_RATE_HZ));
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    if (s_current_task == NULL)
+    {
+        s_current_task = host_task_new("main");
+    }
+    return s_current_task;
+}
+
+char *pcTaskGetName(TaskHandle_t xTaskToQuery)
+{
+    TaskHandle_t task = xTaskToQuery != NULL ? xTaskToQuery : xTaskGetCurrentTaskHandle();
+    return task->name;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t xTaskToNotify)
+{
+    pthread_mutex_lock(&xTaskToNotify->mutex);
+    xTaskToNotify->notification++;
+    pthread_cond_signal(&xTaskToNotify->notified);
+    pthread_mutex_unlock(&xTaskToNotify->mutex);
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t xTaskToNotify, BaseType_t *pxHigherPriorityTaskWoken)
+{
+    if (pxHigherPriorityTaskWoken != NULL)
+    {
+        *pxHigherPriorityTaskWoken = pdFALSE;
+    }
+    xTaskNotifyGive(xTaskToNotify);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit, TickType_t xTicksToWait)
+{
+    struct host_task *task = xTaskGetCurrentTaskHandle();
+    struct timespec deadline;
+    uint32_t value;
+
+    host_ticks_deadline(xTicksToWait, &deadline);
+    pthread_mutex_lock(&task->mutex);
+    while (task->notification == 0 && xTicksToWait != 0)
+    {
+        if (!host_wait(&task->notified, &task->mutex, xTicksToWait, &deadline))
+        {
+            break;
+        }
+    }
+    value = task->notification;
+    if (value != 0)
+    {
+        task->notification = xClearCountOnExit ? 0 : value - 1;
+    }
+    pthread_mutex_unlock(&task->mutex);
+    return value;
+}
+
+static QueueHandle_t host_queue_new(UBaseType_t length, UBaseType_t item_size)
+{
+    struct host_queue *queue = calloc(1, sizeof(*queue));
+
+    if (queue == NULL)
+    {
+        return NULL;
+    }
+    if (item_size > 0)
+    {
+        queue->storage = malloc((size_t)length * item_size);
+        if (queue->storage == NULL)
+        {
+            free(queue);
+            return NULL;
+        }
+    }
+    queue->length = length;
+    queue->item_size = item_size;
+    pthread_mutex_init(&queue->mutex, NULL);
+    host_condition_init(&queue->not_empty);
+    host_condition_init(&queue->not_full);
+    return queue;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t uxQueueLength, UBaseType_t uxItemSize)
+{
+    return host_queue_new(uxQueueLength, uxItemSize);
+}
+
+QueueHandle_t xQueueCreateCountingSemaphore(UBaseType_t uxMaxCount, UBaseType_t uxInitialCount)
+{
+    QueueHandle_t queue = host_queue_new(uxMaxCount, 0);
+
+    if (queue != NULL)
+    {
+        queue->count = uxInitialCount;
+    }
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t xQueue)
+{
+    pthread_mutex_destroy(&xQueue->mutex);
+    pthread_cond_destroy(&xQueue->not_empty);
+    pthread_cond_destroy(&xQueue->not_full);
+    free(xQueue->storage);
+    free(xQueue);
+}
+
+static BaseType_t host_queue_send(QueueHandle_t queue, const void *item, TickType_t ticks, bool front)
+{
+    struct timespec deadline;
+
+    host_ticks_deadline(ticks, &deadline);
+    pthread_mutex_lock(&queue->mutex);
+    while (queue->count == queue->length)
+    {
+        if (ticks == 0 || !host_wait(&queue->not_full, &queue->mutex, ticks, &deadline))
+        {
+            pthread_mutex_unlock(&queue->mutex);
+            return errQUEUE_FULL;
+        }
+    }
+    if (queue->item_size > 0)
+    {
+        UBaseType_t index;
+        if (front)
+        {
+            queue->head = (queue->head + queue->length - 1) % queue->length;
+            index = queue->head;
+        }
+        else
+        {
+            index = (queue->head + queue->count) % queue->length;
+        }
+        memcpy(queue->storage + (size_t)index * queue->item_size, item, queue->item_size);
+    }
+    queue->count++;
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->mutex);
+    return pdPASS;
+}
+
+BaseType_t xQueueSend(QueueHandle_t xQueue, const void *pvItemToQueue, TickType_t xTicksToWait)
+{
+    return host_queue_send(xQueue, pvItemToQueue, xTicksToWait, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t xQueue, const void *pvItemToQueue, TickType_t xTicksToWait)
+{
+    return host_queue_send(xQueue, pvItemToQueue, xTicksToWait, true);
+}
+
+static BaseType_t host_queue_receive(QueueHandle_t queue, void *buffer, TickType_t ticks, bool remove)
+{
+    struct timespec deadline;
+
+    host_ticks_deadline(ticks, &deadline);
+    pthread_mutex_lock(&queue->mutex);
+    while (queue->count == 0)
+    {
+        if (ticks == 0 || !host_wait(&queue->not_empty, &queue->mutex, ticks, &deadline))
+        {
+            pthread_mutex_unlock(&queue->mutex);
+            return errQUEUE_EMPTY;
+        }
+    }
+    if (queue->item_size > 0 && buffer != NULL)
+    {
+        memcpy(buffer, queue->storage + (size_t)queue->head * queue->item_size, queue->item_size);
+    }
+    if (remove)
+    {
+        if (queue->item_size > 0)
+        {
+            queue->head = (queue->head + 1) % queue->length;
+        }
+        queue->count--;
+        pthread_cond_signal(&queue->not_full);
+    }
+    else
+    {
+        /* Other receivers may be waiting for the same item */
+        pthread_cond_signal(&queue->not_empty);
+    }
+    pthread_mutex_unlock(&queue->mutex);
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t xQueue, void *pvBuffer, TickType_t xTicksToWait)
+{
+    return host_queue_receive(xQueue, pvBuffer, xTicksToWait, true);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t xQueue, void *pvBuffer, TickType_t xTicksToWait)
+{
+    return host_queue_receive(xQueue, pvBuffer, xTicksToWait, false);
+}
+
+BaseType_t xQueueReset(QueueHandle_t xQueue)
+{
+    pthread_mutex_lock(&xQueue->mutex);
+    xQueue->count = 0;
+    xQueue->head = 0;
+    pthread_cond_broadcast(&xQueue->not_full);
+    pthread_mutex_unlock(&xQueue->mutex);
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(const QueueHandle_t xQueue)
+{
+    pthread_mutex_lock(&xQueue->mutex);
+    UBaseType_t count = xQueue->count;
+    pthread_mutex_unlock(&xQueue->mutex);
+    return count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(const QueueHandle_t xQueue)
+{
+    pthread_mutex_lock(&xQueue->mutex);
+    UBaseType_t spaces = xQueue->length - xQueue->count;
+    pthread_mutex_unlock(&xQueue->mutex);
+    return spaces;
+}
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    struct host_event_group *group = calloc(1, sizeof(*group));
+
+    if (group != NULL)
+    {
+        pthread_mutex_init(&group->mutex, NULL);
+        host_condition_init(&group->changed);
+    }
+    return group;
+}
+
+void vEventGroupDelete(EventGroupHandle_t xEventGroup)
+{
+    pthread_mutex_destroy(&xEventGroup->mutex);
+    pthread_cond_destroy(&xEventGroup->changed);
+    free(xEventGroup);
+}
+
+static bool host_bits_satisfied(EventBits_t bits, EventBits_t wait_for, BaseType_t all)
+{
+    return all ? (bits & wait_for) == wait_for : (bits & wait_for) != 0;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t xEventGroup, const EventBits_t uxBitsToWaitFor,
+                                const BaseType_t xClearOnExit, const BaseType_t xWaitForAllBits, TickType_t xTicksToWait)
+{
+    struct timespec deadline;
+    EventBits_t bits;
+
+    host_ticks_deadline(xTicksToWait, &deadline);
+    pthread_mutex_lock(&xEventGroup->mutex);
+    while (!host_bits_satisfied(xEventGroup->bits, uxBitsToWaitFor, xWaitForAllBits) && xTicksToWait != 0)
+    {
+        if (!host_wait(&xEventGroup->changed, &xEventGroup->mutex, xTicksToWait, &deadline))
+        {
+            break;
+        }
+    }
+    bits = xEventGroup->bits;
+    if (xClearOnExit && host_bits_satisfied(bits, uxBitsToWaitFor, xWaitForAllBits))
+    {
+        xEventGroup->bits &= ~uxBitsToWaitFor;
+    }
+    pthread_mutex_unlock(&xEventGroup->mutex);
+    return bits;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t xEventGroup, const EventBits_t uxBitsToSet)
+{
+    pthread_mutex_lock(&xEventGroup->mutex);
+    xEventGroup->bits |= uxBitsToSet;
+    EventBits_t bits = xEventGroup->bits;
+    pthread_cond_broadcast(&xEventGroup->changed);
+    pthread_mutex_unlock(&xEventGroup->mutex);
+    return bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t xEventGroup, const EventBits_t uxBitsToClear)
+{
+    pthread_mutex_lock(&xEventGroup->mutex);
+    /* Returns the bits before they were cleared, like FreeRTOS */
+    EventBits_t bits = xEventGroup->bits;
+    xEventGroup->bits &= ~uxBitsToClear;
+    pthread_mutex_unlock(&xEventGroup->mutex);
+    return bits;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t xEventGroup)
+{
+    pthread_mutex_lock(&xEventGroup->mutex);
+    EventBits_t bits = xEventGroup->bits;
+    pthread_mutex_unlock(&xEventGroup->mutex);
+    return bits;
+}
@@ -0,0 +1,13 @@
+/* Helpers shared by the host shims, not part of the ESP-IDF API */
+#pragma once
+
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+
+/* Microseconds since the program started, the time base of esp_timer_get_time() */
+int64_t host_time_us(void);
+
+/* Condition variable on CLOCK_MONOTONIC, the clock of all deadlines */
+void host_condition_init(pthread_cond_t *condition);
+void host_deadline(int64_t timeout_us, struct timespec *deadline);
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "esp_err.h"
+
+typedef struct
+{
+    int max_freq_mhz;
+    int min_freq_mhz;
+    bool light_sleep_enable;
+} esp_pm_config_esp32_t;
+
+/* Always ESP_ERR_NOT_SUPPORTED, the host never sleeps */
+esp_err_t esp_pm_configure(const void *config);
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_attr.h"
+#include "esp_bit_defs.h"
+#include "esp_idf_version.h"
+
+uint32_t esp_random(void);
+esp_err_t esp_efuse_mac_get_default(uint8_t *mac);
+uint32_t esp_get_free_heap_size(void);
+void esp_restart(void) __attribute__((noreturn));
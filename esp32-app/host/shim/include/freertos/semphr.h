@@ -0,0 +1,20 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+/* A semaphore is a queue of items without data, the count is the number of items */
+typedef QueueHandle_t SemaphoreHandle_t;
+
+QueueHandle_t xQueueCreateCountingSemaphore(UBaseType_t uxMaxCount, UBaseType_t uxInitialCount);
+
+#define xSemaphoreCreateBinary() xQueueCreateCountingSemaphore(1, 0)
+#define xSemaphoreCreateCounting(uxMaxCount, uxInitialCount) xQueueCreateCountingSemaphore(uxMaxCount, uxInitialCount)
+/* No priority inheritance and no owner, enough for the way the application uses its mutexes */
+#define xSemaphoreCreateMutex() xQueueCreateCountingSemaphore(1, 1)
+#define vSemaphoreDelete(xSemaphore) vQueueDelete(xSemaphore)
+#define xSemaphoreTake(xSemaphore, xBlockTime) xQueueReceive(xSemaphore, NULL, xBlockTime)
+#define xSemaphoreGive(xSemaphore) xQueueSend(xSemaphore, NULL, 0)
+#define xSemaphoreTakeFromISR(xSemaphore, pxHigherPriorityTaskWoken) xQueueReceive(xSemaphore, NULL, 0)
+#define xSemaphoreGiveFromISR(xSemaphore, pxHigherPriorityTaskWoken) xQueueSend(xSemaphore, NULL, 0)
+#define uxSemaphoreGetCount(xSemaphore) uxQueueMessagesWaiting(xSemaphore)
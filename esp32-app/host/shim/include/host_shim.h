@@ -0,0 +1,120 @@
+/*
+ * Controls of the simulated peripherals behind the host shims. Not part of ESP-IDF, only used by
+ * the host firmware and the host tests to play the network, the broker, the flash and the display.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_partition.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Access point of the esp_wifi shim */
+typedef struct
+{
+    uint32_t attempts;   // esp_wifi_connect() calls
+    uint32_t scans;      // attempts that scanned all channels
+    uint32_t connects;   // attempts that ended with an IP address
+    uint32_t disconnects; // WIFI_EVENT_STA_DISCONNECTED events, failed attempts included
+} host_wifi_counters_t;
+
+/**
+ * Move the access point. A station connected to the old BSSID is disconnected, a station that
+ * joins the old BSSID directly does not find it anymore.
+ */
+void host_wifi_set_access_point(const uint8_t bssid[6], uint8_t channel);
+
+/**
+ * Switch the access point on or off. Switching it off disconnects the station with
+ * WIFI_REASON_BEACON_TIMEOUT.
+ */
+void host_wifi_set_available(bool available);
+
+/**
+ * Duration of a connection attempt that scans all channels and of one that probes the cached
+ * channel only. Both include the association and DHCP when the access point is found.
+ */
+void host_wifi_set_timing(uint32_t scan_ms, uint32_t probe_ms);
+
+/** Drop the current connection with the given reason, as the access point would */
+void host_wifi_drop(uint8_t reason);
+
+void host_wifi_get_counters(host_wifi_counters_t *counters);
+
+/* Key value store of the nvs shim, in memory */
+
+/** Number of nvs_commit() calls that changed the stored data */
+uint32_t host_nvs_get_write_count(void);
+
+/* Broker of the mqtt_client shim */
+typedef void (*host_mqtt_receiver_t)(const char *topic, const uint8_t *data, size_t length, void *arg);
+
+typedef struct
+{
+    uint32_t connects;
+    uint32_t published; // QoS 1 messages received by the broker
+    uint32_t acked;     // MQTT_EVENT_PUBLISHED events
+    uint32_t dropped;   // published but not acknowledged because the connection was lost
+} host_mqtt_counters_t;
+
+/**
+ * Make the broker reachable or not. An unreachable broker disconnects the client, the
+ * acknowledgements still in flight are lost. The client reconnects once it is reachable again.
+ */
+void host_mqtt_set_available(bool available);
+
+/** Time between a publish and its acknowledgement */
+void host_mqtt_set_ack_delay_us(uint32_t delay_us);
+
+/** Called on the publishing task for every message the broker receives */
+void host_mqtt_set_receiver(host_mqtt_receiver_t receiver, void *arg);
+
+void host_mqtt_get_counters(host_mqtt_counters_t *counters);
+
+/* Loopback server of the esp_http_server shim */
+
+/** TCP port of the servers started after this call, in place of the configured one. 0 picks a free port. */
+void host_httpd_set_port(uint16_t port);
+
+/** Port the last started server listens on */
+uint16_t host_httpd_get_port(void);
+
+/* Flash of the esp_partition shim */
+
+/** Exit status of a process that lost power, see host_flash_set_power_loss() */
+#define HOST_FLASH_POWER_LOSS_STATUS 75
+
+/**
+ * Keep the data partitions in the file at path instead of in memory, so that they survive the end
+ * of the process like the flash survives a reboot. A missing file is created as erased flash. Call
+ * before the first esp_partition_find_first(), path must stay valid.
+ */
+void host_flash_set_file(const char *path);
+
+/**
+ * Lose the power once bytes more bytes were programmed: the process exits with
+ * HOST_FLASH_POWER_LOSS_STATUS in the middle of the write, what it programmed until then stays in
+ * the flash.
+ */
+void host_flash_set_power_loss(uint32_t bytes);
+
+/** Erases of a sector of a partition since the start of the process */
+uint32_t host_flash_get_erase_count(const esp_partition_t *partition, uint32_t sector);
+
+/* Line of the uart driver shim */
+
+/**
+ * Device end of the line of a UART port, the master side of a pseudo terminal. What the driver
+ * writes is read from it and what is written to it is received by the driver. The line is opened
+ * on first use and outlives uart_driver_delete(), like the wire.
+ */
+int host_uart_get_device_fd(int port);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,82 @@
+/*
+ * Configuration of the host build, in place of the sdkconfig.h generated by menuconfig. The values
+ * are the Kconfig defaults except that all sensors are installed and simulated, so that every
+ * component runs against the simulated devices.
+ */
+#pragma once
+
+#define CONFIG_IDF_TARGET_ESP32 1
+#define CONFIG_FREERTOS_HZ 100
+
+/* AIR QUALITY SENSORS CONFIGURATION */
+#define CONFIG_VOC_INSTALLED 1
+#define CONFIG_CO2_INSTALLED 1
+#define CONFIG_PM_INSTALLED 1
+#define CONFIG_ACQUISITION_MODE_CONTINUOUS 1
+
+/* SENSIRION DRIVERS CONFIGURATION */
+/* The UART loopback test puts the simulated SPS30 behind the pty of the uart shim instead */
+#ifndef HOST_SENSIRION_UART_PTY
+#define CONFIG_SENSIRION_SIMULATED_SENSORS 1
+#endif
+/* Defined by the targets that build the SPS30 UART driver */
+#ifdef HOST_SPS30_INTERFACE_UART
+#define CONFIG_SENSIRION_SPS30_INTERFACE_UART 1
+#define CONFIG_SENSIRION_UART_PORT 1
+#define CONFIG_SENSIRION_UART_TX 25
+#define CONFIG_SENSIRION_UART_RX 26
+#else
+#define CONFIG_SENSIRION_SPS30_INTERFACE_I2C 1
+#define CONFIG_SENSIRION_SPS30_I2C_PORT 1
+#endif
+#define CONFIG_SENSIRION_I2C0_SDA 21
+#define CONFIG_SENSIRION_I2C0_SCL 22
+#define CONFIG_SENSIRION_I2C0_CLK_SPEED 400000
+#define CONFIG_SENSIRION_I2C1_SDA 27
+#define CONFIG_SENSIRION_I2C1_SCL 14
+#define CONFIG_SENSIRION_I2C1_CLK_SPEED 100000
+#define CONFIG_SENSIRION_SCD4X_I2C_PORT 1
+#define CONFIG_SENSIRION_SVM40_I2C_PORT 1
+/* The CRC8 tests build the other implementations too */
+#if !defined(CONFIG_SENSIRION_CRC8_BITWISE) && !defined(CONFIG_SENSIRION_CRC8_TABLE_RAM)
+#define CONFIG_SENSIRION_CRC8_TABLE_FLASH 1
+#endif
+
+/* TELEMETRY CONFIGURATION, the broker is the fake one of the host mqtt_client */
+#define CONFIG_TELEMETRY_MQTT_BROKER_URI "mqtt://localhost"
+#define CONFIG_TELEMETRY_MQTT_TOPIC "airquality"
+#define CONFIG_TELEMETRY_MQTT_WINDOW 8
+
+/* WIFI CONFIGURATION, the access point is the simulated one of the host esp_wifi */
+#define CONFIG_WIFI_SSID "host"
+#define CONFIG_WIFI_PASSWORD "host"
+#define CONFIG_WIFI_BACKOFF_MAX_S 60
+
+/* AIR QUALITY INDEX CONFIGURATION */
+/* The AQI tests build the European index too */
+#ifndef CONFIG_AQI_STANDARD_EU
+#define CONFIG_AQI_STANDARD_US_EPA 1
+#endif
+
+/* GUI CONFIGURATION, the options are set by the host build options of the same name */
+#ifdef HOST_GUI_FLUSH_TASK
+#define CONFIG_GUI_FLUSH_TASK 1
+#endif
+#ifdef HOST_GUI_BENCHMARK
+#define CONFIG_GUI_BENCHMARK 1
+#endif
+#define CONFIG_GUI_BENCHMARK_FRAMES 100
+
+/* LVGL, a 240x240 ST7789 with the fonts used by the GUI */
+#define CONFIG_LV_CONF_SKIP 1
+#define CONFIG_LV_HOR_RES_MAX 240
+#define CONFIG_LV_VER_RES_MAX 240
+#define CONFIG_LV_COLOR_DEPTH 16
+#define CONFIG_LV_TFT_DISPLAY_CONTROLLER_ST7789 1
+#define CONFIG_LV_FONT_MONTSERRAT_12 1
+#define CONFIG_LV_FONT_MONTSERRAT_14 1
+#define CONFIG_LV_FONT_MONTSERRAT_16 1
+#define CONFIG_LV_FONT_MONTSERRAT_18 1
+#define CONFIG_LV_FONT_MONTSERRAT_22 1
+#define CONFIG_LV_FONT_MONTSERRAT_26 1
+#define CONFIG_LV_FONT_MONTSERRAT_28 1
@@ -0,0 +1,9 @@
+/* newlib string.h has the BSD functions the application uses, glibc only since 2.38 */
+#pragma once
+
+#include_next <string.h>
+
+#if defined(__GLIBC__) && (__GLIBC__ < 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ < 38))
+#define HOST_SHIM_STRLCPY
+size_t strlcpy(char *dst, const char *src, size_t size);
+#endif
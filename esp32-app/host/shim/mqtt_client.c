@@ -0,0 +1,241 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "mqtt_client.h"
+
+#include "host_shim.h"
+#include "host_shim_internal.h"
+
+/* Messages the broker received and did not acknowledge yet */
+#define MQTT_MAX_IN_FLIGHT 64
+
+typedef struct
+{
+    int msg_id;
+    int64_t ack_us;
+} mqtt_pending_t;
+
+struct esp_mqtt_client
+{
+    bool persistent_session;
+    esp_event_handler_t handler;
+    void *handler_arg;
+    bool started;
+    bool connected;
+    bool session;
+    int next_msg_id;
+    mqtt_pending_t pending[MQTT_MAX_IN_FLIGHT];
+    unsigned pending_head;
+    unsigned pending_count;
+};
+
+static const char *const MQTT_EVENTS = "MQTT_EVENTS";
+
+/* The broker state, shared with the host controls */
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_changed;
+static pthread_once_t s_once = PTHREAD_ONCE_INIT;
+static bool s_available = true;
+static uint32_t s_ack_delay_us = 20000;
+static host_mqtt_receiver_t s_receiver;
+static void *s_receiver_arg;
+static host_mqtt_counters_t s_counters;
+
+static void mqtt_init_condition(void)
+{
+    host_condition_init(&s_changed);
+}
+
+static void mqtt_dispatch(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event_id, int msg_id, int session_present)
+{
+    esp_mqtt_event_t event = {
+        .event_id = event_id,
+        .client = client,
+        .msg_id = msg_id,
+        .session_present = session_present,
+    };
+
+    if (client->handler != NULL)
+    {
+        client->handler(client->handler_arg, MQTT_EVENTS, event_id, &event);
+    }
+}
+
+/* The client task, connects, acknowledges and disconnects as the broker dictates */
+static void *mqtt_client_task(void *arg)
+{
+    esp_mqtt_client_handle_t client = arg;
+
+    pthread_setname_np(pthread_self(), "mqtt_task");
+    pthread_mutex_lock(&s_lock);
+    while (client->started)
+    {
+        if (!client->connected && s_available)
+        {
+            int session_present = client->session && client->persistent_session;
+            client->connected = true;
+            client->session = true;
+            s_counters.connects++;
+            pthread_mutex_unlock(&s_lock);
+            mqtt_dispatch(client, MQTT_EVENT_CONNECTED, 0, session_present);
+            pthread_mutex_lock(&s_lock);
+        }
+        else if (client->connected && !s_available)
+        {
+            client->connected = false;
+            s_counters.dropped += client->pending_count;
+            client->pending_count = 0;
+            pthread_mutex_unlock(&s_lock);
+            mqtt_dispatch(client, MQTT_EVENT_DISCONNECTED, 0, 0);
+            pthread_mutex_lock(&s_lock);
+        }
+        else if (client->connected && client->pending_count > 0 &&
+                 client->pending[client->pending_head].ack_us <= host_time_us())
+        {
+            int msg_id = client->pending[client->pending_head].msg_id;
+            client->pending_head = (client->pending_head + 1) % MQTT_MAX_IN_FLIGHT;
+            client->pending_count--;
+            s_counters.acked++;
+            pthread_mutex_unlock(&s_lock);
+            mqtt_dispatch(client, MQTT_EVENT_PUBLISHED, msg_id, 0);
+            pthread_mutex_lock(&s_lock);
+        }
+        else if (client->connected && client->pending_count > 0)
+        {
+            struct timespec deadline;
+            host_deadline(client->pending[client->pending_head].ack_us - host_time_us(), &deadline);
+            pthread_cond_timedwait(&s_changed, &s_lock, &deadline);
+        }
+        else
+        {
+            pthread_cond_wait(&s_changed, &s_lock);
+        }
+    }
+    pthread_mutex_unlock(&s_lock);
+    return NULL;
+}
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *config)
+{
+    esp_mqtt_client_handle_t client = calloc(1, sizeof(*client));
+
+    if (client != NULL)
+    {
+        client->persistent_session = config->disable_clean_session;
+        client->next_msg_id = 1;
+    }
+    pthread_once(&s_once, mqtt_init_condition);
+    return client;
+}
+
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event,
+                                         esp_event_handler_t event_handler, void *event_handler_arg)
+{
+    if (event != MQTT_EVENT_ANY)
+    {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    client->handler = event_handler;
+    client->handler_arg = event_handler_arg;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client)
+{
+    pthread_t thread;
+
+    pthread_mutex_lock(&s_lock);
+    if (client->started)
+    {
+        pthread_mutex_unlock(&s_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    client->started = true;
+    pthread_mutex_unlock(&s_lock);
+
+    if (pthread_create(&thread, NULL, mqtt_client_task, client) != 0)
+    {
+        client->started = false;
+        return ESP_FAIL;
+    }
+    pthread_detach(thread);
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_stop(esp_mqtt_client_handle_t client)
+{
+    pthread_mutex_lock(&s_lock);
+    client->started = false;
+    client->connected = false;
+    pthread_cond_broadcast(&s_changed);
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len, int qos, int retain)
+{
+    (void)retain;
+    int msg_id = 0;
+
+    if (len == 0)
+    {
+        len = strlen(data);
+    }
+
+    pthread_mutex_lock(&s_lock);
+    if (!client->connected || (qos > 0 && client->pending_count == MQTT_MAX_IN_FLIGHT))
+    {
+        pthread_mutex_unlock(&s_lock);
+        return -1;
+    }
+    if (qos > 0)
+    {
+        msg_id = client->next_msg_id;
+        client->next_msg_id = client->next_msg_id == 0xFFFF ? 1 : client->next_msg_id + 1;
+        unsigned tail = (client->pending_head + client->pending_count) % MQTT_MAX_IN_FLIGHT;
+        client->pending[tail] = (mqtt_pending_t){.msg_id = msg_id, .ack_us = host_time_us() + s_ack_delay_us};
+        client->pending_count++;
+        s_counters.published++;
+        pthread_cond_broadcast(&s_changed);
+    }
+    host_mqtt_receiver_t receiver = s_receiver;
+    void *receiver_arg = s_receiver_arg;
+    pthread_mutex_unlock(&s_lock);
+
+    if (receiver != NULL)
+    {
+        receiver(topic, (const uint8_t *)data, len, receiver_arg);
+    }
+    return msg_id;
+}
+
+void host_mqtt_set_available(bool available)
+{
+    pthread_once(&s_once, mqtt_init_condition);
+    pthread_mutex_lock(&s_lock);
+    s_available = available;
+    pthread_cond_broadcast(&s_changed);
+    pthread_mutex_unlock(&s_lock);
+}
+
+void host_mqtt_set_ack_delay_us(uint32_t delay_us)
+{
+    pthread_mutex_lock(&s_lock);
+    s_ack_delay_us = delay_us;
+    pthread_mutex_unlock(&s_lock);
+}
+
+void host_mqtt_set_receiver(host_mqtt_receiver_t receiver, void *arg)
+{
+    pthread_mutex_lock(&s_lock);
+    s_receiver = receiver;
+    s_receiver_arg = arg;
+    pthread_mutex_unlock(&s_lock);
+}
+
+void host_mqtt_get_counters(host_mqtt_counters_t *counters)
+{
+    pthread_mutex_lock(&s_lock);
+    *counters = s_counters;
+    pthread_mutex_unlock(&s_lock);
+}
@@ -0,0 +1,253 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nvs_flash.h"
+#include "freertos/FreeRTOS.h"
+
+#include "host_shim.h"
+
+#define NVS_MAX_ENTRIES 32
+#define NVS_MAX_HANDLES 8
+#define NVS_KEY_NAME_MAX_SIZE 16
+
+typedef struct
+{
+    char namespace_name[NVS_KEY_NAME_MAX_SIZE];
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    void *value;
+    size_t length;
+} nvs_entry_t;
+
+typedef struct
+{
+    bool open;
+    bool writable;
+    bool dirty;
+    char namespace_name[NVS_KEY_NAME_MAX_SIZE];
+} nvs_handle_entry_t;
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool s_initialized;
+static nvs_entry_t s_entries[NVS_MAX_ENTRIES];
+static nvs_handle_entry_t s_handles[NVS_MAX_HANDLES];
+static uint32_t s_write_count;
+
+/* Must be called with s_lock held */
+static nvs_handle_entry_t *nvs_get_handle(nvs_handle_t handle)
+{
+    return handle >= 1 && handle <= NVS_MAX_HANDLES && s_handles[handle - 1].open ? &s_handles[handle - 1] : NULL;
+}
+
+/* Must be called with s_lock held */
+static nvs_entry_t *nvs_find(const char *namespace_name, const char *key)
+{
+    for (size_t i = 0; i < NVS_MAX_ENTRIES; i++)
+    {
+        if (s_entries[i].value != NULL && strcmp(s_entries[i].namespace_name, namespace_name) == 0 &&
+            strcmp(s_entries[i].key, key) == 0)
+        {
+            return &s_entries[i];
+        }
+    }
+    return NULL;
+}
+
+esp_err_t nvs_flash_init(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_initialized = true;
+    portEXIT_CRITICAL(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    for (size_t i = 0; i < NVS_MAX_ENTRIES; i++)
+    {
+        free(s_entries[i].value);
+        s_entries[i].value = NULL;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    esp_err_t err = ESP_ERR_NO_MEM;
+
+    if (strlen(name) >= NVS_KEY_NAME_MAX_SIZE)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    portENTER_CRITICAL(&s_lock);
+    if (!s_initialized)
+    {
+        err = ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+    else
+    {
+        for (size_t i = 0; i < NVS_MAX_HANDLES; i++)
+        {
+            if (!s_handles[i].open)
+            {
+                s_handles[i] = (nvs_handle_entry_t){.open = true, .writable = open_mode == NVS_READWRITE};
+                strcpy(s_handles[i].namespace_name, name);
+                *out_handle = i + 1;
+                err = ESP_OK;
+                break;
+            }
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return err;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    esp_err_t err = ESP_OK;
+
+    portENTER_CRITICAL(&s_lock);
+    nvs_handle_entry_t *entry = nvs_get_handle(handle);
+    nvs_entry_t *value = entry != NULL ? nvs_find(entry->namespace_name, key) : NULL;
+    if (entry == NULL)
+    {
+        err = ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    else if (value == NULL)
+    {
+        err = ESP_ERR_NVS_NOT_FOUND;
+    }
+    else if (out_value == NULL)
+    {
+        *length = value->length;
+    }
+    else if (*length < value->length)
+    {
+        err = ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    else
+    {
+        memcpy(out_value, value->value, value->length);
+        *length = value->length;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return err;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    esp_err_t err = ESP_OK;
+
+    if (strlen(key) >= NVS_KEY_NAME_MAX_SIZE)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    portENTER_CRITICAL(&s_lock);
+    nvs_handle_entry_t *entry = nvs_get_handle(handle);
+    nvs_entry_t *stored = entry != NULL ? nvs_find(entry->namespace_name, key) : NULL;
+    if (entry == NULL)
+    {
+        err = ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    else if (!entry->writable)
+    {
+        err = ESP_ERR_NVS_READ_ONLY;
+    }
+    else if (stored != NULL && stored->length == length && memcmp(stored->value, value, length) == 0)
+    {
+        /* The target does not write unchanged values either */
+    }
+    else
+    {
+        for (size_t i = 0; stored == NULL && i < NVS_MAX_ENTRIES; i++)
+        {
+            if (s_entries[i].value == NULL)
+            {
+                stored = &s_entries[i];
+                strcpy(stored->namespace_name, entry->namespace_name);
+                strcpy(stored->key, key);
+            }
+        }
+        void *copy = malloc(length > 0 ? length : 1);
+        if (stored == NULL || copy == NULL)
+        {
+            free(copy);
+            err = ESP_ERR_NVS_NO_FREE_PAGES;
+        }
+        else
+        {
+            memcpy(copy, value, length);
+            free(stored->value);
+            stored->value = copy;
+            stored->length = length;
+            entry->dirty = true;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return err;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    esp_err_t err = ESP_OK;
+
+    portENTER_CRITICAL(&s_lock);
+    nvs_handle_entry_t *entry = nvs_get_handle(handle);
+    nvs_entry_t *stored = entry != NULL ? nvs_find(entry->namespace_name, key) : NULL;
+    if (entry == NULL)
+    {
+        err = ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    else if (stored == NULL)
+    {
+        err = ESP_ERR_NVS_NOT_FOUND;
+    }
+    else
+    {
+        free(stored->value);
+        stored->value = NULL;
+        entry->dirty = true;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return err;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    esp_err_t err = ESP_OK;
+
+    portENTER_CRITICAL(&s_lock);
+    nvs_handle_entry_t *entry = nvs_get_handle(handle);
+    if (entry == NULL)
+    {
+        err = ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    else if (entry->dirty)
+    {
+        entry->dirty = false;
+        s_write_count++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return err;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+    portENTER_CRITICAL(&s_lock);
+    nvs_handle_entry_t *entry = nvs_get_handle(handle);
+    if (entry != NULL)
+    {
+        entry->open = false;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+uint32_t host_nvs_get_write_count(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    uint32_t count = s_write_count;
+    portEXIT_CRITICAL(&s_lock);
+    return count;
+}
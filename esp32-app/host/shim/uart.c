@@ -0,0 +1,259 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "driver/uart.h"
+#include "esp_log.h"
+
+#include "host_shim.h"
+#include "host_shim_internal.h"
+
+#define TAG "uart"
+
+/* The line of a port: the driver holds the terminal side, the device the master side */
+typedef struct
+{
+    int driver_fd;
+    int device_fd;
+    bool installed;
+} host_uart_t;
+
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static host_uart_t s_ports[UART_NUM_MAX] = {
+    [0 ... UART_NUM_MAX - 1] = {.driver_fd = -1, .device_fd = -1},
+};
+
+/* Opens the pseudo terminal of the port on first use, in raw mode so that every byte goes through */
+static bool host_uart_open(uart_port_t port)
+{
+    host_uart_t *uart = &s_ports[port];
+    struct termios settings;
+
+    if (uart->device_fd >= 0)
+    {
+        return true;
+    }
+    int device_fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (device_fd < 0 || grantpt(device_fd) != 0 || unlockpt(device_fd) != 0)
+    {
+        ESP_LOGE(TAG, "UART%d: no pseudo terminal: %d", port, errno);
+        if (device_fd >= 0)
+        {
+            close(device_fd);
+        }
+        return false;
+    }
+    int driver_fd = open(ptsname(device_fd), O_RDWR | O_NOCTTY);
+    if (driver_fd < 0 || tcgetattr(driver_fd, &settings) != 0)
+    {
+        ESP_LOGE(TAG, "UART%d: cannot open %s: %d", port, ptsname(device_fd), errno);
+        if (driver_fd >= 0)
+        {
+            close(driver_fd);
+        }
+        close(device_fd);
+        return false;
+    }
+    cfmakeraw(&settings);
+    tcsetattr(driver_fd, TCSANOW, &settings);
+    uart->driver_fd = driver_fd;
+    uart->device_fd = device_fd;
+    return true;
+}
+
+/* The terminal side of an installed driver, -1 otherwise */
+static int host_uart_driver_fd(uart_port_t port)
+{
+    int fd = -1;
+
+    if (port < 0 || port >= UART_NUM_MAX)
+    {
+        return -1;
+    }
+    pthread_mutex_lock(&s_lock);
+    if (s_ports[port].installed)
+    {
+        fd = s_ports[port].driver_fd;
+    }
+    pthread_mutex_unlock(&s_lock);
+    return fd;
+}
+
+int host_uart_get_device_fd(int port)
+{
+    int fd = -1;
+
+    if (port < 0 || port >= UART_NUM_MAX)
+    {
+        return -1;
+    }
+    pthread_mutex_lock(&s_lock);
+    if (host_uart_open(port))
+    {
+        fd = s_ports[port].device_fd;
+    }
+    pthread_mutex_unlock(&s_lock);
+    return fd;
+}
+
+esp_err_t uart_param_config(uart_port_t uart_num, const uart_config_t *uart_config)
+{
+    return uart_num >= 0 && uart_num < UART_NUM_MAX && uart_config != NULL ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t uart_set_pin(uart_port_t uart_num, int tx_io_num, int rx_io_num, int rts_io_num, int cts_io_num)
+{
+    (void)tx_io_num;
+    (void)rx_io_num;
+    (void)rts_io_num;
+    (void)cts_io_num;
+    return uart_num >= 0 && uart_num < UART_NUM_MAX ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t uart_driver_install(uart_port_t uart_num, int rx_buffer_size, int tx_buffer_size, int queue_size,
+                              QueueHandle_t *uart_queue, int intr_alloc_flags)
+{
+    esp_err_t err = ESP_OK;
+
+    (void)rx_buffer_size;
+    (void)tx_buffer_size;
+    (void)queue_size;
+    (void)intr_alloc_flags;
+
+    if (uart_num < 0 || uart_num >= UART_NUM_MAX || uart_queue != NULL)
+    {
+        /* No event queue, nothing of the application waits for UART events */
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_lock);
+    if (s_ports[uart_num].installed)
+    {
+        err = ESP_FAIL;
+    }
+    else if (!host_uart_open(uart_num))
+    {
+        err = ESP_ERR_NO_MEM;
+    }
+    else
+    {
+        s_ports[uart_num].installed = true;
+    }
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+esp_err_t uart_driver_delete(uart_port_t uart_num)
+{
+    if (uart_num < 0 || uart_num >= UART_NUM_MAX)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    /* The line stays, bytes still on it are read by the next driver */
+    pthread_mutex_lock(&s_lock);
+    s_ports[uart_num].installed = false;
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+int uart_write_bytes(uart_port_t uart_num, const void *src, size_t size)
+{
+    const uint8_t *data = src;
+    size_t written = 0;
+    int fd = host_uart_driver_fd(uart_num);
+
+    if (fd < 0)
+    {
+        return -1;
+    }
+    /* Blocks until everything is on the line, like the driver without a TX buffer */
+    while (written < size)
+    {
+        ssize_t count = write(fd, &data[written], size - written);
+        if (count < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (count <= 0)
+        {
+            return -1;
+        }
+        written += count;
+    }
+    return written;
+}
+
+int uart_read_bytes(uart_port_t uart_num, void *buf, uint32_t length, TickType_t ticks_to_wait)
+{
+    uint8_t *data = buf;
+    uint32_t received = 0;
+    int fd = host_uart_driver_fd(uart_num);
+    int64_t end_us = host_time_us() + (int64_t)ticks_to_wait * portTICK_PERIOD_MS * 1000;
+
+    if (fd < 0)
+    {
+        return -1;
+    }
+    /* Waits until length bytes arrived or the time is up, returns what arrived */
+    while (received < length)
+    {
+        struct pollfd poll_fd = {.fd = fd, .events = POLLIN};
+        int timeout_ms = -1;
+
+        if (ticks_to_wait != portMAX_DELAY)
+        {
+            int64_t left_us = end_us - host_time_us();
+            timeout_ms = left_us > 0 ? (int)((left_us + 999) / 1000) : 0;
+        }
+        int ready = poll(&poll_fd, 1, timeout_ms);
+        if (ready < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (ready <= 0)
+        {
+            break;
+        }
+        ssize_t count = read(fd, &data[received], length - received);
+        if (count < 0 && (errno == EINTR || errno == EAGAIN))
+        {
+            continue;
+        }
+        if (count <= 0)
+        {
+            return received > 0 ? (int)received : -1;
+        }
+        received += count;
+    }
+    return received;
+}
+
+esp_err_t uart_get_buffered_data_len(uart_port_t uart_num, size_t *size)
+{
+    int count = 0;
+    int fd = host_uart_driver_fd(uart_num);
+
+    if (fd < 0 || ioctl(fd, FIONREAD, &count) != 0)
+    {
+        return ESP_FAIL;
+    }
+    *size = count;
+    return ESP_OK;
+}
+
+esp_err_t uart_flush_input(uart_port_t uart_num)
+{
+    int fd = host_uart_driver_fd(uart_num);
+
+    if (fd < 0)
+    {
+        return ESP_FAIL;
+    }
+    tcflush(fd, TCIFLUSH);
+    return ESP_OK;
+}
@@ -1,3 +1,4 @@
+#include <assert.h>
 #include <stdio.h>
 #include <stdbool.h>
 #include <string.h>
@@ -5,9 +6,10 @@
 /* esp specific includes */
 #include "esp_log.h"
 #include "esp_err.h"
+#include "esp_pm.h"
+#include "nvs_flash.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "driver/i2c.h"
 
 /* gui component includes */
 #include "gui_st7789.h"
@@ -30,24 +32,43 @@
 #endif
 
 #include "telemetry.h"
+#include "metrics.h"
+#include "statistics.h"
+#include "aqi.h"
+#include "sample_bus.h"
+#include "sensirion_i2c_hal.h"
+#include "energy.h"
+#include "wifi.h"
 
 #define TAG "main.c"
 
-/* GPIO pin used for I2C bus one */
-#define I2C1_SDA 27
-#define I2C1_SCL 14
+#if defined(CONFIG_ACQUISITION_MODE_SINGLE_SHOT)
+#define ACQUISITION_MODE_NAME "single shot"
+#elif defined(CONFIG_ACQUISITION_MODE_LOW_POWER)
+#define ACQUISITION_MODE_NAME "low power"
+#else
+#define ACQUISITION_MODE_NAME "continuous"
+#endif
 
 /* Static functions prototype */
 static void system_init();
 
 void app_main(void)
 {
-    int16_t voc_index, rhumidity, temperature;
-    uint16_t co2;
-    uint16_t pm2p5, pm10p0;
+    sample_bus_sample_t sample;
 
     system_init();
 
+    /* Subscribe before starting the sensors so that no sample is missed */
+    sample_bus_subscriber_t subscriber = sample_bus_subscribe(SAMPLE_BUS_ALL_SOURCES);
+    assert(subscriber != NULL);
+
+    /* Windowed statistics of every sample, also subscribes before the sensors start */
+    statistics_init();
+
+    /* Air quality index, computed once per sample for the display and the telemetry */
+    aqi_init();
+
 #ifdef CONFIG_VOC_INSTALLED
     /* Start voc index component. This shoud be called first before you can retrieve values
     from the sensor */
@@ -75,50 +96,86 @@ void app_main(void)
     /* Initialize telemetry. Initialize this after setting up all the sensors and cloud connection */
     telemetry_init();
 
+    /* Serve the latest values and internal counters over HTTP for scraping */
+    metrics_init();
+
     while (1)
     {
+        /* Only wake up when a sensor published a new sample */
+        uint32_t updated = sample_bus_wait(subscriber, portMAX_DELAY);
+
 #ifdef CONFIG_VOC_INSTALLED
-        voc_index_get_voc(&voc_index);
-        float real_voc = voc_index / 10.0;
-        voc_index_get_temperature(&temperature);
-        float real_temperature = temperature / 200.0;
-        voc_index_get_rhumidity(&rhumidity);
-        float real_rhumidity = rhumidity / 100.0;
-
-        /* Log sensor values from VOC sensor */
-        ESP_LOGI(TAG, "VOC: %.02f   Temperature: %.02f  Relative humidity: %.02f", real_voc, real_temperature, real_rhumidity);
+        if (updated & SAMPLE_BUS_SOURCE_BIT(SAMPLE_BUS_SOURCE_VOC))
+        {
+            sample_bus_get(SAMPLE_BUS_SOURCE_VOC, &sample);
+            float real_voc = sample.voc.voc_index / 10.0;
+            float real_temperature = sample.voc.temperature / 200.0;
+            float real_rhumidity = sample.voc.rhumidity / 100.0;
+
+            /* Log sensor values from VOC sensor */
+            ESP_LOGI(TAG, "VOC: %.02f   Temperature: %.02f  Relative humidity: %.02f", real_voc, real_temperature, real_rhumidity);
+        }
 #endif
 
 #ifdef CONFIG_CO2_INSTALLED
-        co2_get_co2(&co2);
-        /* Log sensor values from CO2 sensor*/
-        ESP_LOGI(TAG, "CO2: %i", co2);
+        if (updated & SAMPLE_BUS_SOURCE_BIT(SAMPLE_BUS_SOURCE_CO2))
+        {
+            sample_bus_get(SAMPLE_BUS_SOURCE_CO2, &sample);
+            /* Log sensor values from CO2 sensor*/
+            ESP_LOGI(TAG, "CO2: %i", sample.co2.co2);
+        }
 #endif
 
 #ifdef CONFIG_PM_INSTALLED
-        particulate_matter_get_pm10p0(&pm10p0);
-        float real_pm10p0 = pm10p0 / 1000.0;
-        particulate_matter_get_pm2p5(&pm2p5);
-        float real_pm2p5 = pm2p5 / 1000.0;
-        ESP_LOGI(TAG, "PM2.5: %0.2f PM10.0: %.02f", real_pm2p5, real_pm10p0);
+        if (updated & SAMPLE_BUS_SOURCE_BIT(SAMPLE_BUS_SOURCE_PM))
+        {
+            sample_bus_get(SAMPLE_BUS_SOURCE_PM, &sample);
+            ESP_LOGI(TAG, "PM2.5: %u.%u PM10.0: %u.%u", sample.pm.mc_2p5 / 10, sample.pm.mc_2p5 % 10, sample.pm.mc_10p0 / 10, sample.pm.mc_10p0 % 10);
+        }
 #endif
-        vTaskDelay(pdMS_TO_TICKS(2000));
     }
 }
 
 static void system_init()
 {
-    /* Initialize I2C port 1 */ /* This is where Sensirion sensors are connected */
-    i2c_config_t i2c1_config = {
-        .mode = I2C_MODE_MASTER,
-        .sda_io_num = I2C1_SDA,
-        .scl_io_num = I2C1_SCL,
-        .sda_pullup_en = true,
-        .scl_pullup_en = true,
-        .master.clk_speed = 100000};
-    i2c_param_config(I2C_NUM_1, &i2c1_config);
-    i2c_driver_install(I2C_NUM_1, i2c1_config.mode, 0, 0, 0);
-
-    /* Initialise WiFi */
+    /* Start energy accounting before any sensor changes state */
+    energy_init(ACQUISITION_MODE_NAME);
+
+#ifndef CONFIG_ACQUISITION_MODE_CONTINUOUS
+#if defined(CONFIG_PM_ENABLE) && defined(CONFIG_FREERTOS_USE_TICKLESS_IDLE)
+    /* Let the ESP32 light sleep between samples, the sensor tasks block for most of the
+    acquisition interval */
+    esp_pm_config_esp32_t pm_config = {
+        .max_freq_mhz = 80,
+        .min_freq_mhz = 40,
+        .light_sleep_enable = true};
+    esp_err_t err = esp_pm_configure(&pm_config);
+    if (err == ESP_OK)
+    {
+        energy_set_light_sleep_allowed(true);
+    }
+    else
+    {
+        ESP_LOGE(TAG, "Error configuring power management: %s", esp_err_to_name(err));
+    }
+#else
+    ESP_LOGW(TAG, "Light sleep needs CONFIG_PM_ENABLE and CONFIG_FREERTOS_USE_TICKLESS_IDLE, the ESP32 stays awake");
+#endif
+#endif
+
+    /* Initialize the I2C buses the Sensirion sensors are connected to, see the Sensirion drivers
+    configuration for pins, speeds and which sensor is on which bus */
+    sensirion_i2c_hal_init();
+
+    /* Initialise NVS, it holds the wifi calibration data and the cached access point */
+    esp_err_t nvs_err = nvs_flash_init();
+    if (nvs_err == ESP_ERR_NVS_NO_FREE_PAGES || nvs_err == ESP_ERR_NVS_NEW_VERSION_FOUND)
+    {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        nvs_err = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(nvs_err);
 
+    /* Initialise WiFi. Connects in the background, nothing waits for it */
+    initialize_wifi();
 }